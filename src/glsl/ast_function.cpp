@@ -351,6 +351,12 @@ match_function_by_name(const char *name,
       if (builtin == NULL)
 	 continue;
 
+      /* The bodies are needed for constant expression evaluation.  Read
+       * them before matching: reading a body replaces the parameters of
+       * the prototype it belongs to.
+       */
+      _mesa_glsl_read_builtin_function(state->builtins_to_link[i], name);
+
       bool is_exact = false;
       ir_function_signature *builtin_sig =
 	 builtin->matching_signature(actual_parameters, &is_exact);
@@ -410,6 +416,9 @@ no_matching_function_error(const char *name,
       if (f == NULL)
 	 continue;
 
+      if (i >= 0)
+	 _mesa_glsl_read_builtin_function(state->builtins_to_link[i], name);
+
       foreach_list (node, &f->signatures) {
 	 ir_function_signature *sig = (ir_function_signature *) node;
 
@@ -37,3 +37,26 @@ _mesa_glsl_initialize_functions(_mesa_glsl_parse_state *state)
 {
    (void) state;
 }
+
+void
+_mesa_glsl_read_builtin_function(gl_shader *sh, const char *name)
+{
+   (void) sh;
+   (void) name;
+}
+
+gl_shader *
+_mesa_glsl_get_builtin_profile(unsigned index)
+{
+   (void) index;
+   return NULL;
+}
+
+int
+_mesa_glsl_builtin_profile_index(gl_shader *sh)
+{
+   (void) sh;
+   return -1;
+}
+
+const char _mesa_glsl_builtin_functions_id[] = "";
@@ -3,12 +3,15 @@
 
 from __future__ import with_statement
 
+import hashlib
 import re
 import sys
 from glob import glob
 from os import path
+from shutil import rmtree
 from subprocess import Popen, PIPE
 from sys import argv
+from tempfile import mkdtemp
 
 # Local module: generator for texture lookup builtins
 from texture_builtins import generate_texture_functions
@@ -48,27 +51,15 @@ def get_builtin_definitions():
     read_glsl_files(fs)
     return fs
 
-def stringify(s):
-    # Work around MSVC's 65535 byte limit by outputting an array of characters
-    # rather than actual string literals.
-    if len(s) >= 65535:
-        #t = "/* Warning: length " + repr(len(s)) + " too large */\n"
-        t = ""
-        for c in re.sub('\s\s+', ' ', s):
-            if c == '\n':
-                t += '\n'
-            else:
-                t += "'" + c + "',"
-        return '{' + t[:-1] + '}'
-
-    t = s.replace('\\', '\\\\').replace('"', '\\"').replace('\n', '\\n"\n   "')
-    return '   "' + t + '"\n'
-
-def write_function_definitions():
-    fs = get_builtin_definitions()
-    for k, v in sorted(fs.iteritems()):
-        print 'static const char builtin_' + k + '[] ='
-        print stringify(v), ';'
+def write_blob(name, data):
+    print 'static const uint8_t ' + name + '[] = {'
+    for i in range(0, len(data), 12):
+        print '   ' + ' '.join(['0x%02x,' % ord(c) for c in data[i:i + 12]])
+    print '};'
+
+# A digest of all the built-in IR.  This identifies the built-in library
+# in the on-disk shader cache.
+ir_digest = hashlib.md5()
 
 def run_compiler(args):
     command = [compiler, '--dump-hir'] + args
@@ -96,32 +87,99 @@ def run_compiler(args):
 
     return (output, p.returncode)
 
-def write_profile(filename, profile):
+def run_serializer(args):
+    command = [compiler, '--serialize-builtins'] + args
+    p = Popen(command, 1, stdout=PIPE, shell=False)
+    output = p.communicate()[0]
+
+    if (p.returncode):
+        sys.stderr.write("Failed to serialize builtins with command:\n")
+        for arg in command:
+            sys.stderr.write(arg + " ")
+        sys.stderr.write("\n")
+        sys.stderr.write("Result:\n")
+        sys.stderr.write(output)
+        return (None, p.returncode)
+
+    # Each line is the name of a blob and its bytes in hex.
+    blobs = []
+    for line in output.splitlines():
+        (name, data) = line.split(' ', 1)
+        blobs.append((name, data.strip().decode('hex')))
+    return (blobs, p.returncode)
+
+# Blobs already written, mapped to their C names.  A function usually has
+# the same signatures, and so the same blob, in several profiles.
+body_names = {}
+body_counts = {}
+
+def write_body(func, data):
+    if (func, data) not in body_names:
+        n = body_counts.get(func, 0)
+        body_counts[func] = n + 1
+        name = 'builtin_' + func
+        if n > 0:
+            name += '_%d' % n
+        body_names[(func, data)] = name
+        write_blob(name, data)
+    return body_names[(func, data)]
+
+def write_profile(filename, profile, ir_dir):
     (proto_ir, returncode) = run_compiler([filename])
 
     if returncode != 0:
         print '#error builtins profile', profile, 'failed to compile'
         return
 
-    print 'static const char prototypes_for_' + profile + '[] ='
-    print stringify(proto_ir), ';'
-
-    # Print a table of all the functions (not signatures) referenced.
-    # This is done so we can avoid bothering with a hash table in the C++ code.
-
     function_names = set()
     for func in re.finditer(r'\(function (.+)\n', proto_ir):
         function_names.add(func.group(1))
 
-    print 'static const char *functions_for_' + profile + ' [] = {'
-    for func in sorted(function_names):
-        print '   builtin_' + func + ','
+    proto_file = path.join(ir_dir, profile + '.protos')
+    with open(proto_file, 'w') as f:
+        f.write(proto_ir)
+
+    # The IR is serialized into the binary form that ir_deserialize()
+    # reads: the prototypes of the profile, and the bodies of each
+    # function, which are read the first time a shader calls the function.
+    (blobs, returncode) = run_serializer(
+        [proto_file] + [path.join(ir_dir, func + '.ir')
+                        for func in sorted(function_names)])
+
+    if returncode != 0:
+        print '#error builtins profile', profile, 'failed to serialize'
+        return
+
+    ir_digest.update(profile)
+    for (name, data) in blobs:
+        ir_digest.update(name)
+        ir_digest.update(data)
+
+    write_blob('prototypes_for_' + profile, blobs[0][1])
+
+    # The table is sorted by name so that the body of a single function can
+    # be found with a binary search when a shader first uses it.  This is
+    # done so we can avoid bothering with a hash table in the C++ code.
+    bodies = [(func, write_body(func, data)) for (func, data) in blobs[1:]]
+    print 'static const builtin_function functions_for_' + profile + ' [] = {'
+    for (func, name) in bodies:
+        print '   { "' + func + '", ' + name + ', sizeof(' + name + ') },'
     print '};'
 
 def write_profiles():
+    fs = get_builtin_definitions()
+
+    # The serializer reads the IR of each function from a file of its own.
+    ir_dir = mkdtemp()
+    for k, v in fs.iteritems():
+        with open(path.join(ir_dir, k + '.ir'), 'w') as f:
+            f.write(v)
+
     profiles = get_profile_list()
     for (filename, profile) in profiles:
-        write_profile(filename, profile)
+        write_profile(filename, profile, ir_dir)
+
+    rmtree(ir_dir)
 
 def get_profile_list():
     profile_files = []
@@ -160,26 +218,71 @@ if __name__ == "__main__":
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "main/core.h" /* for struct gl_shader */
+#include "glapi/glthread.h"
 #include "glsl_parser_extras.h"
-#include "ir_reader.h"
+#include "ir_serialize.h"
 #include "program.h"
 #include "ast.h"
 
 extern "C" struct gl_shader *
 _mesa_new_shader(struct gl_context *ctx, GLuint name, GLenum type);
 
-gl_shader *
-read_builtins(GLenum target, const char *protos, const char **functions, unsigned count)
+/**
+ * The serialized IR for the signatures of one built-in function that a
+ * profile has.
+ */
+struct builtin_function {
+   const char *name;
+   const uint8_t *ir;
+   size_t size;
+};
+
+/**
+ * A built-in profile.  Only the prototypes are read when the profile is
+ * first used; the body of each function is read the first time a shader
+ * calls it.
+ */
+struct builtin_profile_source {
+   const uint8_t *prototypes;
+   size_t prototypes_size;
+   const builtin_function *functions;
+   unsigned num_functions;
+};
+
+struct builtin_profile {
+   gl_shader *sh;
+   bool *loaded;        /**< which functions of the profile have been read */
+
+   /**
+    * Symbol table used while reading function bodies
+    *
+    * Reading a body adds any globals it uses to the symbol table, so that
+    * functions using the same global share it.  \c sh->symbols is searched
+    * by every shader that uses the profile, so it must not change once the
+    * prototypes are read.
+    */
+   glsl_symbol_table *body_symbols;
+};
+
+/**
+ * Protects the profiles.  Several contexts, or several threads linking
+ * one program, may read built-ins at the same time.
+ */
+_glthread_DECLARE_STATIC_MUTEX(builtin_mutex);
+
+static _mesa_glsl_parse_state *
+new_builtin_parse_state(struct gl_context *fakeCtx, GLenum target,
+                        void *mem_ctx)
 {
-   struct gl_context fakeCtx;
-   fakeCtx.API = API_OPENGL_COMPAT;
-   fakeCtx.Const.GLSLVersion = 140;
-   fakeCtx.Extensions.ARB_ES2_compatibility = true;
-   fakeCtx.Const.ForceGLSLExtensionsWarn = false;
-   gl_shader *sh = _mesa_new_shader(NULL, 0, target);
+   fakeCtx->API = API_OPENGL_COMPAT;
+   fakeCtx->Const.GLSLVersion = 140;
+   fakeCtx->Extensions.ARB_ES2_compatibility = true;
+   fakeCtx->Const.ForceGLSLExtensionsWarn = false;
    struct _mesa_glsl_parse_state *st =
-      new(sh) _mesa_glsl_parse_state(&fakeCtx, target, sh);
+      new(mem_ctx) _mesa_glsl_parse_state(fakeCtx, target, mem_ctx);
 
    st->language_version = 140;
    st->symbols->language_version = 140;
@@ -188,42 +291,117 @@ read_builtins(GLenum target, const char *protos, const char **functions, unsigne
    st->OES_EGL_image_external_enable = true;
    st->ARB_shader_bit_encoding_enable = true;
    st->ARB_texture_cube_map_array_enable = true;
+
+   return st;
+}
+
+gl_shader *
+read_builtins(GLenum target, const uint8_t *protos, size_t size)
+{
+   struct gl_context fakeCtx;
+   gl_shader *sh = _mesa_new_shader(NULL, 0, target);
+   struct _mesa_glsl_parse_state *st =
+      new_builtin_parse_state(&fakeCtx, target, sh);
+
    _mesa_glsl_initialize_types(st);
 
    sh->ir = new(sh) exec_list;
    sh->symbols = st->symbols;
 
-   /* Read the IR containing the prototypes */
-   _mesa_glsl_read_ir(st, sh->ir, protos, true);
-
-   /* Read ALL the function bodies, telling the IR reader not to scan for
-    * prototypes (we've already created them).  The IR reader will skip any
-    * signature that does not already exist as a prototype.
+   /* Read the prototypes.  The function bodies are read on demand by
+    * read_builtin_body().
     */
-   for (unsigned i = 0; i < count; i++) {
-      _mesa_glsl_read_ir(st, sh->ir, functions[i], false);
-
-      if (st->error) {
-         printf("error reading builtin: %.35s ...\\n", functions[i]);
-         printf("Info log:\\n%s\\n", st->info_log);
-         ralloc_free(sh);
-         return NULL;
-      }
+   ir_blob_reader reader(protos, size);
+   if (!ir_deserialize(sh, sh->ir, st->symbols, NULL, 0, &reader)) {
+      printf("error reading builtin prototypes\\n");
+      ralloc_free(sh);
+      return NULL;
    }
 
-   reparent_ir(sh->ir, sh);
    delete st;
 
    return sh;
 }
+
+/**
+ * Read the bodies of the signatures of one function into the profile's
+ * prototypes.
+ */
+static void
+read_builtin_body(builtin_profile *profile, const builtin_function *func)
+{
+   gl_shader *sh = profile->sh;
+   void *mem_ctx = ralloc_context(NULL);
+   exec_list instructions;
+   ir_blob_reader reader(func->ir, func->size);
+
+   /* Calls to other built-ins refer to the profile's prototypes.  Their
+    * bodies are read by load_builtin_function(), which holds the lock
+    * already.
+    */
+   if (!ir_deserialize(mem_ctx, &instructions, profile->body_symbols,
+                       &sh, 1, &reader, false)) {
+      printf("error reading builtin: %s\\n", func->name);
+      ralloc_free(mem_ctx);
+      return;
+   }
+
+   reparent_ir(&instructions, sh);
+
+   /* Shaders that were compiled before this point call the prototypes, so
+    * move the parameters and bodies there.  The function that was read is
+    * left empty.
+    */
+   ir_function *proto = sh->symbols->get_function(func->name);
+
+   while (!instructions.is_empty()) {
+      ir_instruction *ir = (ir_instruction *) instructions.pop_head();
+      ir_function *f = ir->as_function();
+
+      if (f == NULL) {
+         sh->ir->push_head(ir);
+         continue;
+      }
+
+      foreach_list(node, &f->signatures) {
+         ir_function_signature *sig = (ir_function_signature *) node;
+         ir_function_signature *proto_sig = proto == NULL ? NULL
+            : proto->exact_matching_signature(&sig->parameters);
+
+         if (proto_sig == NULL)
+            continue;
+
+         proto_sig->replace_parameters(&sig->parameters);
+         sig->body.move_nodes_to(&proto_sig->body);
+         proto_sig->is_defined = sig->is_defined;
+      }
+   }
+
+   ralloc_free(mem_ctx);
+}
+
+static int
+compare_builtin_function(const void *key, const void *elem)
+{
+   return strcmp((const char *) key, ((const builtin_function *) elem)->name);
+}
 """
 
-    write_function_definitions()
     write_profiles()
 
     profiles = get_profile_list()
 
-    print 'static gl_shader *builtin_profiles[%d];' % len(profiles)
+    print 'static const builtin_profile_source builtin_profile_sources[] = {'
+    for (filename, profile) in profiles:
+        print '   { prototypes_for_' + profile + ','
+        print '     sizeof(prototypes_for_' + profile + '),'
+        print '     functions_for_' + profile + ','
+        print '     Elements(functions_for_' + profile + ') },'
+    print '};'
+    print
+    print 'static builtin_profile builtin_profiles[%d];' % len(profiles)
+    print
+    print 'const char _mesa_glsl_builtin_functions_id[] = "%s";' % ir_digest.hexdigest()
 
     print """
 static void *builtin_mem_ctx = NULL;
@@ -236,36 +414,157 @@ _mesa_glsl_release_functions(void)
    memset(builtin_profiles, 0, sizeof(builtin_profiles));
 }
 
-static void
-_mesa_read_profile(struct _mesa_glsl_parse_state *state,
-                   int profile_index,
-		   const char *prototypes,
-		   const char **functions,
-                   int count)
+gl_shader *
+_mesa_glsl_get_builtin_profile(unsigned index)
 {
-   gl_shader *sh = builtin_profiles[profile_index];
+   if (index >= Elements(builtin_profiles))
+      return NULL;
 
-   if (sh == NULL) {
-      sh = read_builtins(GL_VERTEX_SHADER, prototypes, functions, count);
+   builtin_profile *profile = &builtin_profiles[index];
+
+   _glthread_LOCK_MUTEX(builtin_mutex);
+   if (builtin_mem_ctx == NULL) {
+      builtin_mem_ctx = ralloc_context(NULL); // "GLSL built-in functions"
+      memset(&builtin_profiles, 0, sizeof(builtin_profiles));
+   }
+
+   if (profile->sh == NULL) {
+      const builtin_profile_source *src = &builtin_profile_sources[index];
+      gl_shader *sh = read_builtins(GL_VERTEX_SHADER, src->prototypes,
+                                    src->prototypes_size);
       ralloc_steal(builtin_mem_ctx, sh);
-      builtin_profiles[profile_index] = sh;
+      profile->loaded = rzalloc_array(builtin_mem_ctx, bool,
+                                      src->num_functions);
+      profile->body_symbols = new(sh) glsl_symbol_table;
+      profile->sh = sh;
    }
+   _glthread_UNLOCK_MUTEX(builtin_mutex);
+
+   return profile->sh;
+}
+
+int
+_mesa_glsl_builtin_profile_index(gl_shader *sh)
+{
+   int index = -1;
+
+   /* Another thread may be reading the prototypes of a profile. */
+   _glthread_LOCK_MUTEX(builtin_mutex);
+   for (unsigned i = 0; i < Elements(builtin_profiles); i++) {
+      if (builtin_profiles[i].sh == sh) {
+         index = i;
+         break;
+      }
+   }
+   _glthread_UNLOCK_MUTEX(builtin_mutex);
+
+   return index;
+}
+
+static void
+_mesa_read_profile(struct _mesa_glsl_parse_state *state, int profile_index)
+{
+   gl_shader *sh = _mesa_glsl_get_builtin_profile(profile_index);
 
    state->builtins_to_link[state->num_builtins_to_link] = sh;
    state->num_builtins_to_link++;
 }
 
+static const builtin_function *
+find_builtin_function(unsigned index, const char *name)
+{
+   const builtin_profile_source *src = &builtin_profile_sources[index];
+   return (const builtin_function *)
+      bsearch(name, src->functions, src->num_functions,
+              sizeof(builtin_function), compare_builtin_function);
+}
+
+static void
+load_builtin_function(unsigned index, const builtin_function *func);
+
+/**
+ * Reads the bodies of the built-ins called by a freshly read body
+ *
+ * Constant expression evaluation and the linker both need the bodies of
+ * every function reachable from a call, e.g. \c acos calls \c asin.
+ */
+class builtin_callee_loader : public ir_hierarchical_visitor {
+public:
+   builtin_callee_loader(unsigned index)
+      : index(index)
+   {
+   }
+
+   virtual ir_visitor_status visit_enter(ir_call *ir)
+   {
+      const builtin_function *func =
+         find_builtin_function(this->index, ir->callee_name());
+      if (func != NULL)
+         load_builtin_function(this->index, func);
+
+      return visit_continue;
+   }
+
+private:
+   unsigned index;
+};
+
+/**
+ * Read the bodies of \c func and of everything it calls.  The caller must
+ * hold \c builtin_mutex.
+ */
+static void
+load_builtin_function(unsigned index, const builtin_function *func)
+{
+   builtin_profile *profile = &builtin_profiles[index];
+   const unsigned i = func - builtin_profile_sources[index].functions;
+
+   if (profile->loaded[i])
+      return;
+
+   /* Mark the function first so that recursion through its callees stops
+    * here.
+    */
+   profile->loaded[i] = true;
+   read_builtin_body(profile, func);
+
+   ir_function *f = profile->sh->symbols->get_function(func->name);
+   if (f == NULL)
+      return;
+
+   builtin_callee_loader v(index);
+   foreach_list(node, &f->signatures) {
+      ir_function_signature *sig = (ir_function_signature *) node;
+      v.run(&sig->body);
+   }
+}
+
+void
+_mesa_glsl_read_builtin_function(gl_shader *sh, const char *name)
+{
+   const int index = _mesa_glsl_builtin_profile_index(sh);
+   if (index < 0)
+      return;
+
+   const builtin_function *func = find_builtin_function(index, name);
+   if (func == NULL)
+      return;
+
+   /* Several contexts may be compiling or linking against the same
+    * profile at once.  The loaded flags and the signatures' bodies are
+    * only touched with the mutex held.
+    */
+   _glthread_LOCK_MUTEX(builtin_mutex);
+   load_builtin_function(index, func);
+   _glthread_UNLOCK_MUTEX(builtin_mutex);
+}
+
 void
 _mesa_glsl_initialize_functions(struct _mesa_glsl_parse_state *state)
 {
    /* If we've already initialized the built-ins, bail early. */
    if (state->num_builtins_to_link > 0)
       return;
-
-   if (builtin_mem_ctx == NULL) {
-      builtin_mem_ctx = ralloc_context(NULL); // "GLSL built-in functions"
-      memset(&builtin_profiles, 0, sizeof(builtin_profiles));
-   }
 """
 
     i = 0
@@ -284,12 +583,8 @@ _mesa_glsl_initialize_functions(struct _mesa_glsl_parse_state *state)
             check += 'state->' + version + '_enable'
 
         print '   if (' + check + ') {'
-        print '      _mesa_read_profile(state, %d,' % i
-        print '                         prototypes_for_' + profile + ','
-        print '                         functions_for_' + profile + ','
-        print '                         Elements(functions_for_' + profile + '));'
+        print '      _mesa_read_profile(state, %d);' % i
         print '   }'
         print
         i = i + 1
     print '}'
-
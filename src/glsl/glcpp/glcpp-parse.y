@@ -118,6 +118,10 @@ static void
 _glcpp_parser_expand_token_list (glcpp_parser_t *parser,
 				 token_list_t *list);
 
+static void
+_glcpp_parser_expand_tokens (glcpp_parser_t *parser,
+			     token_list_t *list);
+
 static void
 _glcpp_parser_print_expanded_token_list (glcpp_parser_t *parser,
 					 token_list_t *list);
@@ -248,7 +252,10 @@ control_line:
 		macro_t *macro = hash_table_find (parser->defines, $2);
 		if (macro) {
 			hash_table_remove (parser->defines, $2);
-			ralloc_free (macro);
+			parser->defines_generation++;
+			/* Macros imported from a prefix belong to it. */
+			if (ralloc_parent (macro) == parser)
+				ralloc_free (macro);
 		}
 		ralloc_free ($2);
 	}
@@ -337,7 +344,8 @@ control_line:
 		macro_t *macro = hash_table_find (parser->defines, "__VERSION__");
 		if (macro) {
 			hash_table_remove (parser->defines, "__VERSION__");
-			ralloc_free (macro);
+			if (ralloc_parent (macro) == parser)
+				ralloc_free (macro);
 		}
 		add_builtin_define (parser, "__VERSION__", $2);
 
@@ -937,11 +945,22 @@ _token_list_equal_ignoring_space (token_list_t *a, token_list_t *b)
 	return 1;
 }
 
+/* Append 'n' bytes of 'str' to the output, without the cost of
+ * formatting. Nearly every token printed is a string or a single
+ * character, so this is the common case. */
+static void
+_string_append (char **out, size_t *len, const char *str, size_t n)
+{
+	if (ralloc_str_append (out, str, *len, n))
+		*len += n;
+}
+
 static void
 _token_print (char **out, size_t *len, token_t *token)
 {
 	if (token->type < 256) {
-		ralloc_asprintf_rewrite_tail (out, len, "%c", token->type);
+		char c = token->type;
+		_string_append (out, len, &c, 1);
 		return;
 	}
 
@@ -952,10 +971,11 @@ _token_print (char **out, size_t *len, token_t *token)
 	case IDENTIFIER:
 	case INTEGER_STRING:
 	case OTHER:
-		ralloc_asprintf_rewrite_tail (out, len, "%s", token->value.str);
+		_string_append (out, len, token->value.str,
+				strlen (token->value.str));
 		break;
 	case SPACE:
-		ralloc_asprintf_rewrite_tail (out, len, " ");
+		_string_append (out, len, " ", 1);
 		break;
 	case LEFT_SHIFT:
 		ralloc_asprintf_rewrite_tail (out, len, "<<");
@@ -1167,6 +1187,10 @@ glcpp_parser_create (const struct gl_extensions *extensions, int api)
 	glcpp_lex_init_extra (parser, &parser->scanner);
 	parser->defines = hash_table_ctor (32, hash_table_string_hash,
 					   hash_table_string_compare);
+	parser->defines_generation = 0;
+	parser->expansions = hash_table_ctor (32, hash_table_pointer_hash,
+					      hash_table_pointer_compare);
+	parser->expansion_macros = NULL;
 	parser->active = NULL;
 	parser->lexing_if = 0;
 	parser->space_tokens = 1;
@@ -1189,6 +1213,7 @@ glcpp_parser_create (const struct gl_extensions *extensions, int api)
 	parser->new_line_number = 1;
 	parser->has_new_source_number = 0;
 	parser->new_source_number = 0;
+	parser->first_column = 1;
 
 	/* Add pre-defined macros. */
 	if (extensions != NULL) {
@@ -1247,9 +1272,30 @@ glcpp_parser_destroy (glcpp_parser_t *parser)
 {
 	glcpp_lex_destroy (parser->scanner);
 	hash_table_dtor (parser->defines);
+	hash_table_dtor (parser->expansions);
 	ralloc_free (parser);
 }
 
+static void
+_import_define (const void *key, void *data, void *closure)
+{
+	glcpp_parser_t *parser = closure;
+
+	hash_table_insert (parser->defines, data, key);
+}
+
+/* Replace the macros of 'parser', including the pre-defined ones, with
+ * those of 'source'. The macros are shared rather than copied, so
+ * 'source' must outlive 'parser' and must not define or undefine any
+ * more macros. */
+void
+glcpp_parser_import_defines (glcpp_parser_t *parser, glcpp_parser_t *source)
+{
+	hash_table_clear (parser->defines);
+	hash_table_call_foreach (source->defines, _import_define, parser);
+	parser->defines_generation++;
+}
+
 typedef enum function_status
 {
 	FUNCTION_STATUS_SUCCESS,
@@ -1530,7 +1576,14 @@ _glcpp_parser_expand_function (glcpp_parser_t *parser,
 				_token_list_append (substituted, new_token);
 			}
 		} else {
-			_token_list_append (substituted, node->token);
+			/* Expansion changes tokens in place, so copy
+			 * them rather than modify the macro, which may
+			 * be shared with other parsers. */
+			token_t *new_token;
+
+			new_token = ralloc (substituted, token_t);
+			*new_token = *node->token;
+			_token_list_append (substituted, new_token);
 		}
 	}
 
@@ -1544,6 +1597,112 @@ _glcpp_parser_expand_function (glcpp_parser_t *parser,
 	return substituted;
 }
 
+/* Does the last non-space token of 'list' name a function-like macro?
+ * If so, the expansion of 'list' depends on what follows it. */
+static int
+_token_list_ends_with_function_macro (glcpp_parser_t *parser,
+				      token_list_t *list)
+{
+	token_node_t *node;
+	token_t *last = NULL;
+	macro_t *macro;
+
+	for (node = list->head; node; node = node->next)
+		if (node->token->type != SPACE)
+			last = node->token;
+
+	if (last == NULL || last->type != IDENTIFIER)
+		return 0;
+
+	macro = hash_table_find (parser->defines, last->value.str);
+
+	return macro && macro->is_function;
+}
+
+/* Expand the object-like macro 'macro' on its own, the way it would be
+ * expanded anywhere that none of the macros it expands to are already
+ * being expanded. */
+static cached_expansion_t *
+_glcpp_parser_compute_expansion (glcpp_parser_t *parser, macro_t *macro)
+{
+	cached_expansion_t *cached;
+	token_list_t *list;
+	active_list_t *active = parser->active;
+	string_list_t *expansion_macros = parser->expansion_macros;
+	size_t info_log_length = parser->info_log_length;
+	int error = parser->error;
+
+	cached = ralloc (parser, cached_expansion_t);
+	cached->tokens = NULL;
+	cached->macros = _string_list_create (cached);
+	cached->generation = parser->defines_generation;
+
+	list = _token_list_copy (cached, macro->replacements);
+
+	parser->active = NULL;
+	parser->error = 0;
+	_parser_active_list_push (parser, macro->identifier, NULL);
+	parser->expansion_macros = cached->macros;
+
+	_glcpp_parser_apply_pastes (parser, list);
+	_glcpp_parser_expand_tokens (parser, list);
+
+	parser->expansion_macros = expansion_macros;
+	_parser_active_list_pop (parser);
+	parser->active = active;
+
+	if (parser->error) {
+		/* Take back any diagnostics. The macro will be expanded
+		 * again in context, which reports them where they
+		 * belong. */
+		parser->info_log[info_log_length] = '\0';
+		parser->info_log_length = info_log_length;
+	} else if (! _token_list_ends_with_function_macro (parser, list)) {
+		cached->tokens = list;
+	}
+
+	parser->error = error;
+
+	return cached;
+}
+
+/* Return a copy of the complete expansion of the object-like macro
+ * 'macro', or NULL if the cached expansion can't be used here.
+ *
+ * Headers full of #defines often define macros in terms of other
+ * macros, which makes expanding them again every time they are used
+ * costly. */
+static token_list_t *
+_glcpp_parser_expand_object_macro_cached (glcpp_parser_t *parser,
+					  macro_t *macro)
+{
+	cached_expansion_t *cached;
+	active_list_t *active;
+
+	/* Macros within an expansion being computed are expanded the
+	 * usual way, which also records them as ones it depends on. */
+	if (parser->expansion_macros)
+		return NULL;
+
+	cached = hash_table_find (parser->expansions, macro);
+	if (cached == NULL ||
+	    cached->generation != parser->defines_generation)
+	{
+		cached = _glcpp_parser_compute_expansion (parser, macro);
+		hash_table_replace (parser->expansions, cached, macro);
+	}
+
+	if (cached->tokens == NULL)
+		return NULL;
+
+	for (active = parser->active; active; active = active->next)
+		if (_string_list_contains (cached->macros,
+					   active->identifier, NULL))
+			return NULL;
+
+	return _token_list_copy (parser, cached->tokens);
+}
+
 /* Compute the complete expansion of node, (and subsequent nodes after
  * 'node' in the case that 'node' is a function-like macro and
  * subsequent nodes are arguments).
@@ -1624,6 +1783,11 @@ _glcpp_parser_expand_node (glcpp_parser_t *parser,
 		if (macro->replacements == NULL)
 			return _token_list_create_with_one_space (parser);
 
+		replacement = _glcpp_parser_expand_object_macro_cached (parser,
+									macro);
+		if (replacement)
+			return replacement;
+
 		replacement = _token_list_copy (parser, macro->replacements);
 		_glcpp_parser_apply_pastes (parser, replacement);
 		return replacement;
@@ -1652,6 +1816,10 @@ _parser_active_list_push (glcpp_parser_t *parser,
 	node->next = parser->active;
 
 	parser->active = node;
+
+	if (parser->expansion_macros)
+		_string_list_append_item (parser->expansion_macros,
+					  identifier);
 }
 
 static void
@@ -1694,16 +1862,25 @@ static void
 _glcpp_parser_expand_token_list (glcpp_parser_t *parser,
 				 token_list_t *list)
 {
-	token_node_t *node_prev;
-	token_node_t *node, *last = NULL;
-	token_list_t *expansion;
-	active_list_t *active_initial = parser->active;
-
 	if (list == NULL)
 		return;
 
 	_token_list_trim_trailing_space (list);
 
+	_glcpp_parser_expand_tokens (parser, list);
+}
+
+/* The body of _glcpp_parser_expand_token_list, which leaves any
+ * trailing space in 'list' alone. */
+static void
+_glcpp_parser_expand_tokens (glcpp_parser_t *parser,
+			     token_list_t *list)
+{
+	token_node_t *node_prev;
+	token_node_t *node, *last = NULL;
+	token_list_t *expansion;
+	active_list_t *active_initial = parser->active;
+
 	node_prev = NULL;
 	node = list->head;
 
@@ -1835,6 +2012,7 @@ _define_object_macro (glcpp_parser_t *parser,
 	}
 
 	hash_table_insert (parser->defines, macro, identifier);
+	parser->defines_generation++;
 }
 
 void
@@ -1867,6 +2045,7 @@ _define_function_macro (glcpp_parser_t *parser,
 	}
 
 	hash_table_insert (parser->defines, macro, identifier);
+	parser->defines_generation++;
 }
 
 static int
@@ -94,24 +94,58 @@ load_text_file(void *ctx, const char *filename)
 	return text;
 }
 
+/* Preprocess shader with the contents of prefix_name in front of it, the
+ * way the compiler does when a shader has several source strings.
+ */
+static int
+preprocess_with_prefix(void *ctx, const char *prefix_name,
+		       const char **shader, char **info_log)
+{
+	const char *text = load_text_file (ctx, prefix_name);
+	char *prefix_log = ralloc_strdup(ctx, "");
+	glcpp_prefix_t *prefix;
+
+	if (text == NULL)
+		return 1;
+
+	prefix = glcpp_prefix_create(ctx, text, &prefix_log, NULL,
+				     API_OPENGL_COMPAT);
+	if (prefix == NULL) {
+		*shader = ralloc_asprintf(ctx, "%s%s", text, *shader);
+		return glcpp_preprocess(ctx, shader, info_log, NULL,
+					API_OPENGL_COMPAT);
+	}
+
+	return glcpp_preprocess_with_prefix(ctx, prefix, shader, info_log);
+}
+
 int
 main (int argc, char *argv[])
 {
 	char *filename = NULL;
+	const char *prefix_name = NULL;
 	void *ctx = ralloc(NULL, void*);
 	char *info_log = ralloc_strdup(ctx, "");
 	const char *shader;
-	int ret;
+	int i, ret;
 
-	if (argc) {
-		filename = argv[1];
+	for (i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--prefix=", 9) == 0)
+			prefix_name = argv[i] + 9;
+		else
+			filename = argv[i];
 	}
 
 	shader = load_text_file (ctx, filename);
 	if (shader == NULL)
 	   return 1;
 
-	ret = glcpp_preprocess(ctx, &shader, &info_log, NULL, API_OPENGL_COMPAT);
+	if (prefix_name != NULL)
+		ret = preprocess_with_prefix(ctx, prefix_name, &shader,
+					     &info_log);
+	else
+		ret = glcpp_preprocess(ctx, &shader, &info_log, NULL,
+				       API_OPENGL_COMPAT);
 
 	printf("%s", shader);
 	fprintf(stderr, "%s", info_log);
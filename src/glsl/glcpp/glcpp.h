@@ -137,6 +137,16 @@ typedef struct {
 	token_list_t *replacements;
 } macro_t;
 
+/* The complete expansion of an object-like macro, computed once and then
+ * reused for as long as no macro is defined or undefined.  The expansion
+ * is only reused where none of the macros that produced it are being
+ * expanded already. */
+typedef struct cached_expansion {
+	token_list_t *tokens;	/* NULL if the expansion depends on context */
+	string_list_t *macros;	/* macros expanded to produce 'tokens' */
+	int generation;		/* value of defines_generation when computed */
+} cached_expansion_t;
+
 typedef struct expansion_node {
 	macro_t *macro;
 	token_node_t *replacements;
@@ -164,6 +174,9 @@ typedef struct active_list {
 struct glcpp_parser {
 	yyscan_t scanner;
 	struct hash_table *defines;
+	int defines_generation;
+	struct hash_table *expansions;
+	string_list_t *expansion_macros;
 	active_list_t *active;
 	int lexing_if;
 	int space_tokens;
@@ -182,6 +195,8 @@ struct glcpp_parser {
 	int new_line_number;
 	bool has_new_source_number;
 	int new_source_number;
+	/* Starting column, 0 when continuing the line count of a prefix. */
+	int first_column;
 };
 
 struct gl_extensions;
@@ -195,10 +210,27 @@ glcpp_parser_parse (glcpp_parser_t *parser);
 void
 glcpp_parser_destroy (glcpp_parser_t *parser);
 
+void
+glcpp_parser_import_defines (glcpp_parser_t *parser, glcpp_parser_t *source);
+
 int
 glcpp_preprocess(void *ralloc_ctx, const char **shader, char **info_log,
 	   const struct gl_extensions *extensions, int api);
 
+/* A prefix shared by many shaders, such as a header of #defines, that
+ * is preprocessed once.  Preprocessing a shader with a prefix gives the
+ * same output as preprocessing the prefix followed by the shader, but
+ * only the shader has to be lexed and parsed. */
+typedef struct glcpp_prefix glcpp_prefix_t;
+
+glcpp_prefix_t *
+glcpp_prefix_create(void *ralloc_ctx, const char *prefix, char **info_log,
+		    const struct gl_extensions *extensions, int api);
+
+int
+glcpp_preprocess_with_prefix(void *ralloc_ctx, const glcpp_prefix_t *prefix,
+			     const char **shader, char **info_log);
+
 /* Functions for writing to the info log */
 
 void
@@ -221,6 +253,9 @@ glcpp_lex (YYSTYPE *lvalp, YYLTYPE *llocp, yyscan_t scanner);
 int
 glcpp_lex_destroy (yyscan_t scanner);
 
+int
+glcpp_get_lineno (yyscan_t scanner);
+
 /* Generated by glcpp-parse.y to glcpp-parse.c */
 
 int
@@ -95,14 +95,20 @@ in_directive(const char *shader, const char *ptr)
  * However, ignore any in GLSL code, as "There is no line continuation
  * character" (1.30 page 9) in GLSL.
  */
-static char *
+static const char *
 remove_line_continuations(glcpp_parser_t *ctx, const char *shader)
 {
 	int in_continued_line = 0;
 	int extra_newlines = 0;
-	char *clean = ralloc_strdup(ctx, "");
+	char *clean;
 	const char *search_start = shader;
 	const char *newline;
+
+	/* Most shaders have no backslashes at all. */
+	if (strchr(shader, '\\') == NULL)
+		return shader;
+
+	clean = ralloc_strdup(ctx, "");
 	while ((newline = strchr(search_start, '\n')) != NULL) {
 		const char *backslash = NULL;
 
@@ -149,6 +155,19 @@ remove_line_continuations(glcpp_parser_t *ctx, const char *shader)
 	return clean;
 }
 
+static void
+parse(glcpp_parser_t *parser, const char *shader, char **info_log)
+{
+	glcpp_lex_set_source_string (parser, shader);
+
+	glcpp_parser_parse (parser);
+
+	if (parser->skip_stack)
+		glcpp_error (&parser->skip_stack->loc, parser, "Unterminated #if\n");
+
+	ralloc_strcat(info_log, parser->info_log);
+}
+
 int
 glcpp_preprocess(void *ralloc_ctx, const char **shader, char **info_log,
 	   const struct gl_extensions *extensions, int api)
@@ -157,17 +176,132 @@ glcpp_preprocess(void *ralloc_ctx, const char **shader, char **info_log,
 	glcpp_parser_t *parser = glcpp_parser_create (extensions, api);
 	*shader = remove_line_continuations(parser, *shader);
 
-	glcpp_lex_set_source_string (parser, *shader);
+	parse(parser, *shader, info_log);
 
-	glcpp_parser_parse (parser);
+	ralloc_steal(ralloc_ctx, parser->output);
+	*shader = parser->output;
 
-	if (parser->skip_stack)
-		glcpp_error (&parser->skip_stack->loc, parser, "Unterminated #if\n");
+	errors = parser->error;
+	glcpp_parser_destroy (parser);
+	return errors;
+}
 
-	ralloc_strcat(info_log, parser->info_log);
+struct glcpp_prefix {
+	/* The parser that read the prefix, which owns its macros. */
+	glcpp_parser_t *parser;
 
-	ralloc_steal(ralloc_ctx, parser->output);
-	*shader = parser->output;
+	/* The output for the prefix. */
+	const char *output;
+	size_t output_length;
+
+	/* The line and source numbers of the line after the prefix. */
+	int line;
+	int source;
+
+	/* Whether the prefix had any text for the shader to follow. */
+	bool empty;
+
+	/* Zero if the prefix ended with a directive, after which the
+	 * lexer drops leading space on the next line. */
+	int space_tokens;
+};
+
+static void
+destroy_prefix_parser(void *ptr)
+{
+	glcpp_parser_t *parser = ptr;
+
+	hash_table_dtor (parser->defines);
+	hash_table_dtor (parser->expansions);
+}
+
+/* The prefix is read as if it ended with a newline, so that it is made
+ * of whole lines and any line continuations end with it.
+ *
+ * Returns NULL, after adding the errors to info_log, if the prefix
+ * couldn't be preprocessed.  Also returns NULL, without any error, if
+ * the prefix ends with the name of a function-like macro whose
+ * arguments could still come from the shader; the caller should then
+ * preprocess the prefix and shader together.
+ */
+glcpp_prefix_t *
+glcpp_prefix_create(void *ralloc_ctx, const char *text, char **info_log,
+		    const struct gl_extensions *extensions, int api)
+{
+	glcpp_prefix_t *prefix;
+	glcpp_parser_t *parser = glcpp_parser_create (extensions, api);
+	size_t length = strlen(text);
+
+	if (length > 0 && text[length - 1] != '\n')
+		text = ralloc_asprintf(parser, "%s\n", text);
+
+	text = remove_line_continuations(parser, text);
+
+	parse(parser, text, info_log);
+
+	if (parser->error || parser->newline_as_space) {
+		glcpp_parser_destroy (parser);
+		return NULL;
+	}
+
+	prefix = ralloc(ralloc_ctx, glcpp_prefix_t);
+	prefix->parser = parser;
+	ralloc_steal(prefix, parser);
+
+	/* The end of the input is seen as one more, empty, line, which the
+	 * shader's first line will provide instead. */
+	prefix->output = parser->output;
+	prefix->output_length = parser->output_length;
+	if (prefix->output_length > 0 &&
+	    prefix->output[prefix->output_length - 1] == '\n')
+		prefix->output_length--;
+
+	/* A #line on the last line only takes effect on the next one. */
+	if (parser->has_new_line_number)
+		prefix->line = parser->new_line_number;
+	else
+		prefix->line = glcpp_get_lineno (parser->scanner);
+	prefix->source = parser->new_source_number;
+	prefix->empty = length == 0;
+	prefix->space_tokens = parser->space_tokens;
+
+	glcpp_lex_destroy (parser->scanner);
+	parser->scanner = NULL;
+
+	ralloc_set_destructor(parser, destroy_prefix_parser);
+
+	return prefix;
+}
+
+int
+glcpp_preprocess_with_prefix(void *ralloc_ctx, const glcpp_prefix_t *prefix,
+			     const char **shader, char **info_log)
+{
+	int errors;
+	char *output;
+	glcpp_parser_t *parser = glcpp_parser_create (NULL, API_OPENGL_COMPAT);
+
+	glcpp_parser_import_defines (parser, prefix->parser);
+
+	/* Continue numbering lines where the prefix left off. */
+	parser->has_new_line_number = 1;
+	parser->new_line_number = prefix->line;
+	parser->has_new_source_number = 1;
+	parser->new_source_number = prefix->source;
+	parser->space_tokens = prefix->space_tokens;
+	if (!prefix->empty)
+		parser->first_column = 0;
+
+	*shader = remove_line_continuations(parser, *shader);
+
+	parse(parser, *shader, info_log);
+
+	output = ralloc_size(ralloc_ctx, prefix->output_length +
+			     parser->output_length + 1);
+	memcpy(output, prefix->output, prefix->output_length);
+	memcpy(output + prefix->output_length, parser->output,
+	       parser->output_length + 1);
+	*shader = output;
 
 	errors = parser->error;
 	glcpp_parser_destroy (parser);
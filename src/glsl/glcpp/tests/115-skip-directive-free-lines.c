@@ -0,0 +1,9 @@
+success_1
+#if 0
+failure_1 #endif
+  failure_2 # else
+failure_3 /* #endif */
+#else
+success_2
+#endif
+success_3
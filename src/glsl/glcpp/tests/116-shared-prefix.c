@@ -0,0 +1,8 @@
+float a = SCALE(2);
+#if HAVE_WIDTH
+float b = WIDTH;
+#endif
+#undef WIDTH
+#define WIDTH 8
+float c = SCALE(3);
+float line = __LINE__;
@@ -66,7 +66,7 @@ static int classify_identifier(struct _mesa_glsl_parse_state *, const char *);
 			  "Illegal use of reserved word `%s'", yytext);	\
 	 return ERROR_TOK;						\
       } else {								\
-	 yylval->identifier = strdup(yytext);				\
+	 yylval->identifier = yyextra->intern_identifier(yytext);	\
 	 return classify_identifier(yyextra, yytext);			\
       }									\
    } while (0)
@@ -208,7 +208,7 @@ HASH		^{SPC}#{SPC}
 <PP>[ \t\r]*			{ }
 <PP>:				return COLON;
 <PP>[_a-zA-Z][_a-zA-Z0-9]*	{
-				   yylval->identifier = strdup(yytext);
+				   yylval->identifier = yyextra->intern_identifier(yytext);
 				   return IDENTIFIER;
 				}
 <PP>[1-9][0-9]*			{
@@ -341,7 +341,7 @@ layout		{
 		      || yyextra->ARB_fragment_coord_conventions_enable) {
 		      return LAYOUT_TOK;
 		   } else {
-		      yylval->identifier = strdup(yytext);
+		      yylval->identifier = yyextra->intern_identifier(yytext);
 		      return IDENTIFIER;
 		   }
 		}
@@ -504,8 +504,7 @@ usamplerBuffer	KEYWORD(140, 140, USAMPLERBUFFER);
 
 [_a-zA-Z][_a-zA-Z0-9]*	{
 			    struct _mesa_glsl_parse_state *state = yyextra;
-			    void *ctx = state;	
-			    yylval->identifier = ralloc_strdup(ctx, yytext);
+			    yylval->identifier = state->intern_identifier(yytext);
 			    return classify_identifier(state, yytext);
 			}
 
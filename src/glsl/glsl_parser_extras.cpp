@@ -35,7 +35,8 @@ extern "C" {
 #include "glsl_parser_extras.h"
 #include "glsl_parser.h"
 #include "ir_optimization.h"
-#include "loop_analysis.h"
+#include "ir_pass_manager.h"
+#include "main/hash_table.h"
 
 _mesa_glsl_parse_state::_mesa_glsl_parse_state(struct gl_context *_ctx,
 					       GLenum target, void *mem_ctx)
@@ -48,6 +49,9 @@ _mesa_glsl_parse_state::_mesa_glsl_parse_state(struct gl_context *_ctx,
    }
 
    this->scanner = NULL;
+   this->linalloc = ralloc_arena_context(this);
+   this->identifiers = _mesa_hash_table_create(this->linalloc,
+					       _mesa_key_string_equal);
    this->translation_unit.make_empty();
    this->symbols = new(mem_ctx) glsl_symbol_table;
    this->info_log = ralloc_strdup(mem_ctx, "");
@@ -113,6 +117,21 @@ _mesa_glsl_parse_state::_mesa_glsl_parse_state(struct gl_context *_ctx,
    this->default_uniform_qualifier->flags.q.column_major = 1;
 }
 
+const char *
+_mesa_glsl_parse_state::intern_identifier(const char *str)
+{
+   const uint32_t hash = _mesa_hash_string(str);
+   struct hash_entry *entry =
+      _mesa_hash_table_search(this->identifiers, hash, str);
+
+   if (entry != NULL)
+      return (const char *) entry->key;
+
+   char *copy = ralloc_strdup(this->linalloc, str);
+   _mesa_hash_table_insert(this->identifiers, hash, copy, copy);
+   return copy;
+}
+
 const char *
 _mesa_glsl_shader_target_name(enum _mesa_glsl_parser_targets target)
 {
@@ -1024,53 +1043,19 @@ ast_struct_specifier::ast_struct_specifier(const char *identifier,
  * \param max_unroll_iterations       Maximum number of loop iterations to be
  *                                    unrolled.  Setting to 0 forces all loops
  *                                    to be unrolled.
+ *
+ * Every pass is run once over the whole program.  Callers that just want to
+ * optimize until nothing changes should use \c do_common_optimization_loop.
  */
 bool
 do_common_optimization(exec_list *ir, bool linked,
 		       bool uniform_locations_assigned,
 		       unsigned max_unroll_iterations)
 {
-   GLboolean progress = GL_FALSE;
-
-   progress = lower_instructions(ir, SUB_TO_ADD_NEG) || progress;
-
-   if (linked) {
-      progress = do_function_inlining(ir) || progress;
-      progress = do_dead_functions(ir) || progress;
-      progress = do_structure_splitting(ir) || progress;
-   }
-   progress = do_if_simplification(ir) || progress;
-   progress = do_copy_propagation(ir) || progress;
-   progress = do_copy_propagation_elements(ir) || progress;
-   if (linked)
-      progress = do_dead_code(ir, uniform_locations_assigned) || progress;
-   else
-      progress = do_dead_code_unlinked(ir) || progress;
-   progress = do_dead_code_local(ir) || progress;
-   progress = do_tree_grafting(ir) || progress;
-   progress = do_constant_propagation(ir) || progress;
-   if (linked)
-      progress = do_constant_variable(ir) || progress;
-   else
-      progress = do_constant_variable_unlinked(ir) || progress;
-   progress = do_constant_folding(ir) || progress;
-   progress = do_algebraic(ir) || progress;
-   progress = do_lower_jumps(ir) || progress;
-   progress = do_vec_index_to_swizzle(ir) || progress;
-   progress = do_swizzle_swizzle(ir) || progress;
-   progress = do_noop_swizzle(ir) || progress;
-
-   progress = optimize_split_arrays(ir, linked) || progress;
-   progress = optimize_redundant_jumps(ir) || progress;
-
-   loop_state *ls = analyze_loop_variables(ir);
-   if (ls->loop_found) {
-      progress = set_loop_controls(ir, ls) || progress;
-      progress = unroll_loops(ir, ls, max_unroll_iterations) || progress;
-   }
-   delete ls;
+   ir_pass_manager pm(linked, uniform_locations_assigned,
+		      max_unroll_iterations);
 
-   return progress;
+   return pm.run_once(ir);
 }
 
 extern "C" {
@@ -82,6 +82,24 @@ struct _mesa_glsl_parse_state {
    exec_list translation_unit;
    glsl_symbol_table *symbols;
 
+   /**
+    * Arena context that the AST and the identifiers from the lexer are
+    * allocated out of.  None of it outlives the parse state, so it is all
+    * freed at once with it.
+    */
+   void *linalloc;
+
+   /**
+    * Return the copy of \c str that every identifier with the same name in
+    * the shader shares
+    *
+    * Identifiers returned by this function can be compared by pointer.
+    */
+   const char *intern_identifier(const char *str);
+
+   /** Set of the identifiers returned by \c intern_identifier */
+   struct hash_table *identifiers;
+
    unsigned num_uniform_blocks;
    unsigned uniform_block_array_size;
    struct gl_uniform_block *uniform_blocks;
@@ -301,6 +319,17 @@ extern "C" {
 extern int glcpp_preprocess(void *ctx, const char **shader, char **info_log,
                       const struct gl_extensions *extensions, int api);
 
+struct glcpp_prefix;
+
+extern struct glcpp_prefix *
+glcpp_prefix_create(void *ralloc_ctx, const char *prefix, char **info_log,
+                    const struct gl_extensions *extensions, int api);
+
+extern int
+glcpp_preprocess_with_prefix(void *ralloc_ctx,
+                             const struct glcpp_prefix *prefix,
+                             const char **shader, char **info_log);
+
 extern void _mesa_destroy_shader_compiler(void);
 extern void _mesa_destroy_shader_compiler_caches(void);
 
@@ -24,18 +24,25 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "main/core.h" /* for Elements */
+#include "glapi/glthread.h"
 #include "glsl_symbol_table.h"
 #include "glsl_parser_extras.h"
 #include "glsl_types.h"
 #include "builtin_types.h"
-extern "C" {
-#include "program/hash_table.h"
-}
+#include "main/hash_table.h"
 
 hash_table *glsl_type::array_types = NULL;
 hash_table *glsl_type::record_types = NULL;
+hash_table *glsl_type::builtin_types = NULL;
 void *glsl_type::mem_ctx = NULL;
 
+/**
+ * Protects the type tables and \c glsl_type::mem_ctx.  Shaders for several
+ * contexts, or several stages of one program, may be compiled and linked at
+ * the same time, and they all share the array and record types.
+ */
+_glthread_DECLARE_STATIC_MUTEX(glsl_type_mutex);
+
 void
 glsl_type::init_ralloc_type_ctx(void)
 {
@@ -364,15 +371,24 @@ const glsl_type *glsl_type::get_scalar_type() const
 void
 _mesa_glsl_release_types(void)
 {
+   _glthread_LOCK_MUTEX(glsl_type_mutex);
+
    if (glsl_type::array_types != NULL) {
-      hash_table_dtor(glsl_type::array_types);
+      _mesa_hash_table_destroy(glsl_type::array_types, NULL);
       glsl_type::array_types = NULL;
    }
 
    if (glsl_type::record_types != NULL) {
-      hash_table_dtor(glsl_type::record_types);
+      _mesa_hash_table_destroy(glsl_type::record_types, NULL);
       glsl_type::record_types = NULL;
    }
+
+   if (glsl_type::builtin_types != NULL) {
+      _mesa_hash_table_destroy(glsl_type::builtin_types, NULL);
+      glsl_type::builtin_types = NULL;
+   }
+
+   _glthread_UNLOCK_MUTEX(glsl_type_mutex);
 }
 
 
@@ -464,30 +480,57 @@ glsl_type::get_instance(unsigned base_type, unsigned rows, unsigned columns)
 }
 
 
+/**
+ * Key of the array type table
+ *
+ * The base type pointer is used rather than its name, because the name of
+ * the base type may not be unique across shaders.  For example, two shaders
+ * may have different record types named 'foo'.
+ */
+struct array_type_key {
+   const glsl_type *base;
+   unsigned length;
+};
+
+static bool
+array_type_key_equal(const void *a, const void *b)
+{
+   const array_type_key *const key1 = (const array_type_key *) a;
+   const array_type_key *const key2 = (const array_type_key *) b;
+
+   return key1->base == key2->base && key1->length == key2->length;
+}
+
 const glsl_type *
 glsl_type::get_array_instance(const glsl_type *base, unsigned array_size)
 {
+   _glthread_LOCK_MUTEX(glsl_type_mutex);
 
    if (array_types == NULL) {
-      array_types = hash_table_ctor(64, hash_table_string_hash,
-				    hash_table_string_compare);
+      init_ralloc_type_ctx();
+      array_types = _mesa_hash_table_create(mem_ctx, array_type_key_equal);
    }
 
-   /* Generate a name using the base type pointer in the key.  This is
-    * done because the name of the base type may not be unique across
-    * shaders.  For example, two shaders may have different record types
-    * named 'foo'.
-    */
-   char key[128];
-   snprintf(key, sizeof(key), "%p[%u]", (void *) base, array_size);
+   array_type_key key;
+   key.base = base;
+   key.length = array_size;
 
-   const glsl_type *t = (glsl_type *) hash_table_find(array_types, key);
-   if (t == NULL) {
+   const uint32_t hash = _mesa_hash_pointer(base) ^ (array_size * 0x9e3779b9);
+
+   const hash_entry *entry = _mesa_hash_table_search(array_types, hash, &key);
+   const glsl_type *t;
+   if (entry == NULL) {
       t = new glsl_type(base, array_size);
 
-      hash_table_insert(array_types, (void *) t, ralloc_strdup(mem_ctx, key));
+      array_type_key *stored_key = ralloc(array_types, array_type_key);
+      *stored_key = key;
+      _mesa_hash_table_insert(array_types, hash, stored_key, (void *) t);
+   } else {
+      t = (const glsl_type *) entry->data;
    }
 
+   _glthread_UNLOCK_MUTEX(glsl_type_mutex);
+
    assert(t->base_type == GLSL_TYPE_ARRAY);
    assert(t->length == array_size);
    assert(t->fields.array == base);
@@ -496,51 +539,110 @@ glsl_type::get_array_instance(const glsl_type *base, unsigned array_size)
 }
 
 
-int
-glsl_type::record_key_compare(const void *a, const void *b)
+/**
+ * Key of the record type table
+ *
+ * Lookups use the fields they were passed, so that no type has to be built
+ * just to find out that it already exists.
+ */
+struct record_type_key {
+   const glsl_struct_field *fields;
+   unsigned num_fields;
+   const char *name;
+};
+
+bool
+glsl_type::record_key_equal(const void *a, const void *b)
 {
-   const glsl_type *const key1 = (glsl_type *) a;
-   const glsl_type *const key2 = (glsl_type *) b;
+   const record_type_key *const key1 = (const record_type_key *) a;
+   const record_type_key *const key2 = (const record_type_key *) b;
 
-   /* Return zero is the types match (there is zero difference) or non-zero
-    * otherwise.
-    */
-   if (strcmp(key1->name, key2->name) != 0)
-      return 1;
+   if (key1->num_fields != key2->num_fields)
+      return false;
 
-   if (key1->length != key2->length)
-      return 1;
+   if (strcmp(key1->name, key2->name) != 0)
+      return false;
 
-   for (unsigned i = 0; i < key1->length; i++) {
-      if (key1->fields.structure[i].type != key2->fields.structure[i].type)
-	 return 1;
-      if (strcmp(key1->fields.structure[i].name,
-		 key2->fields.structure[i].name) != 0)
-	 return 1;
+   for (unsigned i = 0; i < key1->num_fields; i++) {
+      if (key1->fields[i].type != key2->fields[i].type)
+	 return false;
+      if (strcmp(key1->fields[i].name, key2->fields[i].name) != 0)
+	 return false;
    }
 
-   return 0;
+   return true;
 }
 
 
-unsigned
-glsl_type::record_key_hash(const void *a)
+uint32_t
+glsl_type::record_key_hash(const glsl_struct_field *fields,
+			   unsigned num_fields, const char *name)
 {
-   const glsl_type *const key = (glsl_type *) a;
-   char hash_key[128];
-   unsigned size = 0;
+   uint32_t hash = _mesa_hash_string(name) ^ num_fields;
 
-   size = snprintf(hash_key, sizeof(hash_key), "%08x", key->length);
+   for (unsigned i = 0; i < num_fields; i++)
+      hash = hash * 31 + _mesa_hash_pointer(fields[i].type);
 
-   for (unsigned i = 0; i < key->length; i++) {
-      if (size >= sizeof(hash_key))
-	 break;
+   return hash;
+}
 
-      size += snprintf(& hash_key[size], sizeof(hash_key) - size,
-		       "%p", (void *) key->fields.structure[i].type);
+
+const glsl_type *
+glsl_type::get_builtin_instance(const char *name)
+{
+   static const struct {
+      const glsl_type *types;
+      unsigned count;
+   } tables[] = {
+      { builtin_core_types, Elements(builtin_core_types) },
+      { builtin_structure_types, Elements(builtin_structure_types) },
+      { builtin_110_deprecated_structure_types,
+	Elements(builtin_110_deprecated_structure_types) },
+      { builtin_110_types, Elements(builtin_110_types) },
+      { builtin_120_types, Elements(builtin_120_types) },
+      { builtin_130_types, Elements(builtin_130_types) },
+      { builtin_140_types, Elements(builtin_140_types) },
+      { builtin_ARB_texture_rectangle_types,
+	Elements(builtin_ARB_texture_rectangle_types) },
+      { builtin_EXT_texture_array_types,
+	Elements(builtin_EXT_texture_array_types) },
+      { builtin_EXT_texture_buffer_object_types,
+	Elements(builtin_EXT_texture_buffer_object_types) },
+      { builtin_OES_EGL_image_external_types,
+	Elements(builtin_OES_EGL_image_external_types) },
+      { builtin_ARB_texture_cube_map_array_types,
+	Elements(builtin_ARB_texture_cube_map_array_types) },
+      { &_sampler3D_type, 1 },
+      { &_void_type, 1 },
+      { &_error_type, 1 },
+   };
+
+   _glthread_LOCK_MUTEX(glsl_type_mutex);
+
+   if (builtin_types == NULL) {
+      init_ralloc_type_ctx();
+      builtin_types = _mesa_hash_table_create(mem_ctx, _mesa_key_string_equal);
+
+      for (unsigned i = 0; i < Elements(tables); i++) {
+	 for (unsigned j = 0; j < tables[i].count; j++) {
+	    const glsl_type *const t = &tables[i].types[j];
+	    const uint32_t hash = _mesa_hash_string(t->name);
+
+	    /* Like the linear search this replaced, the first type with a
+	     * given name wins.
+	     */
+	    if (_mesa_hash_table_search(builtin_types, hash, t->name) == NULL)
+	       _mesa_hash_table_insert(builtin_types, hash, t->name, (void *) t);
+	 }
+      }
    }
 
-   return hash_table_string_hash(& hash_key);
+   const hash_entry *entry =
+      _mesa_hash_table_search(builtin_types, _mesa_hash_string(name), name);
+
+   _glthread_UNLOCK_MUTEX(glsl_type_mutex);
+
+   return entry != NULL ? (const glsl_type *) entry->data : NULL;
 }
 
 
@@ -549,19 +651,37 @@ glsl_type::get_record_instance(const glsl_struct_field *fields,
 			       unsigned num_fields,
 			       const char *name)
 {
-   const glsl_type key(fields, num_fields, name);
+   _glthread_LOCK_MUTEX(glsl_type_mutex);
 
    if (record_types == NULL) {
-      record_types = hash_table_ctor(64, record_key_hash, record_key_compare);
+      init_ralloc_type_ctx();
+      record_types = _mesa_hash_table_create(mem_ctx, record_key_equal);
    }
 
-   const glsl_type *t = (glsl_type *) hash_table_find(record_types, & key);
-   if (t == NULL) {
+   record_type_key key;
+   key.fields = fields;
+   key.num_fields = num_fields;
+   key.name = name;
+
+   const uint32_t hash = record_key_hash(fields, num_fields, name);
+
+   const hash_entry *entry = _mesa_hash_table_search(record_types, hash, &key);
+   const glsl_type *t;
+   if (entry == NULL) {
       t = new glsl_type(fields, num_fields, name);
 
-      hash_table_insert(record_types, (void *) t, t);
+      /* The stored key refers to the copies of the fields in the type. */
+      record_type_key *stored_key = ralloc(record_types, record_type_key);
+      stored_key->fields = t->fields.structure;
+      stored_key->num_fields = t->length;
+      stored_key->name = t->name;
+      _mesa_hash_table_insert(record_types, hash, stored_key, (void *) t);
+   } else {
+      t = (const glsl_type *) entry->data;
    }
 
+   _glthread_UNLOCK_MUTEX(glsl_type_mutex);
+
    assert(t->base_type == GLSL_TYPE_STRUCT);
    assert(t->length == num_fields);
    assert(strcmp(t->name, name) == 0);
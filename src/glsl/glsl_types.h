@@ -231,6 +231,17 @@ struct glsl_type {
 					       unsigned num_fields,
 					       const char *name);
 
+   /**
+    * Get the built-in type named \c name
+    *
+    * This includes the built-in structure types, such as
+    * \c gl_LightSourceParameters, but not user-defined records or arrays.
+    *
+    * \return
+    * The type, or \c NULL if there is no built-in type by that name.
+    */
+   static const glsl_type *get_builtin_instance(const char *name);
+
    /**
     * Query the total number of scalars that make up a scalar, vector or matrix
     */
@@ -475,7 +486,7 @@ private:
     */
    static void *mem_ctx;
 
-   void init_ralloc_type_ctx(void);
+   static void init_ralloc_type_ctx(void);
 
    /** Constructor for vector and matrix types */
    glsl_type(GLenum gl_type,
@@ -500,8 +511,12 @@ private:
    /** Hash table containing the known record types. */
    static struct hash_table *record_types;
 
-   static int record_key_compare(const void *a, const void *b);
-   static unsigned record_key_hash(const void *key);
+   /** Hash table of the built-in types, by name. */
+   static struct hash_table *builtin_types;
+
+   static bool record_key_equal(const void *a, const void *b);
+   static uint32_t record_key_hash(const glsl_struct_field *fields,
+				   unsigned num_fields, const char *name);
 
    /**
     * \name Pointers to various type singletons
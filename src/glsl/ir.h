@@ -1866,6 +1866,38 @@ _mesa_glsl_initialize_functions(_mesa_glsl_parse_state *state);
 extern void
 _mesa_glsl_release_functions(void);
 
+/**
+ * Read the bodies of the built-in function \c name into the built-in
+ * profile shader \c sh, if they haven't been read yet.
+ *
+ * Built-in profiles are created with prototypes only, and are shared by
+ * every context.  Reading a body replaces the parameters of its prototype,
+ * so this must be called before any signature of \c name is matched or
+ * its \c is_defined flag or body is used.
+ */
+extern void
+_mesa_glsl_read_builtin_function(struct gl_shader *sh, const char *name);
+
+/**
+ * Get the built-in profile shader with the given index, reading its
+ * prototypes if that hasn't been done yet.  Returns \c NULL if there is no
+ * profile with that index.
+ */
+extern struct gl_shader *
+_mesa_glsl_get_builtin_profile(unsigned index);
+
+/**
+ * Get the index of the built-in profile shader \c sh, or -1 if \c sh is not
+ * a built-in profile.
+ */
+extern int
+_mesa_glsl_builtin_profile_index(struct gl_shader *sh);
+
+/**
+ * A string identifying the contents of the built-in function library.
+ */
+extern const char _mesa_glsl_builtin_functions_id[];
+
 extern void
 reparent_ir(exec_list *list, void *mem_ctx);
 
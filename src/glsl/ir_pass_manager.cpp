@@ -0,0 +1,576 @@
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file ir_pass_manager.cpp
+ *
+ * Worklist-driven scheduling of the common optimization passes.
+ */
+
+#include "main/core.h" /* for Elements */
+#include "ir.h"
+#include "ir_optimization.h"
+#include "ir_pass_manager.h"
+#include "ir_stats.h"
+#include "loop_analysis.h"
+
+static bool
+run_lower_instructions(exec_list *ir, const ir_pass_options *)
+{
+   return lower_instructions(ir, SUB_TO_ADD_NEG);
+}
+
+static bool
+run_function_inlining(exec_list *ir, const ir_pass_options *)
+{
+   return do_function_inlining(ir);
+}
+
+static bool
+run_dead_functions(exec_list *ir, const ir_pass_options *)
+{
+   return do_dead_functions(ir);
+}
+
+static bool
+run_structure_splitting(exec_list *ir, const ir_pass_options *)
+{
+   return do_structure_splitting(ir);
+}
+
+static bool
+run_if_simplification(exec_list *ir, const ir_pass_options *)
+{
+   return do_if_simplification(ir);
+}
+
+static bool
+run_copy_propagation(exec_list *ir, const ir_pass_options *)
+{
+   return do_copy_propagation(ir);
+}
+
+static bool
+run_copy_propagation_elements(exec_list *ir, const ir_pass_options *)
+{
+   return do_copy_propagation_elements(ir);
+}
+
+static bool
+run_dead_code(exec_list *ir, const ir_pass_options *options)
+{
+   if (options->linked)
+      return do_dead_code(ir, options->uniform_locations_assigned);
+   else
+      return do_dead_code_unlinked(ir);
+}
+
+static bool
+run_dead_code_local(exec_list *ir, const ir_pass_options *)
+{
+   return do_dead_code_local(ir);
+}
+
+static bool
+run_dead_code_global(exec_list *ir, const ir_pass_options *)
+{
+   return do_dead_code_global(ir);
+}
+
+static bool
+run_tree_grafting(exec_list *ir, const ir_pass_options *)
+{
+   return do_tree_grafting(ir);
+}
+
+static bool
+run_constant_propagation(exec_list *ir, const ir_pass_options *)
+{
+   return do_constant_propagation(ir);
+}
+
+static bool
+run_constant_variable(exec_list *ir, const ir_pass_options *options)
+{
+   if (options->linked)
+      return do_constant_variable(ir);
+   else
+      return do_constant_variable_unlinked(ir);
+}
+
+static bool
+run_constant_folding(exec_list *ir, const ir_pass_options *)
+{
+   return do_constant_folding(ir);
+}
+
+static bool
+run_algebraic(exec_list *ir, const ir_pass_options *)
+{
+   return do_algebraic(ir);
+}
+
+static bool
+run_global_value_numbering(exec_list *ir, const ir_pass_options *)
+{
+   return do_global_value_numbering(ir);
+}
+
+static bool
+run_lower_jumps(exec_list *ir, const ir_pass_options *)
+{
+   return do_lower_jumps(ir);
+}
+
+static bool
+run_vec_index_to_swizzle(exec_list *ir, const ir_pass_options *)
+{
+   return do_vec_index_to_swizzle(ir);
+}
+
+static bool
+run_swizzle_swizzle(exec_list *ir, const ir_pass_options *)
+{
+   return do_swizzle_swizzle(ir);
+}
+
+static bool
+run_noop_swizzle(exec_list *ir, const ir_pass_options *)
+{
+   return do_noop_swizzle(ir);
+}
+
+static bool
+run_split_arrays(exec_list *ir, const ir_pass_options *options)
+{
+   return optimize_split_arrays(ir, options->linked);
+}
+
+static bool
+run_redundant_jumps(exec_list *ir, const ir_pass_options *)
+{
+   return optimize_redundant_jumps(ir);
+}
+
+static bool
+run_loop_unrolling(exec_list *ir, const ir_pass_options *options)
+{
+   bool progress = false;
+
+   loop_state *ls = analyze_loop_variables(ir);
+   if (ls->loop_found) {
+      progress = set_loop_controls(ir, ls) || progress;
+      progress = unroll_loops(ir, ls, options->max_unroll_iterations)
+	 || progress;
+   }
+   delete ls;
+
+   return progress;
+}
+
+static bool
+run_loop_invariant_motion(exec_list *ir, const ir_pass_options *)
+{
+   return do_loop_invariant_code_motion(ir);
+}
+
+static bool
+run_loop_strength_reduction(exec_list *ir, const ir_pass_options *)
+{
+   bool progress = false;
+
+   loop_state *ls = analyze_loop_variables(ir);
+   if (ls->loop_found)
+      progress = reduce_induction_strength(ir, ls);
+   delete ls;
+
+   return progress;
+}
+
+/** Number of copies of the body made by partial unrolling */
+#define PARTIAL_UNROLL_FACTOR 4
+
+static bool
+run_loop_partial_unrolling(exec_list *ir, const ir_pass_options *options)
+{
+   bool progress = false;
+
+   loop_state *ls = analyze_loop_variables(ir);
+   if (ls->loop_found) {
+      progress = partially_unroll_loops(ir, ls, PARTIAL_UNROLL_FACTOR,
+					options->max_unroll_iterations);
+   }
+   delete ls;
+
+   return progress;
+}
+
+/** What a pass looks at */
+enum ir_pass_scope {
+   /** One function at a time */
+   PASS_FUNCTION,
+
+   /** The whole program */
+   PASS_PROGRAM,
+
+   /**
+    * The whole program once the shader is linked, but only one function at
+    * a time before that
+    */
+   PASS_PROGRAM_IF_LINKED,
+};
+
+struct ir_pass_info {
+   const char *name;
+   bool (*run)(exec_list *ir, const ir_pass_options *options);
+   ir_pass_scope scope;
+
+   /** Is the pass only run on linked shaders? */
+   bool linked_only;
+
+   /**
+    * Is the pass only run once the other passes stop making progress?
+    *
+    * The loop passes that reshape loops would otherwise get to loops that
+    * later rounds of constant propagation make fully unrollable.
+    */
+   bool late;
+};
+
+/**
+ * The passes of \c do_common_optimization, in the order they run
+ */
+static const ir_pass_info passes[] = {
+   { "lower_instructions",        run_lower_instructions,         PASS_FUNCTION,           false, false },
+   { "function_inlining",         run_function_inlining,          PASS_PROGRAM,            true,  false },
+   { "dead_functions",            run_dead_functions,             PASS_PROGRAM,            true,  false },
+   { "structure_splitting",       run_structure_splitting,        PASS_PROGRAM,            true,  false },
+   { "if_simplification",         run_if_simplification,          PASS_FUNCTION,           false, false },
+   { "copy_propagation",          run_copy_propagation,           PASS_FUNCTION,           false, false },
+   { "copy_propagation_elements", run_copy_propagation_elements,  PASS_FUNCTION,           false, false },
+   { "dead_code",                 run_dead_code,                  PASS_PROGRAM_IF_LINKED,  false, false },
+   { "dead_code_local",           run_dead_code_local,            PASS_FUNCTION,           false, false },
+   { "dead_code_global",          run_dead_code_global,           PASS_FUNCTION,           false, false },
+   { "tree_grafting",             run_tree_grafting,              PASS_FUNCTION,           false, false },
+   { "constant_propagation",      run_constant_propagation,       PASS_FUNCTION,           false, false },
+   { "constant_variable",         run_constant_variable,          PASS_PROGRAM_IF_LINKED,  false, false },
+   { "constant_folding",          run_constant_folding,           PASS_FUNCTION,           false, false },
+   { "algebraic",                 run_algebraic,                  PASS_FUNCTION,           false, false },
+   { "global_value_numbering",    run_global_value_numbering,     PASS_FUNCTION,           false, false },
+   { "lower_jumps",               run_lower_jumps,                PASS_FUNCTION,           false, false },
+   { "vec_index_to_swizzle",      run_vec_index_to_swizzle,       PASS_FUNCTION,           false, false },
+   { "swizzle_swizzle",           run_swizzle_swizzle,            PASS_FUNCTION,           false, false },
+   { "noop_swizzle",              run_noop_swizzle,               PASS_FUNCTION,           false, false },
+   { "split_arrays",              run_split_arrays,               PASS_PROGRAM_IF_LINKED,  false, false },
+   { "redundant_jumps",           run_redundant_jumps,            PASS_FUNCTION,           false, false },
+   { "loop_unrolling",            run_loop_unrolling,             PASS_FUNCTION,           false, false },
+   { "loop_invariant_motion",     run_loop_invariant_motion,      PASS_FUNCTION,           false, true },
+   { "loop_strength_reduction",   run_loop_strength_reduction,    PASS_FUNCTION,           false, true },
+   { "loop_partial_unrolling",    run_loop_partial_unrolling,     PASS_FUNCTION,           true,  true },
+};
+
+ir_pass_manager::ir_pass_manager(bool linked, bool uniform_locations_assigned,
+				 unsigned max_unroll_iterations)
+{
+   assert(Elements(passes) == IR_PASS_COUNT);
+
+   this->mem_ctx = ralloc_context(NULL);
+   this->options.linked = linked;
+   this->options.uniform_locations_assigned = uniform_locations_assigned;
+   this->options.max_unroll_iterations = max_unroll_iterations;
+
+   for (unsigned i = 0; i < IR_PASS_COUNT; i++) {
+      this->stats[i].name = passes[i].name;
+      this->stats[i].runs = 0;
+      this->stats[i].progress = 0;
+      this->stats[i].seconds = 0.0;
+   }
+   this->rounds = 0;
+
+   this->regions = NULL;
+   this->num_regions = 0;
+   this->regions_size = 0;
+   this->global_done = 0;
+}
+
+ir_pass_manager::~ir_pass_manager()
+{
+   ralloc_free(this->mem_ctx);
+}
+
+bool
+ir_pass_manager::run_pass(unsigned pass, exec_list *instructions)
+{
+   const double start = glsl_stats_get_time();
+   const bool progress = passes[pass].run(instructions, &this->options);
+
+   this->stats[pass].seconds += glsl_stats_get_time() - start;
+   this->stats[pass].runs++;
+   if (progress)
+      this->stats[pass].progress++;
+
+   return progress;
+}
+
+/**
+ * Run a function-local pass on just \c func
+ *
+ * The function is moved to a list of its own for the duration of the pass,
+ * and then put back where it was.
+ */
+bool
+ir_pass_manager::run_pass_on_function(unsigned pass, ir_function *func)
+{
+   exec_node *prev = func->prev;
+   exec_list single;
+
+   func->remove();
+   single.push_tail(func);
+
+   const bool progress = run_pass(pass, &single);
+
+   while (!single.is_empty()) {
+      exec_node *node = single.pop_head();
+      prev->insert_after(node);
+      prev = node;
+   }
+
+   return progress;
+}
+
+/**
+ * Split the program into the regions the function-local passes run on
+ *
+ * Every region starts out dirty.
+ */
+void
+ir_pass_manager::build_regions(exec_list *instructions)
+{
+   bool top_level_code = false;
+   unsigned count = 0;
+
+   foreach_list(node, instructions) {
+      ir_instruction *const ir = (ir_instruction *) node;
+
+      if (ir->as_function() != NULL)
+	 count++;
+      else if (ir->as_variable() == NULL)
+	 top_level_code = true;
+   }
+
+   if (top_level_code)
+      count = 1;
+
+   if (count > this->regions_size) {
+      this->regions = reralloc(this->mem_ctx, this->regions, region, count);
+      this->regions_size = count;
+   }
+
+   this->num_regions = count;
+
+   if (top_level_code) {
+      this->regions[0].func = NULL;
+      this->regions[0].done = 0;
+      return;
+   }
+
+   unsigned i = 0;
+   foreach_list(node, instructions) {
+      ir_function *const func = ((ir_instruction *) node)->as_function();
+
+      if (func != NULL) {
+	 this->regions[i].func = func;
+	 this->regions[i].done = 0;
+	 i++;
+      }
+   }
+}
+
+/**
+ * Go through the pass list once, running either the late passes or the
+ * others
+ *
+ * \return
+ * \c true if any pass changed the IR.
+ */
+bool
+ir_pass_manager::run_round(exec_list *instructions, bool late)
+{
+   bool progress = false;
+
+   for (unsigned p = 0; p < IR_PASS_COUNT; p++) {
+      const unsigned bit = 1u << p;
+
+      if (passes[p].late != late)
+	 continue;
+
+      if (passes[p].linked_only && !this->options.linked)
+	 continue;
+
+      const bool global = passes[p].scope == PASS_PROGRAM
+	 || (passes[p].scope == PASS_PROGRAM_IF_LINKED
+	     && this->options.linked);
+
+      if (global) {
+	 if (this->global_done & bit)
+	    continue;
+
+	 if (run_pass(p, instructions)) {
+	    /* Any function may have changed, and some may be gone. */
+	    progress = true;
+	    this->global_done = 0;
+	    build_regions(instructions);
+	 } else {
+	    this->global_done |= bit;
+	 }
+	 continue;
+      }
+
+      bool rebuild = false;
+      for (unsigned r = 0; r < this->num_regions; r++) {
+	 region *const reg = &this->regions[r];
+
+	 if (reg->done & bit)
+	    continue;
+
+	 const bool changed = (reg->func != NULL)
+	    ? run_pass_on_function(p, reg->func)
+	    : run_pass(p, instructions);
+
+	 if (changed) {
+	    progress = true;
+	    reg->done = 0;
+	    this->global_done = 0;
+	    rebuild = rebuild || reg->func == NULL;
+	 } else {
+	    reg->done |= bit;
+	 }
+      }
+
+      /* Top-level code may have been optimized away, so that the
+       * functions can be handled one at a time again.
+       */
+      if (rebuild)
+	 build_regions(instructions);
+   }
+
+   return progress;
+}
+
+bool
+ir_pass_manager::run(exec_list *instructions)
+{
+   bool any_progress = false;
+   bool progress;
+
+   build_regions(instructions);
+   this->global_done = 0;
+
+   do {
+      progress = run_round(instructions, false);
+      if (!progress)
+	 progress = run_round(instructions, true);
+
+      this->rounds++;
+      any_progress = any_progress || progress;
+   } while (progress);
+
+   return any_progress;
+}
+
+bool
+ir_pass_manager::run_once(exec_list *instructions)
+{
+   bool progress = false;
+
+   for (unsigned p = 0; p < IR_PASS_COUNT; p++) {
+      if (passes[p].late || (passes[p].linked_only && !this->options.linked))
+	 continue;
+
+      progress = run_pass(p, instructions) || progress;
+   }
+
+   /* Callers repeat this until nothing changes, so the late passes get
+    * their turn in the last rounds.
+    */
+   for (unsigned p = 0; p < IR_PASS_COUNT && !progress; p++) {
+      if (!passes[p].late || (passes[p].linked_only && !this->options.linked))
+	 continue;
+
+      progress = run_pass(p, instructions) || progress;
+   }
+
+   this->rounds++;
+   return progress;
+}
+
+void
+ir_pass_manager::add_stats(struct glsl_shader_stats *stats) const
+{
+   for (unsigned i = 0; i < IR_PASS_COUNT; i++) {
+      stats->passes[i].name = this->stats[i].name;
+      stats->passes[i].runs += this->stats[i].runs;
+      stats->passes[i].progress += this->stats[i].progress;
+      stats->passes[i].seconds += this->stats[i].seconds;
+   }
+   stats->rounds += this->rounds;
+}
+
+void
+ir_pass_manager::print_stats(FILE *f) const
+{
+   fprintf(f, "%-26s %8s %8s %10s\n", "pass", "runs", "progress", "ms");
+   for (unsigned i = 0; i < IR_PASS_COUNT; i++) {
+      if (this->stats[i].runs == 0)
+	 continue;
+
+      fprintf(f, "%-26s %8u %8u %10.3f\n", this->stats[i].name,
+	      this->stats[i].runs, this->stats[i].progress,
+	      this->stats[i].seconds * 1000.0);
+   }
+   fprintf(f, "%u rounds\n", this->rounds);
+}
+
+/**
+ * Run the passes of \c do_common_optimization until they make no more
+ * progress
+ *
+ * This gives the same result as calling \c do_common_optimization in a loop,
+ * without revisiting functions that have stopped changing.
+ */
+bool
+do_common_optimization_loop(exec_list *ir, bool linked,
+			    bool uniform_locations_assigned,
+			    unsigned max_unroll_iterations,
+			    struct glsl_shader_stats *stats)
+{
+   ir_pass_manager pm(linked, uniform_locations_assigned,
+		      max_unroll_iterations);
+
+   const bool progress = pm.run(ir);
+
+   if (stats != NULL)
+      pm.add_stats(stats);
+
+   return progress;
+}
@@ -0,0 +1,132 @@
+/* -*- c++ -*- */
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file ir_pass_manager.h
+ *
+ * Runs the common optimization passes to a fixed point while only revisiting
+ * the parts of the program that changed.
+ */
+
+#pragma once
+#ifndef IR_PASS_MANAGER_H
+#define IR_PASS_MANAGER_H
+
+#include <stdio.h>
+#include "ir.h"
+
+struct glsl_shader_stats;
+
+/** Number of passes in the common optimization pipeline */
+#define IR_PASS_COUNT 26
+
+/** Settings shared by all of the passes of one pass manager */
+struct ir_pass_options {
+   bool linked;
+   bool uniform_locations_assigned;
+   unsigned max_unroll_iterations;
+};
+
+/** Counters kept for each pass */
+struct ir_pass_stat {
+   const char *name;
+   unsigned runs;        /**< Number of times the pass was run */
+   unsigned progress;    /**< Number of runs that changed the IR */
+   double seconds;       /**< Total time spent in the pass */
+};
+
+/**
+ * Schedules the passes of \c do_common_optimization
+ *
+ * Passes either work on one function at a time or look at the whole program.
+ * The pass manager remembers, for every function, which function-local
+ * passes have already run on it without making progress, and skips those
+ * passes until something changes the function again.  Whole-program passes
+ * are skipped until something anywhere in the program changes.  Progress by
+ * a whole-program pass makes every function dirty again.
+ *
+ * A few loop passes that reshape loops only run once the other passes have
+ * stopped making progress.
+ *
+ * When the top level of the program holds code other than declarations and
+ * functions (as in an unlinked shader with global initializers), the
+ * function-local passes fall back to running on the whole program.
+ */
+class ir_pass_manager {
+public:
+   ir_pass_manager(bool linked, bool uniform_locations_assigned,
+		   unsigned max_unroll_iterations);
+   ~ir_pass_manager();
+
+   /**
+    * Run the passes until none of them makes progress
+    *
+    * \return
+    * \c true if any pass changed the IR.
+    */
+   bool run(exec_list *instructions);
+
+   /**
+    * Run every pass once over the whole program, and the late passes too if
+    * none of the others made progress
+    *
+    * \return
+    * \c true if any pass changed the IR.
+    */
+   bool run_once(exec_list *instructions);
+
+   /** Print the per-pass statistics as a table */
+   void print_stats(FILE *f) const;
+
+   /** Add the per-pass statistics to those of a shader */
+   void add_stats(struct glsl_shader_stats *stats) const;
+
+   struct ir_pass_stat stats[IR_PASS_COUNT];
+
+   /** Number of rounds \c run has gone through the pass list */
+   unsigned rounds;
+
+private:
+   struct region {
+      ir_function *func;   /**< NULL for the whole program */
+      unsigned done;       /**< Passes known to make no progress here */
+   };
+
+   bool run_round(exec_list *instructions, bool late);
+   bool run_pass(unsigned pass, exec_list *instructions);
+   bool run_pass_on_function(unsigned pass, ir_function *func);
+   void build_regions(exec_list *instructions);
+
+   void *mem_ctx;
+   struct ir_pass_options options;
+
+   region *regions;
+   unsigned num_regions;
+   unsigned regions_size;
+
+   /** Whole-program passes known to make no progress */
+   unsigned global_done;
+};
+
+#endif /* IR_PASS_MANAGER_H */
@@ -0,0 +1,1149 @@
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file ir_serialize.cpp
+ *
+ * Compact binary form of the GLSL IR.
+ *
+ * The IR is written as a pre-order walk of the tree.  Each instruction
+ * starts with its \c ir_node_type; a zero tag (\c ir_type_unset) stands for
+ * a \c NULL pointer or the end of an instruction list.  Variables are
+ * numbered in the order they are declared and references to them are
+ * written as those numbers, so a reference must follow the declaration it
+ * refers to.  Function signatures are numbered, and their return types
+ * written, before the instructions, so calls may precede the callee.  Types
+ * are written by name, except for arrays and user-defined records, which
+ * are written structurally.
+ */
+
+#include <string.h>
+#include "main/core.h" /* for gl_shader */
+#include "ir.h"
+#include "ir_serialize.h"
+#include "glsl_symbol_table.h"
+#include "program/hash_table.h"
+
+ir_blob::ir_blob(void *mem_ctx)
+   : data(NULL), size(0), mem_ctx(mem_ctx), capacity(0)
+{
+}
+
+void
+ir_blob::write(const void *bytes, size_t n)
+{
+   if (size + n > capacity) {
+      size_t new_capacity = capacity ? capacity * 2 : 4096;
+      while (new_capacity < size + n)
+	 new_capacity *= 2;
+
+      data = (uint8_t *) reralloc_size(mem_ctx, data, new_capacity);
+      capacity = new_capacity;
+   }
+
+   memcpy(data + size, bytes, n);
+   size += n;
+}
+
+void
+ir_blob::write_string(const char *s)
+{
+   if (s == NULL) {
+      write_uint32(0);
+      return;
+   }
+
+   const uint32_t len = strlen(s) + 1;
+   write_uint32(len);
+   write(s, len);
+}
+
+bool
+ir_blob_reader::read(void *bytes, size_t n)
+{
+   if (overrun || (size_t) (end - current) < n) {
+      overrun = true;
+      memset(bytes, 0, n);
+      return false;
+   }
+
+   memcpy(bytes, current, n);
+   current += n;
+   return true;
+}
+
+uint8_t
+ir_blob_reader::read_uint8()
+{
+   uint8_t v;
+   read(&v, sizeof(v));
+   return v;
+}
+
+uint32_t
+ir_blob_reader::read_uint32()
+{
+   uint32_t v;
+   read(&v, sizeof(v));
+   return v;
+}
+
+int32_t
+ir_blob_reader::read_int32()
+{
+   int32_t v;
+   read(&v, sizeof(v));
+   return v;
+}
+
+char *
+ir_blob_reader::read_string(void *mem_ctx)
+{
+   const uint32_t len = read_uint32();
+   if (len == 0 || overrun)
+      return NULL;
+
+   if ((size_t) (end - current) < len || current[len - 1] != '\0') {
+      overrun = true;
+      return NULL;
+   }
+
+   char *s = ralloc_strndup(mem_ctx, (const char *) current, len - 1);
+   current += len;
+   return s;
+}
+
+
+namespace {
+
+enum {
+   callee_local = 0,
+   callee_builtin = 1,
+};
+
+class ir_serializer {
+public:
+   ir_serializer(ir_blob *blob, gl_shader **builtins, unsigned num_builtins)
+      : blob(blob), builtins(builtins), num_builtins(num_builtins),
+	num_variables(0), num_signatures(0), failed(false)
+   {
+      this->ids = hash_table_ctor(0, hash_table_pointer_hash,
+				  hash_table_pointer_compare);
+   }
+
+   ~ir_serializer()
+   {
+      hash_table_dtor(this->ids);
+   }
+
+   void write_top_level(const exec_list *list);
+   void write_list(const exec_list *list);
+   void write_instruction(ir_instruction *ir);
+
+private:
+   void write_type(const glsl_type *type);
+   void write_variable(ir_variable *var);
+   void write_variable_ref(ir_variable *var);
+   void write_function(ir_function *f);
+   void write_callee(const ir_function_signature *callee);
+   void write_constant(ir_constant *c);
+   void write_texture(ir_texture *tex);
+
+   void assign_id(const void *ptr, unsigned id)
+   {
+      hash_table_insert(this->ids, (void *) (uintptr_t) (id + 1), ptr);
+   }
+
+   /** Return the number assigned to \c ptr, or -1 if it has none. */
+   int find_id(const void *ptr)
+   {
+      return (int) (uintptr_t) hash_table_find(this->ids, ptr) - 1;
+   }
+
+   ir_blob *blob;
+   gl_shader **builtins;
+   unsigned num_builtins;
+
+   /** Maps variables and signatures to their numbers, plus one. */
+   struct hash_table *ids;
+   unsigned num_variables;
+   unsigned num_signatures;
+
+public:
+   bool failed;
+};
+
+void
+ir_serializer::write_type(const glsl_type *type)
+{
+   blob->write_uint8(type->base_type);
+
+   switch (type->base_type) {
+   case GLSL_TYPE_ARRAY:
+      write_type(type->fields.array);
+      blob->write_uint32(type->length);
+      break;
+
+   case GLSL_TYPE_STRUCT:
+      if (glsl_type::get_builtin_instance(type->name) == type) {
+	 blob->write_uint8(1);
+	 blob->write_string(type->name);
+      } else {
+	 blob->write_uint8(0);
+	 blob->write_string(type->name);
+	 blob->write_uint32(type->length);
+	 for (unsigned i = 0; i < type->length; i++) {
+	    blob->write_string(type->fields.structure[i].name);
+	    write_type(type->fields.structure[i].type);
+	 }
+      }
+      break;
+
+   default:
+      blob->write_string(type->name);
+      break;
+   }
+}
+
+void
+ir_serializer::write_variable_ref(ir_variable *var)
+{
+   const int id = find_id(var);
+   if (id < 0)
+      failed = true;
+
+   blob->write_int32(id);
+}
+
+void
+ir_serializer::write_variable(ir_variable *var)
+{
+   assign_id(var, num_variables++);
+
+   blob->write_string(var->name);
+   write_type(var->type);
+   blob->write_uint32(var->max_array_access);
+   blob->write_uint8(var->read_only);
+   blob->write_uint8(var->centroid);
+   blob->write_uint8(var->invariant);
+   blob->write_uint8(var->used);
+   blob->write_uint8(var->assigned);
+   blob->write_uint8(var->mode);
+   blob->write_uint8(var->interpolation);
+   blob->write_uint8(var->origin_upper_left);
+   blob->write_uint8(var->pixel_center_integer);
+   blob->write_uint8(var->explicit_location);
+   blob->write_uint8(var->explicit_index);
+   blob->write_uint8(var->has_initializer);
+   blob->write_uint8(var->depth_layout);
+   blob->write_int32(var->location);
+   blob->write_int32(var->uniform_block);
+   blob->write_int32(var->index);
+   blob->write_string(var->warn_extension);
+
+   blob->write_uint32(var->num_state_slots);
+   for (unsigned i = 0; i < var->num_state_slots; i++)
+      blob->write(&var->state_slots[i], sizeof(var->state_slots[i]));
+
+   write_instruction(var->constant_value);
+   write_instruction(var->constant_initializer);
+}
+
+void
+ir_serializer::write_function(ir_function *f)
+{
+   blob->write_string(f->name);
+
+   foreach_list(node, &f->signatures) {
+      ir_function_signature *sig = (ir_function_signature *) node;
+
+      /* Signatures were numbered up front by write_top_level. */
+      const int id = find_id(sig);
+      if (id < 0)
+	 failed = true;
+
+      blob->write_uint8(ir_type_function_signature);
+      blob->write_int32(id);
+      blob->write_uint8(sig->is_defined);
+      blob->write_uint8(sig->is_builtin);
+      foreach_list(param, &sig->parameters) {
+	 blob->write_uint8(ir_type_variable);
+	 write_variable((ir_variable *) param);
+      }
+      blob->write_uint8(ir_type_unset);
+      write_list(&sig->body);
+   }
+   blob->write_uint8(ir_type_unset);
+}
+
+void
+ir_serializer::write_callee(const ir_function_signature *callee)
+{
+   /* Look in the built-ins first.  When the built-in library itself is
+    * serialized, a body may call another signature of its own function,
+    * and that call must refer to the prototype in the built-in shader.
+    */
+   const char *name = callee->function_name();
+   for (unsigned i = 0; i < num_builtins; i++) {
+      ir_function *f = builtins[i]->symbols->get_function(name);
+      if (f != callee->function())
+	 continue;
+
+      unsigned index = 0;
+      foreach_list(node, &f->signatures) {
+	 if (node == callee) {
+	    blob->write_uint8(callee_builtin);
+	    blob->write_uint32(i);
+	    blob->write_string(name);
+	    blob->write_uint32(index);
+	    return;
+	 }
+	 index++;
+      }
+   }
+
+   const int id = find_id(callee);
+   if (id < 0) {
+      failed = true;
+      return;
+   }
+
+   blob->write_uint8(callee_local);
+   blob->write_uint32(id);
+}
+
+void
+ir_serializer::write_constant(ir_constant *c)
+{
+   write_type(c->type);
+
+   if (c->type->is_array()) {
+      for (unsigned i = 0; i < c->type->length; i++)
+	 write_constant(c->array_elements[i]);
+   } else if (c->type->is_record()) {
+      foreach_list(node, &c->components)
+	 write_constant((ir_constant *) node);
+   } else {
+      blob->write(&c->value, sizeof(c->value));
+   }
+}
+
+void
+ir_serializer::write_texture(ir_texture *tex)
+{
+   blob->write_uint8(tex->op);
+   write_type(tex->type);
+   write_instruction(tex->sampler);
+   write_instruction(tex->coordinate);
+   write_instruction(tex->projector);
+   write_instruction(tex->shadow_comparitor);
+   write_instruction(tex->offset);
+
+   switch (tex->op) {
+   case ir_tex:
+      break;
+   case ir_txb:
+      write_instruction(tex->lod_info.bias);
+      break;
+   case ir_txl:
+   case ir_txf:
+   case ir_txs:
+      write_instruction(tex->lod_info.lod);
+      break;
+   case ir_txd:
+      write_instruction(tex->lod_info.grad.dPdx);
+      write_instruction(tex->lod_info.grad.dPdy);
+      break;
+   }
+}
+
+void
+ir_serializer::write_top_level(const exec_list *list)
+{
+   /* Functions may be called before they appear in the list; the linker,
+    * for example, appends the functions it pulls in after main.  So number
+    * all of the signatures, and write their return types, first.  This is
+    * all the reader needs to create a call to a signature.
+    */
+   foreach_list_const(node, list) {
+      ir_function *f = ((ir_instruction *) node)->as_function();
+      if (f == NULL)
+	 continue;
+
+      foreach_list(sig_node, &f->signatures)
+	 assign_id((ir_function_signature *) sig_node, num_signatures++);
+   }
+
+   blob->write_uint32(num_signatures);
+   foreach_list_const(node, list) {
+      ir_function *f = ((ir_instruction *) node)->as_function();
+      if (f == NULL)
+	 continue;
+
+      foreach_list(sig_node, &f->signatures)
+	 write_type(((ir_function_signature *) sig_node)->return_type);
+   }
+
+   write_list(list);
+}
+
+void
+ir_serializer::write_list(const exec_list *list)
+{
+   foreach_list_const(node, list)
+      write_instruction((ir_instruction *) node);
+
+   blob->write_uint8(ir_type_unset);
+}
+
+void
+ir_serializer::write_instruction(ir_instruction *ir)
+{
+   if (ir == NULL) {
+      blob->write_uint8(ir_type_unset);
+      return;
+   }
+
+   blob->write_uint8(ir->ir_type);
+
+   switch (ir->ir_type) {
+   case ir_type_variable:
+      write_variable((ir_variable *) ir);
+      break;
+
+   case ir_type_assignment: {
+      ir_assignment *assign = (ir_assignment *) ir;
+      write_instruction(assign->lhs);
+      write_instruction(assign->rhs);
+      write_instruction(assign->condition);
+      blob->write_uint8(assign->write_mask);
+      break;
+   }
+
+   case ir_type_call: {
+      ir_call *call = (ir_call *) ir;
+      write_callee(call->callee);
+      write_instruction(call->return_deref);
+      write_list(&call->actual_parameters);
+      blob->write_uint8(call->use_builtin);
+      break;
+   }
+
+   case ir_type_constant:
+      write_constant((ir_constant *) ir);
+      break;
+
+   case ir_type_dereference_array: {
+      ir_dereference_array *deref = (ir_dereference_array *) ir;
+      write_instruction(deref->array);
+      write_instruction(deref->array_index);
+      break;
+   }
+
+   case ir_type_dereference_record: {
+      ir_dereference_record *deref = (ir_dereference_record *) ir;
+      write_instruction(deref->record);
+      blob->write_string(deref->field);
+      break;
+   }
+
+   case ir_type_dereference_variable:
+      write_variable_ref(((ir_dereference_variable *) ir)->var);
+      break;
+
+   case ir_type_discard:
+      write_instruction(((ir_discard *) ir)->condition);
+      break;
+
+   case ir_type_expression: {
+      ir_expression *expr = (ir_expression *) ir;
+      blob->write_uint32(expr->operation);
+      write_type(expr->type);
+      const unsigned num_operands = expr->get_num_operands();
+      for (unsigned i = 0; i < Elements(expr->operands); i++)
+	 write_instruction(i < num_operands ? expr->operands[i] : NULL);
+      break;
+   }
+
+   case ir_type_function:
+      write_function((ir_function *) ir);
+      break;
+
+   case ir_type_if: {
+      ir_if *iff = (ir_if *) ir;
+      write_instruction(iff->condition);
+      write_list(&iff->then_instructions);
+      write_list(&iff->else_instructions);
+      break;
+   }
+
+   case ir_type_loop: {
+      ir_loop *loop = (ir_loop *) ir;
+      write_instruction(loop->from);
+      write_instruction(loop->to);
+      write_instruction(loop->increment);
+      if (loop->counter != NULL) {
+	 blob->write_uint8(1);
+	 write_variable_ref(loop->counter);
+      } else {
+	 blob->write_uint8(0);
+      }
+      blob->write_int32(loop->cmp);
+      write_list(&loop->body_instructions);
+      break;
+   }
+
+   case ir_type_loop_jump:
+      blob->write_uint8(((ir_loop_jump *) ir)->mode);
+      break;
+
+   case ir_type_return:
+      write_instruction(((ir_return *) ir)->value);
+      break;
+
+   case ir_type_swizzle: {
+      ir_swizzle *swiz = (ir_swizzle *) ir;
+      write_instruction(swiz->val);
+      blob->write_uint8(swiz->mask.x);
+      blob->write_uint8(swiz->mask.y);
+      blob->write_uint8(swiz->mask.z);
+      blob->write_uint8(swiz->mask.w);
+      blob->write_uint8(swiz->mask.num_components);
+      blob->write_uint8(swiz->mask.has_duplicates);
+      break;
+   }
+
+   case ir_type_texture:
+      write_texture((ir_texture *) ir);
+      break;
+
+   default:
+      /* Function signatures only appear inside functions. */
+      failed = true;
+      break;
+   }
+}
+
+
+class ir_deserializer {
+public:
+   ir_deserializer(void *mem_ctx, glsl_symbol_table *symbols,
+		   gl_shader **builtins, unsigned num_builtins,
+		   ir_blob_reader *reader, bool read_builtin_bodies)
+      : mem_ctx(mem_ctx), symbols(symbols), builtins(builtins),
+	num_builtins(num_builtins), read_builtin_bodies(read_builtin_bodies),
+	reader(reader),
+	variables(NULL), num_variables(0), variables_size(0),
+	signatures(NULL), num_signatures(0), failed(false)
+   {
+   }
+
+   bool read_top_level(exec_list *list);
+   bool read_list(exec_list *list, bool top_level);
+
+private:
+   const glsl_type *read_type();
+   ir_instruction *read_instruction(bool top_level);
+   ir_rvalue *read_rvalue();
+   ir_dereference *read_dereference();
+   ir_variable *read_variable(bool top_level);
+   ir_variable *read_variable_ref();
+   ir_function *read_function(bool top_level);
+   ir_function_signature *read_callee();
+   ir_constant *read_constant();
+   ir_constant *read_optional_constant();
+   ir_texture *read_texture();
+
+   ir_instruction *fail()
+   {
+      failed = true;
+      return NULL;
+   }
+
+   /** Has everything read so far been valid? */
+   bool ok()
+   {
+      if (reader->overrun)
+	 failed = true;
+      return !failed;
+   }
+
+   void *mem_ctx;
+   glsl_symbol_table *symbols;
+   gl_shader **builtins;
+   unsigned num_builtins;
+   bool read_builtin_bodies;
+   ir_blob_reader *reader;
+
+   /** Variables read so far and all signatures, indexed by number */
+   /*@{*/
+   ir_variable **variables;
+   unsigned num_variables;
+   unsigned variables_size;
+   ir_function_signature **signatures;
+   unsigned num_signatures;
+   /*@}*/
+
+public:
+   bool failed;
+};
+
+const glsl_type *
+ir_deserializer::read_type()
+{
+   const unsigned base_type = reader->read_uint8();
+   const glsl_type *type = NULL;
+
+   switch (base_type) {
+   case GLSL_TYPE_ARRAY: {
+      const glsl_type *element = read_type();
+      const unsigned length = reader->read_uint32();
+      if (element != NULL)
+	 type = glsl_type::get_array_instance(element, length);
+      break;
+   }
+
+   case GLSL_TYPE_STRUCT: {
+      const bool builtin = reader->read_uint8();
+      char *name = reader->read_string(mem_ctx);
+      if (name == NULL)
+	 break;
+
+      if (builtin) {
+	 type = glsl_type::get_builtin_instance(name);
+	 break;
+      }
+
+      const unsigned length = reader->read_uint32();
+      if (reader->overrun)
+	 break;
+
+      glsl_struct_field *fields =
+	 ralloc_array(mem_ctx, glsl_struct_field, length);
+      for (unsigned i = 0; i < length; i++) {
+	 fields[i].name = reader->read_string(mem_ctx);
+	 fields[i].type = read_type();
+	 if (fields[i].name == NULL || fields[i].type == NULL)
+	    return NULL;
+      }
+      type = glsl_type::get_record_instance(fields, length, name);
+      break;
+   }
+
+   default: {
+      char *name = reader->read_string(mem_ctx);
+      if (name != NULL)
+	 type = glsl_type::get_builtin_instance(name);
+      break;
+   }
+   }
+
+   if (type == NULL || type->base_type != base_type) {
+      failed = true;
+      return NULL;
+   }
+
+   return type;
+}
+
+ir_variable *
+ir_deserializer::read_variable(bool top_level)
+{
+   char *name = reader->read_string(mem_ctx);
+   const glsl_type *type = read_type();
+   if (!ok() || name == NULL)
+      return NULL;
+
+   ir_variable *var = NULL;
+   if (top_level && symbols != NULL) {
+      var = symbols->get_variable(name);
+      if (var != NULL) {
+	 /* Reuse the existing object so that pointers to it stay valid. */
+	 if (var->next != NULL)
+	    var->remove();
+	 var->type = type;
+      }
+   }
+
+   if (var == NULL) {
+      var = new(mem_ctx) ir_variable(type, name, ir_var_auto);
+      if (top_level && symbols != NULL)
+	 symbols->add_variable(var);
+   }
+
+   var->max_array_access = reader->read_uint32();
+   var->read_only = reader->read_uint8();
+   var->centroid = reader->read_uint8();
+   var->invariant = reader->read_uint8();
+   var->used = reader->read_uint8();
+   var->assigned = reader->read_uint8();
+   var->mode = reader->read_uint8();
+   var->interpolation = reader->read_uint8();
+   var->origin_upper_left = reader->read_uint8();
+   var->pixel_center_integer = reader->read_uint8();
+   var->explicit_location = reader->read_uint8();
+   var->explicit_index = reader->read_uint8();
+   var->has_initializer = reader->read_uint8();
+   var->depth_layout = (ir_depth_layout) reader->read_uint8();
+   var->location = reader->read_int32();
+   var->uniform_block = reader->read_int32();
+   var->index = reader->read_int32();
+   var->warn_extension = reader->read_string(var);
+
+   var->num_state_slots = reader->read_uint32();
+   var->state_slots = NULL;
+   if (var->num_state_slots > 0) {
+      if (var->num_state_slots > (size_t) (reader->end - reader->current)) {
+	 failed = true;
+	 return NULL;
+      }
+
+      var->state_slots = ralloc_array(var, ir_state_slot,
+				      var->num_state_slots);
+      for (unsigned i = 0; i < var->num_state_slots; i++)
+	 reader->read(&var->state_slots[i], sizeof(var->state_slots[i]));
+   }
+
+   /* Number the variable before reading its initializers, in the same
+    * order as the serializer.
+    */
+   if (num_variables == variables_size) {
+      variables_size = variables_size ? variables_size * 2 : 16;
+      variables = reralloc(mem_ctx, variables, ir_variable *, variables_size);
+   }
+   variables[num_variables++] = var;
+
+   var->constant_value = read_optional_constant();
+   var->constant_initializer = read_optional_constant();
+
+   return failed ? NULL : var;
+}
+
+ir_variable *
+ir_deserializer::read_variable_ref()
+{
+   const int id = reader->read_int32();
+   if (id < 0 || (unsigned) id >= num_variables) {
+      failed = true;
+      return NULL;
+   }
+
+   return variables[id];
+}
+
+ir_function *
+ir_deserializer::read_function(bool top_level)
+{
+   char *name = reader->read_string(mem_ctx);
+   if (name == NULL)
+      return (ir_function *) fail();
+
+   ir_function *f = NULL;
+   if (top_level && symbols != NULL) {
+      f = symbols->get_function(name);
+      if (f != NULL) {
+	 if (f->next != NULL)
+	    f->remove();
+	 f->signatures.make_empty();
+      }
+   }
+
+   if (f == NULL) {
+      f = new(mem_ctx) ir_function(name);
+      if (top_level && symbols != NULL)
+	 symbols->add_function(f);
+   }
+
+   while (!failed && reader->read_uint8() == ir_type_function_signature) {
+      const int id = reader->read_int32();
+
+      /* Each signature is defined exactly once. */
+      if (id < 0 || (unsigned) id >= num_signatures
+	  || signatures[id]->next != NULL)
+	 return (ir_function *) fail();
+
+      ir_function_signature *sig = signatures[id];
+      f->add_signature(sig);
+
+      sig->is_defined = reader->read_uint8();
+      sig->is_builtin = reader->read_uint8();
+
+      while (!failed && reader->read_uint8() == ir_type_variable) {
+	 ir_variable *param = read_variable(false);
+	 if (param != NULL)
+	    sig->parameters.push_tail(param);
+      }
+
+      read_list(&sig->body, false);
+   }
+
+   return failed ? NULL : f;
+}
+
+ir_function_signature *
+ir_deserializer::read_callee()
+{
+   const unsigned kind = reader->read_uint8();
+
+   if (kind == callee_local) {
+      const unsigned id = reader->read_uint32();
+      if (id >= num_signatures)
+	 return (ir_function_signature *) fail();
+      return signatures[id];
+   }
+
+   if (kind != callee_builtin)
+      return (ir_function_signature *) fail();
+
+   const unsigned shader = reader->read_uint32();
+   char *name = reader->read_string(mem_ctx);
+   unsigned index = reader->read_uint32();
+   if (shader >= num_builtins || name == NULL)
+      return (ir_function_signature *) fail();
+
+   ir_function *f = builtins[shader]->symbols->get_function(name);
+   if (f == NULL)
+      return (ir_function_signature *) fail();
+
+   /* The body is needed for constant expression evaluation. */
+   if (read_builtin_bodies)
+      _mesa_glsl_read_builtin_function(builtins[shader], name);
+
+   foreach_list(node, &f->signatures) {
+      if (index-- == 0)
+	 return (ir_function_signature *) node;
+   }
+
+   return (ir_function_signature *) fail();
+}
+
+ir_constant *
+ir_deserializer::read_constant()
+{
+   const glsl_type *type = read_type();
+   if (type == NULL)
+      return NULL;
+
+   if (type->is_array() || type->is_record()) {
+      /* For records, length is the number of fields. */
+      exec_list values;
+      for (unsigned i = 0; i < type->length; i++) {
+	 ir_constant *value = read_constant();
+	 if (value == NULL)
+	    return NULL;
+	 values.push_tail(value);
+      }
+      return new(mem_ctx) ir_constant(type, &values);
+   }
+
+   ir_constant_data data;
+   reader->read(&data, sizeof(data));
+   if (!ok() || !(type->is_scalar() || type->is_vector() || type->is_matrix()))
+      return (ir_constant *) fail();
+
+   return new(mem_ctx) ir_constant(type, &data);
+}
+
+ir_constant *
+ir_deserializer::read_optional_constant()
+{
+   switch (reader->read_uint8()) {
+   case ir_type_unset:
+      return NULL;
+   case ir_type_constant:
+      return read_constant();
+   default:
+      return (ir_constant *) fail();
+   }
+}
+
+ir_texture *
+ir_deserializer::read_texture()
+{
+   const unsigned op = reader->read_uint8();
+   if (op > ir_txs)
+      return (ir_texture *) fail();
+
+   ir_texture *tex = new(mem_ctx) ir_texture((ir_texture_opcode) op);
+   const glsl_type *type = read_type();
+   ir_dereference *sampler = read_dereference();
+   if (!ok())
+      return NULL;
+
+   tex->set_sampler(sampler, type);
+   tex->coordinate = read_rvalue();
+   tex->projector = read_rvalue();
+   tex->shadow_comparitor = read_rvalue();
+   tex->offset = read_rvalue();
+
+   switch (tex->op) {
+   case ir_tex:
+      break;
+   case ir_txb:
+      tex->lod_info.bias = read_rvalue();
+      break;
+   case ir_txl:
+   case ir_txf:
+   case ir_txs:
+      tex->lod_info.lod = read_rvalue();
+      break;
+   case ir_txd:
+      tex->lod_info.grad.dPdx = read_rvalue();
+      tex->lod_info.grad.dPdy = read_rvalue();
+      break;
+   }
+
+   return tex;
+}
+
+ir_rvalue *
+ir_deserializer::read_rvalue()
+{
+   ir_instruction *ir = read_instruction(false);
+   if (ir == NULL)
+      return NULL;
+
+   ir_rvalue *rvalue = ir->as_rvalue();
+   if (rvalue == NULL)
+      failed = true;
+   return rvalue;
+}
+
+ir_dereference *
+ir_deserializer::read_dereference()
+{
+   ir_rvalue *rvalue = read_rvalue();
+   ir_dereference *deref = rvalue ? rvalue->as_dereference() : NULL;
+   if (deref == NULL)
+      failed = true;
+   return deref;
+}
+
+bool
+ir_deserializer::read_top_level(exec_list *list)
+{
+   num_signatures = reader->read_uint32();
+
+   /* Each return type takes at least one byte. */
+   if (num_signatures > (size_t) (reader->end - reader->current))
+      return false;
+
+   signatures = ralloc_array(mem_ctx, ir_function_signature *,
+			     num_signatures);
+   for (unsigned i = 0; i < num_signatures; i++) {
+      const glsl_type *return_type = read_type();
+      if (return_type == NULL)
+	 return false;
+
+      signatures[i] = new(mem_ctx) ir_function_signature(return_type);
+   }
+
+   return read_list(list, true);
+}
+
+bool
+ir_deserializer::read_list(exec_list *list, bool top_level)
+{
+   while (!failed) {
+      ir_instruction *ir = read_instruction(top_level);
+      if (ir == NULL)
+	 break;
+      list->push_tail(ir);
+   }
+
+   return !failed && !reader->overrun;
+}
+
+ir_instruction *
+ir_deserializer::read_instruction(bool top_level)
+{
+   const unsigned tag = reader->read_uint8();
+
+   if (!ok())
+      return fail();
+
+   switch (tag) {
+   case ir_type_unset:
+      return NULL;
+
+   case ir_type_variable:
+      return read_variable(top_level);
+
+   case ir_type_assignment: {
+      ir_dereference *lhs = read_dereference();
+      ir_rvalue *rhs = read_rvalue();
+      ir_rvalue *condition = read_rvalue();
+      const unsigned write_mask = reader->read_uint8();
+      if (!ok() || rhs == NULL)
+	 return fail();
+      return new(mem_ctx) ir_assignment(lhs, rhs, condition, write_mask);
+   }
+
+   case ir_type_call: {
+      ir_function_signature *callee = read_callee();
+      ir_rvalue *ret = read_rvalue();
+      exec_list parameters;
+      read_list(&parameters, false);
+      const bool use_builtin = reader->read_uint8();
+      if (!ok())
+	 return NULL;
+
+      ir_dereference_variable *return_deref = NULL;
+      if (ret != NULL) {
+	 return_deref = ret->as_dereference_variable();
+	 if (return_deref == NULL)
+	    return fail();
+      }
+
+      ir_call *call =
+	 new(mem_ctx) ir_call(callee, return_deref, &parameters);
+      call->use_builtin = use_builtin;
+      return call;
+   }
+
+   case ir_type_constant:
+      return read_constant();
+
+   case ir_type_dereference_array: {
+      ir_rvalue *array = read_rvalue();
+      ir_rvalue *index = read_rvalue();
+      if (!ok() || array == NULL || index == NULL)
+	 return fail();
+      return new(mem_ctx) ir_dereference_array(array, index);
+   }
+
+   case ir_type_dereference_record: {
+      ir_rvalue *record = read_rvalue();
+      char *field = reader->read_string(mem_ctx);
+      if (!ok() || record == NULL || field == NULL
+	  || !record->type->is_record())
+	 return fail();
+      return new(mem_ctx) ir_dereference_record(record, field);
+   }
+
+   case ir_type_dereference_variable: {
+      ir_variable *var = read_variable_ref();
+      if (var == NULL)
+	 return NULL;
+      return new(mem_ctx) ir_dereference_variable(var);
+   }
+
+   case ir_type_discard:
+      return new(mem_ctx) ir_discard(read_rvalue());
+
+   case ir_type_expression: {
+      const unsigned op = reader->read_uint32();
+      const glsl_type *type = read_type();
+      ir_rvalue *operands[4];
+      for (unsigned i = 0; i < Elements(operands); i++)
+	 operands[i] = read_rvalue();
+      if (!ok() || op > ir_last_opcode)
+	 return fail();
+      return new(mem_ctx) ir_expression(op, type, operands[0], operands[1],
+					operands[2], operands[3]);
+   }
+
+   case ir_type_function:
+      /* Functions only appear at the top level. */
+      if (!top_level)
+	 return fail();
+      return read_function(top_level);
+
+   case ir_type_if: {
+      ir_if *iff = new(mem_ctx) ir_if(read_rvalue());
+      read_list(&iff->then_instructions, false);
+      read_list(&iff->else_instructions, false);
+      if (!ok() || iff->condition == NULL)
+	 return fail();
+      return iff;
+   }
+
+   case ir_type_loop: {
+      ir_loop *loop = new(mem_ctx) ir_loop();
+      loop->from = read_rvalue();
+      loop->to = read_rvalue();
+      loop->increment = read_rvalue();
+      if (reader->read_uint8())
+	 loop->counter = read_variable_ref();
+      loop->cmp = reader->read_int32();
+      read_list(&loop->body_instructions, false);
+      return failed ? NULL : loop;
+   }
+
+   case ir_type_loop_jump: {
+      const unsigned mode = reader->read_uint8();
+      if (mode != ir_loop_jump::jump_break
+	  && mode != ir_loop_jump::jump_continue)
+	 return fail();
+      return new(mem_ctx) ir_loop_jump((ir_loop_jump::jump_mode) mode);
+   }
+
+   case ir_type_return:
+      return new(mem_ctx) ir_return(read_rvalue());
+
+   case ir_type_swizzle: {
+      ir_rvalue *val = read_rvalue();
+      ir_swizzle_mask mask;
+      mask.x = reader->read_uint8();
+      mask.y = reader->read_uint8();
+      mask.z = reader->read_uint8();
+      mask.w = reader->read_uint8();
+      mask.num_components = reader->read_uint8();
+      mask.has_duplicates = reader->read_uint8();
+      if (!ok() || val == NULL)
+	 return fail();
+      return new(mem_ctx) ir_swizzle(val, mask);
+   }
+
+   case ir_type_texture:
+      return read_texture();
+
+   default:
+      return fail();
+   }
+}
+
+} /* anonymous namespace */
+
+
+bool
+ir_serialize(ir_blob *blob, exec_list *instructions,
+	     gl_shader **builtins, unsigned num_builtins)
+{
+   ir_serializer s(blob, builtins, num_builtins);
+
+   s.write_top_level(instructions);
+   return !s.failed;
+}
+
+bool
+ir_deserialize(void *mem_ctx, exec_list *instructions,
+	       glsl_symbol_table *symbols,
+	       gl_shader **builtins, unsigned num_builtins,
+	       ir_blob_reader *reader, bool read_builtin_bodies)
+{
+   ir_deserializer d(mem_ctx, symbols, builtins, num_builtins, reader,
+		     read_builtin_bodies);
+
+   return d.read_top_level(instructions);
+}
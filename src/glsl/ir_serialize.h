@@ -0,0 +1,127 @@
+/* -*- c++ -*- */
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+#ifndef IR_SERIALIZE_H
+#define IR_SERIALIZE_H
+
+#include <stdint.h>
+#include "ir.h"
+
+class glsl_symbol_table;
+
+/**
+ * Version of the binary IR format.  Bump this whenever the format changes.
+ */
+#define IR_SERIALIZE_VERSION 2
+
+/**
+ * A growable, ralloc'd byte buffer that IR is serialized into.
+ */
+class ir_blob {
+public:
+   /** The buffer is allocated out of \c mem_ctx. */
+   ir_blob(void *mem_ctx);
+
+   void write(const void *bytes, size_t n);
+   void write_uint8(uint8_t v) { write(&v, sizeof(v)); }
+   void write_uint32(uint32_t v) { write(&v, sizeof(v)); }
+   void write_int32(int32_t v) { write(&v, sizeof(v)); }
+
+   /** Write a string, which may be \c NULL. */
+   void write_string(const char *s);
+
+   uint8_t *data;
+   size_t size;
+
+private:
+   void *mem_ctx;
+   size_t capacity;
+};
+
+/**
+ * Reads values back out of a serialized buffer.
+ *
+ * Reading past the end of the buffer sets \c overrun and returns zeros, so
+ * callers only need to check \c overrun once they are done.
+ */
+class ir_blob_reader {
+public:
+   ir_blob_reader(const uint8_t *data, size_t size)
+      : current(data), end(data + size), overrun(false)
+   {
+   }
+
+   bool read(void *bytes, size_t n);
+   uint8_t read_uint8();
+   uint32_t read_uint32();
+   int32_t read_int32();
+
+   /** Read a string into \c mem_ctx; \c NULL strings come back as \c NULL. */
+   char *read_string(void *mem_ctx);
+
+   const uint8_t *current;
+   const uint8_t *end;
+   bool overrun;
+};
+
+/**
+ * Serialize a list of top-level IR instructions
+ *
+ * Calls to functions of the \c builtins shaders are recorded by their
+ * position in those shaders, even when \c instructions holds the function
+ * too.  Calls to any other function must be to one in \c instructions.
+ *
+ * \return
+ * \c false if the IR cannot be serialized, for example because it calls a
+ * function that is in neither \c instructions nor \c builtins.
+ */
+bool
+ir_serialize(ir_blob *blob, exec_list *instructions,
+	     gl_shader **builtins, unsigned num_builtins);
+
+/**
+ * Deserialize IR written by \c ir_serialize
+ *
+ * The new IR is allocated out of \c mem_ctx and appended to
+ * \c instructions.  Top-level functions and variables are entered into
+ * \c symbols.  If \c symbols already contains a variable or function of the
+ * same name, that object is updated in place and reused, so that existing
+ * pointers to it stay valid.
+ *
+ * \c builtins must be the same built-in shaders, in the same order, that
+ * were passed to \c ir_serialize.  Unless \c read_builtin_bodies is
+ * \c false, the body of each built-in that the IR calls is read as well.
+ *
+ * \return
+ * \c false if the data is malformed.  The contents of \c instructions are
+ * undefined in that case.
+ */
+bool
+ir_deserialize(void *mem_ctx, exec_list *instructions,
+	       glsl_symbol_table *symbols,
+	       gl_shader **builtins, unsigned num_builtins,
+	       ir_blob_reader *reader, bool read_builtin_bodies = true);
+
+#endif /* IR_SERIALIZE_H */
@@ -0,0 +1,221 @@
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file ir_stats.cpp
+ *
+ * Collecting and printing compiler statistics.
+ */
+
+#include <string.h>
+#include <time.h>
+#include "main/core.h" /* for struct gl_shader */
+#include "ir.h"
+#include "ir_hierarchical_visitor.h"
+#include "ir_stats.h"
+
+static const char *const phase_names[GLSL_PHASE_COUNT] = {
+   "preprocess",
+   "parse",
+   "ast_to_hir",
+   "optimize",
+   "link",
+   "driver_link",
+};
+
+static const char *const node_names[ir_type_max] = {
+   "unset",
+   "variable",
+   "assignment",
+   "call",
+   "constant",
+   "dereference_array",
+   "dereference_record",
+   "dereference_variable",
+   "discard",
+   "expression",
+   "function",
+   "function_signature",
+   "if",
+   "loop",
+   "loop_jump",
+   "return",
+   "swizzle",
+   "texture",
+};
+
+double
+glsl_stats_get_time(void)
+{
+#if defined(_WIN32)
+   return (double) clock() / CLOCKS_PER_SEC;
+#else
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+void
+glsl_stats_init(struct glsl_shader_stats *stats)
+{
+   memset(stats, 0, sizeof(*stats));
+}
+
+/**
+ * Cost of computing one component of an expression
+ */
+static unsigned
+expression_cost(ir_expression_operation op)
+{
+   switch (op) {
+   case ir_unop_rcp:
+   case ir_unop_rsq:
+   case ir_unop_sqrt:
+   case ir_unop_exp:
+   case ir_unop_log:
+   case ir_unop_exp2:
+   case ir_unop_log2:
+   case ir_unop_sin:
+   case ir_unop_cos:
+   case ir_unop_sin_reduced:
+   case ir_unop_cos_reduced:
+   case ir_binop_div:
+   case ir_binop_mod:
+   case ir_binop_pow:
+      return 4;
+   default:
+      return 1;
+   }
+}
+
+static void
+count_instruction(ir_instruction *ir, void *data)
+{
+   struct ir_instruction_counts *counts =
+      (struct ir_instruction_counts *) data;
+
+   counts->nodes[ir->ir_type]++;
+
+   switch (ir->ir_type) {
+   case ir_type_expression: {
+      ir_expression *expr = (ir_expression *) ir;
+
+      /* A dot product computes its result from every operand component. */
+      const unsigned components = (expr->operation == ir_binop_dot)
+	 ? expr->operands[0]->type->components()
+	 : expr->type->components();
+
+      counts->alu++;
+      counts->alu_components += components;
+      counts->cost += components * expression_cost(expr->operation);
+      break;
+   }
+   case ir_type_texture:
+      counts->texture++;
+      counts->cost += 4;
+      break;
+   case ir_type_if:
+   case ir_type_loop:
+   case ir_type_loop_jump:
+   case ir_type_return:
+   case ir_type_discard:
+      counts->flow_control++;
+      break;
+   case ir_type_call:
+      counts->calls++;
+      break;
+   default:
+      break;
+   }
+}
+
+void
+ir_count_instructions(exec_list *instructions,
+		      struct ir_instruction_counts *counts)
+{
+   memset(counts, 0, sizeof(*counts));
+
+   foreach_list(node, instructions) {
+      visit_tree((ir_instruction *) node, count_instruction, counts);
+   }
+}
+
+static const char *
+stage_name(GLenum type)
+{
+   switch (type) {
+   case GL_VERTEX_SHADER:   return "vertex";
+   case GL_GEOMETRY_SHADER: return "geometry";
+   case GL_FRAGMENT_SHADER: return "fragment";
+   default:                 return "unknown";
+   }
+}
+
+void
+glsl_stats_print(FILE *f, const char *action, unsigned name,
+		 struct gl_shader *sh, struct glsl_shader_stats *stats)
+{
+   const struct ir_instruction_counts *counts = &stats->counts;
+
+   ir_count_instructions(sh->ir, &stats->counts);
+
+   fprintf(f, "{\"action\": \"%s\", \"stage\": \"%s\", \"name\": %u, "
+	   "\"cached\": %s", action, stage_name(sh->Type), name,
+	   stats->cached ? "true" : "false");
+
+   fprintf(f, ", \"ms\": {");
+   for (unsigned i = 0; i < GLSL_PHASE_COUNT; i++) {
+      fprintf(f, "%s\"%s\": %.3f", i == 0 ? "" : ", ", phase_names[i],
+	      stats->seconds[i] * 1000.0);
+   }
+   fprintf(f, "}");
+
+   fprintf(f, ", \"alu\": %u, \"alu_components\": %u, \"texture\": %u, "
+	   "\"flow_control\": %u, \"calls\": %u, \"cost\": %u",
+	   counts->alu, counts->alu_components, counts->texture,
+	   counts->flow_control, counts->calls, counts->cost);
+
+   fprintf(f, ", \"nodes\": {");
+   for (unsigned i = ir_type_unset + 1; i < ir_type_max; i++) {
+      fprintf(f, "%s\"%s\": %u", i == ir_type_unset + 1 ? "" : ", ",
+	      node_names[i], counts->nodes[i]);
+   }
+   fprintf(f, "}");
+
+   fprintf(f, ", \"rounds\": %u, \"passes\": {", stats->rounds);
+   bool first = true;
+   for (unsigned i = 0; i < IR_PASS_COUNT; i++) {
+      const struct ir_pass_stat *pass = &stats->passes[i];
+
+      if (pass->runs == 0)
+	 continue;
+
+      fprintf(f, "%s\"%s\": {\"runs\": %u, \"progress\": %u, "
+	      "\"ms\": %.3f}", first ? "" : ", ", pass->name, pass->runs,
+	      pass->progress, pass->seconds * 1000.0);
+      first = false;
+   }
+   fprintf(f, "}}\n");
+   fflush(f);
+}
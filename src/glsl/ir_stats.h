@@ -0,0 +1,109 @@
+/* -*- c++ -*- */
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file ir_stats.h
+ *
+ * Compiler statistics for one shader: time spent in each phase and in each
+ * optimization pass, and the size of the IR that comes out.
+ *
+ * The statistics are printed as one line of JSON per shader, so that they
+ * can be collected by scripts.  They are enabled with \c MESA_GLSL=stats or
+ * with the \c --stats option of the standalone compiler.
+ */
+
+#pragma once
+#ifndef IR_STATS_H
+#define IR_STATS_H
+
+#include <stdio.h>
+#include "ir.h"
+#include "ir_pass_manager.h"
+
+struct gl_shader;
+
+/** Phases of compiling and linking a shader that are timed */
+enum glsl_stats_phase {
+   GLSL_PHASE_PREPROCESS,
+   GLSL_PHASE_PARSE,
+   GLSL_PHASE_AST_TO_HIR,
+   GLSL_PHASE_OPTIMIZE,
+   GLSL_PHASE_LINK,
+   GLSL_PHASE_DRIVER_LINK,   /**< ctx->Driver.LinkShader */
+   GLSL_PHASE_COUNT
+};
+
+/** Counts of the IR in a shader */
+struct ir_instruction_counts {
+   unsigned nodes[ir_type_max];  /**< IR nodes, by ir_node_type */
+
+   unsigned alu;                 /**< Expressions */
+   unsigned alu_components;      /**< Vector components they compute */
+   unsigned texture;             /**< Texture lookups */
+   unsigned flow_control;        /**< Ifs, loops, jumps, returns, discards */
+   unsigned calls;               /**< Calls that were not inlined */
+
+   /**
+    * Rough cost of running the shader once, ignoring loops and branches
+    *
+    * Each computed component of an expression costs 1, or 4 for divides,
+    * transcendentals and other operations that are usually several
+    * instructions.  A texture lookup costs 4.
+    */
+   unsigned cost;
+};
+
+struct glsl_shader_stats {
+   /** Time spent in each phase, in seconds */
+   double seconds[GLSL_PHASE_COUNT];
+
+   /** Passes run by \c do_common_optimization_loop, summed over calls */
+   struct ir_pass_stat passes[IR_PASS_COUNT];
+   unsigned rounds;
+
+   /** Was the shader loaded from the shader cache? */
+   bool cached;
+
+   struct ir_instruction_counts counts;
+};
+
+/** Current time in seconds, for timing phases */
+double glsl_stats_get_time(void);
+
+void glsl_stats_init(struct glsl_shader_stats *stats);
+
+void ir_count_instructions(exec_list *instructions,
+			   struct ir_instruction_counts *counts);
+
+/**
+ * Count the instructions of a shader and print its statistics as one line
+ * of JSON
+ *
+ * \param action   \c "compile" or \c "link"
+ * \param name     GL name of the shader, or of the program when linking
+ */
+void glsl_stats_print(FILE *f, const char *action, unsigned name,
+		      struct gl_shader *sh, struct glsl_shader_stats *stats);
+
+#endif /* IR_STATS_H */
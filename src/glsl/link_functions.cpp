@@ -256,6 +256,12 @@ find_matching_signature(const char *name, const exec_list *actual_parameters,
       if (f == NULL)
 	 continue;
 
+      /* Built-in bodies are read the first time they are needed.  Other
+       * threads may be reading them too, so the signatures of a built-in
+       * may only be looked at once this has returned.
+       */
+      _mesa_glsl_read_builtin_function(shader_list[i], name);
+
       ir_function_signature *sig = f->matching_signature(actual_parameters);
 
       if ((sig == NULL) || !sig->is_defined)
@@ -71,6 +71,8 @@
 #include "program/hash_table.h"
 #include "linker.h"
 #include "ir_optimization.h"
+#include "ir_stats.h"
+#include "shader_cache.h"
 
 extern "C" {
 #include "main/shaderobj.h"
@@ -2385,14 +2387,70 @@ check_resources(struct gl_context *ctx, struct gl_shader_program *prog)
    return prog->LinkStatus;
 }
 
+/**
+ * Run the link-time optimization loop on \c sh, or fetch its result from the
+ * shader cache
+ */
+static void
+optimize_linked_shader(struct gl_shader *sh, unsigned max_unroll,
+		       struct glsl_shader_stats *stats)
+{
+   const double start = glsl_stats_get_time();
+   void *mem_ctx = ralloc_context(NULL);
+   ir_blob key(mem_ctx);
+   const bool cacheable = glsl_cache_linked_shader_key(&key, sh, max_unroll);
+
+   if (cacheable && glsl_cache_load_linked_shader(&key, sh)) {
+      stats->cached = true;
+   } else {
+      do_common_optimization_loop(sh->ir, true, false, max_unroll, stats);
+
+      if (cacheable)
+	 glsl_cache_store_linked_shader(&key, sh);
+   }
+
+   ralloc_free(mem_ctx);
+   stats->seconds[GLSL_PHASE_OPTIMIZE] = glsl_stats_get_time() - start;
+}
+
+/**
+ * The linked stages that link_shaders() optimizes on separate threads
+ */
+struct optimize_job {
+   struct gl_context *ctx;
+   struct gl_shader_program *prog;
+   struct glsl_shader_stats *stats;
+   unsigned stages[MESA_SHADER_TYPES];
+};
+
+static void
+optimize_linked_shaders(void *data, GLuint first, GLuint end)
+{
+   struct optimize_job *job = (struct optimize_job *) data;
+
+   for (GLuint j = first; j < end; j++) {
+      const unsigned i = job->stages[j];
+      unsigned max_unroll =
+         job->ctx->ShaderCompilerOptions[i].MaxUnrollIterations;
+
+      optimize_linked_shader(job->prog->_LinkedShaders[i], max_unroll,
+			     &job->stats[i]);
+   }
+}
+
 void
-link_shaders(struct gl_context *ctx, struct gl_shader_program *prog)
+link_shaders(struct gl_context *ctx, struct gl_shader_program *prog,
+	     struct glsl_shader_stats *stats)
 {
    tfeedback_decl *tfeedback_decls = NULL;
    unsigned num_tfeedback_decls = prog->TransformFeedback.NumVarying;
 
    void *mem_ctx = ralloc_context(NULL); // temporary linker context
 
+   const double start = glsl_stats_get_time();
+   for (unsigned i = 0; i < MESA_SHADER_TYPES; i++)
+      glsl_stats_init(&stats[i]);
+
    prog->LinkStatus = false;
    prog->Validated = false;
    prog->_Used = false;
@@ -2553,11 +2611,26 @@ link_shaders(struct gl_context *ctx, struct gl_shader_program *prog)
 
       if (ctx->ShaderCompilerOptions[i].LowerClipDistance)
          lower_clip_distance(prog->_LinkedShaders[i]->ir);
+   }
 
-      unsigned max_unroll = ctx->ShaderCompilerOptions[i].MaxUnrollIterations;
+   /* The stages no longer share any IR, so each one can be optimized on its
+    * own thread.  The type tables and built-in profiles that they do share
+    * are locked.
+    */
+   {
+      struct optimize_job job;
+      GLuint num_stages = 0;
+
+      job.ctx = ctx;
+      job.prog = prog;
+      job.stats = stats;
+      for (unsigned i = 0; i < MESA_SHADER_TYPES; i++) {
+	 if (prog->_LinkedShaders[i] != NULL)
+	    job.stages[num_stages++] = i;
+      }
 
-      while (do_common_optimization(prog->_LinkedShaders[i]->ir, true, false, max_unroll))
-	 ;
+      _mesa_parallel_for(num_stages, MIN2(num_stages, _mesa_num_threads()),
+			 optimize_linked_shaders, &job);
    }
 
    /* FINISHME: The value of the max_attribute_index parameter is
@@ -2694,6 +2767,8 @@ done:
       if (prog->_LinkedShaders[i] == NULL)
 	 continue;
 
+      stats[i].seconds[GLSL_PHASE_LINK] = glsl_stats_get_time() - start;
+
       /* Retain any live IR, but trash the rest. */
       reparent_ir(prog->_LinkedShaders[i]->ir, prog->_LinkedShaders[i]->ir);
 
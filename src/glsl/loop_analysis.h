@@ -60,6 +60,26 @@ extern bool
 unroll_loops(exec_list *instructions, loop_state *ls, unsigned max_iterations);
 
 
+/**
+ * Replicate the body of loops with an unknown number of iterations
+ *
+ * Each of the \c factor copies keeps the exit test at the top of the body.
+ * Loops are only unrolled while the body times \c factor stays within the
+ * budget used by \c unroll_loops for \c max_iterations.
+ */
+extern bool
+partially_unroll_loops(exec_list *instructions, loop_state *ls,
+		       unsigned factor, unsigned max_iterations);
+
+
+/**
+ * Replace multiplications of an integer induction variable by a constant
+ * with a second induction variable that is stepped alongside it
+ */
+extern bool
+reduce_induction_strength(exec_list *instructions, loop_state *ls);
+
+
 /**
  * Tracking for all variables used in a loop
  */
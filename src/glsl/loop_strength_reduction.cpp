@@ -0,0 +1,269 @@
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file loop_strength_reduction.cpp
+ *
+ * Replace multiplications of a basic induction variable by a constant with
+ * a second induction variable.
+ *
+ * For a loop like
+ *
+ *     for (int i = 0; ...; i++)
+ *        ... a[i * 4] ...
+ *
+ * a variable \c j is set to \c i*4 in front of the loop and increased by 4
+ * right after every increment of \c i, so that \c i*4 can be replaced by
+ * \c j everywhere in the loop.
+ *
+ * Only integer scalar induction variables that are incremented by a constant
+ * at the top level of the body are handled.  Loops that have already been
+ * given a counter by \c set_loop_controls are left alone: their increment
+ * is done by the backend at the end of the body, where \c j cannot follow.
+ * Neither are loops with nested loops, since the loop analysis doesn't see
+ * assignments made in an inner loop.
+ */
+
+#include "glsl_types.h"
+#include "loop_analysis.h"
+#include "ir_hierarchical_visitor.h"
+#include "ir_rvalue_visitor.h"
+
+namespace {
+
+/** Most distinct multipliers of one induction variable that get reduced */
+#define MAX_REDUCED_MULTIPLIERS 4
+
+class has_loop_visitor : public ir_hierarchical_visitor {
+public:
+   has_loop_visitor()
+      : found(false)
+   {
+   }
+
+   virtual ir_visitor_status visit_enter(ir_loop *ir)
+   {
+      (void) ir;
+      this->found = true;
+      return visit_stop;
+   }
+
+   bool found;
+};
+
+/**
+ * Replaces \c iv*c and \c c*iv in a loop body with derived induction
+ * variables
+ */
+class multiply_replacer : public ir_rvalue_visitor {
+public:
+   multiply_replacer(ir_loop *loop, ir_variable *iv, ir_assignment *increment,
+		     ir_constant *step)
+      : loop(loop), iv(iv), increment(increment), step(step),
+	num_derived(0), progress(false)
+   {
+      this->mem_ctx = ralloc_parent(loop);
+   }
+
+   virtual void handle_rvalue(ir_rvalue **rvalue);
+
+   ir_variable *get_derived(ir_constant *scale);
+
+   ir_loop *loop;
+   ir_variable *iv;
+   ir_assignment *increment;
+   ir_constant *step;
+   void *mem_ctx;
+
+   struct {
+      ir_constant *scale;
+      ir_variable *var;
+   } derived[MAX_REDUCED_MULTIPLIERS];
+   unsigned num_derived;
+
+   bool progress;
+};
+
+static bool
+same_scalar(ir_constant *a, ir_constant *b)
+{
+   return a->type->base_type == GLSL_TYPE_INT
+      ? a->value.i[0] == b->value.i[0]
+      : a->value.u[0] == b->value.u[0];
+}
+
+/**
+ * Get the variable that holds \c iv*scale, creating it if needed
+ */
+ir_variable *
+multiply_replacer::get_derived(ir_constant *scale)
+{
+   for (unsigned i = 0; i < this->num_derived; i++) {
+      if (same_scalar(this->derived[i].scale, scale))
+	 return this->derived[i].var;
+   }
+
+   if (this->num_derived == MAX_REDUCED_MULTIPLIERS)
+      return NULL;
+
+   ir_variable *const var =
+      new(mem_ctx) ir_variable(iv->type, "iv_scaled", ir_var_temporary);
+
+   /* var = iv * scale, in front of the loop */
+   ir_expression *const init =
+      new(mem_ctx) ir_expression(ir_binop_mul,
+				 new(mem_ctx) ir_dereference_variable(iv),
+				 scale->clone(mem_ctx, NULL));
+
+   loop->insert_before(var);
+   loop->insert_before(new(mem_ctx)
+		       ir_assignment(new(mem_ctx) ir_dereference_variable(var),
+				     init, NULL));
+
+   /* var = var + step * scale, right after iv is stepped.  The product is
+    * computed with unsigned arithmetic so that it wraps the same way the
+    * shader's own multiplication would.
+    */
+   ir_constant *delta;
+   if (iv->type->base_type == GLSL_TYPE_INT) {
+      delta = new(mem_ctx) ir_constant(int(unsigned(step->value.i[0])
+					   * unsigned(scale->value.i[0])));
+   } else {
+      delta = new(mem_ctx) ir_constant(step->value.u[0] * scale->value.u[0]);
+   }
+
+   ir_expression *const add =
+      new(mem_ctx) ir_expression(ir_binop_add,
+				 new(mem_ctx) ir_dereference_variable(var),
+				 delta);
+   increment->insert_after(new(mem_ctx)
+			   ir_assignment(new(mem_ctx)
+					 ir_dereference_variable(var),
+					 add, NULL));
+
+   this->derived[this->num_derived].scale = scale;
+   this->derived[this->num_derived].var = var;
+   this->num_derived++;
+
+   return var;
+}
+
+void
+multiply_replacer::handle_rvalue(ir_rvalue **rvalue)
+{
+   ir_expression *const expr =
+      (*rvalue != NULL) ? (*rvalue)->as_expression() : NULL;
+
+   if (expr == NULL || expr->operation != ir_binop_mul
+       || expr->type != iv->type)
+      return;
+
+   for (unsigned i = 0; i < 2; i++) {
+      ir_dereference_variable *const deref =
+	 expr->operands[i]->as_dereference_variable();
+      ir_constant *const scale = expr->operands[1 - i]->as_constant();
+
+      if (deref == NULL || deref->var != iv || scale == NULL
+	  || scale->type != iv->type)
+	 continue;
+
+      ir_variable *const var = get_derived(scale);
+      if (var == NULL)
+	 return;
+
+      *rvalue = new(mem_ctx) ir_dereference_variable(var);
+      this->progress = true;
+      return;
+   }
+}
+
+class strength_reduction_visitor : public ir_hierarchical_visitor {
+public:
+   strength_reduction_visitor(loop_state *state)
+      : state(state), progress(false)
+   {
+   }
+
+   virtual ir_visitor_status visit_leave(ir_loop *ir);
+
+   loop_state *state;
+   bool progress;
+};
+
+ir_visitor_status
+strength_reduction_visitor::visit_leave(ir_loop *ir)
+{
+   loop_variable_state *const ls = this->state->get(ir);
+
+   if (ls == NULL || ls->contains_calls || ir->counter != NULL)
+      return visit_continue;
+
+   has_loop_visitor nested;
+   nested.run(&ir->body_instructions);
+   if (nested.found)
+      return visit_continue;
+
+   foreach_list(node, &ls->induction_variables) {
+      loop_variable *const lv = (loop_variable *) node;
+
+      if (lv->biv != lv->var || !lv->var->type->is_integer()
+	  || !lv->var->type->is_scalar())
+	 continue;
+
+      ir_constant *const step = lv->increment->constant_expression_value();
+      if (step == NULL)
+	 continue;
+
+      /* The increment has to be reached on every iteration that gets to
+       * the end of the body.
+       */
+      bool top_level = false;
+      foreach_list(n, &ir->body_instructions) {
+	 if (n == lv->first_assignment) {
+	    top_level = true;
+	    break;
+	 }
+      }
+      if (!top_level)
+	 continue;
+
+      multiply_replacer v(ir, lv->var, lv->first_assignment, step);
+      v.run(&ir->body_instructions);
+
+      this->progress = this->progress || v.progress;
+   }
+
+   return visit_continue;
+}
+
+} /* anonymous namespace */
+
+bool
+reduce_induction_strength(exec_list *instructions, loop_state *ls)
+{
+   strength_reduction_visitor v(ls);
+
+   v.run(instructions);
+
+   return v.progress;
+}
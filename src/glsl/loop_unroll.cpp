@@ -251,3 +251,92 @@ unroll_loops(exec_list *instructions, loop_state *ls, unsigned max_iterations)
 
    return v.progress;
 }
+
+
+/**
+ * Replicate the bodies of loops whose trip count isn't known
+ *
+ * Only loops whose single exit is the terminator at the top of the body are
+ * handled.  Every copy of the body keeps that terminator, so the loop still
+ * stops after the right iteration, but it takes a branch back to the top
+ * only once every \c factor iterations.  Once a loop has been unrolled like
+ * this it has more than one exit and is not touched again.
+ */
+class loop_partial_unroll_visitor : public ir_hierarchical_visitor {
+public:
+   loop_partial_unroll_visitor(loop_state *state, unsigned factor,
+			       unsigned max_iterations)
+   {
+      this->state = state;
+      this->progress = false;
+      this->factor = factor;
+      this->max_iterations = max_iterations;
+   }
+
+   virtual ir_visitor_status visit_leave(ir_loop *ir);
+
+   loop_state *state;
+
+   bool progress;
+   unsigned factor;
+   unsigned max_iterations;
+};
+
+
+ir_visitor_status
+loop_partial_unroll_visitor::visit_leave(ir_loop *ir)
+{
+   loop_variable_state *const ls = this->state->get(ir);
+
+   if (ls == NULL) {
+      assert(ls != NULL);
+      return visit_continue;
+   }
+
+   /* Loops with a counter are stepped by the backend at the end of the
+    * body, so the copies could not be told apart.
+    */
+   if (ir->counter != NULL)
+      return visit_continue;
+
+   if (ls->num_loop_jumps != 1 || ls->terminators.is_empty())
+      return visit_continue;
+
+   /* Use the same budget as full unrolling.
+    */
+   loop_unroll_count count(&ir->body_instructions);
+
+   if (count.fail
+       || (unsigned) count.nodes * this->factor > this->max_iterations * 5)
+      return visit_continue;
+
+   void *const mem_ctx = ralloc_parent(ir);
+   exec_list copies;
+
+   for (unsigned i = 1; i < this->factor; i++) {
+      exec_list copy_list;
+
+      clone_ir_list(mem_ctx, &copy_list, &ir->body_instructions);
+      copies.append_list(&copy_list);
+   }
+
+   ir->body_instructions.append_list(&copies);
+
+   this->progress = true;
+   return visit_continue;
+}
+
+
+bool
+partially_unroll_loops(exec_list *instructions, loop_state *ls,
+		       unsigned factor, unsigned max_iterations)
+{
+   loop_partial_unroll_visitor v(ls, factor, max_iterations);
+
+   if (factor < 2)
+      return false;
+
+   v.run(instructions);
+
+   return v.progress;
+}
@@ -35,6 +35,10 @@
 #include "glsl_parser_extras.h"
 #include "ir_optimization.h"
 #include "ir_print_visitor.h"
+#include "ir_pass_manager.h"
+#include "ir_reader.h"
+#include "ir_serialize.h"
+#include "ir_stats.h"
 #include "program.h"
 #include "loop_analysis.h"
 #include "standalone_scaffolding.h"
@@ -108,6 +112,10 @@ int dump_ast = 0;
 int dump_hir = 0;
 int dump_lir = 0;
 int do_link = 0;
+int pass_stats = 0;
+int stats = 0;
+int bench_iterations = 0;
+int serialize_builtins = 0;
 
 const struct option compiler_opts[] = {
    { "glsl-es",  0, &glsl_es,  1 },
@@ -115,6 +123,10 @@ const struct option compiler_opts[] = {
    { "dump-hir", 0, &dump_hir, 1 },
    { "dump-lir", 0, &dump_lir, 1 },
    { "link",     0, &do_link,  1 },
+   { "pass-stats", 0, &pass_stats, 1 },
+   { "stats",    0, &stats,    1 },
+   { "bench", 1, NULL, 'b' },
+   { "serialize-builtins", 0, &serialize_builtins, 1 },
    { NULL, 0, NULL, 0 }
 };
 
@@ -142,16 +154,23 @@ compile_shader(struct gl_context *ctx, struct gl_shader *shader)
 {
    struct _mesa_glsl_parse_state *state =
       new(shader) _mesa_glsl_parse_state(ctx, shader->Type, shader);
+   struct glsl_shader_stats shader_stats;
+
+   glsl_stats_init(&shader_stats);
+   double start = glsl_stats_get_time();
 
    const char *source = shader->Source;
    state->error = glcpp_preprocess(state, &source, &state->info_log,
 			     state->extensions, ctx->API) != 0;
+   shader_stats.seconds[GLSL_PHASE_PREPROCESS] = glsl_stats_get_time() - start;
 
+   start = glsl_stats_get_time();
    if (!state->error) {
       _mesa_glsl_lexer_ctor(state, source);
       _mesa_glsl_parse(state);
       _mesa_glsl_lexer_dtor(state);
    }
+   shader_stats.seconds[GLSL_PHASE_PARSE] = glsl_stats_get_time() - start;
 
    if (dump_ast) {
       foreach_list_const(n, &state->translation_unit) {
@@ -161,9 +180,11 @@ compile_shader(struct gl_context *ctx, struct gl_shader *shader)
       printf("\n\n");
    }
 
+   start = glsl_stats_get_time();
    shader->ir = new(shader) exec_list;
    if (!state->error && !state->translation_unit.is_empty())
       _mesa_ast_to_hir(shader->ir, state);
+   shader_stats.seconds[GLSL_PHASE_AST_TO_HIR] = glsl_stats_get_time() - start;
 
    /* Print out the unoptimized IR. */
    if (!state->error && dump_hir) {
@@ -173,10 +194,19 @@ compile_shader(struct gl_context *ctx, struct gl_shader *shader)
 
    /* Optimization passes */
    if (!state->error && !shader->ir->is_empty()) {
-      bool progress;
-      do {
-	 progress = do_common_optimization(shader->ir, false, false, 32);
-      } while (progress);
+      start = glsl_stats_get_time();
+      ir_pass_manager pm(false, false, 32);
+      pm.run(shader->ir);
+      pm.add_stats(&shader_stats);
+      shader_stats.seconds[GLSL_PHASE_OPTIMIZE] =
+	 glsl_stats_get_time() - start;
+
+      if (pass_stats) {
+	 printf("Optimization passes for %s shader:\n",
+		_mesa_glsl_shader_target_name(state->target));
+	 pm.print_stats(stdout);
+	 printf("\n");
+      }
 
       validate_ir_tree(shader->ir);
    }
@@ -187,6 +217,9 @@ compile_shader(struct gl_context *ctx, struct gl_shader *shader)
       _mesa_print_ir(shader->ir, state);
    }
 
+   if (!state->error && stats)
+      glsl_stats_print(stdout, "compile", shader->Name, shader, &shader_stats);
+
    shader->symbols = state->symbols;
    shader->CompileStatus = !state->error;
    shader->Version = state->language_version;
@@ -207,6 +240,161 @@ compile_shader(struct gl_context *ctx, struct gl_shader *shader)
    return;
 }
 
+/**
+ * Run the front end (preprocessor, parser and AST to HIR) on a shader
+ * \c bench_iterations times
+ *
+ * \return the time taken, in seconds.
+ */
+static double
+bench_front_end(struct gl_context *ctx, struct gl_shader *shader)
+{
+   const double start = glsl_stats_get_time();
+
+   for (int i = 0; i < bench_iterations; i++) {
+      void *mem_ctx = ralloc_context(NULL);
+      struct _mesa_glsl_parse_state *state =
+	 new(mem_ctx) _mesa_glsl_parse_state(ctx, shader->Type, mem_ctx);
+
+      const char *source = shader->Source;
+      state->error = glcpp_preprocess(state, &source, &state->info_log,
+				      state->extensions, ctx->API) != 0;
+
+      if (!state->error) {
+	 _mesa_glsl_lexer_ctor(state, source);
+	 _mesa_glsl_parse(state);
+	 _mesa_glsl_lexer_dtor(state);
+      }
+
+      exec_list *ir = new(mem_ctx) exec_list;
+      if (!state->error && !state->translation_unit.is_empty())
+	 _mesa_ast_to_hir(ir, state);
+
+      ralloc_free(mem_ctx);
+   }
+
+   return glsl_stats_get_time() - start;
+}
+
+/**
+ * Print a serialized blob as its name and its bytes in hex, on one line
+ */
+static void
+print_blob(const char *name, const ir_blob *blob)
+{
+   printf("%s ", name);
+   for (size_t i = 0; i < blob->size; i++)
+      printf("%02x", blob->data[i]);
+   printf("\n");
+}
+
+/**
+ * Serialize the built-in functions of one profile for builtin_function.cpp
+ *
+ * \c files[0] holds the prototypes of the profile, as printed by
+ * --dump-hir.  Each of the other files holds the IR of the built-in
+ * function it is named after.  The prototypes are printed as the blob
+ * "prototypes", followed by one blob per function with the bodies of the
+ * profile's signatures of that function.  Calls between built-ins refer to
+ * the prototypes, so the bodies can be read one function at a time.
+ */
+static int
+serialize_profile(struct gl_context *ctx, char **files, int num_files)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   struct _mesa_glsl_parse_state *st =
+      new(mem_ctx) _mesa_glsl_parse_state(ctx, GL_VERTEX_SHADER, mem_ctx);
+
+   /* Everything the built-in profiles may use, as in builtin_function.cpp */
+   st->language_version = 140;
+   st->symbols->language_version = 140;
+   st->ARB_texture_rectangle_enable = true;
+   st->EXT_texture_array_enable = true;
+   st->OES_EGL_image_external_enable = true;
+   st->ARB_shader_bit_encoding_enable = true;
+   st->ARB_texture_cube_map_array_enable = true;
+   _mesa_glsl_initialize_types(st);
+
+   exec_list prototypes;
+   char *text = load_text_file(mem_ctx, files[0]);
+   if (text == NULL) {
+      printf("File \"%s\" does not exist.\n", files[0]);
+      ralloc_free(mem_ctx);
+      return EXIT_FAILURE;
+   }
+
+   _mesa_glsl_read_ir(st, &prototypes, text, true);
+
+   ir_blob blob(mem_ctx);
+   if (st->error || !ir_serialize(&blob, &prototypes, NULL, 0)) {
+      printf("Failed to read prototypes from %s:\n%s\n", files[0],
+	     st->info_log);
+      ralloc_free(mem_ctx);
+      return EXIT_FAILURE;
+   }
+   print_blob("prototypes", &blob);
+
+   /* The bodies refer to the prototypes through this shader. */
+   struct gl_shader profile;
+   memset(&profile, 0, sizeof(profile));
+   profile.symbols = st->symbols;
+   gl_shader *builtins[] = { &profile };
+
+   for (int i = 1; i < num_files; i++) {
+      /* The function is named after the file, as in generate_builtins.py */
+      const char *base = files[i];
+      for (const char *c = files[i]; *c != '\0'; c++) {
+	 if (*c == '/' || *c == '\\')
+	    base = c + 1;
+      }
+      char *name = ralloc_strdup(mem_ctx, base);
+      char *ext = strchr(name, '.');
+      if (ext != NULL)
+	 *ext = '\0';
+
+      text = load_text_file(mem_ctx, files[i]);
+      if (text == NULL) {
+	 printf("File \"%s\" does not exist.\n", files[i]);
+	 ralloc_free(mem_ctx);
+	 return EXIT_FAILURE;
+      }
+
+      /* The globals that a body uses are declared in a scope of their own,
+       * so that each function gets its own copy of them.
+       */
+      exec_list body;
+      st->symbols->push_scope();
+      _mesa_glsl_read_ir(st, &body, text, false);
+      st->symbols->pop_scope();
+
+      ir_function *f = st->symbols->get_function(name);
+      if (st->error || f == NULL) {
+	 printf("Failed to read built-in %s:\n%s\n", name, st->info_log);
+	 ralloc_free(mem_ctx);
+	 return EXIT_FAILURE;
+      }
+
+      f->remove();
+      body.push_tail(f);
+
+      ir_blob blob(mem_ctx);
+      const bool ok = ir_serialize(&blob, &body, builtins, 1);
+
+      f->remove();
+      prototypes.push_tail(f);
+
+      if (!ok) {
+	 printf("Failed to serialize built-in %s\n", name);
+	 ralloc_free(mem_ctx);
+	 return EXIT_FAILURE;
+      }
+      print_blob(name, &blob);
+   }
+
+   ralloc_free(mem_ctx);
+   return EXIT_SUCCESS;
+}
+
 int
 main(int argc, char **argv)
 {
@@ -216,14 +404,24 @@ main(int argc, char **argv)
 
    int c;
    int idx = 0;
-   while ((c = getopt_long(argc, argv, "", compiler_opts, &idx)) != -1)
-      /* empty */ ;
+   while ((c = getopt_long(argc, argv, "", compiler_opts, &idx)) != -1) {
+      if (c == 'b')
+	 bench_iterations = atoi(optarg);
+   }
 
 
    if (argc <= optind)
       usage_fail(argv[0]);
 
    initialize_context(ctx, (glsl_es) ? API_OPENGLES2 : API_OPENGL_COMPAT);
+   if (stats)
+      ctx->Shader.Flags |= GLSL_STATS;
+
+   if (serialize_builtins) {
+      status = serialize_profile(ctx, &argv[optind], argc - optind);
+      _mesa_glsl_release_types();
+      return status;
+   }
 
    struct gl_shader_program *whole_program;
 
@@ -231,6 +429,9 @@ main(int argc, char **argv)
    assert(whole_program != NULL);
    whole_program->InfoLog = ralloc_strdup(whole_program, "");
 
+   double bench_seconds = 0.0;
+   size_t bench_bytes = 0;
+
    for (/* empty */; argc > optind; optind++) {
       whole_program->Shaders =
 	 reralloc(whole_program, whole_program->Shaders,
@@ -269,12 +470,38 @@ main(int argc, char **argv)
 	 status = EXIT_FAILURE;
 	 break;
       }
+
+      if (bench_iterations > 0) {
+	 const double seconds = bench_front_end(ctx, shader);
+	 const size_t bytes = strlen(shader->Source) * bench_iterations;
+
+	 printf("%s: %.3f ms per compile, %.2f MB/s\n", argv[optind],
+		seconds * 1000.0 / bench_iterations,
+		bytes / seconds / (1024.0 * 1024.0));
+	 bench_seconds += seconds;
+	 bench_bytes += bytes;
+      }
+   }
+
+   if (bench_iterations > 0 && bench_seconds > 0.0) {
+      printf("Front end: %.2f MB/s over %u shaders\n",
+	     bench_bytes / bench_seconds / (1024.0 * 1024.0),
+	     whole_program->NumShaders);
    }
 
    if ((status == EXIT_SUCCESS) && do_link)  {
-      link_shaders(ctx, whole_program);
+      struct glsl_shader_stats stats[MESA_SHADER_TYPES];
+
+      link_shaders(ctx, whole_program, stats);
       status = (whole_program->LinkStatus) ? EXIT_SUCCESS : EXIT_FAILURE;
 
+      for (unsigned i = 0; i < MESA_SHADER_TYPES; i++) {
+	 if ((ctx->Shader.Flags & GLSL_STATS) && whole_program->LinkStatus
+	     && whole_program->_LinkedShaders[i] != NULL)
+	    glsl_stats_print(stdout, "link", whole_program->Name,
+			     whole_program->_LinkedShaders[i], &stats[i]);
+      }
+
       if (strlen(whole_program->InfoLog) > 0)
 	 printf("Info log for linking:\n%s\n", whole_program->InfoLog);
    }
@@ -96,7 +96,7 @@ public:
    {
       this->progress = false;
       this->killed_all = false;
-      this->mem_ctx = ralloc_context(NULL);
+      this->mem_ctx = ralloc_arena_context(NULL);
       this->shader_mem_ctx = NULL;
       this->acp = new(mem_ctx) exec_list;
       this->kills = new(mem_ctx) exec_list;
@@ -0,0 +1,419 @@
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file opt_dead_code_global.cpp
+ *
+ * Removes assignments whose values are never read, using liveness across
+ * the whole function.
+ *
+ * \c do_dead_code only removes variables that are never read at all, and
+ * \c do_dead_code_local only sees one basic block at a time.  This pass
+ * computes, walking backwards through each function, which components of
+ * each local scalar or vector variable may still be read.  Across an if the
+ * live sets of the two branches are merged, and loops are iterated until
+ * the live set at the top of the loop stops growing.  An assignment that
+ * only writes components that are not live is removed.
+ */
+
+#include "main/core.h" /* for MAX2 */
+#include "ir.h"
+#include "ir_visitor.h"
+#include "ir_optimization.h"
+#include "glsl_types.h"
+#include "program/hash_table.h"
+
+namespace {
+
+/** Live sets at the targets of break and continue in the current loop */
+struct loop_live {
+   uint8_t *exit;
+   uint8_t *header;
+};
+
+class ir_dead_code_global_visitor {
+public:
+   ir_dead_code_global_visitor(ir_function_signature *sig);
+   ~ir_dead_code_global_visitor();
+
+   void run();
+
+   /** Index of a tracked variable, or -1 */
+   int index(ir_variable *var);
+
+   void process_list(exec_list *instructions, uint8_t *live);
+   void process_assignment(ir_assignment *ir, uint8_t *live);
+   void process_loop(ir_loop *ir, uint8_t *live);
+   void add_uses(ir_instruction *ir, uint8_t *live);
+
+   uint8_t *new_set();
+   void copy_set(uint8_t *dst, const uint8_t *src);
+
+   bool progress;
+
+   void *mem_ctx;
+   ir_function_signature *sig;
+
+   /** Maps tracked variables to their index + 1 */
+   struct hash_table *vars;
+   unsigned num_vars;
+
+   loop_live *loop;
+
+   /**
+    * While this is non-zero a loop is still being iterated, and the live
+    * sets aren't final yet.
+    */
+   unsigned no_remove;
+};
+
+/**
+ * Adds the components read by an rvalue to a live set
+ */
+class live_uses_visitor : public ir_hierarchical_visitor {
+public:
+   live_uses_visitor(ir_dead_code_global_visitor *v, uint8_t *live)
+      : v(v), live(live)
+   {
+   }
+
+   virtual ir_visitor_status visit_enter(ir_swizzle *ir)
+   {
+      ir_dereference_variable *deref = ir->val->as_dereference_variable();
+      if (deref == NULL)
+	 return visit_continue;
+
+      const int i = v->index(deref->var);
+      if (i >= 0) {
+	 live[i] |= (1 << ir->mask.x);
+	 if (ir->mask.num_components > 1)
+	    live[i] |= (1 << ir->mask.y);
+	 if (ir->mask.num_components > 2)
+	    live[i] |= (1 << ir->mask.z);
+	 if (ir->mask.num_components > 3)
+	    live[i] |= (1 << ir->mask.w);
+      }
+
+      return visit_continue_with_parent;
+   }
+
+   virtual ir_visitor_status visit(ir_dereference_variable *ir)
+   {
+      const int i = v->index(ir->var);
+      if (i >= 0)
+	 live[i] = 0xf;
+
+      return visit_continue;
+   }
+
+   ir_dead_code_global_visitor *v;
+   uint8_t *live;
+};
+
+/**
+ * Collects the local scalar and vector variables of a function
+ */
+class local_variables_visitor : public ir_hierarchical_visitor {
+public:
+   local_variables_visitor(ir_dead_code_global_visitor *v)
+      : v(v)
+   {
+   }
+
+   virtual ir_visitor_status visit(ir_variable *ir)
+   {
+      if ((ir->mode == ir_var_auto || ir->mode == ir_var_temporary)
+	  && (ir->type->is_scalar() || ir->type->is_vector())) {
+	 v->num_vars++;
+	 hash_table_insert(v->vars, (void *) (uintptr_t) v->num_vars, ir);
+      }
+
+      return visit_continue;
+   }
+
+   ir_dead_code_global_visitor *v;
+};
+
+} /* unnamed namespace */
+
+ir_dead_code_global_visitor::ir_dead_code_global_visitor(ir_function_signature *sig)
+{
+   this->progress = false;
+   this->mem_ctx = ralloc_arena_context(NULL);
+   this->sig = sig;
+   this->vars = hash_table_ctor(509, hash_table_pointer_hash,
+				hash_table_pointer_compare);
+   this->num_vars = 0;
+   this->loop = NULL;
+   this->no_remove = 0;
+}
+
+ir_dead_code_global_visitor::~ir_dead_code_global_visitor()
+{
+   hash_table_dtor(this->vars);
+   ralloc_free(this->mem_ctx);
+}
+
+int
+ir_dead_code_global_visitor::index(ir_variable *var)
+{
+   return (int) (uintptr_t) hash_table_find(this->vars, var) - 1;
+}
+
+uint8_t *
+ir_dead_code_global_visitor::new_set()
+{
+   return rzalloc_array(this->mem_ctx, uint8_t, MAX2(this->num_vars, 1));
+}
+
+void
+ir_dead_code_global_visitor::copy_set(uint8_t *dst, const uint8_t *src)
+{
+   memcpy(dst, src, this->num_vars);
+}
+
+void
+ir_dead_code_global_visitor::add_uses(ir_instruction *ir, uint8_t *live)
+{
+   live_uses_visitor v(this, live);
+   ir->accept(&v);
+}
+
+void
+ir_dead_code_global_visitor::process_assignment(ir_assignment *ir,
+						uint8_t *live)
+{
+   ir_variable *const var = ir->lhs->variable_referenced();
+   const int i = var != NULL ? index(var) : -1;
+
+   if (i >= 0) {
+      /* Writes through an array index may hit any component. */
+      const unsigned written =
+	 ir->lhs->ir_type == ir_type_dereference_variable ? ir->write_mask : 0xf;
+
+      if ((live[i] & written) == 0) {
+	 if (this->no_remove == 0) {
+	    ir->remove();
+	    this->progress = true;
+	 }
+	 return;
+      }
+
+      if (ir->condition == NULL
+	  && ir->lhs->ir_type == ir_type_dereference_variable)
+	 live[i] &= ~written;
+   }
+
+   add_uses(ir->rhs, live);
+   if (ir->condition)
+      add_uses(ir->condition, live);
+
+   /* Array indices in the l-value are reads. */
+   for (ir_dereference_array *lhs = ir->lhs->as_dereference_array();
+	lhs != NULL; lhs = lhs->array->as_dereference_array())
+      add_uses(lhs->array_index, live);
+}
+
+void
+ir_dead_code_global_visitor::process_loop(ir_loop *ir, uint8_t *live)
+{
+   loop_live ll;
+   loop_live *const outer = this->loop;
+
+   ll.exit = new_set();
+   ll.header = new_set();
+   copy_set(ll.exit, live);
+
+   /* A loop with a counter compares it at the top of every iteration, and
+    * may leave from there.
+    */
+   if (ir->counter != NULL) {
+      copy_set(ll.header, ll.exit);
+      if (index(ir->counter) >= 0)
+	 ll.header[index(ir->counter)] = 0xf;
+      add_uses(ir->to, ll.header);
+      add_uses(ir->increment, ll.header);
+   }
+
+   uint8_t *body = new_set();
+
+   /* Iterate until the live set at the top of the loop is stable. */
+   this->loop = &ll;
+   this->no_remove++;
+   for (;;) {
+      copy_set(body, ll.header);
+      process_list(&ir->body_instructions, body);
+
+      bool changed = false;
+      for (unsigned i = 0; i < this->num_vars; i++) {
+	 if ((body[i] & ~ll.header[i]) != 0) {
+	    ll.header[i] |= body[i];
+	    changed = true;
+	 }
+      }
+
+      if (!changed)
+	 break;
+   }
+   this->no_remove--;
+
+   /* Now that the live sets are known, do it for real. */
+   copy_set(body, ll.header);
+   process_list(&ir->body_instructions, body);
+   this->loop = outer;
+
+   /* A loop with a counter may not run at all. */
+   for (unsigned i = 0; i < this->num_vars; i++)
+      live[i] = ll.header[i] | ll.exit[i];
+
+   if (ir->counter != NULL && index(ir->counter) >= 0)
+      live[index(ir->counter)] = 0xf;
+   if (ir->from)
+      add_uses(ir->from, live);
+   if (ir->to)
+      add_uses(ir->to, live);
+   if (ir->increment)
+      add_uses(ir->increment, live);
+
+   ralloc_free(body);
+   ralloc_free(ll.exit);
+   ralloc_free(ll.header);
+}
+
+/**
+ * Walk \c instructions backwards, turning the live set at the end of the
+ * list into the live set at its start
+ */
+void
+ir_dead_code_global_visitor::process_list(exec_list *instructions,
+					  uint8_t *live)
+{
+   exec_node *prev;
+
+   for (exec_node *node = instructions->get_tail();
+	node != NULL && !node->is_head_sentinel();
+	node = prev) {
+      ir_instruction *const ir = (ir_instruction *) node;
+      prev = node->prev;
+
+      switch (ir->ir_type) {
+      case ir_type_assignment:
+	 process_assignment((ir_assignment *) ir, live);
+	 break;
+
+      case ir_type_if: {
+	 ir_if *const iff = (ir_if *) ir;
+	 uint8_t *else_live = new_set();
+
+	 copy_set(else_live, live);
+	 process_list(&iff->then_instructions, live);
+	 process_list(&iff->else_instructions, else_live);
+
+	 for (unsigned i = 0; i < this->num_vars; i++)
+	    live[i] |= else_live[i];
+	 ralloc_free(else_live);
+
+	 add_uses(iff->condition, live);
+	 break;
+      }
+
+      case ir_type_loop:
+	 process_loop((ir_loop *) ir, live);
+	 break;
+
+      case ir_type_loop_jump:
+	 if (this->loop != NULL) {
+	    ir_loop_jump *const jump = (ir_loop_jump *) ir;
+	    copy_set(live, jump->is_break() ? this->loop->exit
+		     : this->loop->header);
+	 }
+	 break;
+
+      case ir_type_return: {
+	 /* Locals are dead once the function returns. */
+	 ir_return *const ret = (ir_return *) ir;
+	 memset(live, 0, this->num_vars);
+	 if (ret->value)
+	    add_uses(ret->value, live);
+	 break;
+      }
+
+      case ir_type_discard: {
+	 ir_discard *const discard = (ir_discard *) ir;
+	 if (discard->condition)
+	    add_uses(discard->condition, live);
+	 else
+	    memset(live, 0, this->num_vars);
+	 break;
+      }
+
+      case ir_type_call:
+	 /* Out parameters are treated as reads, which is conservative. */
+	 foreach_list(param, &((ir_call *) ir)->actual_parameters)
+	    add_uses((ir_rvalue *) param, live);
+	 break;
+
+      default:
+	 break;
+      }
+   }
+}
+
+void
+ir_dead_code_global_visitor::run()
+{
+   local_variables_visitor v(this);
+   visit_list_elements(&v, &this->sig->body);
+
+   if (this->num_vars == 0)
+      return;
+
+   uint8_t *live = new_set();
+   process_list(&this->sig->body, live);
+}
+
+bool
+do_dead_code_global(exec_list *instructions)
+{
+   bool progress = false;
+
+   foreach_list(node, instructions) {
+      ir_function *const func = ((ir_instruction *) node)->as_function();
+      if (func == NULL)
+	 continue;
+
+      foreach_list(sig_node, &func->signatures) {
+	 ir_function_signature *const sig =
+	    (ir_function_signature *) sig_node;
+
+	 if (!sig->is_defined)
+	    continue;
+
+	 ir_dead_code_global_visitor v(sig);
+	 v.run();
+	 progress = v.progress || progress;
+      }
+   }
+
+   return progress;
+}
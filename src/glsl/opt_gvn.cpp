@@ -0,0 +1,1140 @@
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file opt_gvn.cpp
+ *
+ * Global value numbering with conditional constant propagation.
+ *
+ * Each function is walked in dominator order.  For structured IR that is
+ * just program order, with the branches of an if and the body of a loop
+ * treated as nested scopes.  Every assignment of a whole scalar or vector
+ * variable starts a new version of the variable, which amounts to renaming
+ * the function into SSA form on the fly.  A version is identified by the
+ * value number of the value assigned to it.
+ *
+ * Where control flow joins after an if, a variable that holds different
+ * values on the incoming paths gets a fresh value number, like a phi.
+ * Paths that end in a jump, and branches that cannot be taken because the
+ * condition has a known constant value, don't take part in the join.
+ * Variables assigned in a loop get fresh value numbers at the top of the
+ * loop and after it.
+ *
+ * Expressions are numbered by their operation and the value numbers of
+ * their operands, so two expressions with the same number always compute
+ * the same value.  The pass then:
+ *
+ * - replaces an expression with a variable that already holds its value,
+ *   if that variable is still current;
+ * - replaces an expression that was already computed by a dominating
+ *   instruction with a temporary holding the first result;
+ * - replaces references to variables whose value is a known constant with
+ *   that constant, and folds expressions whose operands are all constants;
+ * - removes assignments that store the value a variable already holds.
+ */
+
+#include "main/core.h" /* for MIN2 and MAX2 */
+#include "ir.h"
+#include "ir_visitor.h"
+#include "ir_optimization.h"
+#include "glsl_types.h"
+#include "program/hash_table.h"
+
+namespace {
+
+enum vn_key_kind {
+   VN_KEY_CONSTANT,
+   VN_KEY_EXPRESSION,
+   VN_KEY_SWIZZLE,
+};
+
+/**
+ * What a value number stands for
+ *
+ * Keys are hash-consed, so equal keys always get the same value number.
+ */
+struct vn_key {
+   vn_key_kind kind;
+   unsigned op;                  /**< Expression operation or swizzle bits */
+   const glsl_type *type;
+   unsigned operands[4];
+   ir_constant *constant;
+};
+
+/** Per value number information that depends on the position in the IR */
+struct vn_info {
+   /** The value, if it is a known constant */
+   ir_constant *constant;
+
+   /** A variable that held the value when it was recorded */
+   ir_variable *leader;
+
+   /**
+    * An expression computing the value that dominates the current position,
+    * and the top-level instruction containing it.
+    */
+   ir_rvalue **first;
+   ir_instruction *first_stmt;
+};
+
+/** A change to undo when leaving a scope */
+struct undo_entry {
+   /** The variable whose value number changed, or NULL */
+   ir_variable *var;
+   unsigned old_vn;
+
+   /** Otherwise, the value number whose info changed */
+   unsigned vn;
+   vn_info old_info;
+};
+
+static unsigned
+vn_key_hash(const void *key)
+{
+   const vn_key *k = (const vn_key *) key;
+   unsigned hash = k->kind * 31 + k->op;
+
+   hash = hash * 31 + (unsigned) (uintptr_t) k->type;
+
+   if (k->kind == VN_KEY_CONSTANT) {
+      const unsigned n = MIN2(k->type->components(), 16);
+
+      for (unsigned i = 0; i < n; i++) {
+	 hash = hash * 31 + (k->type->base_type == GLSL_TYPE_BOOL
+			     ? k->constant->value.b[i]
+			     : k->constant->value.u[i]);
+      }
+   } else {
+      for (unsigned i = 0; i < 4; i++)
+	 hash = hash * 31 + k->operands[i];
+   }
+
+   return hash;
+}
+
+static int
+vn_key_compare(const void *key1, const void *key2)
+{
+   const vn_key *a = (const vn_key *) key1;
+   const vn_key *b = (const vn_key *) key2;
+
+   if (a->kind != b->kind || a->op != b->op || a->type != b->type)
+      return 1;
+
+   if (a->kind == VN_KEY_CONSTANT)
+      return a->constant->has_value(b->constant) ? 0 : 1;
+
+   return memcmp(a->operands, b->operands, sizeof(a->operands));
+}
+
+static bool
+is_commutative(ir_expression *ir)
+{
+   switch (ir->operation) {
+   case ir_binop_mul:
+      /* Matrix multiplication is not commutative. */
+      return !ir->operands[0]->type->is_matrix()
+	 && !ir->operands[1]->type->is_matrix();
+   case ir_binop_add:
+   case ir_binop_equal:
+   case ir_binop_nequal:
+   case ir_binop_all_equal:
+   case ir_binop_any_nequal:
+   case ir_binop_bit_and:
+   case ir_binop_bit_xor:
+   case ir_binop_bit_or:
+   case ir_binop_logic_and:
+   case ir_binop_logic_xor:
+   case ir_binop_logic_or:
+   case ir_binop_dot:
+   case ir_binop_min:
+   case ir_binop_max:
+      return true;
+   default:
+      return false;
+   }
+}
+
+/**
+ * Does the last instruction of the list always leave it?
+ */
+static bool
+ends_with_jump(exec_list *instructions)
+{
+   if (instructions->is_empty())
+      return false;
+
+   ir_instruction *const last = (ir_instruction *) instructions->get_tail();
+   switch (last->ir_type) {
+   case ir_type_return:
+   case ir_type_loop_jump:
+      return true;
+   case ir_type_discard:
+      return ((ir_discard *) last)->condition == NULL;
+   default:
+      return false;
+   }
+}
+
+/**
+ * Collects the variables that a piece of IR may write
+ */
+class assigned_variables_visitor : public ir_hierarchical_visitor {
+public:
+   assigned_variables_visitor(void *mem_ctx)
+      : mem_ctx(mem_ctx), vars(NULL), num_vars(0), size(0), has_call(false)
+   {
+   }
+
+   void add(ir_variable *var)
+   {
+      if (var == NULL)
+	 return;
+
+      if (num_vars == size) {
+	 size = MAX2(16, size * 2);
+	 vars = reralloc(mem_ctx, vars, ir_variable *, size);
+      }
+      vars[num_vars++] = var;
+   }
+
+   virtual ir_visitor_status visit_leave(ir_assignment *ir)
+   {
+      add(ir->lhs->variable_referenced());
+      return visit_continue;
+   }
+
+   virtual ir_visitor_status visit_enter(ir_call *ir)
+   {
+      if (ir->return_deref)
+	 add(ir->return_deref->variable_referenced());
+
+      exec_list_iterator sig_iter = ir->callee->parameters.iterator();
+      foreach_iter(exec_list_iterator, iter, *ir) {
+	 ir_rvalue *const param = (ir_rvalue *) iter.get();
+	 ir_variable *const sig_param = (ir_variable *) sig_iter.get();
+
+	 if (sig_param->mode == ir_var_out || sig_param->mode == ir_var_inout)
+	    add(param->variable_referenced());
+
+	 sig_iter.next();
+      }
+
+      has_call = true;
+      return visit_continue_with_parent;
+   }
+
+   virtual ir_visitor_status visit_enter(ir_loop *ir)
+   {
+      add(ir->counter);
+      return visit_continue;
+   }
+
+   void *mem_ctx;
+   ir_variable **vars;
+   unsigned num_vars;
+   unsigned size;
+   bool has_call;
+};
+
+class ir_gvn_visitor {
+public:
+   ir_gvn_visitor(ir_function_signature *sig);
+   ~ir_gvn_visitor();
+
+   void run();
+
+   bool progress;
+
+private:
+   unsigned new_vn();
+   unsigned lookup_key(const vn_key *key, ir_constant *fold);
+   unsigned constant_vn(ir_constant *ir);
+
+   bool is_tracked(ir_variable *var);
+   unsigned get_var_vn(ir_variable *var);
+   unsigned peek_var_vn(ir_variable *var);
+   void set_var_vn(ir_variable *var, unsigned vn);
+   void set_info(unsigned vn, const vn_info *info);
+   void undo(unsigned mark);
+   void invalidate_globals();
+
+   ir_variable *current_leader(unsigned vn);
+
+   unsigned number(ir_rvalue *ir);
+   unsigned node_vn(ir_rvalue *ir);
+   void rewrite(ir_rvalue **rvalue, ir_instruction *stmt, bool record);
+   unsigned process_rvalue(ir_rvalue **rvalue, ir_instruction *stmt,
+			   bool record);
+   void materialize(unsigned vn);
+
+   void process_list(exec_list *instructions);
+   void process_assignment(ir_assignment *ir);
+   void process_call(ir_call *ir);
+   void process_if(ir_if *ir);
+   void process_loop(ir_loop *ir);
+
+   void *mem_ctx;
+   ir_function_signature *sig;
+
+   /** Variables declared in the function (including parameters) */
+   struct hash_table *locals;
+
+   /** Current value number of each variable */
+   struct hash_table *var_vns;
+
+   /** Non-local variables that have had a value number */
+   ir_variable **globals;
+   unsigned num_globals;
+   unsigned globals_size;
+
+   /** Hash-consing of vn_key to value numbers */
+   struct hash_table *keys;
+
+   /** Value numbers of the nodes of the rvalue being processed */
+   struct hash_table *node_vns;
+
+   vn_info *infos;
+   unsigned num_vns;
+   unsigned infos_size;
+
+   undo_entry *log;
+   unsigned log_size;
+   unsigned log_capacity;
+};
+
+/**
+ * Records every variable declared in a function body as a local
+ */
+class local_variables_visitor : public ir_hierarchical_visitor {
+public:
+   local_variables_visitor(struct hash_table *locals)
+      : locals(locals)
+   {
+   }
+
+   virtual ir_visitor_status visit(ir_variable *ir)
+   {
+      hash_table_insert(locals, ir, ir);
+      return visit_continue;
+   }
+
+   struct hash_table *locals;
+};
+
+} /* unnamed namespace */
+
+ir_gvn_visitor::ir_gvn_visitor(ir_function_signature *sig)
+{
+   this->progress = false;
+   this->mem_ctx = ralloc_arena_context(NULL);
+   this->sig = sig;
+
+   this->locals = hash_table_ctor(509, hash_table_pointer_hash,
+				  hash_table_pointer_compare);
+   this->var_vns = hash_table_ctor(509, hash_table_pointer_hash,
+				   hash_table_pointer_compare);
+   this->keys = hash_table_ctor(1021, vn_key_hash, vn_key_compare);
+   this->node_vns = hash_table_ctor(61, hash_table_pointer_hash,
+				    hash_table_pointer_compare);
+
+   this->globals = NULL;
+   this->num_globals = 0;
+   this->globals_size = 0;
+
+   this->infos = NULL;
+   this->num_vns = 0;
+   this->infos_size = 0;
+
+   this->log = NULL;
+   this->log_size = 0;
+   this->log_capacity = 0;
+
+   /* Value number 0 means "none". */
+   new_vn();
+}
+
+ir_gvn_visitor::~ir_gvn_visitor()
+{
+   hash_table_dtor(this->locals);
+   hash_table_dtor(this->var_vns);
+   hash_table_dtor(this->keys);
+   hash_table_dtor(this->node_vns);
+   ralloc_free(this->mem_ctx);
+}
+
+unsigned
+ir_gvn_visitor::new_vn()
+{
+   if (this->num_vns == this->infos_size) {
+      this->infos_size = MAX2(64, this->infos_size * 2);
+      this->infos = reralloc(this->mem_ctx, this->infos, vn_info,
+			     this->infos_size);
+   }
+
+   memset(&this->infos[this->num_vns], 0, sizeof(vn_info));
+   return this->num_vns++;
+}
+
+/**
+ * Find the value number for \c key, creating one if needed
+ *
+ * \param fold  Constant value of the key, if known.  A key with a constant
+ *              value gets the value number of the constant.
+ */
+unsigned
+ir_gvn_visitor::lookup_key(const vn_key *key, ir_constant *fold)
+{
+   void *data = hash_table_find(this->keys, key);
+   if (data != NULL)
+      return (unsigned) (uintptr_t) data;
+
+   const unsigned vn = fold != NULL ? constant_vn(fold) : new_vn();
+
+   vn_key *stored = ralloc(this->mem_ctx, vn_key);
+   *stored = *key;
+   hash_table_insert(this->keys, (void *) (uintptr_t) vn, stored);
+
+   return vn;
+}
+
+unsigned
+ir_gvn_visitor::constant_vn(ir_constant *ir)
+{
+   vn_key key;
+
+   memset(&key, 0, sizeof(key));
+   key.kind = VN_KEY_CONSTANT;
+   key.type = ir->type;
+   key.constant = ir;
+
+   void *data = hash_table_find(this->keys, &key);
+   if (data != NULL)
+      return (unsigned) (uintptr_t) data;
+
+   const unsigned vn = new_vn();
+   this->infos[vn].constant = ir;
+
+   vn_key *stored = ralloc(this->mem_ctx, vn_key);
+   *stored = key;
+   hash_table_insert(this->keys, (void *) (uintptr_t) vn, stored);
+
+   return vn;
+}
+
+/**
+ * Only whole scalars and vectors are given value numbers.
+ */
+bool
+ir_gvn_visitor::is_tracked(ir_variable *var)
+{
+   return var->type->is_scalar() || var->type->is_vector();
+}
+
+unsigned
+ir_gvn_visitor::peek_var_vn(ir_variable *var)
+{
+   return (unsigned) (uintptr_t) hash_table_find(this->var_vns, var);
+}
+
+/**
+ * Get the value number of a variable, giving it a new one if it doesn't
+ * have one yet
+ */
+unsigned
+ir_gvn_visitor::get_var_vn(ir_variable *var)
+{
+   unsigned vn = peek_var_vn(var);
+
+   if (vn == 0) {
+      vn = new_vn();
+      set_var_vn(var, vn);
+   }
+
+   return vn;
+}
+
+void
+ir_gvn_visitor::set_var_vn(ir_variable *var, unsigned vn)
+{
+   if (this->log_size == this->log_capacity) {
+      this->log_capacity = MAX2(64, this->log_capacity * 2);
+      this->log = reralloc(this->mem_ctx, this->log, undo_entry,
+			   this->log_capacity);
+   }
+
+   undo_entry *const entry = &this->log[this->log_size++];
+   entry->var = var;
+   entry->old_vn = peek_var_vn(var);
+
+   if (entry->old_vn == 0) {
+      hash_table_insert(this->var_vns, (void *) (uintptr_t) vn, var);
+
+      if (hash_table_find(this->locals, var) == NULL) {
+	 if (this->num_globals == this->globals_size) {
+	    this->globals_size = MAX2(16, this->globals_size * 2);
+	    this->globals = reralloc(this->mem_ctx, this->globals,
+				     ir_variable *, this->globals_size);
+	 }
+	 this->globals[this->num_globals++] = var;
+      }
+   } else {
+      hash_table_replace(this->var_vns, (void *) (uintptr_t) vn, var);
+   }
+}
+
+void
+ir_gvn_visitor::set_info(unsigned vn, const vn_info *info)
+{
+   if (this->log_size == this->log_capacity) {
+      this->log_capacity = MAX2(64, this->log_capacity * 2);
+      this->log = reralloc(this->mem_ctx, this->log, undo_entry,
+			   this->log_capacity);
+   }
+
+   undo_entry *const entry = &this->log[this->log_size++];
+   entry->var = NULL;
+   entry->vn = vn;
+   entry->old_info = this->infos[vn];
+
+   this->infos[vn] = *info;
+}
+
+/**
+ * Undo every change made since the log had \c mark entries
+ */
+void
+ir_gvn_visitor::undo(unsigned mark)
+{
+   while (this->log_size > mark) {
+      const undo_entry *const entry = &this->log[--this->log_size];
+
+      if (entry->var != NULL) {
+	 if (entry->old_vn == 0)
+	    hash_table_remove(this->var_vns, entry->var);
+	 else
+	    hash_table_replace(this->var_vns,
+			       (void *) (uintptr_t) entry->old_vn, entry->var);
+      } else {
+	 this->infos[entry->vn] = entry->old_info;
+      }
+   }
+}
+
+/**
+ * A function call may write any variable that isn't local to this function.
+ */
+void
+ir_gvn_visitor::invalidate_globals()
+{
+   for (unsigned i = 0; i < this->num_globals; i++) {
+      if (peek_var_vn(this->globals[i]) != 0)
+	 set_var_vn(this->globals[i], new_vn());
+   }
+}
+
+ir_variable *
+ir_gvn_visitor::current_leader(unsigned vn)
+{
+   ir_variable *const leader = this->infos[vn].leader;
+
+   if (leader != NULL && peek_var_vn(leader) == vn)
+      return leader;
+
+   return NULL;
+}
+
+unsigned
+ir_gvn_visitor::node_vn(ir_rvalue *ir)
+{
+   return (unsigned) (uintptr_t) hash_table_find(this->node_vns, ir);
+}
+
+/**
+ * Compute the value number of every node of \c ir, without changing it
+ */
+unsigned
+ir_gvn_visitor::number(ir_rvalue *ir)
+{
+   unsigned vn = 0;
+   vn_key key;
+
+   memset(&key, 0, sizeof(key));
+
+   switch (ir->ir_type) {
+   case ir_type_constant:
+      vn = constant_vn((ir_constant *) ir);
+      break;
+
+   case ir_type_dereference_variable: {
+      ir_variable *const var = ((ir_dereference_variable *) ir)->var;
+      vn = is_tracked(var) ? get_var_vn(var) : new_vn();
+      break;
+   }
+
+   case ir_type_swizzle: {
+      ir_swizzle *const swiz = (ir_swizzle *) ir;
+      const unsigned val = number(swiz->val);
+      ir_constant *fold = NULL;
+
+      key.kind = VN_KEY_SWIZZLE;
+      key.type = ir->type;
+      key.op = swiz->mask.x | (swiz->mask.y << 2) | (swiz->mask.z << 4)
+	 | (swiz->mask.w << 6) | (swiz->mask.num_components << 8);
+      key.operands[0] = val;
+
+      if (this->infos[val].constant != NULL
+	  && hash_table_find(this->keys, &key) == NULL) {
+	 ir_swizzle *tmp =
+	    new(this->mem_ctx) ir_swizzle(this->infos[val].constant,
+					  swiz->mask);
+	 fold = tmp->constant_expression_value();
+      }
+
+      vn = lookup_key(&key, fold);
+      break;
+   }
+
+   case ir_type_expression: {
+      ir_expression *const expr = (ir_expression *) ir;
+      const unsigned num_operands = expr->get_num_operands();
+      bool all_constant = true;
+
+      key.kind = VN_KEY_EXPRESSION;
+      key.type = ir->type;
+      key.op = expr->operation;
+
+      ir_constant *c[4] = { NULL, NULL, NULL, NULL };
+      for (unsigned i = 0; i < num_operands; i++) {
+	 key.operands[i] = number(expr->operands[i]);
+	 c[i] = this->infos[key.operands[i]].constant;
+	 all_constant = all_constant && c[i] != NULL;
+      }
+
+      if (num_operands == 2 && is_commutative(expr)
+	  && key.operands[0] > key.operands[1]) {
+	 const unsigned t = key.operands[0];
+	 key.operands[0] = key.operands[1];
+	 key.operands[1] = t;
+      }
+
+      ir_constant *fold = NULL;
+      if (all_constant && hash_table_find(this->keys, &key) == NULL) {
+	 ir_expression *tmp;
+	 if (num_operands == 1)
+	    tmp = new(this->mem_ctx) ir_expression(expr->operation, ir->type,
+						   c[0]);
+	 else if (num_operands == 2)
+	    tmp = new(this->mem_ctx) ir_expression(expr->operation, ir->type,
+						   c[0], c[1]);
+	 else
+	    tmp = new(this->mem_ctx) ir_expression(expr->operation, ir->type,
+						   c[0], c[1], c[2], c[3]);
+
+	 fold = tmp->constant_expression_value();
+      }
+
+      vn = lookup_key(&key, fold);
+      break;
+   }
+
+   case ir_type_texture: {
+      ir_texture *const tex = (ir_texture *) ir;
+
+      if (tex->coordinate)
+	 number(tex->coordinate);
+      if (tex->projector)
+	 number(tex->projector);
+      if (tex->shadow_comparitor)
+	 number(tex->shadow_comparitor);
+      if (tex->offset)
+	 number(tex->offset);
+
+      switch (tex->op) {
+      case ir_tex:
+	 break;
+      case ir_txb:
+	 number(tex->lod_info.bias);
+	 break;
+      case ir_txf:
+      case ir_txl:
+      case ir_txs:
+	 number(tex->lod_info.lod);
+	 break;
+      case ir_txd:
+	 number(tex->lod_info.grad.dPdx);
+	 number(tex->lod_info.grad.dPdy);
+	 break;
+      }
+
+      vn = new_vn();
+      break;
+   }
+
+   case ir_type_dereference_array:
+      number(((ir_dereference_array *) ir)->array_index);
+      vn = new_vn();
+      break;
+
+   default:
+      vn = new_vn();
+      break;
+   }
+
+   hash_table_insert(this->node_vns, (void *) (uintptr_t) vn, ir);
+   return vn;
+}
+
+/**
+ * Create a temporary for the first computation of \c vn, so that later
+ * computations can use it instead
+ *
+ * The temporary is assigned right before the instruction that contains the
+ * first computation.  The expression is copied there rather than moved, so
+ * that other recorded computations inside it stay where they were.
+ */
+void
+ir_gvn_visitor::materialize(unsigned vn)
+{
+   vn_info info = this->infos[vn];
+   ir_rvalue *const expr = *info.first;
+   void *ctx = ralloc_parent(expr);
+
+   ir_variable *tmp = new(ctx) ir_variable(expr->type, "gvn_tmp",
+					   ir_var_temporary);
+   ir_assignment *assign =
+      new(ctx) ir_assignment(new(ctx) ir_dereference_variable(tmp),
+			     expr->clone(ctx, NULL), NULL);
+
+   info.first_stmt->insert_before(tmp);
+   info.first_stmt->insert_before(assign);
+   *info.first = new(ctx) ir_dereference_variable(tmp);
+
+   hash_table_insert(this->locals, tmp, tmp);
+   set_var_vn(tmp, vn);
+   info.leader = tmp;
+   info.first = NULL;
+   info.first_stmt = NULL;
+   set_info(vn, &info);
+
+   this->progress = true;
+}
+
+/**
+ * Replace \c *rvalue, or the parts of it, with simpler equivalents
+ *
+ * The nodes must already have been numbered.  This works from the top down,
+ * so that the largest redundant expression is the one that is replaced.
+ *
+ * \param record  Can computations in \c *rvalue be recorded for later use?
+ *                This requires that \c rvalue stays valid.
+ */
+void
+ir_gvn_visitor::rewrite(ir_rvalue **rvalue, ir_instruction *stmt, bool record)
+{
+   ir_rvalue *const ir = *rvalue;
+   const unsigned vn = node_vn(ir);
+   void *ctx = ralloc_parent(ir);
+
+   if (vn == 0)
+      return;
+
+   if (this->infos[vn].constant != NULL && ir->ir_type != ir_type_constant) {
+      *rvalue = this->infos[vn].constant->clone(ctx, NULL);
+      this->progress = true;
+      return;
+   }
+
+   switch (ir->ir_type) {
+   case ir_type_expression: {
+      ir_variable *leader = current_leader(vn);
+
+      if (leader == NULL && this->infos[vn].first != NULL) {
+	 materialize(vn);
+	 leader = current_leader(vn);
+      }
+
+      if (leader != NULL) {
+	 *rvalue = new(ctx) ir_dereference_variable(leader);
+	 this->progress = true;
+	 return;
+      }
+
+      if (record) {
+	 vn_info info = this->infos[vn];
+	 info.first = rvalue;
+	 info.first_stmt = stmt;
+	 set_info(vn, &info);
+      }
+
+      ir_expression *const expr = (ir_expression *) ir;
+      for (unsigned i = 0; i < expr->get_num_operands(); i++)
+	 rewrite(&expr->operands[i], stmt, record);
+      break;
+   }
+
+   case ir_type_swizzle:
+      rewrite(&((ir_swizzle *) ir)->val, stmt, record);
+      break;
+
+   case ir_type_texture: {
+      ir_texture *const tex = (ir_texture *) ir;
+
+      if (tex->coordinate)
+	 rewrite(&tex->coordinate, stmt, record);
+      if (tex->projector)
+	 rewrite(&tex->projector, stmt, record);
+      if (tex->shadow_comparitor)
+	 rewrite(&tex->shadow_comparitor, stmt, record);
+      if (tex->offset)
+	 rewrite(&tex->offset, stmt, record);
+
+      switch (tex->op) {
+      case ir_tex:
+	 break;
+      case ir_txb:
+	 rewrite(&tex->lod_info.bias, stmt, record);
+	 break;
+      case ir_txf:
+      case ir_txl:
+      case ir_txs:
+	 rewrite(&tex->lod_info.lod, stmt, record);
+	 break;
+      case ir_txd:
+	 rewrite(&tex->lod_info.grad.dPdx, stmt, record);
+	 rewrite(&tex->lod_info.grad.dPdy, stmt, record);
+	 break;
+      }
+      break;
+   }
+
+   case ir_type_dereference_array:
+      /* Only the index; the array itself may be an l-value. */
+      rewrite(&((ir_dereference_array *) ir)->array_index, stmt, record);
+      break;
+
+   default:
+      break;
+   }
+}
+
+/**
+ * Number and rewrite an rvalue, returning its value number
+ */
+unsigned
+ir_gvn_visitor::process_rvalue(ir_rvalue **rvalue, ir_instruction *stmt,
+			       bool record)
+{
+   hash_table_clear(this->node_vns);
+
+   const unsigned vn = number(*rvalue);
+   rewrite(rvalue, stmt, record);
+
+   return vn;
+}
+
+void
+ir_gvn_visitor::process_assignment(ir_assignment *ir)
+{
+   ir_variable *const var = ir->lhs->variable_referenced();
+   const bool whole = var != NULL && is_tracked(var)
+      && ir->lhs->ir_type == ir_type_dereference_variable
+      && ir->condition == NULL
+      && ir->write_mask == (1U << var->type->vector_elements) - 1;
+
+   /* Indices in the l-value are r-values too. */
+   ir_dereference_array *lhs_array = ir->lhs->as_dereference_array();
+   while (lhs_array != NULL) {
+      process_rvalue(&lhs_array->array_index, ir, true);
+      lhs_array = lhs_array->array->as_dereference_array();
+   }
+
+   if (ir->condition)
+      process_rvalue(&ir->condition, ir, true);
+
+   hash_table_clear(this->node_vns);
+   const unsigned vn = number(ir->rhs);
+
+   /* Storing the value the variable already holds does nothing.  This has
+    * to be checked before anything in the assignment is recorded.
+    */
+   if (whole && peek_var_vn(var) == vn) {
+      ir->remove();
+      this->progress = true;
+      return;
+   }
+
+   rewrite(&ir->rhs, ir, true);
+
+   if (var == NULL || !is_tracked(var))
+      return;
+
+   if (!whole) {
+      set_var_vn(var, new_vn());
+      return;
+   }
+
+   set_var_vn(var, vn);
+
+   if (current_leader(vn) == NULL) {
+      vn_info info = this->infos[vn];
+      info.leader = var;
+      set_info(vn, &info);
+   }
+}
+
+void
+ir_gvn_visitor::process_call(ir_call *ir)
+{
+   exec_list_iterator sig_iter = ir->callee->parameters.iterator();
+   foreach_iter(exec_list_iterator, iter, *ir) {
+      ir_rvalue *const param = (ir_rvalue *) iter.get();
+      ir_variable *const sig_param = (ir_variable *) sig_iter.get();
+
+      if (sig_param->mode == ir_var_in || sig_param->mode == ir_var_const_in) {
+	 ir_rvalue *new_param = param;
+
+	 process_rvalue(&new_param, ir, false);
+	 if (new_param != param)
+	    param->replace_with(new_param);
+      }
+
+      sig_iter.next();
+   }
+
+   sig_iter = ir->callee->parameters.iterator();
+   foreach_iter(exec_list_iterator, iter, *ir) {
+      ir_rvalue *const param = (ir_rvalue *) iter.get();
+      ir_variable *const sig_param = (ir_variable *) sig_iter.get();
+
+      if (sig_param->mode == ir_var_out || sig_param->mode == ir_var_inout) {
+	 ir_variable *const var = param->variable_referenced();
+	 if (var != NULL && is_tracked(var))
+	    set_var_vn(var, new_vn());
+      }
+
+      sig_iter.next();
+   }
+
+   if (ir->return_deref != NULL) {
+      ir_variable *const var = ir->return_deref->variable_referenced();
+      if (is_tracked(var))
+	 set_var_vn(var, new_vn());
+   }
+
+   invalidate_globals();
+}
+
+namespace {
+
+/** A variable assigned in one of the branches of an if */
+struct merge_entry {
+   ir_variable *var;
+   unsigned then_vn;
+   unsigned else_vn;
+};
+
+} /* unnamed namespace */
+
+void
+ir_gvn_visitor::process_if(ir_if *ir)
+{
+   const unsigned cond = process_rvalue(&ir->condition, ir, true);
+   const ir_constant *const cond_value = this->infos[cond].constant;
+   const unsigned mark = this->log_size;
+
+   /* Find the variables changed by each branch and their values at the end
+    * of the branch.
+    */
+   struct hash_table *changed = hash_table_ctor(61, hash_table_pointer_hash,
+						hash_table_pointer_compare);
+   merge_entry *entries = NULL;
+   unsigned num_entries = 0;
+
+   for (unsigned branch = 0; branch < 2; branch++) {
+      exec_list *const instructions =
+	 branch == 0 ? &ir->then_instructions : &ir->else_instructions;
+
+      process_list(instructions);
+
+      for (unsigned i = mark; i < this->log_size; i++) {
+	 ir_variable *const var = this->log[i].var;
+	 if (var == NULL)
+	    continue;
+
+	 /* The table holds index + 1, since the array may move. */
+	 const uintptr_t index = (uintptr_t) hash_table_find(changed, var);
+	 merge_entry *entry;
+
+	 if (index == 0) {
+	    entries = reralloc(this->mem_ctx, entries, merge_entry,
+			       num_entries + 1);
+	    entry = &entries[num_entries++];
+	    entry->var = var;
+	    entry->then_vn = 0;
+	    entry->else_vn = 0;
+	    hash_table_insert(changed, (void *) (uintptr_t) num_entries, var);
+	 } else {
+	    entry = &entries[index - 1];
+	 }
+
+	 if (branch == 0)
+	    entry->then_vn = peek_var_vn(var);
+	 else
+	    entry->else_vn = peek_var_vn(var);
+      }
+
+      undo(mark);
+   }
+
+   hash_table_dtor(changed);
+
+   const bool then_reachable = !ends_with_jump(&ir->then_instructions)
+      && (cond_value == NULL || cond_value->value.b[0]);
+   const bool else_reachable = !ends_with_jump(&ir->else_instructions)
+      && (cond_value == NULL || !cond_value->value.b[0]);
+
+   for (unsigned i = 0; i < num_entries; i++) {
+      merge_entry *const entry = &entries[i];
+      const unsigned before = peek_var_vn(entry->var);
+      const unsigned then_vn = entry->then_vn ? entry->then_vn : before;
+      const unsigned else_vn = entry->else_vn ? entry->else_vn : before;
+      unsigned vn;
+
+      if (then_reachable && else_reachable)
+	 vn = (then_vn == else_vn) ? then_vn : 0;
+      else if (then_reachable)
+	 vn = then_vn;
+      else if (else_reachable)
+	 vn = else_vn;
+      else
+	 vn = 0;
+
+      if (vn == 0)
+	 vn = new_vn();
+
+      if (vn != before)
+	 set_var_vn(entry->var, vn);
+   }
+
+   ralloc_free(entries);
+}
+
+void
+ir_gvn_visitor::process_loop(ir_loop *ir)
+{
+   assigned_variables_visitor assigned(this->mem_ctx);
+   visit_list_elements(&assigned, &ir->body_instructions);
+   if (ir->counter != NULL)
+      assigned.add(ir->counter);
+
+   /* The values coming around the back edge are unknown. */
+   for (unsigned i = 0; i < assigned.num_vars; i++) {
+      if (is_tracked(assigned.vars[i]))
+	 set_var_vn(assigned.vars[i], new_vn());
+   }
+   if (assigned.has_call)
+      invalidate_globals();
+
+   const unsigned mark = this->log_size;
+   process_list(&ir->body_instructions);
+   undo(mark);
+
+   /* ...and so are the values after the loop. */
+   for (unsigned i = 0; i < assigned.num_vars; i++) {
+      if (is_tracked(assigned.vars[i]))
+	 set_var_vn(assigned.vars[i], new_vn());
+   }
+   if (assigned.has_call)
+      invalidate_globals();
+}
+
+void
+ir_gvn_visitor::process_list(exec_list *instructions)
+{
+   foreach_list_safe(node, instructions) {
+      ir_instruction *const ir = (ir_instruction *) node;
+
+      switch (ir->ir_type) {
+      case ir_type_assignment:
+	 process_assignment((ir_assignment *) ir);
+	 break;
+      case ir_type_call:
+	 process_call((ir_call *) ir);
+	 break;
+      case ir_type_if:
+	 process_if((ir_if *) ir);
+	 break;
+      case ir_type_loop:
+	 process_loop((ir_loop *) ir);
+	 break;
+      case ir_type_return:
+	 if (((ir_return *) ir)->value != NULL)
+	    process_rvalue(&((ir_return *) ir)->value, ir, true);
+	 break;
+      case ir_type_discard:
+	 if (((ir_discard *) ir)->condition != NULL)
+	    process_rvalue(&((ir_discard *) ir)->condition, ir, true);
+	 break;
+      default:
+	 break;
+      }
+   }
+}
+
+void
+ir_gvn_visitor::run()
+{
+   local_variables_visitor v(this->locals);
+
+   visit_list_elements(&v, &this->sig->parameters);
+   visit_list_elements(&v, &this->sig->body);
+
+   process_list(&this->sig->body);
+}
+
+bool
+do_global_value_numbering(exec_list *instructions)
+{
+   bool progress = false;
+
+   foreach_list(node, instructions) {
+      ir_function *const func = ((ir_instruction *) node)->as_function();
+      if (func == NULL)
+	 continue;
+
+      foreach_list(sig_node, &func->signatures) {
+	 ir_function_signature *const sig =
+	    (ir_function_signature *) sig_node;
+
+	 if (!sig->is_defined)
+	    continue;
+
+	 ir_gvn_visitor v(sig);
+	 v.run();
+	 progress = v.progress || progress;
+      }
+   }
+
+   return progress;
+}
@@ -0,0 +1,344 @@
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file opt_loop_invariants.cpp
+ *
+ * Loop-invariant code motion.
+ *
+ * A value is invariant in a loop when every variable it reads is left alone
+ * by the whole loop, including any loops nested in it.  Two kinds of code
+ * are moved in front of the loop:
+ *
+ * - Assignments at the top level of the loop body that are the only write
+ *   to a variable declared in the body, and whose right-hand side is
+ *   invariant.  The declaration moves along with the assignment, and the
+ *   variable counts as invariant from then on.
+ *
+ * - Invariant expressions and texture lookups in the instructions at the
+ *   top level of the loop body.  Each one is computed into a temporary in
+ *   front of the loop.  Code inside ifs in the loop is left alone, so that
+ *   work that only happens on some iterations isn't made unconditional.
+ *
+ * Nested loops are handled inside out, so that code leaves a whole nest of
+ * loops one level per loop.  Loops containing function calls are skipped,
+ * since a call may write to any variable passed to it.
+ *
+ * Moving code out of a loop also executes it when the loop runs zero times.
+ * That is harmless for GLSL expressions, which have no side effects and
+ * cannot trap.
+ */
+
+#include "ir.h"
+#include "ir_visitor.h"
+#include "ir_rvalue_visitor.h"
+#include "ir_optimization.h"
+#include "glsl_types.h"
+#include "program/hash_table.h"
+
+namespace {
+
+/**
+ * Variables written and declared anywhere in a loop
+ */
+class loop_writes : public ir_hierarchical_visitor {
+public:
+   loop_writes()
+   {
+      this->assigned = hash_table_ctor(0, hash_table_pointer_hash,
+				       hash_table_pointer_compare);
+      this->declared = hash_table_ctor(0, hash_table_pointer_hash,
+				       hash_table_pointer_compare);
+      this->has_call = false;
+   }
+
+   ~loop_writes()
+   {
+      hash_table_dtor(this->assigned);
+      hash_table_dtor(this->declared);
+   }
+
+   void add_write(ir_variable *var)
+   {
+      const uintptr_t count = (uintptr_t) hash_table_find(this->assigned, var);
+
+      if (count == 0)
+	 hash_table_insert(this->assigned, (void *) (count + 1), var);
+      else
+	 hash_table_replace(this->assigned, (void *) (count + 1), var);
+   }
+
+   /** Number of assignments to \c var in the loop */
+   unsigned writes(ir_variable *var)
+   {
+      return (uintptr_t) hash_table_find(this->assigned, var);
+   }
+
+   bool is_declared(ir_variable *var)
+   {
+      return hash_table_find(this->declared, var) != NULL;
+   }
+
+   virtual ir_visitor_status visit(ir_variable *ir)
+   {
+      hash_table_insert(this->declared, ir, ir);
+      return visit_continue;
+   }
+
+   virtual ir_visitor_status visit_enter(ir_assignment *ir)
+   {
+      ir_variable *const var = ir->lhs->variable_referenced();
+
+      if (var != NULL)
+	 add_write(var);
+      return visit_continue;
+   }
+
+   virtual ir_visitor_status visit_enter(ir_call *ir)
+   {
+      (void) ir;
+      this->has_call = true;
+      return visit_stop;
+   }
+
+   virtual ir_visitor_status visit_enter(ir_loop *ir)
+   {
+      if (ir->counter != NULL)
+	 add_write(ir->counter);
+      return visit_continue;
+   }
+
+   hash_table *assigned;
+   hash_table *declared;
+   bool has_call;
+};
+
+/**
+ * Decides which values are invariant in one loop
+ */
+class loop_invariance {
+public:
+   loop_invariance(ir_loop *loop)
+   {
+      this->hoisted = hash_table_ctor(0, hash_table_pointer_hash,
+				      hash_table_pointer_compare);
+
+      if (loop->counter != NULL)
+	 this->writes.add_write(loop->counter);
+      this->writes.run(&loop->body_instructions);
+   }
+
+   ~loop_invariance()
+   {
+      hash_table_dtor(this->hoisted);
+   }
+
+   bool is_invariant(ir_variable *var)
+   {
+      if (hash_table_find(this->hoisted, var) != NULL)
+	 return true;
+
+      return this->writes.writes(var) == 0 && !this->writes.is_declared(var);
+   }
+
+   /**
+    * Is \c ir an invariant value that reads at least one variable?
+    *
+    * Values built only from constants are left to constant folding.
+    */
+   bool is_invariant(ir_rvalue *ir);
+
+   void mark_hoisted(ir_variable *var)
+   {
+      hash_table_insert(this->hoisted, var, var);
+   }
+
+   loop_writes writes;
+
+private:
+   hash_table *hoisted;
+};
+
+class invariance_check : public ir_hierarchical_visitor {
+public:
+   invariance_check(loop_invariance *inv)
+      : inv(inv), reads(0), invariant(true)
+   {
+   }
+
+   virtual ir_visitor_status visit(ir_dereference_variable *ir)
+   {
+      this->reads++;
+      if (!inv->is_invariant(ir->var)) {
+	 this->invariant = false;
+	 return visit_stop;
+      }
+      return visit_continue;
+   }
+
+   loop_invariance *inv;
+   unsigned reads;
+   bool invariant;
+};
+
+bool
+loop_invariance::is_invariant(ir_rvalue *ir)
+{
+   invariance_check v(this);
+
+   ir->accept(&v);
+   return v.invariant && v.reads > 0;
+}
+
+/**
+ * Moves invariant expressions in one top-level instruction of a loop body
+ * into temporaries in front of the loop
+ *
+ * Rvalues are visited on the way down, so the largest invariant expression
+ * is moved rather than each of its parts.
+ */
+class invariant_expression_hoister : public ir_rvalue_enter_visitor {
+public:
+   invariant_expression_hoister(ir_loop *loop, loop_invariance *inv)
+      : loop(loop), inv(inv), progress(false)
+   {
+      this->mem_ctx = ralloc_parent(loop);
+   }
+
+   virtual void handle_rvalue(ir_rvalue **rvalue);
+
+   virtual ir_visitor_status visit_enter(ir_if *ir)
+   {
+      handle_rvalue(&ir->condition);
+      return visit_continue_with_parent;
+   }
+
+   virtual ir_visitor_status visit_enter(ir_loop *ir)
+   {
+      (void) ir;
+      return visit_continue_with_parent;
+   }
+
+   ir_loop *loop;
+   loop_invariance *inv;
+   void *mem_ctx;
+   bool progress;
+};
+
+void
+invariant_expression_hoister::handle_rvalue(ir_rvalue **rvalue)
+{
+   ir_rvalue *const ir = *rvalue;
+
+   if (ir == NULL)
+      return;
+
+   if (ir->ir_type != ir_type_expression && ir->ir_type != ir_type_texture)
+      return;
+
+   if (!inv->is_invariant(ir))
+      return;
+
+   ir_variable *const var =
+      new(mem_ctx) ir_variable(ir->type, "licm_temp", ir_var_temporary);
+   loop->insert_before(var);
+
+   ir_dereference_variable *const lhs =
+      new(mem_ctx) ir_dereference_variable(var);
+   loop->insert_before(new(mem_ctx) ir_assignment(lhs, ir, NULL));
+
+   *rvalue = new(mem_ctx) ir_dereference_variable(var);
+
+   inv->mark_hoisted(var);
+   this->progress = true;
+}
+
+class loop_invariant_visitor : public ir_hierarchical_visitor {
+public:
+   loop_invariant_visitor()
+      : progress(false)
+   {
+   }
+
+   virtual ir_visitor_status visit_leave(ir_loop *ir);
+
+   bool progress;
+};
+
+ir_visitor_status
+loop_invariant_visitor::visit_leave(ir_loop *ir)
+{
+   loop_invariance inv(ir);
+
+   if (inv.writes.has_call)
+      return visit_continue;
+
+   /* Move single assignments of invariant values to variables that are
+    * local to the loop.
+    */
+   foreach_list_safe(node, &ir->body_instructions) {
+      ir_assignment *const assign = ((ir_instruction *) node)->as_assignment();
+
+      if (assign == NULL || assign->condition != NULL)
+	 continue;
+
+      ir_variable *const var = assign->whole_variable_written();
+      if (var == NULL || !inv.writes.is_declared(var)
+	  || inv.writes.writes(var) != 1)
+	 continue;
+
+      if (!inv.is_invariant(assign->rhs))
+	 continue;
+
+      var->remove();
+      ir->insert_before(var);
+      assign->remove();
+      ir->insert_before(assign);
+
+      inv.mark_hoisted(var);
+      this->progress = true;
+   }
+
+   /* Move the invariant parts of what is left.
+    */
+   invariant_expression_hoister v(ir, &inv);
+
+   foreach_list(node, &ir->body_instructions) {
+      ((ir_instruction *) node)->accept(&v);
+   }
+
+   this->progress = this->progress || v.progress;
+   return visit_continue;
+}
+
+} /* anonymous namespace */
+
+bool
+do_loop_invariant_code_motion(exec_list *instructions)
+{
+   loop_invariant_visitor v;
+
+   v.run(instructions);
+
+   return v.progress;
+}
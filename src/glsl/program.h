@@ -23,8 +23,18 @@
 
 #include "main/core.h"
 
+struct glsl_shader_stats;
+
+/**
+ * Link \c prog
+ *
+ * \c stats must point to \c MESA_SHADER_TYPES statistics, which are
+ * filled in for each linked stage.  They are not printed here, so that the
+ * caller can print them once the driver is done with the IR.
+ */
 extern void
-link_shaders(struct gl_context *ctx, struct gl_shader_program *prog);
+link_shaders(struct gl_context *ctx, struct gl_shader_program *prog,
+	     struct glsl_shader_stats *stats);
 
 extern void
 linker_error(gl_shader_program *prog, const char *fmt, ...)
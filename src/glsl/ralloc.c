@@ -51,11 +51,31 @@ _CRTIMP int _vscprintf(const char *format, va_list argptr);
 
 #define CANARY 0x5A1106
 
+/* Size of the slabs that arenas bump-allocate out of.  Allocations larger
+ * than a quarter of this get a slab of their own.
+ */
+#define ARENA_SLAB_SIZE (32 * 1024)
+
+/* Alignment of arena allocations, matching what malloc guarantees. */
+#define ARENA_ALIGN 16
+
+struct ralloc_arena;
+
 struct ralloc_header
 {
    /* A canary value used to determine whether a pointer is ralloc'd. */
    unsigned canary;
 
+   /* For arena blocks: the block has been stolen out of its arena and is
+    * linked into its parent's list of children.
+    */
+   bool linked;
+
+   /* For arena blocks: the block is in its arena's list of blocks that need
+    * work when the arena is destroyed.
+    */
+   bool tracked;
+
    struct ralloc_header *parent;
 
    /* The first child (head of a linked list) */
@@ -66,12 +86,57 @@ struct ralloc_header
    struct ralloc_header *next;
 
    void (*destructor)(void *);
+
+   /* The arena the block was allocated from, or that the block is the
+    * context of.  NULL for blocks allocated with malloc.
+    */
+   struct ralloc_arena *arena;
+
+   /* For arena blocks, the size of the block.  Used to resize them. */
+   size_t size;
 };
 
 typedef struct ralloc_header ralloc_header;
 
+struct arena_slab
+{
+   struct arena_slab *next;
+};
+
+/**
+ * State of an arena context
+ *
+ * Blocks allocated out of an arena are not linked into their parent's list
+ * of children, so freeing the arena just frees its slabs.  The few blocks
+ * that need more work when the arena goes away, because they have a
+ * destructor or have children that were allocated with malloc, are kept in
+ * \c tracked.
+ *
+ * A block that is stolen out of the arena is linked into its new parent like
+ * any other block, and keeps the arena alive until it is freed.
+ */
+struct ralloc_arena
+{
+   /* The arena context, or NULL once it has been freed. */
+   ralloc_header *context;
+
+   struct arena_slab *slabs;
+
+   /* Free space in the first slab. */
+   char *next;
+   char *end;
+
+   /* Number of blocks that were stolen out of the arena and are alive. */
+   unsigned refs;
+
+   ralloc_header **tracked;
+   unsigned num_tracked;
+   unsigned max_tracked;
+};
+
 static void unlink_block(ralloc_header *info);
 static void unsafe_free(ralloc_header *info);
+static void arena_destroy(struct ralloc_arena *arena);
 
 static ralloc_header *
 get_header(const void *ptr)
@@ -84,6 +149,36 @@ get_header(const void *ptr)
 
 #define PTR_FROM_HEADER(info) (((char *) info) + sizeof(ralloc_header))
 
+/* Whether a block was allocated out of an arena (as opposed to being the
+ * arena context itself, or allocated with malloc).
+ */
+static inline bool
+is_arena_block(const ralloc_header *info)
+{
+   return info->arena != NULL && info->arena->context != info;
+}
+
+static void
+track_block(ralloc_header *info)
+{
+   struct ralloc_arena *arena = info->arena;
+
+   if (info->tracked)
+      return;
+
+   if (arena->num_tracked == arena->max_tracked) {
+      unsigned max = arena->max_tracked ? arena->max_tracked * 2 : 16;
+      ralloc_header **tracked =
+	 realloc(arena->tracked, max * sizeof(ralloc_header *));
+      assert(tracked != NULL);
+      arena->tracked = tracked;
+      arena->max_tracked = max;
+   }
+
+   arena->tracked[arena->num_tracked++] = info;
+   info->tracked = true;
+}
+
 static void
 add_child(ralloc_header *parent, ralloc_header *info)
 {
@@ -94,22 +189,136 @@ add_child(ralloc_header *parent, ralloc_header *info)
 
       if (info->next != NULL)
 	 info->next->prev = info;
+
+      /* The arena has to free this child if the parent is never freed. */
+      if (is_arena_block(parent))
+	 track_block(parent);
    }
 }
 
+static bool
+arena_add_slab(struct ralloc_arena *arena, size_t size)
+{
+   size_t slab_size = sizeof(struct arena_slab) + ARENA_ALIGN +
+      sizeof(ralloc_header) + size;
+   struct arena_slab *slab;
+   bool own_slab = size > ARENA_SLAB_SIZE / 4;
+
+   if (!own_slab && slab_size < ARENA_SLAB_SIZE)
+      slab_size = ARENA_SLAB_SIZE;
+
+   /* Blocks in the arena are never reused, so every block handed out is
+    * zeroed, just like the calloc'd blocks in ralloc_size.
+    */
+   slab = calloc(1, slab_size);
+   if (slab == NULL)
+      return false;
+
+   if (own_slab && arena->slabs != NULL) {
+      /* Keep allocating out of the current slab after this one. */
+      slab->next = arena->slabs->next;
+      arena->slabs->next = slab;
+   } else {
+      slab->next = arena->slabs;
+      arena->slabs = slab;
+   }
+
+   arena->next = (char *) (slab + 1);
+   arena->end = ((char *) slab) + slab_size;
+   return true;
+}
+
+/* Returns the first address at or after \p p where a block's data can go. */
+static char *
+arena_align(char *p)
+{
+   uintptr_t data = (uintptr_t) p + sizeof(ralloc_header);
+   data = (data + ARENA_ALIGN - 1) & ~(uintptr_t) (ARENA_ALIGN - 1);
+   return (char *) data;
+}
+
+static ralloc_header *
+arena_alloc(struct ralloc_arena *arena, size_t size)
+{
+   char *data = arena->next != NULL ? arena_align(arena->next) : NULL;
+   ralloc_header *info;
+
+   if (data == NULL || data + size > arena->end) {
+      char *next = arena->next, *end = arena->end;
+
+      if (!arena_add_slab(arena, size))
+	 return NULL;
+
+      data = arena_align(arena->next);
+
+      /* A slab of its own: carry on with the previous slab. */
+      if (size > ARENA_SLAB_SIZE / 4 && next != NULL) {
+	 arena->next = next;
+	 arena->end = end;
+	 info = (ralloc_header *) (data - sizeof(ralloc_header));
+	 info->size = size;
+	 return info;
+      }
+   }
+
+   arena->next = data + size;
+
+   info = (ralloc_header *) (data - sizeof(ralloc_header));
+   info->size = size;
+   return info;
+}
+
 void *
 ralloc_context(const void *ctx)
 {
    return ralloc_size(ctx, 0);
 }
 
+void *
+ralloc_arena_context(const void *ctx)
+{
+   ralloc_header *parent = ctx != NULL ? get_header(ctx) : NULL;
+   struct ralloc_arena *arena;
+   ralloc_header *info;
+
+   arena = calloc(1, sizeof(struct ralloc_arena));
+   if (unlikely(arena == NULL))
+      return NULL;
+
+   info = calloc(1, sizeof(ralloc_header));
+   if (unlikely(info == NULL)) {
+      free(arena);
+      return NULL;
+   }
+
+   add_child(parent, info);
+
+   info->canary = CANARY;
+   info->arena = arena;
+   arena->context = info;
+
+   return PTR_FROM_HEADER(info);
+}
+
 void *
 ralloc_size(const void *ctx, size_t size)
 {
+   ralloc_header *parent = ctx != NULL ? get_header(ctx) : NULL;
+
+   if (parent != NULL && parent->arena != NULL) {
+      ralloc_header *info = arena_alloc(parent->arena, size);
+      if (unlikely(info == NULL))
+	 return NULL;
+
+      info->canary = CANARY;
+      info->parent = parent;
+      info->arena = parent->arena;
+      return PTR_FROM_HEADER(info);
+   }
+
    void *block = calloc(1, size + sizeof(ralloc_header));
 
    ralloc_header *info = (ralloc_header *) block;
-   ralloc_header *parent = ctx != NULL ? get_header(ctx) : NULL;
 
    add_child(parent, info);
 
@@ -127,21 +336,18 @@ rzalloc_size(const void *ctx, size_t size)
    return ptr;
 }
 
-/* helper function - assumes ptr != NULL */
-static void *
-resize(void *ptr, size_t size)
+/* Point \p info's parent, siblings and children at \p info, after it was
+ * moved.  \p first_child says whether the block was its parent's first
+ * child; it must be found out before the move, since the old copy may be
+ * gone by now.
+ */
+static void
+relink_block(ralloc_header *info, bool first_child)
 {
-   ralloc_header *child, *old, *info;
-
-   old = get_header(ptr);
-   info = realloc(old, size + sizeof(ralloc_header));
-
-   if (info == NULL)
-      return NULL;
+   ralloc_header *child;
 
-   /* Update parent and sibling's links to the reallocated node. */
-   if (info != old && info->parent != NULL) {
-      if (info->parent->child == old)
+   if (info->parent != NULL) {
+      if (first_child)
 	 info->parent->child = info;
 
       if (info->prev != NULL)
@@ -154,6 +360,86 @@ resize(void *ptr, size_t size)
    /* Update child->parent links for all children */
    for (child = info->child; child != NULL; child = child->next)
       child->parent = info;
+}
+
+/* resize for arena blocks
+ *
+ * Blocks allocated out of the arena after \p old keep pointing at the old
+ * copy as their parent, which is why resized blocks should not be used as
+ * contexts.
+ */
+static void *
+arena_resize(ralloc_header *old, size_t size)
+{
+   struct ralloc_arena *arena = old->arena;
+   ralloc_header *info, *child;
+   unsigned i;
+
+   if (size <= old->size)
+      return PTR_FROM_HEADER(old);
+
+   /* Grow in place if this is the last block in the current slab. */
+   if (PTR_FROM_HEADER(old) + old->size == arena->next &&
+       PTR_FROM_HEADER(old) + size <= arena->end) {
+      arena->next = PTR_FROM_HEADER(old) + size;
+      old->size = size;
+      return PTR_FROM_HEADER(old);
+   }
+
+   info = arena_alloc(arena, size);
+   if (unlikely(info == NULL))
+      return NULL;
+
+   memcpy(info, old, sizeof(ralloc_header) + old->size);
+   info->size = size;
+
+   if (info->linked)
+      relink_block(info, info->parent != NULL && info->parent->child == old);
+   else
+      for (child = info->child; child != NULL; child = child->next)
+	 child->parent = info;
+
+   if (info->tracked) {
+      for (i = 0; i < arena->num_tracked; i++) {
+	 if (arena->tracked[i] == old)
+	    arena->tracked[i] = info;
+      }
+   }
+
+   /* The old copy must not be freed or destroyed twice. */
+   old->child = NULL;
+   old->destructor = NULL;
+   old->linked = false;
+
+   return PTR_FROM_HEADER(info);
+}
+
+/* helper function - assumes ptr != NULL */
+static void *
+resize(void *ptr, size_t size)
+{
+   ralloc_header *old, *info;
+   bool first_child;
+
+   old = get_header(ptr);
+   if (is_arena_block(old))
+      return arena_resize(old, size);
+
+   /* Arena contexts are referred to by their arena and can't move. */
+   assert(old->arena == NULL);
+
+   /* The old pointer may not be looked at once realloc has returned. */
+   first_child = old->parent != NULL && old->parent->child == old;
+
+   info = realloc(old, size + sizeof(ralloc_header));
+
+   if (info == NULL)
+      return NULL;
+
+   /* Update parent and sibling's links to the reallocated node.  Rewriting
+    * them is harmless if the block didn't move.
+    */
+   relink_block(info, first_child);
 
    return PTR_FROM_HEADER(info);
 }
@@ -211,8 +497,10 @@ ralloc_free(void *ptr)
 static void
 unlink_block(ralloc_header *info)
 {
-   /* Unlink from parent & siblings */
-   if (info->parent != NULL) {
+   /* Unlink from parent & siblings.  Arena blocks are only in their parent's
+    * list if they were stolen out of the arena.
+    */
+   if (info->parent != NULL && (!is_arena_block(info) || info->linked)) {
       if (info->parent->child == info)
 	 info->parent->child = info->next;
 
@@ -242,7 +530,59 @@ unsafe_free(ralloc_header *info)
    if (info->destructor != NULL)
       info->destructor(PTR_FROM_HEADER(info));
 
-   free(info);
+   if (info->arena == NULL) {
+      free(info);
+   } else if (is_arena_block(info)) {
+      /* The memory goes away with the arena.  Just make sure the arena
+       * doesn't call the destructor again.
+       */
+      struct ralloc_arena *arena = info->arena;
+
+      info->destructor = NULL;
+      if (info->linked) {
+	 info->linked = false;
+	 if (--arena->refs == 0 && arena->context == NULL)
+	    arena_destroy(arena);
+      }
+   } else {
+      struct ralloc_arena *arena = info->arena;
+
+      arena->context = NULL;
+      if (arena->refs == 0)
+	 arena_destroy(arena);
+      free(info);
+   }
+}
+
+static void
+arena_destroy(struct ralloc_arena *arena)
+{
+   struct arena_slab *slab, *next;
+   unsigned i;
+
+   /* Free the children and call the destructors of blocks that were never
+    * freed themselves.
+    */
+   for (i = 0; i < arena->num_tracked; i++) {
+      ralloc_header *info = arena->tracked[i];
+
+      while (info->child != NULL) {
+	 ralloc_header *temp = info->child;
+	 info->child = temp->next;
+	 unsafe_free(temp);
+      }
+
+      if (info->destructor != NULL)
+	 info->destructor(PTR_FROM_HEADER(info));
+   }
+
+   for (slab = arena->slabs; slab != NULL; slab = next) {
+      next = slab->next;
+      free(slab);
+   }
+
+   free(arena->tracked);
+   free(arena);
 }
 
 void
@@ -256,6 +596,28 @@ ralloc_steal(const void *new_ctx, void *ptr)
    info = get_header(ptr);
    parent = get_header(new_ctx);
 
+   if (is_arena_block(info)) {
+      struct ralloc_arena *arena = info->arena;
+      bool was_linked = info->linked;
+
+      unlink_block(info);
+
+      if (parent->arena == arena) {
+	 /* Moving within the arena only changes the parent. */
+	 info->parent = parent;
+	 if (was_linked) {
+	    info->linked = false;
+	    arena->refs--;
+	 }
+      } else {
+	 add_child(parent, info);
+	 info->linked = true;
+	 if (!was_linked)
+	    arena->refs++;
+      }
+      return;
+   }
+
    unlink_block(info);
 
    add_child(parent, info);
@@ -296,6 +658,9 @@ ralloc_set_destructor(const void *ptr, void(*destructor)(void *))
 {
    ralloc_header *info = get_header(ptr);
    info->destructor = destructor;
+
+   if (is_arena_block(info))
+      track_block(info);
 }
 
 char *
@@ -336,18 +701,25 @@ ralloc_strndup(const void *ctx, const char *str, size_t max)
 /* helper routine for strcat/strncat - n is the exact amount to copy */
 static bool
 cat(char **dest, const char *str, size_t n)
+{
+   assert(dest != NULL && *dest != NULL);
+
+   return ralloc_str_append(dest, str, strlen(*dest), n);
+}
+
+bool
+ralloc_str_append(char **dest, const char *str,
+                  size_t existing_length, size_t str_size)
 {
    char *both;
-   size_t existing_length;
    assert(dest != NULL && *dest != NULL);
 
-   existing_length = strlen(*dest);
-   both = resize(*dest, existing_length + n + 1);
+   both = resize(*dest, existing_length + str_size + 1);
    if (unlikely(both == NULL))
       return false;
 
-   memcpy(both + existing_length, str, n);
-   both[existing_length + n] = '\0';
+   memcpy(both + existing_length, str, str_size);
+   both[existing_length + str_size] = '\0';
 
    *dest = both;
    return true;
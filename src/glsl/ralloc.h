@@ -91,6 +91,32 @@ extern "C" {
  */
 void *ralloc_context(const void *ctx);
 
+/**
+ * Allocate a new arena context.
+ *
+ * Everything allocated out of an arena context, or out of anything allocated
+ * from it, is carved out of large slabs instead of being malloc'd one block
+ * at a time.  Freeing the arena frees the slabs, without visiting the blocks
+ * in them, so it is much cheaper than freeing a normal context with many
+ * children.  This makes arenas a good fit for the many small, short-lived
+ * allocations a compiler makes.
+ *
+ * Blocks in an arena work with the rest of the ralloc API, with a few
+ * differences:
+ *
+ * - Freeing a block in an arena calls its destructor and frees any children
+ *   that were malloc'd, but its memory is only reclaimed with the arena.
+ *   The destructors of the block's children in the arena are only called
+ *   when the arena is freed.
+ *
+ * - A block stolen out of the arena keeps the arena's memory alive until it
+ *   is freed.  Its children in the arena stay where they are.
+ *
+ * - Blocks that are resized, by \c reralloc_size or \c ralloc_strcat and
+ *   friends, should not be used as the context of other allocations.
+ */
+void *ralloc_arena_context(const void *ctx);
+
 /**
  * Allocate memory chained off of the given context.
  *
@@ -294,6 +320,21 @@ bool ralloc_strcat(char **dest, const char *str);
  */
 bool ralloc_strncat(char **dest, const char *str, size_t n);
 
+/**
+ * Concatenate two strings, allocating the necessary space.
+ *
+ * This appends \p str_size bytes of \p str to \p *dest, which must be
+ * \p existing_length bytes long.  Unlike \c ralloc_strncat, neither string
+ * is scanned for its length, so repeatedly appending to a long string does
+ * not take quadratic time.
+ *
+ * The result will always be null-terminated.
+ *
+ * \return True unless allocation failed.
+ */
+bool ralloc_str_append(char **dest, const char *str,
+                       size_t existing_length, size_t str_size);
+
 /**
  * Print to a string.
  *
@@ -0,0 +1,551 @@
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file shader_cache.cpp
+ *
+ * On-disk cache of compiled and optimized GLSL IR.
+ *
+ * An entry is a file in the cache directory named after the 64-bit FNV-1a
+ * hash of its key.  It holds a small header, the key itself and the
+ * payload, which is mostly IR written by \c ir_serialize.  Entries are
+ * written to a temporary file and renamed into place, so concurrent
+ * readers never see a partial entry.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#if !defined(_WIN32)
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+#if defined(HAVE_DLOPEN) && !defined(_WIN32)
+#include <dlfcn.h>
+#endif
+#if defined(HAVE_DLOPEN) && defined(__ELF__)
+#include <link.h>
+#endif
+#include "main/core.h" /* for struct gl_shader */
+#include "main/version.h"
+#include "glapi/glthread.h"
+#include "glsl_parser_extras.h"
+#include "glsl_symbol_table.h"
+#include "ir.h"
+#include "ir_serialize.h"
+#include "shader_cache.h"
+
+static const char cache_magic[8] = "MESAGIR";
+
+struct cache_entry_header {
+   char magic[8];
+   uint32_t key_size;
+   uint32_t payload_size;
+   uint64_t payload_hash;
+};
+
+static const char *
+cache_dir(void)
+{
+#if defined(_WIN32)
+   return NULL;
+#else
+   static bool initialized = false;
+   static const char *dir = NULL;
+
+   if (!initialized) {
+      dir = getenv("MESA_GLSL_CACHE_DIR");
+      if (dir != NULL && dir[0] == '\0')
+	 dir = NULL;
+      initialized = true;
+   }
+
+   return dir;
+#endif
+}
+
+static const char *build_id(void);
+
+bool
+glsl_cache_enabled(void)
+{
+   return cache_dir() != NULL && build_id() != NULL;
+}
+
+/**
+ * 64-bit FNV-1a hash of \c data, continuing from \c hash
+ */
+static uint64_t
+hash_bytes(const uint8_t *data, size_t size,
+	   uint64_t hash = 0xcbf29ce484222325ull)
+{
+   for (size_t i = 0; i < size; i++) {
+      hash ^= data[i];
+      hash *= 0x100000001b3ull;
+   }
+
+   return hash;
+}
+
+static char *
+entry_path(void *mem_ctx, const ir_blob *key)
+{
+   return ralloc_asprintf(mem_ctx, "%s/%016llx", cache_dir(),
+			  (unsigned long long) hash_bytes(key->data,
+							  key->size));
+}
+
+/**
+ * Read the payload of the entry for \c key, or return \c NULL on a miss.
+ */
+static uint8_t *
+read_entry(void *mem_ctx, const ir_blob *key, size_t *size)
+{
+   FILE *f = fopen(entry_path(mem_ctx, key), "rb");
+   if (f == NULL)
+      return NULL;
+
+   struct cache_entry_header header;
+   uint8_t *stored_key = NULL;
+   uint8_t *payload = NULL;
+
+   if (fread(&header, sizeof(header), 1, f) != 1
+       || memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0
+       || header.key_size != key->size)
+      goto fail;
+
+   stored_key = ralloc_array(mem_ctx, uint8_t, key->size);
+   if (fread(stored_key, 1, key->size, f) != key->size
+       || memcmp(stored_key, key->data, key->size) != 0)
+      goto fail;
+
+   payload = ralloc_array(mem_ctx, uint8_t, header.payload_size);
+   if (fread(payload, 1, header.payload_size, f) != header.payload_size
+       || hash_bytes(payload, header.payload_size) != header.payload_hash)
+      goto fail;
+
+   fclose(f);
+   ralloc_free(stored_key);
+   *size = header.payload_size;
+   return payload;
+
+fail:
+   fclose(f);
+   ralloc_free(stored_key);
+   ralloc_free(payload);
+   return NULL;
+}
+
+static void
+write_entry(void *mem_ctx, const ir_blob *key, const ir_blob *payload)
+{
+#if !defined(_WIN32)
+   const char *path = entry_path(mem_ctx, key);
+   /* Other threads of this process may be writing the same entry. */
+   const char *tmp = ralloc_asprintf(mem_ctx, "%s.%d.%lx", path, (int) getpid(),
+				     u_thread_self());
+
+   FILE *f = fopen(tmp, "wb");
+   if (f == NULL)
+      return;
+
+   struct cache_entry_header header;
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, cache_magic, sizeof(cache_magic));
+   header.key_size = key->size;
+   header.payload_size = payload->size;
+   header.payload_hash = hash_bytes(payload->data, payload->size);
+
+   bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+      && fwrite(key->data, 1, key->size, f) == key->size
+      && fwrite(payload->data, 1, payload->size, f) == payload->size;
+   ok = (fclose(f) == 0) && ok;
+
+   if (!ok || rename(tmp, path) != 0)
+      remove(tmp);
+#endif
+}
+
+/**
+ * Version of the passes whose output is stored in the cache.  Bump this
+ * whenever the optimizations run before a shader is stored change.
+ */
+#define GLSL_CACHE_PIPELINE_VERSION 2
+
+_glthread_DECLARE_STATIC_MUTEX(build_id_mutex);
+
+#if defined(HAVE_DLOPEN) && defined(__ELF__)
+struct build_id_note {
+   const void *addr;
+   const uint8_t *desc;
+   size_t size;
+};
+
+/**
+ * dl_iterate_phdr() callback that finds the GNU build-id note of the object
+ * containing \c note->addr
+ */
+static int
+find_build_id_note(struct dl_phdr_info *info, size_t size, void *data)
+{
+   struct build_id_note *note = (struct build_id_note *) data;
+   const uintptr_t addr = (uintptr_t) note->addr;
+   bool found = false;
+
+   (void) size;
+
+   for (unsigned i = 0; i < info->dlpi_phnum; i++) {
+      const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+      const uintptr_t start = info->dlpi_addr + phdr->p_vaddr;
+
+      if (phdr->p_type == PT_LOAD
+	  && addr >= start && addr - start < phdr->p_memsz)
+	 found = true;
+   }
+
+   if (!found)
+      return 0;
+
+   for (unsigned i = 0; i < info->dlpi_phnum; i++) {
+      const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+      if (phdr->p_type != PT_NOTE)
+	 continue;
+
+      /* Names and descriptors are padded to the alignment of the segment. */
+      const unsigned align = phdr->p_align > 4 ? phdr->p_align : 4;
+      const uint8_t *p = (const uint8_t *) (info->dlpi_addr + phdr->p_vaddr);
+      const uint8_t *end = p + phdr->p_memsz;
+
+      while ((size_t) (end - p) >= sizeof(ElfW(Nhdr))) {
+	 const ElfW(Nhdr) *nhdr = (const ElfW(Nhdr) *) p;
+	 const uint8_t *name = p + sizeof(*nhdr);
+	 const size_t name_size = (nhdr->n_namesz + align - 1) & ~(align - 1);
+	 const size_t desc_size = (nhdr->n_descsz + align - 1) & ~(align - 1);
+
+	 if ((size_t) (end - name) < name_size
+	     || (size_t) (end - name) - name_size < desc_size)
+	    break;
+
+	 if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == 4
+	     && memcmp(name, "GNU", 4) == 0) {
+	    note->desc = name + name_size;
+	    note->size = nhdr->n_descsz;
+	    return 1;
+	 }
+
+	 p = name + name_size + desc_size;
+      }
+   }
+
+   /* This is the object, but it has no build id. */
+   return 1;
+}
+#endif
+
+/**
+ * Identify this build of the compiler
+ *
+ * The version string alone doesn't change between development builds.
+ * Use the build id that the linker put in the library or executable the
+ * compiler was linked into.  Without one, hash the contents of that file.
+ * If neither is available the build can't be told apart from another, and
+ * the cache is disabled.
+ */
+static const char *
+build_id(void)
+{
+   static bool initialized = false;
+   static char id[65];
+
+   _glthread_LOCK_MUTEX(build_id_mutex);
+   if (!initialized) {
+#if defined(HAVE_DLOPEN) && defined(__ELF__)
+      struct build_id_note note;
+      memset(&note, 0, sizeof(note));
+      note.addr = (const void *) build_id;
+
+      if (dl_iterate_phdr(find_build_id_note, &note) != 0
+	  && note.desc != NULL) {
+	 for (unsigned i = 0; i < note.size && 2 * i + 2 < sizeof(id); i++)
+	    snprintf(&id[2 * i], 3, "%02x", note.desc[i]);
+      }
+#endif
+#if defined(HAVE_DLOPEN) && !defined(_WIN32)
+      Dl_info info;
+      FILE *f;
+
+      if (id[0] == '\0' && dladdr((void *) build_id, &info) != 0
+	  && info.dli_fname != NULL
+	  && (f = fopen(info.dli_fname, "rb")) != NULL) {
+	 uint64_t hash = hash_bytes(NULL, 0);
+	 uint8_t buf[4096];
+	 size_t n;
+
+	 while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+	    hash = hash_bytes(buf, n, hash);
+
+	 if (!ferror(f))
+	    snprintf(id, sizeof(id), "%016llx", (unsigned long long) hash);
+	 fclose(f);
+      }
+#endif
+      initialized = true;
+   }
+   _glthread_UNLOCK_MUTEX(build_id_mutex);
+
+   return id[0] != '\0' ? id : NULL;
+}
+
+/**
+ * Start a key with everything that identifies this build of the compiler.
+ */
+static void
+begin_key(ir_blob *key, char kind)
+{
+   key->write_string(MESA_VERSION_STRING);
+   key->write_string(build_id());
+   key->write_uint32(GLSL_CACHE_PIPELINE_VERSION);
+   key->write_uint32(IR_SERIALIZE_VERSION);
+   key->write_string(_mesa_glsl_builtin_functions_id);
+   key->write_uint8(kind);
+}
+
+static void
+shader_key(ir_blob *key, struct gl_shader *shader,
+	   struct _mesa_glsl_parse_state *state)
+{
+   struct gl_context *ctx = state->ctx;
+
+   begin_key(key, 'c');
+   key->write_uint32(shader->Type);
+   key->write_uint32(ctx->API);
+   key->write_uint32(ctx->Const.GLSLVersion);
+   key->write_uint8(ctx->Const.ForceGLSLExtensionsWarn);
+
+   /* All of the extension enables, but not the extension string. */
+   key->write(&ctx->Extensions, offsetof(struct gl_extensions, String));
+
+   /* The implementation limits the compiler exposes to the shader. */
+   key->write(&state->Const, sizeof(state->Const));
+
+   key->write_string(shader->Source);
+}
+
+bool
+glsl_cache_load_shader(struct gl_shader *shader,
+		       struct _mesa_glsl_parse_state *state)
+{
+   if (!glsl_cache_enabled() || shader->Source == NULL)
+      return false;
+
+   void *mem_ctx = ralloc_context(NULL);
+   ir_blob key(mem_ctx);
+   size_t size;
+
+   shader_key(&key, shader, state);
+   uint8_t *payload = read_entry(mem_ctx, &key, &size);
+   if (payload == NULL) {
+      ralloc_free(mem_ctx);
+      return false;
+   }
+
+   ir_blob_reader reader(payload, size);
+   const unsigned version = reader.read_uint32();
+   const unsigned num_builtins = reader.read_uint32();
+   gl_shader *builtins[Elements(shader->builtins_to_link)];
+
+   if (num_builtins > Elements(builtins)) {
+      ralloc_free(mem_ctx);
+      return false;
+   }
+
+   for (unsigned i = 0; i < num_builtins; i++) {
+      builtins[i] = _mesa_glsl_get_builtin_profile(reader.read_uint32());
+      if (builtins[i] == NULL) {
+	 ralloc_free(mem_ctx);
+	 return false;
+      }
+   }
+
+   char *info_log = reader.read_string(mem_ctx);
+   exec_list *ir = new(mem_ctx) exec_list;
+   glsl_symbol_table *symbols = new(mem_ctx) glsl_symbol_table;
+
+   if (reader.overrun
+       || !ir_deserialize(mem_ctx, ir, symbols, builtins, num_builtins,
+			  &reader)
+       || reader.current != reader.end) {
+      ralloc_free(mem_ctx);
+      return false;
+   }
+
+   validate_ir_tree(ir);
+
+   ralloc_free(shader->ir);
+   shader->ir = ir;
+   ralloc_steal(shader, ir);
+   reparent_ir(ir, ir);
+
+   shader->symbols = symbols;
+   ralloc_steal(shader, symbols);
+
+   shader->CompileStatus = GL_TRUE;
+   shader->InfoLog = ralloc_strdup(shader, info_log ? info_log : "");
+   shader->Version = version;
+   memcpy(shader->builtins_to_link, builtins,
+	  sizeof(builtins[0]) * num_builtins);
+   shader->num_builtins_to_link = num_builtins;
+
+   if (shader->UniformBlocks)
+      ralloc_free(shader->UniformBlocks);
+   shader->UniformBlocks = NULL;
+   shader->NumUniformBlocks = 0;
+
+   ralloc_free(mem_ctx);
+   return true;
+}
+
+void
+glsl_cache_store_shader(struct gl_shader *shader,
+			struct _mesa_glsl_parse_state *state)
+{
+   /* Uniform blocks live outside of the IR; don't bother with them. */
+   if (!glsl_cache_enabled() || !shader->CompileStatus
+       || state->num_uniform_blocks != 0)
+      return;
+
+   void *mem_ctx = ralloc_context(NULL);
+   ir_blob key(mem_ctx);
+   ir_blob payload(mem_ctx);
+
+   shader_key(&key, shader, state);
+
+   payload.write_uint32(state->language_version);
+   payload.write_uint32(state->num_builtins_to_link);
+   for (unsigned i = 0; i < state->num_builtins_to_link; i++) {
+      const int index =
+	 _mesa_glsl_builtin_profile_index(state->builtins_to_link[i]);
+      if (index < 0) {
+	 ralloc_free(mem_ctx);
+	 return;
+      }
+      payload.write_uint32(index);
+   }
+   payload.write_string(state->info_log);
+
+   if (ir_serialize(&payload, shader->ir, state->builtins_to_link,
+		    state->num_builtins_to_link))
+      write_entry(mem_ctx, &key, &payload);
+
+   ralloc_free(mem_ctx);
+}
+
+bool
+glsl_cache_linked_shader_key(ir_blob *key, struct gl_shader *sh,
+			     unsigned max_unroll)
+{
+   if (!glsl_cache_enabled())
+      return false;
+
+   begin_key(key, 'l');
+   key->write_uint32(sh->Type);
+   key->write_uint32(max_unroll);
+
+   return ir_serialize(key, sh->ir, NULL, 0);
+}
+
+bool
+glsl_cache_load_linked_shader(const ir_blob *key, struct gl_shader *sh)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   size_t size;
+
+   uint8_t *payload = read_entry(mem_ctx, key, &size);
+   if (payload == NULL) {
+      ralloc_free(mem_ctx);
+      return false;
+   }
+
+   /* Reading the IR for real updates the variables and functions in
+    * sh->symbols, and there is no undoing that.  So check that the entry is
+    * good by reading it without a symbol table first.
+    */
+   exec_list scratch;
+   ir_blob_reader check(payload, size);
+   if (!ir_deserialize(mem_ctx, &scratch, NULL, NULL, 0, &check)
+       || check.current != check.end) {
+      ralloc_free(mem_ctx);
+      return false;
+   }
+
+   /* Hand the IR being replaced to mem_ctx so that it is freed with it.
+    * The deserializer moves the top-level variables and functions it
+    * reuses into the new IR, and they are stolen back below.
+    */
+   exec_list *old_ir = sh->ir;
+   reparent_ir(old_ir, mem_ctx);
+   ralloc_steal(mem_ctx, old_ir);
+
+   exec_list *ir = new(mem_ctx) exec_list;
+   ir_blob_reader reader(payload, size);
+   ir_deserialize(mem_ctx, ir, sh->symbols, NULL, 0, &reader);
+
+   /* Variables and functions that the optimizer removed are still in the
+    * symbol table, just as when the shader is optimized for real.  Keep
+    * those objects alive, but not the bodies of their signatures.
+    */
+   foreach_list(node, old_ir) {
+      ir_instruction *const inst = (ir_instruction *) node;
+      ir_variable *const var = inst->as_variable();
+      ir_function *const f = inst->as_function();
+
+      if (var != NULL && sh->symbols->get_variable(var->name) == var) {
+	 ralloc_steal(sh, var);
+      } else if (f != NULL && sh->symbols->get_function(f->name) == f) {
+	 f->signatures.make_empty();
+	 ralloc_steal(sh, f);
+      }
+   }
+
+   validate_ir_tree(ir);
+
+   sh->ir = ir;
+   ralloc_steal(sh, ir);
+   reparent_ir(ir, sh);
+
+   ralloc_free(mem_ctx);
+   return true;
+}
+
+void
+glsl_cache_store_linked_shader(const ir_blob *key, struct gl_shader *sh)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   ir_blob payload(mem_ctx);
+
+   if (ir_serialize(&payload, sh->ir, NULL, 0))
+      write_entry(mem_ctx, key, &payload);
+
+   ralloc_free(mem_ctx);
+}
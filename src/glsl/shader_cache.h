@@ -0,0 +1,96 @@
+/* -*- c++ -*- */
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file shader_cache.h
+ *
+ * On-disk cache of compiled and optimized GLSL IR.
+ *
+ * The cache is disabled unless the \c MESA_GLSL_CACHE_DIR environment
+ * variable names an existing, writable directory.  Compiled shaders are
+ * cached by their source and the context state that affects compilation.
+ * Linked shaders are cached by their IR before the link-time optimization
+ * loop, so a program that has been linked before skips straight to the
+ * optimized IR.
+ *
+ * Each entry holds its full key, so a hash collision only causes a miss.
+ */
+
+#pragma once
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include "ir_serialize.h"
+
+struct gl_context;
+struct gl_shader;
+struct _mesa_glsl_parse_state;
+
+extern bool
+glsl_cache_enabled(void);
+
+/**
+ * Look up the result of compiling \c shader
+ *
+ * \c state must be the freshly constructed parse state for the compile.  On
+ * a hit the shader's IR, symbol table, info log, version and built-in
+ * shaders are set up just as a successful compile would.
+ */
+extern bool
+glsl_cache_load_shader(struct gl_shader *shader,
+		       struct _mesa_glsl_parse_state *state);
+
+/**
+ * Store the result of a successful compile of \c shader
+ */
+extern void
+glsl_cache_store_shader(struct gl_shader *shader,
+			struct _mesa_glsl_parse_state *state);
+
+/**
+ * Build the cache key for a linked shader before it is optimized
+ *
+ * \return
+ * \c false if the cache is disabled or the shader cannot be cached.
+ */
+extern bool
+glsl_cache_linked_shader_key(ir_blob *key, struct gl_shader *sh,
+			     unsigned max_unroll);
+
+/**
+ * Replace the IR of linked shader \c sh with the cached, optimized IR
+ *
+ * Global variables and functions that are still in \c sh->symbols are
+ * updated in place rather than recreated.
+ */
+extern bool
+glsl_cache_load_linked_shader(const ir_blob *key, struct gl_shader *sh);
+
+/**
+ * Store the optimized IR of linked shader \c sh under \c key
+ */
+extern void
+glsl_cache_store_linked_shader(const ir_blob *key, struct gl_shader *sh);
+
+#endif /* SHADER_CACHE_H */
@@ -47,6 +47,22 @@ _mesa_shader_debug(struct gl_context *, GLenum, GLuint,
 {
 }
 
+GLuint
+_mesa_num_threads(void)
+{
+   return 1;
+}
+
+void
+_mesa_parallel_for(GLuint count, GLuint numRanges,
+                   _mesa_range_func func, void *data)
+{
+   (void) numRanges;
+
+   if (count > 0)
+      func(data, 0, count);
+}
+
 struct gl_shader *
 _mesa_new_shader(struct gl_context *ctx, GLuint name, GLenum type)
 {
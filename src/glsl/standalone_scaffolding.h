@@ -32,6 +32,7 @@
 #define STANDALONE_SCAFFOLDING_H
 
 #include "main/mtypes.h"
+#include "main/imports.h"
 
 extern "C" void
 _mesa_reference_shader(struct gl_context *ctx, struct gl_shader **ptr,
@@ -44,6 +45,13 @@ extern "C" void
 _mesa_shader_debug(struct gl_context *ctx, GLenum type, GLuint id,
                    const char *msg, int len);
 
+extern "C" GLuint
+_mesa_num_threads(void);
+
+extern "C" void
+_mesa_parallel_for(GLuint count, GLuint numRanges,
+                   _mesa_range_func func, void *data);
+
 /**
  * Initialize the given gl_context structure to a reasonable set of
  * defaults representing the minimum capabilities required by the
@@ -42,6 +42,7 @@
 #include "ir_print_visitor.h"
 #include "program.h"
 #include "ir_reader.h"
+#include "loop_analysis.h"
 #include "standalone_scaffolding.h"
 
 using namespace std;
@@ -83,12 +84,18 @@ do_optimization(struct exec_list *ir, const char *optimization)
       return do_dead_code(ir, false);
    } else if (strcmp(optimization, "do_dead_code_local") == 0) {
       return do_dead_code_local(ir);
+   } else if (strcmp(optimization, "do_dead_code_global") == 0) {
+      return do_dead_code_global(ir);
    } else if (strcmp(optimization, "do_dead_code_unlinked") == 0) {
       return do_dead_code_unlinked(ir);
    } else if (strcmp(optimization, "do_dead_functions") == 0) {
       return do_dead_functions(ir);
    } else if (strcmp(optimization, "do_function_inlining") == 0) {
       return do_function_inlining(ir);
+   } else if (strcmp(optimization, "do_global_value_numbering") == 0) {
+      return do_global_value_numbering(ir);
+   } else if (strcmp(optimization, "do_loop_invariant_code_motion") == 0) {
+      return do_loop_invariant_code_motion(ir);
    } else if (sscanf(optimization,
                      "do_lower_jumps ( %d , %d , %d , %d , %d ) ",
                      &int_0, &int_1, &int_2, &int_3, &int_4) == 5) {
@@ -132,6 +139,22 @@ do_optimization(struct exec_list *ir, const char *optimization)
       return lower_quadop_vector(ir, int_0 != 0);
    } else if (strcmp(optimization, "optimize_redundant_jumps") == 0) {
       return optimize_redundant_jumps(ir);
+   } else if (sscanf(optimization, "partially_unroll_loops ( %d , %d ) ",
+                     &int_0, &int_1) == 2) {
+      loop_state *ls = analyze_loop_variables(ir);
+      bool progress = partially_unroll_loops(ir, ls, int_0, int_1);
+      delete ls;
+      return progress;
+   } else if (strcmp(optimization, "set_loop_controls") == 0) {
+      loop_state *ls = analyze_loop_variables(ir);
+      bool progress = set_loop_controls(ir, ls);
+      delete ls;
+      return progress;
+   } else if (strcmp(optimization, "reduce_induction_strength") == 0) {
+      loop_state *ls = analyze_loop_variables(ir);
+      bool progress = reduce_induction_strength(ir, ls);
+      delete ls;
+      return progress;
    } else {
       printf("Unrecognized optimization %s\n", optimization);
       exit(EXIT_FAILURE);
@@ -0,0 +1,245 @@
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include "main/compiler.h"
+#include "main/mtypes.h"
+#include "main/macros.h"
+#include "ralloc.h"
+#include "ir.h"
+#include "ir_reader.h"
+#include "ir_serialize.h"
+#include "glsl_parser_extras.h"
+#include "glsl_symbol_table.h"
+#include "standalone_scaffolding.h"
+
+/**
+ * A function with a parameter and a return value, a counted loop with a
+ * conditional break, swizzles, a call and a constant array.
+ */
+static const char shader_ir[] =
+   "((declare (uniform) vec4 u)\n"
+   " (declare (uniform) int n)\n"
+   " (declare (out) vec4 color)\n"
+   " (declare () (array float 2) weights)\n"
+   " (function scale\n"
+   "  (signature float\n"
+   "   (parameters (declare (in) float x))\n"
+   "   ((return (expression float * (var_ref x) (constant float (2.000000)))))))\n"
+   " (function main\n"
+   "  (signature void (parameters)\n"
+   "   ((declare () int i) (declare () float acc) (declare () float t)\n"
+   "    (assign (x) (array_ref (var_ref weights) (constant int (0)))\n"
+   "     (constant float (0.250000)))\n"
+   "    (assign (x) (var_ref i) (constant int (0)))\n"
+   "    (assign (x) (var_ref acc) (constant float (0.000000)))\n"
+   "    (loop () () () ()\n"
+   "     ((if (expression bool >= (var_ref i) (var_ref n)) (break) ())\n"
+   "      (call scale (var_ref t) ((swiz y (var_ref u))))\n"
+   "      (assign (x) (var_ref acc)\n"
+   "       (expression float + (var_ref acc) (var_ref t)))\n"
+   "      (assign (x) (var_ref i)\n"
+   "       (expression int + (var_ref i) (constant int (1))))))\n"
+   "    (assign (xyzw) (var_ref color)\n"
+   "     (expression vec4 * (var_ref u) (swiz xxxx (var_ref acc))))))))\n";
+
+class ir_serialize_test : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   void read_ir(exec_list *ir, const char *text);
+
+   struct gl_context local_ctx;
+   void *mem_ctx;
+   _mesa_glsl_parse_state *state;
+};
+
+void
+ir_serialize_test::SetUp()
+{
+   this->mem_ctx = ralloc_context(NULL);
+   initialize_context_to_defaults(&this->local_ctx, API_OPENGL_COMPAT);
+   this->state = new(this->mem_ctx)
+      _mesa_glsl_parse_state(&this->local_ctx, GL_VERTEX_SHADER,
+			     this->mem_ctx);
+   _mesa_glsl_initialize_types(this->state);
+}
+
+void
+ir_serialize_test::TearDown()
+{
+   ralloc_free(this->mem_ctx);
+   this->mem_ctx = NULL;
+}
+
+void
+ir_serialize_test::read_ir(exec_list *ir, const char *text)
+{
+   _mesa_glsl_read_ir(this->state, ir, text, true);
+   ASSERT_FALSE(this->state->error) << this->state->info_log;
+   validate_ir_tree(ir);
+}
+
+/**
+ * Serializing, deserializing and serializing again must give the same bytes.
+ */
+TEST_F(ir_serialize_test, round_trip)
+{
+   exec_list ir;
+   read_ir(&ir, shader_ir);
+
+   ir_blob first(this->mem_ctx);
+   ASSERT_TRUE(ir_serialize(&first, &ir, NULL, 0));
+
+   exec_list copy;
+   glsl_symbol_table *symbols = new(this->mem_ctx) glsl_symbol_table;
+   ir_blob_reader reader(first.data, first.size);
+   ASSERT_TRUE(ir_deserialize(this->mem_ctx, &copy, symbols, NULL, 0,
+			      &reader));
+   EXPECT_FALSE(reader.overrun);
+   EXPECT_EQ(reader.end, reader.current);
+   validate_ir_tree(&copy);
+
+   EXPECT_NE((void *) NULL, symbols->get_function("main"));
+   EXPECT_NE((void *) NULL, symbols->get_function("scale"));
+   EXPECT_NE((void *) NULL, symbols->get_variable("color"));
+
+   ir_blob second(this->mem_ctx);
+   ASSERT_TRUE(ir_serialize(&second, &copy, NULL, 0));
+   ASSERT_EQ(first.size, second.size);
+   EXPECT_EQ(0, memcmp(first.data, second.data, first.size));
+}
+
+/**
+ * Deserializing into a symbol table that already has the top-level
+ * variables and functions must reuse those objects.
+ */
+TEST_F(ir_serialize_test, reuses_symbols)
+{
+   exec_list ir;
+   read_ir(&ir, shader_ir);
+
+   ir_blob blob(this->mem_ctx);
+   ASSERT_TRUE(ir_serialize(&blob, &ir, NULL, 0));
+
+   ir_variable *const color = this->state->symbols->get_variable("color");
+   ir_function *const main = this->state->symbols->get_function("main");
+   ASSERT_NE((void *) NULL, color);
+   ASSERT_NE((void *) NULL, main);
+
+   exec_list copy;
+   ir_blob_reader reader(blob.data, blob.size);
+   ASSERT_TRUE(ir_deserialize(this->mem_ctx, &copy, this->state->symbols,
+			      NULL, 0, &reader));
+
+   EXPECT_EQ(color, this->state->symbols->get_variable("color"));
+   EXPECT_EQ(main, this->state->symbols->get_function("main"));
+
+   bool found_color = false;
+   foreach_list(node, &copy) {
+      if ((ir_instruction *) node == color)
+	 found_color = true;
+   }
+   EXPECT_TRUE(found_color);
+   EXPECT_FALSE(main->signatures.is_empty());
+   validate_ir_tree(&copy);
+}
+
+/**
+ * Every truncation of a valid blob must be rejected.
+ */
+TEST_F(ir_serialize_test, truncated)
+{
+   exec_list ir;
+   read_ir(&ir, shader_ir);
+
+   ir_blob blob(this->mem_ctx);
+   ASSERT_TRUE(ir_serialize(&blob, &ir, NULL, 0));
+
+   for (size_t size = 0; size < blob.size; size++) {
+      void *tmp_ctx = ralloc_context(NULL);
+      exec_list copy;
+      ir_blob_reader reader(blob.data, size);
+
+      const bool ok = ir_deserialize(tmp_ctx, &copy, NULL, NULL, 0, &reader);
+      EXPECT_TRUE(!ok || reader.overrun) << "size " << size;
+
+      ralloc_free(tmp_ctx);
+   }
+}
+
+/**
+ * A call to a function of a built-in shader refers to the built-in, even
+ * when the serialized IR holds the function too.  This is how the built-in
+ * library itself is serialized, one function at a time.
+ */
+TEST_F(ir_serialize_test, builtin_callee)
+{
+   exec_list ir;
+   read_ir(&ir, shader_ir);
+
+   struct gl_shader builtin;
+   memset(&builtin, 0, sizeof(builtin));
+   builtin.symbols = this->state->symbols;
+   gl_shader *builtins[] = { &builtin };
+
+   ir_blob blob(this->mem_ctx);
+   ASSERT_TRUE(ir_serialize(&blob, &ir, builtins, 1));
+
+   exec_list copy;
+   glsl_symbol_table *symbols = new(this->mem_ctx) glsl_symbol_table;
+   ir_blob_reader reader(blob.data, blob.size);
+   ASSERT_TRUE(ir_deserialize(this->mem_ctx, &copy, symbols, builtins, 1,
+			      &reader, false));
+   EXPECT_EQ(reader.end, reader.current);
+
+   ir_function *const scale = this->state->symbols->get_function("scale");
+   ir_function *const main = symbols->get_function("main");
+   ASSERT_NE((void *) NULL, main);
+   ASSERT_NE(scale, symbols->get_function("scale"));
+
+   unsigned calls = 0;
+   foreach_list(node, &copy) {
+      ir_function *const f = ((ir_instruction *) node)->as_function();
+      if (f != main)
+	 continue;
+
+      ir_function_signature *const sig =
+	 (ir_function_signature *) f->signatures.get_head();
+      foreach_list(inst, &sig->body) {
+	 ir_loop *const loop = ((ir_instruction *) inst)->as_loop();
+	 if (loop == NULL)
+	    continue;
+
+	 foreach_list(body_inst, &loop->body_instructions) {
+	    ir_call *const call = ((ir_instruction *) body_inst)->as_call();
+	    if (call == NULL)
+	       continue;
+
+	    EXPECT_EQ(scale->signatures.get_head(), call->callee);
+	    calls++;
+	 }
+      }
+   }
+   EXPECT_EQ(1u, calls);
+}
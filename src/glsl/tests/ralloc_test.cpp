@@ -35,4 +35,154 @@ TEST(ralloc_test, null_parent)
 
    EXPECT_EQ(NULL, ralloc_parent(mem_ctx));
 }
+
+TEST(ralloc_test, str_append)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   char *s = ralloc_strdup(mem_ctx, "ab");
+   size_t length = 2;
+
+   for (unsigned i = 0; i < 50; i++) {
+      EXPECT_TRUE(ralloc_str_append(&s, "cde", length, 2));
+      length += 2;
+   }
+
+   EXPECT_EQ(102u, strlen(s));
+   EXPECT_EQ('c', s[2]);
+   EXPECT_EQ('d', s[101]);
+   EXPECT_EQ(mem_ctx, ralloc_parent(s));
+
+   ralloc_free(mem_ctx);
+}
+/*@}*/
+
+/**
+ * \name Arena contexts
+ */
+/*@{*/
+static int destroyed;
+
+static void
+count_destructor(void *)
+{
+   destroyed++;
+}
+
+TEST(ralloc_test, arena_parents)
+{
+   void *arena = ralloc_arena_context(NULL);
+   void *a = ralloc_size(arena, 24);
+   void *b = ralloc_context(a);
+   char *s = ralloc_strdup(b, "string");
+
+   EXPECT_EQ(arena, ralloc_parent(a));
+   EXPECT_EQ(a, ralloc_parent(b));
+   EXPECT_EQ(b, ralloc_parent(s));
+
+   ralloc_steal(arena, s);
+   EXPECT_EQ(arena, ralloc_parent(s));
+   EXPECT_STREQ("string", s);
+
+   ralloc_free(arena);
+}
+
+TEST(ralloc_test, arena_zeroed_and_aligned)
+{
+   void *arena = ralloc_arena_context(NULL);
+
+   for (unsigned i = 1; i < 2000; i++) {
+      unsigned char *p = (unsigned char *) ralloc_size(arena, i % 97 + 1);
+      EXPECT_EQ(0u, ((uintptr_t) p) % 8);
+      for (unsigned j = 0; j < i % 97 + 1; j++)
+	 EXPECT_EQ(0, p[j]);
+      memset(p, 0xff, i % 97 + 1);
+   }
+
+   /* Bigger than a slab */
+   unsigned char *big = (unsigned char *) rzalloc_size(arena, 1 << 20);
+   big[(1 << 20) - 1] = 1;
+   EXPECT_EQ(arena, ralloc_parent(big));
+
+   ralloc_free(arena);
+}
+
+TEST(ralloc_test, arena_destructors)
+{
+   void *arena = ralloc_arena_context(NULL);
+   void *a = ralloc_size(arena, 8);
+   void *b = ralloc_size(arena, 8);
+
+   destroyed = 0;
+   ralloc_set_destructor(a, count_destructor);
+   ralloc_set_destructor(b, count_destructor);
+
+   ralloc_free(a);
+   EXPECT_EQ(1, destroyed);
+
+   ralloc_free(arena);
+   EXPECT_EQ(2, destroyed);
+}
+
+TEST(ralloc_test, arena_steal_in)
+{
+   void *ctx = ralloc_context(NULL);
+   void *arena = ralloc_arena_context(ctx);
+   void *a = ralloc_size(arena, 8);
+   void *m = ralloc_context(NULL);
+
+   destroyed = 0;
+   ralloc_set_destructor(m, count_destructor);
+   ralloc_steal(a, m);
+   EXPECT_EQ(a, ralloc_parent(m));
+
+   /* Freeing the parent of the arena frees it and what was stolen in. */
+   ralloc_free(ctx);
+   EXPECT_EQ(1, destroyed);
+}
+
+TEST(ralloc_test, arena_steal_out)
+{
+   void *arena = ralloc_arena_context(NULL);
+   void *ctx = ralloc_context(NULL);
+   char *a = ralloc_strdup(arena, "stolen");
+   char *child = ralloc_strdup(a, "child");
+
+   destroyed = 0;
+   ralloc_set_destructor(a, count_destructor);
+   ralloc_steal(ctx, a);
+   EXPECT_EQ(ctx, ralloc_parent(a));
+
+   /* The stolen block and its children outlive the arena context. */
+   ralloc_free(arena);
+   EXPECT_EQ(0, destroyed);
+   EXPECT_STREQ("stolen", a);
+   EXPECT_STREQ("child", child);
+
+   char *more = ralloc_strdup(a, "more");
+   EXPECT_STREQ("more", more);
+
+   ralloc_free(ctx);
+   EXPECT_EQ(1, destroyed);
+}
+
+TEST(ralloc_test, arena_strcat)
+{
+   void *arena = ralloc_arena_context(NULL);
+   char *s = ralloc_strdup(arena, "a");
+   char *t = ralloc_strdup(arena, "x");
+
+   for (unsigned i = 0; i < 100; i++) {
+      ralloc_strcat(&s, "b");
+      ralloc_asprintf_append(&t, "%u", i % 10);
+   }
+
+   EXPECT_EQ(101u, strlen(s));
+   EXPECT_EQ('a', s[0]);
+   EXPECT_EQ('b', s[100]);
+   EXPECT_EQ(101u, strlen(t));
+   EXPECT_EQ('9', t[100]);
+   EXPECT_EQ(arena, ralloc_parent(s));
+
+   ralloc_free(arena);
+}
 /*@}*/
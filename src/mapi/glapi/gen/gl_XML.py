@@ -608,6 +608,7 @@ class gl_function( gl_item ):
         self.exec_flavor = 'mesa'
         self.desktop = True
         self.deprecated = None
+        self.marshal = None
 
         # self.entry_point_api_map[name][api] is a decimal value
         # indicating the earliest version of the given API in which
@@ -671,6 +672,10 @@ class gl_function( gl_item ):
         if exec_flavor:
             self.exec_flavor = exec_flavor
 
+        marshal = element.nsProp('marshal', None)
+        if marshal:
+            self.marshal = marshal
+
         deprecated = element.nsProp('deprecated', None)
         if deprecated != 'none':
             self.deprecated = Decimal(deprecated)
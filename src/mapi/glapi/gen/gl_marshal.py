@@ -0,0 +1,417 @@
+#!/usr/bin/env python
+
+# Copyright (C) 2012 The Mesa Authors
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+
+# This script generates marshal_generated.c and marshal_generated.h, which
+# implement the "marshal" dispatch table used when a context runs its GL
+# calls on a separate thread (see main/marshal.h).
+#
+# Every function gets one of two kinds of marshal function:
+#
+# - Asynchronous ones copy their parameters into a command in the current
+#   batch and return.  The command is later executed on the context's
+#   thread by the matching _mesa_unmarshal_* function.
+#
+# - Synchronous ones wait for the context's thread to become idle and then
+#   call the real function directly.
+#
+# A function is asynchronous when it returns nothing and all of its
+# pointer parameters point to input arrays whose size is known from the
+# XML, either a fixed count or another parameter.  The "marshal" attribute
+# of the function overrides that:
+#
+#   sync     always synchronous.
+#   draw     reads vertex arrays; pointers are passed by value when all
+#            arrays (and indices) come from buffer objects, otherwise the
+#            call is synchronous.
+#   pointer  sets a vertex array pointer, which is passed by value.
+#   unpack   reads pixel data, which is an offset into a buffer object
+#            while a pixel unpack buffer is bound; the call is then
+#            synchronous.
+#   custom   hand-written in main/marshal.c.
+
+import license
+import gl_XML
+import sys, getopt
+
+
+header = """
+#include "main/api_exec.h"
+#include "main/context.h"
+#include "main/dispatch.h"
+#include "main/marshal.h"
+#include "main/mtypes.h"
+"""
+
+
+def base_type(p):
+    """Element type of the array a pointer parameter points to."""
+    t = p.get_base_type_string()
+    if t in ('GLvoid', 'void'):
+        return 'GLubyte'
+    return t
+
+
+def element_size(p):
+    return '%d * sizeof(%s)' % (p.count_scale, base_type(p))
+
+
+def is_const_pointer(p):
+    s = p.type_string()
+    return s.startswith('const ') and s.count('*') == 1
+
+
+def params(func):
+    return [p for p in func.parameterIterator()]
+
+
+def call_string(func):
+    return ', '.join([p.name for p in params(func) if not p.is_padding])
+
+
+class marshal_function(object):
+    """How one function is marshalled."""
+
+    def __init__(self, func):
+        self.func = func
+        self.name = func.name
+        self.fixed_params = []
+        self.variable_params = []
+        self.asynchronous = self.classify()
+
+    def classify(self):
+        func = self.func
+
+        if func.marshal == 'sync' or func.return_type != 'void':
+            return False
+
+        names = [p.name for p in params(func)]
+        for p in params(func):
+            if p.is_padding:
+                return False
+            if not p.is_pointer():
+                self.fixed_params.append(p)
+            elif func.marshal in ('draw', 'pointer') and \
+                    p.name in ('pointer', 'indices'):
+                # Offset into a buffer object, or a client pointer that
+                # is only stored: pass it by value.
+                self.fixed_params.append(p)
+            elif p.is_image() or p.is_output or p.count_parameter_list or \
+                    not is_const_pointer(p):
+                return False
+            elif p.count:
+                self.fixed_params.append(p)
+            elif p.counter and p.counter in names:
+                self.variable_params.append(p)
+            else:
+                return False
+
+        return True
+
+    def is_fixed_array(self, p):
+        return p.is_pointer() and p.count and p not in self.variable_params \
+            and p.name not in ('pointer', 'indices')
+
+    def print_sync_call(self, indent):
+        func = self.func
+        print '%s_mesa_glthread_begin_sync(ctx);' % indent
+        if func.return_type != 'void':
+            print '%sresult = CALL_%s(ctx->CurrentDispatch, (%s));' % (
+                indent, func.name, call_string(func))
+        else:
+            print '%sCALL_%s(ctx->CurrentDispatch, (%s));' % (
+                indent, func.name, call_string(func))
+        print '%s_mesa_glthread_end_sync(ctx);' % indent
+
+    def print_sync(self):
+        func = self.func
+        print '/* %s: marshalled synchronously */' % func.name
+        print 'static %s GLAPIENTRY' % func.return_type
+        print '_mesa_marshal_%s(%s)' % (func.name,
+                                       func.get_parameter_string())
+        print '{'
+        print '   GET_CURRENT_CONTEXT(ctx);'
+        if func.return_type != 'void':
+            print '   %s result;' % func.return_type
+        self.print_sync_call('   ')
+        if func.return_type != 'void':
+            print '   return result;'
+        print '}'
+        print ''
+
+    def print_struct(self):
+        print 'struct marshal_cmd_%s' % self.name
+        print '{'
+        print '   struct marshal_cmd_base cmd_base;'
+        for p in self.fixed_params:
+            if self.is_fixed_array(p):
+                print '   %s %s[%d];' % (base_type(p), p.name,
+                                         p.count * p.count_scale)
+            else:
+                print '   %s %s;' % (p.type_string(), p.name)
+        for p in self.variable_params:
+            if p.img_null_flag:
+                print '   GLboolean %s_null;' % p.name
+        for p in self.variable_params:
+            if p.count_scale > 1:
+                count = '%s * %d' % (p.counter, p.count_scale)
+            else:
+                count = p.counter
+            print '   /* Followed by %s %s[%s] */' % (base_type(p), p.name,
+                                                     count)
+        print '};'
+
+    def print_unmarshal(self):
+        func = self.func
+        print 'static INLINE void'
+        print '_mesa_unmarshal_%s(struct gl_context *ctx, ' \
+            'const struct marshal_cmd_%s *cmd)' % (self.name, self.name)
+        print '{'
+        for p in self.fixed_params:
+            if self.is_fixed_array(p):
+                print '   const %s *%s = cmd->%s;' % (base_type(p), p.name,
+                                                    p.name)
+            elif p.is_pointer():
+                print '   %s %s = cmd->%s;' % (p.type_string(), p.name, p.name)
+            else:
+                print '   const %s %s = cmd->%s;' % (p.type_string(), p.name,
+                                                   p.name)
+        if self.variable_params:
+            for p in self.variable_params:
+                print '   const %s *%s;' % (base_type(p), p.name)
+            print '   const char *variable_data = (const char *) (cmd + 1);'
+            for p in self.variable_params:
+                if p.img_null_flag:
+                    print '   %s = cmd->%s_null ? NULL : ' \
+                        '(const %s *) variable_data;' % (p.name, p.name,
+                                                         base_type(p))
+                else:
+                    print '   %s = (const %s *) variable_data;' % (
+                        p.name, base_type(p))
+                if p != self.variable_params[-1]:
+                    print '   variable_data += %s * %s;' % (p.counter,
+                                                            element_size(p))
+        print '   CALL_%s(ctx->CurrentDispatch, (%s));' % (func.name,
+                                                          call_string(func))
+        print '}'
+
+    def print_async(self):
+        func = self.func
+        print '/* %s: marshalled asynchronously */' % func.name
+        self.print_struct()
+        self.print_unmarshal()
+        print 'static void GLAPIENTRY'
+        print '_mesa_marshal_%s(%s)' % (func.name,
+                                       func.get_parameter_string())
+        print '{'
+        print '   GET_CURRENT_CONTEXT(ctx);'
+        for p in self.variable_params:
+            print '   int %s_size = _mesa_glthread_array_size(%s, %s);' % (
+                p.name, p.counter, element_size(p))
+        size = ['sizeof(struct marshal_cmd_%s)' % self.name]
+        size += ['%s_size' % p.name for p in self.variable_params]
+        print '   size_t cmd_size = %s;' % ' + '.join(size)
+        has_data = self.fixed_params or self.variable_params
+        if has_data:
+            print '   struct marshal_cmd_%s *cmd;' % self.name
+        if self.variable_params:
+            print '   char *variable_data;'
+
+        if func.marshal == 'pointer':
+            print '   _mesa_glthread_array_pointer(ctx);'
+
+        conditions = []
+        if func.marshal == 'draw':
+            indexed = 'GL_FALSE'
+            for p in params(func):
+                if p.name == 'indices':
+                    indexed = 'GL_TRUE'
+            conditions.append('!_mesa_glthread_arrays_in_vbos(ctx, %s)' %
+                              indexed)
+        if func.marshal == 'unpack':
+            conditions.append('ctx->GLThread->PixelUnpackBuffer != 0')
+        for p in self.variable_params:
+            conditions.append('%s_size < 0' % p.name)
+            if not p.img_null_flag:
+                conditions.append('(%s_size > 0 && !%s)' % (p.name, p.name))
+        if self.variable_params:
+            conditions.append('cmd_size > MARSHAL_MAX_CMD_SIZE')
+        if conditions:
+            print '   if (%s) {' % ' ||\n       '.join(conditions)
+            self.print_sync_call('      ')
+            print '      return;'
+            print '   }'
+
+        print '   %s_mesa_glthread_allocate_command(ctx, ' \
+            'DISPATCH_CMD_%s, cmd_size);' % ('cmd = ' if has_data else '',
+                                              self.name)
+        for p in self.fixed_params:
+            if self.is_fixed_array(p):
+                print '   memcpy(cmd->%s, %s, %d * sizeof(%s));' % (
+                    p.name, p.name, p.count * p.count_scale, base_type(p))
+            else:
+                print '   cmd->%s = %s;' % (p.name, p.name)
+        if self.variable_params:
+            print '   variable_data = (char *) (cmd + 1);'
+            for p in self.variable_params:
+                if p.img_null_flag:
+                    print '   cmd->%s_null = !%s;' % (p.name, p.name)
+                    print '   if (%s)' % p.name
+                    print '      memcpy(variable_data, %s, %s_size);' % (
+                        p.name, p.name)
+                else:
+                    print '   memcpy(variable_data, %s, %s_size);' % (
+                        p.name, p.name)
+                if p != self.variable_params[-1]:
+                    print '   variable_data += %s_size;' % p.name
+        print '}'
+        print ''
+
+
+def marshal_functions(api):
+    return [marshal_function(f) for f in api.functionIterateByOffset()]
+
+
+class PrintCode(gl_XML.gl_print_base):
+
+    def __init__(self):
+        gl_XML.gl_print_base.__init__(self)
+
+        self.name = 'gl_marshal.py'
+        self.license = license.bsd_license_template % (
+            'Copyright (C) 2012 The Mesa Authors', 'The Mesa Authors')
+
+    def printRealHeader(self):
+        print header
+        print '#include <string.h>'
+        print ''
+
+    def printBody(self, api):
+        functions = marshal_functions(api)
+
+        for m in functions:
+            if m.func.marshal == 'custom':
+                continue
+            if m.asynchronous:
+                m.print_async()
+            else:
+                m.print_sync()
+
+        print 'void'
+        print '_mesa_unmarshal_dispatch_cmd(struct gl_context *ctx, ' \
+            'const void *cmd)'
+        print '{'
+        print '   const struct marshal_cmd_base *cmd_base = cmd;'
+        print ''
+        print '   switch (cmd_base->cmd_id) {'
+        for m in functions:
+            if m.func.marshal != 'custom' and not m.asynchronous:
+                continue
+            print '   case DISPATCH_CMD_%s:' % m.name
+            print '      _mesa_unmarshal_%s(ctx, ' \
+                '(const struct marshal_cmd_%s *) cmd);' % (m.name, m.name)
+            print '      break;'
+        print '   default:'
+        print '      assert(!"unknown marshalled command");'
+        print '      break;'
+        print '   }'
+        print '}'
+        print ''
+
+        print 'struct _glapi_table *'
+        print '_mesa_create_marshal_table(const struct gl_context *ctx)'
+        print '{'
+        print '   struct _glapi_table *table;'
+        print ''
+        print '   table = _mesa_alloc_dispatch_table(_gloffset_COUNT);'
+        print '   if (table == NULL)'
+        print '      return NULL;'
+        print ''
+        for m in functions:
+            print '   SET_%s(table, _mesa_marshal_%s);' % (m.name, m.name)
+        print ''
+        print '   return table;'
+        print '}'
+
+
+class PrintHeader(gl_XML.gl_print_base):
+
+    def __init__(self):
+        gl_XML.gl_print_base.__init__(self)
+
+        self.name = 'gl_marshal.py'
+        self.license = license.bsd_license_template % (
+            'Copyright (C) 2012 The Mesa Authors', 'The Mesa Authors')
+        self.header_tag = '_MARSHAL_GENERATED_H_'
+
+    def printBody(self, api):
+        functions = marshal_functions(api)
+
+        print 'enum marshal_dispatch_cmd_id'
+        print '{'
+        for m in functions:
+            if m.func.marshal == 'custom' or m.asynchronous:
+                print '   DISPATCH_CMD_%s,' % m.name
+        print '   NUM_DISPATCH_CMD'
+        print '};'
+        print ''
+        for m in functions:
+            if m.func.marshal != 'custom':
+                continue
+            print 'struct marshal_cmd_%s;' % m.name
+            print 'void _mesa_unmarshal_%s(struct gl_context *ctx, ' \
+                'const struct marshal_cmd_%s *cmd);' % (m.name, m.name)
+            print '%s GLAPIENTRY _mesa_marshal_%s(%s);' % (
+                m.func.return_type, m.name, m.func.get_parameter_string())
+            print ''
+
+
+def show_usage():
+    print "Usage: %s [-f input_file_name] [-m mode]" % sys.argv[0]
+    print "    -m mode   Mode can be 'code' or 'header'."
+    sys.exit(1)
+
+
+if __name__ == '__main__':
+    file_name = "gl_and_es_API.xml"
+    mode = "code"
+
+    try:
+        (args, trail) = getopt.getopt(sys.argv[1:], "f:m:")
+    except Exception,e:
+        show_usage()
+
+    for (arg,val) in args:
+        if arg == "-f":
+            file_name = val
+        elif arg == "-m":
+            mode = val
+
+    if mode == "code":
+        printer = PrintCode()
+    elif mode == "header":
+        printer = PrintHeader()
+    else:
+        show_usage()
+
+    api = gl_XML.parse_GL_API(file_name)
+    printer.Print(api)
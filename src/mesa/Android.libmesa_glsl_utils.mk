@@ -36,6 +36,7 @@ include $(CLEAR_VARS)
 LOCAL_MODULE := libmesa_glsl_utils
 
 LOCAL_SRC_FILES := \
+	main/hash_table.c \
 	program/hash_table.c \
 	program/symbol_table.c
 
@@ -52,6 +53,7 @@ LOCAL_MODULE := libmesa_glsl_utils
 LOCAL_IS_HOST_MODULE := true
 
 LOCAL_SRC_FILES := \
+	main/hash_table.c \
 	program/hash_table.c \
 	program/symbol_table.c
 
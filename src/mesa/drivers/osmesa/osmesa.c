@@ -786,6 +786,13 @@ OSMesaCreateContextExt( GLenum format, GLint depthBits, GLint stencilBits,
          swrast = SWRAST_CONTEXT( ctx );
          swrast->choose_line = osmesa_choose_line;
          swrast->choose_triangle = osmesa_choose_triangle;
+
+         /* Bin triangles into screen tiles and rasterize the tiles in
+          * parallel, on up to _mesa_num_threads() threads.  The optimized
+          * triangle functions above are not used in this mode.
+          */
+         if (_mesa_getenv("OSMESA_TILED"))
+            _swrast_allow_tiled_rendering( ctx, GL_TRUE );
       }
    }
    return osmesa;
@@ -103,6 +103,7 @@
 #include "light.h"
 #include "lines.h"
 #include "macros.h"
+#include "marshal.h"
 #include "matrix.h"
 #include "multisample.h"
 #include "pixel.h"
@@ -1052,6 +1053,9 @@ _mesa_create_context(gl_api api,
 void
 _mesa_free_context_data( struct gl_context *ctx )
 {
+   /* Let the marshalling thread finish before tearing anything down */
+   _mesa_glthread_destroy(ctx);
+
    if (!_mesa_get_current_context()){
       /* No current context, but we may need one in order to delete
        * texture objs, etc.  So temporarily bind the context now.
@@ -1392,6 +1396,9 @@ _mesa_make_current( struct gl_context *newCtx,
       curCtx != newCtx)
       _mesa_flush(curCtx);
 
+   if (curCtx && curCtx->GLThread)
+      _mesa_glthread_finish(curCtx);
+
    /* We used to call _glapi_check_multithread() here.  Now do it in drivers */
    _glapi_set_context((void *) newCtx);
    ASSERT(_mesa_get_current_context() == newCtx);
@@ -1400,7 +1407,8 @@ _mesa_make_current( struct gl_context *newCtx,
       _glapi_set_dispatch(NULL);  /* none current */
    }
    else {
-      _glapi_set_dispatch(newCtx->CurrentDispatch);
+      _glapi_set_dispatch(newCtx->GLThread ? newCtx->MarshalExec
+                                           : newCtx->CurrentDispatch);
 
       if (drawBuffer && readBuffer) {
          ASSERT(_mesa_is_winsys_fbo(drawBuffer));
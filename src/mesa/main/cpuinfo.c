@@ -36,6 +36,8 @@ _mesa_get_cpu_features(void)
 {
 #ifdef USE_X86_ASM
    _mesa_get_x86_features();
+#elif defined(USE_X86_64_ASM)
+   _mesa_get_x86_64_features();
 #endif
 }
 
@@ -79,6 +81,19 @@ _mesa_get_cpu_string(void)
    }
 # endif
 
+#elif defined(USE_X86_64_ASM)
+
+   strcat(buffer, "x86-64");
+   if (cpu_has_sse4_1) {
+      strcat(buffer, "/SSE4.1");
+   }
+   if (cpu_has_avx2) {
+      strcat(buffer, "/AVX2");
+   }
+   if (cpu_has_f16c) {
+      strcat(buffer, "/F16C");
+   }
+
 #elif defined(USE_SPARC_ASM)
 
    strcat(buffer, "SPARC");
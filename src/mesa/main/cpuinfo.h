@@ -31,6 +31,10 @@
 #include "x86/common_x86_asm.h"
 #endif
 
+#if defined(USE_X86_64_ASM)
+#include "x86-64/x86-64.h"
+#endif
+
 
 extern void
 _mesa_get_cpu_features(void);
@@ -81,6 +81,15 @@ struct gl_list_instruction
    void (*Execute)( struct gl_context *ctx, void *data );
    void (*Destroy)( struct gl_context *ctx, void *data );
    void (*Print)( struct gl_context *ctx, void *data );
+
+   /**
+    * Optional.  Try to fold the instruction \p next, which follows the one
+    * at \p data in the list, into the latter.  On success, \p next is
+    * dropped from the list without being destroyed.  Instructions with a
+    * Merge function must not change any state besides the current
+    * attributes, see compile_list().
+    */
+   GLboolean (*Merge)( struct gl_context *ctx, void *data, void *next );
 };
 
 
@@ -1005,6 +1014,7 @@ _mesa_dlist_alloc(struct gl_context *ctx, GLuint opcode, GLuint bytes)
  * \param execute  function to execute the new display list command
  * \param destroy  function to destroy the new display list command
  * \param print  function to print the new display list command
+ * \param merge  function to merge two consecutive commands, or NULL
  * \return  the new opcode number or -1 if error
  */
 GLint
@@ -1012,7 +1022,9 @@ _mesa_dlist_alloc_opcode(struct gl_context *ctx,
                          GLuint size,
                          void (*execute) (struct gl_context *, void *),
                          void (*destroy) (struct gl_context *, void *),
-                         void (*print) (struct gl_context *, void *))
+                         void (*print) (struct gl_context *, void *),
+                         GLboolean (*merge) (struct gl_context *, void *,
+                                             void *))
 {
    if (ctx->ListExt->NumOpcodes < MAX_DLIST_EXT_OPCODES) {
       const GLuint i = ctx->ListExt->NumOpcodes++;
@@ -1021,6 +1033,7 @@ _mesa_dlist_alloc_opcode(struct gl_context *ctx,
       ctx->ListExt->Opcode[i].Execute = execute;
       ctx->ListExt->Opcode[i].Destroy = destroy;
       ctx->ListExt->Opcode[i].Print = print;
+      ctx->ListExt->Opcode[i].Merge = merge;
       return i + OPCODE_EXT_0;
    }
    return -1;
@@ -7337,6 +7350,236 @@ islist(struct gl_context *ctx, GLuint list)
 
 
 
+/**********************************************************************/
+/*                     Display list compilation                       */
+/**********************************************************************/
+
+
+/** Most state instructions remembered by compile_list() */
+#define MAX_LIST_STATE 16
+
+
+/** Number of nodes of an instruction, including the opcode */
+static inline GLuint
+inst_size(const struct gl_context *ctx, OpCode opcode)
+{
+   if (is_ext_opcode(opcode))
+      return ctx->ListExt->Opcode[opcode - OPCODE_EXT_0].Size;
+   else
+      return InstSize[opcode];
+}
+
+
+/**
+ * For instructions that set a piece of state which no other instruction
+ * changes, the number of leading parameters that say which piece it is.
+ * -1 for all other instructions.
+ */
+static GLint
+state_key_params(OpCode opcode)
+{
+   switch (opcode) {
+   case OPCODE_CULL_FACE:
+   case OPCODE_DEPTH_FUNC:
+   case OPCODE_FRONT_FACE:
+   case OPCODE_LINE_WIDTH:
+   case OPCODE_POINT_SIZE:
+   case OPCODE_SHADE_MODEL:
+      return 0;
+   case OPCODE_BIND_TEXTURE:
+   case OPCODE_DISABLE:
+   case OPCODE_ENABLE:
+   case OPCODE_POLYGON_MODE:
+      return 1;
+   default:
+      return -1;
+   }
+}
+
+
+/**
+ * Do two state instructions set the same piece of state?
+ */
+static GLboolean
+same_state(const Node *a, const Node *b)
+{
+   /* glEnable and glDisable set the same flags */
+   const OpCode opA = a[0].opcode == OPCODE_DISABLE ?
+      OPCODE_ENABLE : a[0].opcode;
+   const OpCode opB = b[0].opcode == OPCODE_DISABLE ?
+      OPCODE_ENABLE : b[0].opcode;
+   GLint i;
+
+   if (opA != opB)
+      return GL_FALSE;
+
+   for (i = 1; i <= state_key_params(opA); i++) {
+      if (a[i].ui != b[i].ui)
+         return GL_FALSE;
+   }
+
+   return GL_TRUE;
+}
+
+
+/**
+ * Does instruction b change part of the state that a sets, without setting
+ * the same piece?  glPolygonMode(GL_FRONT_AND_BACK) sets both faces.
+ */
+static GLboolean
+overlapping_state(const Node *a, const Node *b)
+{
+   return a[0].opcode == OPCODE_POLYGON_MODE &&
+          b[0].opcode == OPCODE_POLYGON_MODE &&
+          a[1].e != b[1].e &&
+          (a[1].e == GL_FRONT_AND_BACK || b[1].e == GL_FRONT_AND_BACK);
+}
+
+
+/**
+ * Are two state instructions the same?  All of their parameters are 32-bit
+ * values.
+ */
+static GLboolean
+same_instruction(const Node *a, const Node *b)
+{
+   GLuint i;
+
+   if (a[0].opcode != b[0].opcode)
+      return GL_FALSE;
+
+   for (i = 1; i < InstSize[a[0].opcode]; i++) {
+      if (a[i].ui != b[i].ui)
+         return GL_FALSE;
+   }
+
+   return GL_TRUE;
+}
+
+
+/**
+ * Optimize a display list whose compilation has just ended:
+ *
+ * - State instructions that repeat the value set by an earlier instruction
+ *   of the list are dropped, provided that only vertex data and other such
+ *   state instructions are found in between.
+ * - Consecutive instructions of an extension opcode with a Merge function,
+ *   such as the vertex lists of the VBO module, are merged when possible,
+ *   which the previous step lets happen more often.
+ * - The remaining instructions are packed into a single block, so that
+ *   execute_list() doesn't follow OPCODE_CONTINUE links.
+ *
+ * The list is left alone if memory runs out.
+ */
+static void
+compile_list(struct gl_context *ctx, struct gl_display_list *dlist)
+{
+   Node *state[MAX_LIST_STATE];
+   GLuint numState = 0;
+   Node *head, *dst, *prev = NULL;
+   Node *n, *block;
+   GLuint total = 0;
+
+   /* Size the new block */
+   n = dlist->Head;
+   while (n[0].opcode != OPCODE_END_OF_LIST) {
+      if (n[0].opcode == OPCODE_CONTINUE) {
+         n = (Node *) n[1].next;
+      }
+      else {
+         total += inst_size(ctx, n[0].opcode);
+         n += inst_size(ctx, n[0].opcode);
+      }
+   }
+
+   head = malloc((total + 1) * sizeof(Node));
+   if (!head)
+      return;
+
+   dst = head;
+   n = dlist->Head;
+   while (n[0].opcode != OPCODE_END_OF_LIST) {
+      const OpCode opcode = n[0].opcode;
+      const GLuint size = inst_size(ctx, opcode);
+      GLuint i = MAX_LIST_STATE;
+
+      if (opcode == OPCODE_CONTINUE) {
+         n = (Node *) n[1].next;
+         continue;
+      }
+
+      if (is_ext_opcode(opcode)) {
+         const struct gl_list_instruction *ext =
+            &ctx->ListExt->Opcode[opcode - OPCODE_EXT_0];
+
+         if (!ext->Merge) {
+            /* we can't tell what it does */
+            numState = 0;
+         }
+         else if (prev && prev[0].opcode == opcode &&
+                  ext->Merge(ctx, &prev[1], &n[1])) {
+            n += size;
+            continue;
+         }
+      }
+      else if (state_key_params(opcode) >= 0) {
+         /* forget the state that this instruction changes part of */
+         for (i = 0; i < numState; ) {
+            if (overlapping_state(state[i], n))
+               state[i] = state[--numState];
+            else
+               i++;
+         }
+
+         for (i = 0; i < numState; i++) {
+            if (same_state(state[i], n))
+               break;
+         }
+
+         if (i < numState && same_instruction(state[i], n)) {
+            /* redundant */
+            n += size;
+            continue;
+         }
+
+         if (i == numState && numState < MAX_LIST_STATE)
+            numState++;
+      }
+      else {
+         numState = 0;
+      }
+
+      memcpy(dst, n, size * sizeof(Node));
+      if (i < numState)
+         state[i] = dst;
+      prev = dst;
+      dst += size;
+      n += size;
+   }
+
+   dst[0].opcode = OPCODE_END_OF_LIST;
+
+   /* Free the old blocks.  The instructions now belong to the new one. */
+   n = block = dlist->Head;
+   while (n[0].opcode != OPCODE_END_OF_LIST) {
+      if (n[0].opcode == OPCODE_CONTINUE) {
+         Node *next = (Node *) n[1].next;
+         free(block);
+         n = block = next;
+      }
+      else {
+         n += inst_size(ctx, n[0].opcode);
+      }
+   }
+   free(block);
+
+   dlist->Head = realloc(head, (dst - head + 1) * sizeof(Node));
+   if (!dlist->Head)
+      dlist->Head = head;
+}
+
+
+
 /**********************************************************************/
 /*                     Display list execution                         */
 /**********************************************************************/
@@ -8728,6 +8971,8 @@ _mesa_EndList(void)
 
    (void) alloc_instruction(ctx, OPCODE_END_OF_LIST, 0);
 
+   compile_list(ctx, ctx->ListState.CurrentList);
+
    /* Destroy old list, if any */
    destroy_list(ctx, ctx->ListState.CurrentList->Name);
 
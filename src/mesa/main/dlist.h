@@ -68,7 +68,8 @@ extern void *_mesa_dlist_alloc(struct gl_context *ctx, GLuint opcode, GLuint sz)
 extern GLint _mesa_dlist_alloc_opcode( struct gl_context *ctx, GLuint sz,
                                        void (*execute)( struct gl_context *, void * ),
                                        void (*destroy)( struct gl_context *, void * ),
-                                       void (*print)( struct gl_context *, void * ) );
+                                       void (*print)( struct gl_context *, void * ),
+                                       GLboolean (*merge)( struct gl_context *, void *, void * ) );
 
 extern void _mesa_delete_list(struct gl_context *ctx, struct gl_display_list *dlist);
 
@@ -41,6 +41,10 @@
 #include "../../gallium/auxiliary/util/u_format_rgb9e5.h"
 #include "../../gallium/auxiliary/util/u_format_r11g11b10f.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 
 /** Helper struct for MESA_FORMAT_Z32_FLOAT_X24S8 */
 struct z32f_x24s8
@@ -1162,6 +1166,12 @@ pack_float_RGBA_FLOAT32(const GLfloat src[4], void *dst)
    d[3] = src[3];
 }
 
+static void
+pack_row_float_RGBA_FLOAT32(GLuint n, const GLfloat src[][4], void *dst)
+{
+   memcpy(dst, src, n * 4 * sizeof(GLfloat));
+}
+
 
 /* MESA_FORMAT_RGBA_FLOAT16 */
 
@@ -1185,6 +1195,12 @@ pack_float_RGBA_FLOAT16(const GLfloat src[4], void *dst)
    d[3] = _mesa_float_to_half(src[3]);
 }
 
+static void
+pack_row_float_RGBA_FLOAT16(GLuint n, const GLfloat src[][4], void *dst)
+{
+   _mesa_float_to_half_array((GLhalfARB *) dst, &src[0][0], 4 * n);
+}
+
 
 /* MESA_FORMAT_RGB_FLOAT32 */
 
@@ -1957,6 +1973,186 @@ _mesa_get_pack_float_rgba_function(gl_format format)
 
 
 
+#if defined(__SSE2__)
+
+/*
+ * SSE2 versions of the row packers for the most common formats.  They
+ * store exactly what the C functions store, and handle whole groups of
+ * pixels only: each returns the number of pixels it packed and the C
+ * function does the rest of the row.
+ */
+
+
+/**
+ * Bit position of the R, G, B and A channels of a 32-bit format with
+ * 8 bits per channel, with -1 for an alpha channel that is stored as 0.
+ * \return GL_FALSE if \p format isn't one of those.
+ */
+static GLboolean
+get_8888_shifts(gl_format format, GLint shift[4])
+{
+   static const GLint shifts[6][4] = {
+      { 24, 16,  8,  0 },       /* RGBA8888, RGBX8888 */
+      {  0,  8, 16, 24 },       /* RGBA8888_REV, RGBX8888_REV */
+      { 16,  8,  0, 24 },       /* ARGB8888 */
+      {  8, 16, 24,  0 },       /* ARGB8888_REV */
+      { 16,  8,  0, -1 },       /* XRGB8888 */
+      {  8, 16, 24, -1 }        /* XRGB8888_REV */
+   };
+   GLuint i;
+
+   switch (format) {
+   case MESA_FORMAT_RGBA8888:
+   case MESA_FORMAT_RGBX8888:
+      i = 0;
+      break;
+   case MESA_FORMAT_RGBA8888_REV:
+   case MESA_FORMAT_RGBX8888_REV:
+      i = 1;
+      break;
+   case MESA_FORMAT_ARGB8888:
+      i = 2;
+      break;
+   case MESA_FORMAT_ARGB8888_REV:
+      i = 3;
+      break;
+   case MESA_FORMAT_XRGB8888:
+      i = 4;
+      break;
+   case MESA_FORMAT_XRGB8888_REV:
+      i = 5;
+      break;
+   default:
+      return GL_FALSE;
+   }
+
+   COPY_4V(shift, shifts[i]);
+   return GL_TRUE;
+}
+
+
+/**
+ * Move the channels of four pixels, given as vectors of 32-bit values in
+ * [0, 255], to their place in a 32-bit 8 bits per channel format.
+ */
+static inline __m128i
+place_8888_sse2(const __m128i v[4], const GLint shift[4])
+{
+   __m128i d = _mm_setzero_si128();
+   GLuint c;
+
+   for (c = 0; c < 4; c++) {
+      if (shift[c] >= 0)
+         d = _mm_or_si128(d, _mm_sll_epi32(v[c], _mm_cvtsi32_si128(shift[c])));
+   }
+
+   return d;
+}
+
+
+static GLuint
+pack_ubyte_8888_sse2(GLuint n, const GLubyte src[][4], GLuint *d,
+                     const GLint shift[4])
+{
+   const __m128i byteMask = _mm_set1_epi32(0xff);
+   GLuint i, c;
+
+   for (i = 0; i + 4 <= n; i += 4) {
+      const __m128i p = _mm_loadu_si128((const __m128i *) src[i]);
+      __m128i v[4];
+
+      for (c = 0; c < 4; c++) {
+         v[c] = _mm_and_si128(_mm_srl_epi32(p, _mm_cvtsi32_si128(8 * c)),
+                              byteMask);
+      }
+
+      _mm_storeu_si128((__m128i *) (d + i), place_8888_sse2(v, shift));
+   }
+
+   return i;
+}
+
+
+static GLuint
+pack_ubyte_rgba_row_sse2(gl_format format, GLuint n,
+                         const GLubyte src[][4], void *dst)
+{
+   GLint shift[4];
+
+   if (get_8888_shifts(format, shift))
+      return pack_ubyte_8888_sse2(n, src, (GLuint *) dst, shift);
+   else
+      return 0;
+}
+
+
+#ifdef IEEE_0996
+
+/**
+ * UNCLAMPED_FLOAT_TO_UBYTE() of four floats.
+ */
+static inline __m128i
+unclamped_float_to_ubyte_sse2(__m128 f)
+{
+   const __m128i bits = _mm_castps_si128(f);
+   const __m128i isNegative = _mm_cmplt_epi32(bits, _mm_setzero_si128());
+   const __m128i isOne = _mm_cmpgt_epi32(bits, _mm_set1_epi32(IEEE_0996 - 1));
+   const __m128i scaled = _mm_castps_si128(
+      _mm_add_ps(_mm_mul_ps(f, _mm_set1_ps(255.0F / 256.0F)),
+                 _mm_set1_ps(32768.0F)));
+   __m128i ub = _mm_and_si128(scaled, _mm_set1_epi32(0xff));
+
+   ub = _mm_andnot_si128(_mm_or_si128(isNegative, isOne), ub);
+   return _mm_or_si128(ub, _mm_and_si128(isOne, _mm_set1_epi32(0xff)));
+}
+
+
+static GLuint
+pack_float_8888_sse2(GLuint n, const GLfloat src[][4], GLuint *d,
+                     const GLint shift[4])
+{
+   GLuint i;
+
+   for (i = 0; i + 4 <= n; i += 4) {
+      __m128 r = _mm_loadu_ps(src[i + 0]);
+      __m128 g = _mm_loadu_ps(src[i + 1]);
+      __m128 b = _mm_loadu_ps(src[i + 2]);
+      __m128 a = _mm_loadu_ps(src[i + 3]);
+      __m128i v[4];
+
+      _MM_TRANSPOSE4_PS(r, g, b, a);
+      v[0] = unclamped_float_to_ubyte_sse2(r);
+      v[1] = unclamped_float_to_ubyte_sse2(g);
+      v[2] = unclamped_float_to_ubyte_sse2(b);
+      v[3] = unclamped_float_to_ubyte_sse2(a);
+
+      _mm_storeu_si128((__m128i *) (d + i), place_8888_sse2(v, shift));
+   }
+
+   return i;
+}
+
+#endif /* IEEE_0996 */
+
+
+static GLuint
+pack_float_rgba_row_sse2(gl_format format, GLuint n,
+                         const GLfloat src[][4], void *dst)
+{
+#ifdef IEEE_0996
+   GLint shift[4];
+
+   if (get_8888_shifts(format, shift))
+      return pack_float_8888_sse2(n, src, (GLuint *) dst, shift);
+#endif
+
+   return 0;
+}
+
+#endif /* __SSE2__ */
+
+
+
 static pack_float_rgba_row_func
 get_pack_float_rgba_row_function(gl_format format)
 {
@@ -1981,6 +2177,8 @@ get_pack_float_rgba_row_function(gl_format format)
       table[MESA_FORMAT_BGR888] = pack_row_float_BGR888;
       table[MESA_FORMAT_RGB565] = pack_row_float_RGB565;
       table[MESA_FORMAT_RGB565_REV] = pack_row_float_RGB565_REV;
+      table[MESA_FORMAT_RGBA_FLOAT32] = pack_row_float_RGBA_FLOAT32;
+      table[MESA_FORMAT_RGBA_FLOAT16] = pack_row_float_RGBA_FLOAT16;
 
       initialized = GL_TRUE;
    }
@@ -2032,6 +2230,12 @@ _mesa_pack_float_rgba_row(gl_format format, GLuint n,
 {
    pack_float_rgba_row_func packrow = get_pack_float_rgba_row_function(format);
    if (packrow) {
+#if defined(__SSE2__)
+      const GLuint done = pack_float_rgba_row_sse2(format, n, src, dst);
+      dst = (GLubyte *) dst + done * _mesa_get_format_bytes(format);
+      src += done;
+      n -= done;
+#endif
       /* use "fast" function */
       packrow(n, src, dst);
    }
@@ -2063,6 +2267,12 @@ _mesa_pack_ubyte_rgba_row(gl_format format, GLuint n,
 {
    pack_ubyte_rgba_row_func packrow = get_pack_ubyte_rgba_row_function(format);
    if (packrow) {
+#if defined(__SSE2__)
+      const GLuint done = pack_ubyte_rgba_row_sse2(format, n, src, dst);
+      dst = (GLubyte *) dst + done * _mesa_get_format_bytes(format);
+      src += done;
+      n -= done;
+#endif
       /* use "fast" function */
       packrow(n, src, dst);
    }
@@ -2103,12 +2313,14 @@ _mesa_pack_ubyte_rgba_rect(gl_format format, GLuint width, GLuint height,
       if (srcRowStride == width * 4 * sizeof(GLubyte) &&
           dstRowStride == _mesa_format_row_stride(format, width)) {
          /* do whole image at once */
-         packrow(width * height, (const GLubyte (*)[4]) src, dst);
+         _mesa_pack_ubyte_rgba_row(format, width * height,
+                                   (const GLubyte (*)[4]) src, dst);
       }
       else {
          /* row by row */
          for (i = 0; i < height; i++) {
-            packrow(width, (const GLubyte (*)[4]) src, dstUB);
+            _mesa_pack_ubyte_rgba_row(format, width,
+                                      (const GLubyte (*)[4]) src, dstUB);
             src += srcRowStride;
             dstUB += dstRowStride;
          }
@@ -28,6 +28,10 @@
 #include "../../gallium/auxiliary/util/u_format_rgb9e5.h"
 #include "../../gallium/auxiliary/util/u_format_r11g11b10f.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 
 /** Helper struct for MESA_FORMAT_Z32_FLOAT_X24S8 */
 struct z32f_x24s8
@@ -80,6 +84,274 @@ nonlinear_to_linear(GLubyte cs8)
 }
 
 
+#if defined(__SSE2__)
+
+/**********************************************************************/
+/*  SSE2 row kernels                                                  */
+/**********************************************************************/
+
+/*
+ * SSE2 versions of the row unpackers for the most common formats.  They
+ * return exactly what the C functions below return, and handle whole
+ * groups of pixels only: each returns the number of pixels it unpacked
+ * and the C function does the rest of the row.
+ */
+
+
+/**
+ * Bit position of the R, G, B and A channels of a 32-bit format with
+ * 8 bits per channel, with -1 for an alpha channel that isn't stored.
+ * \return GL_FALSE if \p format isn't one of those.
+ */
+static GLboolean
+get_8888_shifts(gl_format format, GLint shift[4])
+{
+   static const GLint shifts[8][4] = {
+      { 24, 16,  8,  0 },       /* RGBA8888 */
+      {  0,  8, 16, 24 },       /* RGBA8888_REV */
+      { 16,  8,  0, 24 },       /* ARGB8888 */
+      {  8, 16, 24,  0 },       /* ARGB8888_REV */
+      { 24, 16,  8, -1 },       /* RGBX8888 */
+      {  0,  8, 16, -1 },       /* RGBX8888_REV */
+      { 16,  8,  0, -1 },       /* XRGB8888 */
+      {  8, 16, 24, -1 }        /* XRGB8888_REV */
+   };
+   GLuint i;
+
+   switch (format) {
+   case MESA_FORMAT_RGBA8888:     i = 0; break;
+   case MESA_FORMAT_RGBA8888_REV: i = 1; break;
+   case MESA_FORMAT_ARGB8888:     i = 2; break;
+   case MESA_FORMAT_ARGB8888_REV: i = 3; break;
+   case MESA_FORMAT_RGBX8888:     i = 4; break;
+   case MESA_FORMAT_RGBX8888_REV: i = 5; break;
+   case MESA_FORMAT_XRGB8888:     i = 6; break;
+   case MESA_FORMAT_XRGB8888_REV: i = 7; break;
+   default:
+      return GL_FALSE;
+   }
+
+   COPY_4V(shift, shifts[i]);
+   return GL_TRUE;
+}
+
+
+/**
+ * Store four float pixels, given as vectors of their R, G, B and A values.
+ */
+static inline void
+store_float_rgba_sse2(GLfloat dst[][4], __m128 r, __m128 g, __m128 b,
+                      __m128 a)
+{
+   _MM_TRANSPOSE4_PS(r, g, b, a);
+   _mm_storeu_ps(dst[0], r);
+   _mm_storeu_ps(dst[1], g);
+   _mm_storeu_ps(dst[2], b);
+   _mm_storeu_ps(dst[3], a);
+}
+
+
+/**
+ * Unpack a 32-bit 8 bits per channel format to float.  Dividing by 255
+ * rounds the same way as the _mesa_ubyte_to_float_color_tab entries.
+ */
+static GLuint
+unpack_8888_sse2(const GLuint *s, GLfloat dst[][4], GLuint n,
+                 const GLint shift[4])
+{
+   const __m128i byteMask = _mm_set1_epi32(0xff);
+   const __m128 scale = _mm_set1_ps(255.0F);
+   GLuint i, c;
+
+   for (i = 0; i + 4 <= n; i += 4) {
+      const __m128i p = _mm_loadu_si128((const __m128i *) (s + i));
+      __m128 v[4];
+
+      for (c = 0; c < 4; c++) {
+         if (shift[c] < 0) {
+            v[c] = _mm_set1_ps(1.0F);
+         }
+         else {
+            const __m128i u =
+               _mm_and_si128(_mm_srl_epi32(p, _mm_cvtsi32_si128(shift[c])),
+                             byteMask);
+            v[c] = _mm_div_ps(_mm_cvtepi32_ps(u), scale);
+         }
+      }
+
+      store_float_rgba_sse2(dst + i, v[0], v[1], v[2], v[3]);
+   }
+
+   return i;
+}
+
+
+static GLuint
+unpack_RGB565_sse2(const GLushort *s, GLfloat dst[][4], GLuint n)
+{
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i mask5 = _mm_set1_epi32(0x1f);
+   const __m128i mask6 = _mm_set1_epi32(0x3f);
+   const __m128 scale5 = _mm_set1_ps(1.0F / 31.0F);
+   const __m128 scale6 = _mm_set1_ps(1.0F / 63.0F);
+   const __m128 one = _mm_set1_ps(1.0F);
+   GLuint i, h;
+
+   for (i = 0; i + 8 <= n; i += 8) {
+      const __m128i p8 = _mm_loadu_si128((const __m128i *) (s + i));
+
+      for (h = 0; h < 2; h++) {
+         const __m128i p = h ? _mm_unpackhi_epi16(p8, zero)
+                             : _mm_unpacklo_epi16(p8, zero);
+         const __m128i r = _mm_and_si128(_mm_srli_epi32(p, 11), mask5);
+         const __m128i g = _mm_and_si128(_mm_srli_epi32(p, 5), mask6);
+         const __m128i b = _mm_and_si128(p, mask5);
+
+         store_float_rgba_sse2(dst + i + 4 * h,
+                               _mm_mul_ps(_mm_cvtepi32_ps(r), scale5),
+                               _mm_mul_ps(_mm_cvtepi32_ps(g), scale6),
+                               _mm_mul_ps(_mm_cvtepi32_ps(b), scale5),
+                               one);
+      }
+   }
+
+   return i;
+}
+
+
+static GLuint
+unpack_rgba_row_sse2(gl_format format, GLuint n, const void *src,
+                     GLfloat dst[][4])
+{
+   GLint shift[4];
+
+   if (get_8888_shifts(format, shift))
+      return unpack_8888_sse2((const GLuint *) src, dst, n, shift);
+   else if (format == MESA_FORMAT_RGB565)
+      return unpack_RGB565_sse2((const GLushort *) src, dst, n);
+   else
+      return 0;
+}
+
+
+/**
+ * Unpack a 32-bit 8 bits per channel format to RGBA ubytes by moving each
+ * byte into place with shifts and masks.
+ */
+static GLuint
+unpack_ubyte_8888_sse2(const GLuint *s, GLubyte dst[][4], GLuint n,
+                       const GLint shift[4])
+{
+   const __m128i byteMask = _mm_set1_epi32(0xff);
+   GLuint i, c;
+
+   for (i = 0; i + 4 <= n; i += 4) {
+      const __m128i p = _mm_loadu_si128((const __m128i *) (s + i));
+      __m128i d = _mm_setzero_si128();
+
+      for (c = 0; c < 4; c++) {
+         __m128i u;
+
+         if (shift[c] < 0) {
+            u = byteMask;
+         }
+         else {
+            u = _mm_and_si128(_mm_srl_epi32(p, _mm_cvtsi32_si128(shift[c])),
+                              byteMask);
+         }
+         d = _mm_or_si128(d, _mm_sll_epi32(u, _mm_cvtsi32_si128(8 * c)));
+      }
+
+      _mm_storeu_si128((__m128i *) dst[i], d);
+   }
+
+   return i;
+}
+
+
+static GLuint
+unpack_ubyte_rgba_row_sse2(gl_format format, GLuint n, const void *src,
+                           GLubyte dst[][4])
+{
+   GLint shift[4];
+
+   if (get_8888_shifts(format, shift))
+      return unpack_ubyte_8888_sse2((const GLuint *) src, dst, n, shift);
+   else
+      return 0;
+}
+
+
+/**
+ * Unpack 24-bit Z values, found at bit \p shift of each 32-bit pixel.
+ * The scaling is done in double precision like the C code.
+ */
+static GLuint
+unpack_float_z_24_sse2(const GLuint *s, GLfloat *dst, GLuint n, GLint shift)
+{
+   const __m128i count = _mm_cvtsi32_si128(shift);
+   const __m128i mask = _mm_set1_epi32(0xffffff);
+   const __m128d scale = _mm_set1_pd(1.0 / (GLdouble) 0xffffff);
+   GLuint i;
+
+   for (i = 0; i + 4 <= n; i += 4) {
+      const __m128i z = _mm_and_si128(
+         _mm_srl_epi32(_mm_loadu_si128((const __m128i *) (s + i)), count),
+         mask);
+      const __m128 lo = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtepi32_pd(z), scale));
+      const __m128 hi = _mm_cvtpd_ps(
+         _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(z, 8)), scale));
+
+      _mm_storeu_ps(dst + i, _mm_movelh_ps(lo, hi));
+   }
+
+   return i;
+}
+
+
+static GLuint
+unpack_float_z_Z16_sse2(const GLushort *s, GLfloat *dst, GLuint n)
+{
+   const __m128i zero = _mm_setzero_si128();
+   const __m128 scale = _mm_set1_ps(1.0F / 65535.0F);
+   GLuint i;
+
+   for (i = 0; i + 8 <= n; i += 8) {
+      const __m128i z = _mm_loadu_si128((const __m128i *) (s + i));
+
+      _mm_storeu_ps(dst + i,
+                    _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(z, zero)),
+                               scale));
+      _mm_storeu_ps(dst + i + 4,
+                    _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(z, zero)),
+                               scale));
+   }
+
+   return i;
+}
+
+
+static GLuint
+unpack_float_z_row_sse2(gl_format format, GLuint n, const void *src,
+                        GLfloat *dst)
+{
+   switch (format) {
+   case MESA_FORMAT_Z24_S8:
+   case MESA_FORMAT_Z24_X8:
+      return unpack_float_z_24_sse2((const GLuint *) src, dst, n, 8);
+   case MESA_FORMAT_S8_Z24:
+   case MESA_FORMAT_X8_Z24:
+      return unpack_float_z_24_sse2((const GLuint *) src, dst, n, 0);
+   case MESA_FORMAT_Z16:
+      return unpack_float_z_Z16_sse2((const GLushort *) src, dst, n);
+   default:
+      return 0;
+   }
+}
+
+#endif /* __SSE2__ */
+
+
 /**********************************************************************/
 /*  Unpack, returning GLfloat colors                                  */
 /**********************************************************************/
@@ -855,27 +1127,13 @@ unpack_RGBA_DXT5(const void *src, GLfloat dst[][4], GLuint n)
 static void
 unpack_RGBA_FLOAT32(const void *src, GLfloat dst[][4], GLuint n)
 {
-   const GLfloat *s = (const GLfloat *) src;
-   GLuint i;
-   for (i = 0; i < n; i++) {
-      dst[i][RCOMP] = s[i*4+0];
-      dst[i][GCOMP] = s[i*4+1];
-      dst[i][BCOMP] = s[i*4+2];
-      dst[i][ACOMP] = s[i*4+3];
-   }
+   memcpy(dst, src, n * 4 * sizeof(GLfloat));
 }
 
 static void
 unpack_RGBA_FLOAT16(const void *src, GLfloat dst[][4], GLuint n)
 {
-   const GLhalfARB *s = (const GLhalfARB *) src;
-   GLuint i;
-   for (i = 0; i < n; i++) {
-      dst[i][RCOMP] = _mesa_half_to_float(s[i*4+0]);
-      dst[i][GCOMP] = _mesa_half_to_float(s[i*4+1]);
-      dst[i][BCOMP] = _mesa_half_to_float(s[i*4+2]);
-      dst[i][ACOMP] = _mesa_half_to_float(s[i*4+3]);
-   }
+   _mesa_half_to_float_array(&dst[0][0], (const GLhalfARB *) src, 4 * n);
 }
 
 static void
@@ -1621,6 +1879,16 @@ _mesa_unpack_rgba_row(gl_format format, GLuint n,
                       const void *src, GLfloat dst[][4])
 {
    unpack_rgba_func unpack = get_unpack_rgba_function(format);
+
+#if defined(__SSE2__)
+   if (unpack) {
+      const GLuint done = unpack_rgba_row_sse2(format, n, src, dst);
+      src = (const GLubyte *) src + done * _mesa_get_format_bytes(format);
+      dst += done;
+      n -= done;
+   }
+#endif
+
    unpack(src, dst, n);
 }
 
@@ -1993,6 +2261,13 @@ void
 _mesa_unpack_ubyte_rgba_row(gl_format format, GLuint n,
                             const void *src, GLubyte dst[][4])
 {
+#if defined(__SSE2__)
+   const GLuint done = unpack_ubyte_rgba_row_sse2(format, n, src, dst);
+   src = (const GLubyte *) src + done * _mesa_get_format_bytes(format);
+   dst += done;
+   n -= done;
+#endif
+
    switch (format) {
    case MESA_FORMAT_RGBA8888:
       unpack_ubyte_RGBA8888(src, dst, n);
@@ -2951,6 +3226,15 @@ _mesa_unpack_float_z_row(gl_format format, GLuint n,
       return;
    }
 
+#if defined(__SSE2__)
+   {
+      const GLuint done = unpack_float_z_row_sse2(format, n, src, dst);
+      src = (const GLubyte *) src + done * _mesa_get_format_bytes(format);
+      dst += done;
+      n -= done;
+   }
+#endif
+
    unpack(n, src, dst);
 }
 
@@ -3,7 +3,8 @@
  * Generic hash table. 
  *
  * Used for display lists, texture objects, vertex/fragment programs,
- * buffer objects, etc.  The hash functions are thread-safe.
+ * buffer objects, etc.  The hash functions are thread-safe.  Lookups of
+ * small keys don't take the table's lock.
  * 
  * \note key=0 is illegal.
  *
@@ -53,6 +54,49 @@
  */
 #define DELETED_KEY_VALUE 1
 
+/**
+ * Keys below this are also kept in a directly indexed array, which
+ * _mesa_HashLookup() reads without taking the table's mutex.
+ *
+ * glGen*() hands out small consecutive names, so in practice this covers
+ * every object an application creates.  The array grows by doubling up to
+ * this many entries as keys are inserted.
+ */
+#define DENSE_MAX_KEYS (64 * 1024)
+
+/** Smallest dense array that gets allocated */
+#define DENSE_MIN_KEYS 64
+
+/**
+ * Readers of the dense array need the entries of a newly published array to
+ * be visible before the pointer to it.  That takes a store barrier on the
+ * writer's side.  Loads through the pointer depend on it, which orders them
+ * on every CPU we run on.  Without a way to emit the barrier, lookups always
+ * take the mutex.
+ */
+#if defined(__GNUC__)
+#define HASH_LOCK_FREE 1
+#define HASH_WRITE_BARRIER() __sync_synchronize()
+#else
+#define HASH_LOCK_FREE 0
+#define HASH_WRITE_BARRIER()
+#endif
+
+/**
+ * Directly indexed copy of the entries with keys below \c Size
+ *
+ * An array is never changed in size once published.  When it needs to grow,
+ * a larger copy replaces it and the old one is kept until the table is
+ * deleted, since a reader may still be looking at it.  Because the arrays
+ * double in size, the retired ones never take more memory than the current
+ * one.
+ */
+struct dense_array {
+   GLuint Size;
+   struct dense_array *Retired;          /**< Previous, smaller array */
+   void *volatile Entries[1];            /**< Size entries */
+};
+
 /**
  * The hash table data structure.  
  */
@@ -64,6 +108,15 @@ struct _mesa_HashTable {
    GLboolean InDeleteAll;                /**< Debug check */
    /** Value that would be in the table for DELETED_KEY_VALUE. */
    void *deleted_key_data;
+
+   /**
+    * Copy of the entries with small keys, for lock-free lookups
+    *
+    * Every key below \c Dense->Size that is in the table is also in the
+    * array, and the entries for all other keys below \c Dense->Size are
+    * NULL.  Only changed while holding \c Mutex.
+    */
+   struct dense_array *volatile Dense;
 };
 
 /** @{
@@ -104,6 +157,61 @@ uint_key(GLuint id)
 }
 /** @} */
 
+/**
+ * Make sure the dense array covers \c key, if it is small enough to be kept
+ * there.  Called with the table's mutex held.
+ *
+ * \return the dense array if it covers \c key, or NULL.
+ */
+static struct dense_array *
+dense_array_reserve(struct _mesa_HashTable *table, GLuint key)
+{
+   struct dense_array *old = table->Dense;
+   struct dense_array *dense;
+   GLuint size, i;
+
+   if (old && key < old->Size)
+      return old;
+
+   if (key >= DENSE_MAX_KEYS)
+      return NULL;
+
+   size = old ? old->Size : DENSE_MIN_KEYS;
+   while (size <= key)
+      size *= 2;
+
+   dense = malloc(sizeof(struct dense_array)
+                  + (size - 1) * sizeof(dense->Entries[0]));
+   if (!dense)
+      return NULL;
+
+   dense->Size = size;
+   dense->Retired = old;
+   for (i = 0; i < size; i++)
+      dense->Entries[i] = (old && i < old->Size) ? old->Entries[i] : NULL;
+
+   /* The entries have to be in place before readers can find the array. */
+   HASH_WRITE_BARRIER();
+   table->Dense = dense;
+
+   return dense;
+}
+
+
+/**
+ * Set the dense array's entry for \c key, if it has one.  Called with the
+ * table's mutex held.
+ */
+static inline void
+dense_array_set(struct _mesa_HashTable *table, GLuint key, void *data)
+{
+   struct dense_array *dense = table->Dense;
+
+   if (dense && key < dense->Size)
+      dense->Entries[key] = data;
+}
+
+
 /**
  * Create a new hash table.
  * 
@@ -144,6 +252,12 @@ _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 
    _mesa_hash_table_destroy(table->ht, NULL);
 
+   while (table->Dense) {
+      struct dense_array *dense = table->Dense;
+      table->Dense = dense->Retired;
+      free(dense);
+   }
+
    _glthread_DESTROY_MUTEX(table->Mutex);
    _glthread_DESTROY_MUTEX(table->WalkMutex);
    free(table);
@@ -177,6 +291,9 @@ _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
 /**
  * Lookup an entry in the hash table.
  * 
+ * Small keys are looked up in the dense array without locking, so that
+ * contexts binding objects on several threads don't contend for the mutex.
+ *
  * \param table the hash table.
  * \param key the key.
  * 
@@ -187,6 +304,16 @@ _mesa_HashLookup(struct _mesa_HashTable *table, GLuint key)
 {
    void *res;
    assert(table);
+   assert(key);
+
+#if HASH_LOCK_FREE
+   {
+      const struct dense_array *dense = table->Dense;
+      if (dense && key < dense->Size)
+         return dense->Entries[key];
+   }
+#endif
+
    _glthread_LOCK_MUTEX(table->Mutex);
    res = _mesa_HashLookup_unlocked(table, key);
    _glthread_UNLOCK_MUTEX(table->Mutex);
@@ -227,6 +354,9 @@ _mesa_HashInsert(struct _mesa_HashTable *table, GLuint key, void *data)
       }
    }
 
+   dense_array_reserve(table, key);
+   dense_array_set(table, key, data);
+
    _glthread_UNLOCK_MUTEX(table->Mutex);
 }
 
@@ -263,6 +393,7 @@ _mesa_HashRemove(struct _mesa_HashTable *table, GLuint key)
       entry = _mesa_hash_table_search(table->ht, uint_hash(key), uint_key(key));
       _mesa_hash_table_remove(table->ht, entry);
    }
+   dense_array_set(table, key, NULL);
    _glthread_UNLOCK_MUTEX(table->Mutex);
 }
 
@@ -289,10 +420,12 @@ _mesa_HashDeleteAll(struct _mesa_HashTable *table,
    _glthread_LOCK_MUTEX(table->Mutex);
    table->InDeleteAll = GL_TRUE;
    hash_table_foreach(table->ht, entry) {
+      dense_array_set(table, (uintptr_t)entry->key, NULL);
       callback((uintptr_t)entry->key, entry->data, userData);
       _mesa_hash_table_remove(table->ht, entry);
    }
    if (table->deleted_key_data) {
+      dense_array_set(table, DELETED_KEY_VALUE, NULL);
       callback(DELETED_KEY_VALUE, table->deleted_key_data, userData);
       table->deleted_key_data = NULL;
    }
@@ -46,6 +46,8 @@
 
 #include "imports.h"
 #include "context.h"
+#include "cpuinfo.h"
+#include "macros.h"
 #include "mtypes.h"
 #include "version.h"
 
@@ -56,6 +58,15 @@
 #endif
 #endif
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
 
 #ifdef _WIN32
 #define vsnprintf _vsnprintf
@@ -453,6 +464,240 @@ _mesa_half_to_float(GLhalfARB val)
    return result;
 }
 
+
+/**
+ * Convert \p n floats to half floats, with the same results as
+ * _mesa_float_to_half().
+ */
+void
+_mesa_float_to_half_array(GLhalfARB *dst, const GLfloat *src, GLuint n)
+{
+   GLuint i = 0;
+
+#if defined(USE_X86_64_ASM)
+   if (cpu_has_f16c)
+      i = _mesa_x86_64_f16c_float_to_half(dst, src, n);
+#endif
+
+#if defined(__SSE2__)
+   const __m128i absMask = _mm_set1_epi32(0x7fffffff);
+   const __m128i minNormal = _mm_set1_epi32(0x38800000); /* 2^-14 */
+   const __m128i maxFinite = _mm_set1_epi32(0x477fffff);
+   const __m128i infinity = _mm_set1_epi32(0x7f800000);
+   const __m128i expBias = _mm_set1_epi32(0x38000000); /* 127 - 15 */
+   const __m128 denormScale = _mm_set1_ps(16777216.0f); /* 2^24 */
+
+   for (; i + 8 <= n; i += 8) {
+      __m128i h[2];
+      GLuint k;
+
+      for (k = 0; k < 2; k++) {
+         const __m128i f = _mm_castps_si128(_mm_loadu_ps(src + i + 4 * k));
+         const __m128i a = _mm_and_si128(f, absMask);
+         const __m128i sign = _mm_srli_epi32(_mm_andnot_si128(absMask, f), 16);
+         /* Results below 2^-14 are half denormals, truncated like the
+          * mantissa of normal results.  Float denormals become zero.
+          */
+         const __m128i denorm =
+            _mm_cvttps_epi32(_mm_mul_ps(_mm_castsi128_ps(a), denormScale));
+         const __m128i normal = _mm_srli_epi32(_mm_sub_epi32(a, expBias), 13);
+         const __m128i isDenorm = _mm_cmplt_epi32(a, minNormal);
+         const __m128i isInf = _mm_cmpgt_epi32(a, maxFinite);
+         const __m128i isNaN = _mm_cmpgt_epi32(a, infinity);
+         __m128i r;
+
+         r = _mm_or_si128(_mm_and_si128(isDenorm, denorm),
+                          _mm_andnot_si128(isDenorm, normal));
+         r = _mm_or_si128(_mm_andnot_si128(isInf, r),
+                          _mm_and_si128(isInf, _mm_set1_epi32(0x7c00)));
+         r = _mm_or_si128(r, _mm_and_si128(isNaN, _mm_set1_epi32(1)));
+         r = _mm_or_si128(r, sign);
+
+         /* sign extend, so that packing doesn't saturate */
+         h[k] = _mm_srai_epi32(_mm_slli_epi32(r, 16), 16);
+      }
+
+      _mm_storeu_si128((__m128i *) (dst + i), _mm_packs_epi32(h[0], h[1]));
+   }
+#endif
+
+   for (; i < n; i++)
+      dst[i] = _mesa_float_to_half(src[i]);
+}
+
+
+/**
+ * Convert \p n half floats to floats, with the same results as
+ * _mesa_half_to_float().
+ */
+void
+_mesa_half_to_float_array(GLfloat *dst, const GLhalfARB *src, GLuint n)
+{
+   GLuint i = 0;
+
+#if defined(__SSE2__)
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i expMask = _mm_set1_epi32(0x7c00);
+   const __m128i mantMask = _mm_set1_epi32(0x03ff);
+   const __m128i signMask = _mm_set1_epi32(0x8000);
+   const __m128i expBias = _mm_set1_epi32(112 << 23); /* 127 - 15 */
+   const __m128i nan = _mm_set1_epi32(0x7f800001);
+   const __m128i infinity = _mm_set1_epi32(0x7f800000);
+   const __m128 denormScale = _mm_set1_ps(1.0f / 16777216.0f); /* 2^-24 */
+
+   for (; i + 8 <= n; i += 8) {
+      const __m128i h8 = _mm_loadu_si128((const __m128i *) (src + i));
+      __m128i h[2];
+      GLuint k;
+
+      h[0] = _mm_unpacklo_epi16(h8, zero);
+      h[1] = _mm_unpackhi_epi16(h8, zero);
+
+      for (k = 0; k < 2; k++) {
+         const __m128i e = _mm_and_si128(h[k], expMask);
+         const __m128i m = _mm_and_si128(h[k], mantMask);
+         const __m128i sign = _mm_slli_epi32(_mm_and_si128(h[k], signMask), 16);
+         const __m128i isDenorm = _mm_cmpeq_epi32(e, zero);
+         const __m128i isSpecial = _mm_cmpeq_epi32(e, expMask);
+         const __m128i isNaN =
+            _mm_andnot_si128(_mm_cmpeq_epi32(m, zero), isSpecial);
+         /* zeros and denormals are exact multiples of 2^-24 */
+         const __m128i denorm = _mm_castps_si128(
+            _mm_mul_ps(_mm_cvtepi32_ps(m), denormScale));
+         const __m128i normal = _mm_add_epi32(
+            _mm_slli_epi32(_mm_or_si128(e, m), 13), expBias);
+         __m128i r;
+
+         r = _mm_or_si128(_mm_and_si128(isDenorm, denorm),
+                          _mm_andnot_si128(isDenorm, normal));
+         r = _mm_or_si128(_mm_andnot_si128(isSpecial, r),
+                          _mm_and_si128(isSpecial,
+                                        _mm_or_si128(_mm_and_si128(isNaN, nan),
+                                                     _mm_andnot_si128(isNaN,
+                                                                      infinity))));
+         r = _mm_or_si128(r, sign);
+
+         _mm_storeu_ps(dst + i + 4 * k, _mm_castsi128_ps(r));
+      }
+   }
+#endif
+
+   for (; i < n; i++)
+      dst[i] = _mesa_half_to_float(src[i]);
+}
+
+/*@}*/
+
+
+/**********************************************************************/
+/** \name Threads */
+/*@{*/
+
+#ifdef HAVE_PTHREAD
+
+/** One range of items of a _mesa_parallel_for() */
+struct parallel_range
+{
+   _mesa_range_func func;
+   void *data;
+   GLuint first, end;
+};
+
+
+static void *
+parallel_range_thread(void *data)
+{
+   const struct parallel_range *range = (const struct parallel_range *) data;
+
+   range->func(range->data, range->first, range->end);
+   return NULL;
+}
+
+#endif /* HAVE_PTHREAD */
+
+
+/**
+ * Number of threads to split large CPU-side texture work and tiled
+ * rasterization over: the number of CPUs, or MESA_TEXTURE_THREADS if set,
+ * at most MESA_MAX_THREADS.
+ */
+GLuint
+_mesa_num_threads(void)
+{
+#ifdef HAVE_PTHREAD
+   static GLint threads = -1;
+
+   if (threads < 0) {
+      const char *env = _mesa_getenv("MESA_TEXTURE_THREADS");
+      GLint n = 1;
+
+      if (env)
+         n = atoi(env);
+#ifdef _SC_NPROCESSORS_ONLN
+      else
+         n = (GLint) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+      threads = CLAMP(n, 1, MESA_MAX_THREADS);
+   }
+
+   return threads;
+#else
+   return 1;
+#endif
+}
+
+
+/**
+ * Call \p func for \p numRanges consecutive ranges of the items
+ * [0, \p count), each on a thread of its own.  The first range is done by
+ * the calling thread, as is any range whose thread can't be started.
+ * Returns once all the ranges are done.
+ */
+void
+_mesa_parallel_for(GLuint count, GLuint numRanges,
+                   _mesa_range_func func, void *data)
+{
+#ifdef HAVE_PTHREAD
+   struct parallel_range ranges[MESA_MAX_THREADS];
+   pthread_t threads[MESA_MAX_THREADS];
+   GLboolean started[MESA_MAX_THREADS];
+   GLuint i, first = 0;
+
+   numRanges = MIN3(numRanges, count, MESA_MAX_THREADS);
+   if (numRanges > 1) {
+      for (i = 0; i < numRanges; i++) {
+         const GLuint items = (count - first) / (numRanges - i);
+
+         ranges[i].func = func;
+         ranges[i].data = data;
+         ranges[i].first = first;
+         ranges[i].end = first + items;
+         first += items;
+      }
+
+      for (i = 1; i < numRanges; i++) {
+         started[i] = pthread_create(&threads[i], NULL, parallel_range_thread,
+                                     &ranges[i]) == 0;
+      }
+
+      func(data, ranges[0].first, ranges[0].end);
+
+      for (i = 1; i < numRanges; i++) {
+         if (started[i])
+            pthread_join(threads[i], NULL);
+         else
+            func(data, ranges[i].first, ranges[i].end);
+      }
+      return;
+   }
+#else
+   (void) numRanges;
+#endif
+
+   if (count > 0)
+      func(data, 0, count);
+}
+
 /*@}*/
 
 
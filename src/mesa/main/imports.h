@@ -554,6 +554,28 @@ _mesa_float_to_half(float f);
 extern float
 _mesa_half_to_float(GLhalfARB h);
 
+extern void
+_mesa_float_to_half_array(GLhalfARB *dst, const GLfloat *src, GLuint n);
+
+extern void
+_mesa_half_to_float_array(GLfloat *dst, const GLhalfARB *src, GLuint n);
+
+
+/** Most threads _mesa_parallel_for() runs on, the caller's included */
+#define MESA_MAX_THREADS 8
+
+/**
+ * Work done by _mesa_parallel_for() for the items [first, end)
+ */
+typedef void (*_mesa_range_func)(void *data, GLuint first, GLuint end);
+
+extern GLuint
+_mesa_num_threads(void);
+
+extern void
+_mesa_parallel_for(GLuint count, GLuint numRanges,
+                   _mesa_range_func func, void *data);
+
 
 extern void *
 _mesa_bsearch( const void *key, const void *base, size_t nmemb, size_t size, 
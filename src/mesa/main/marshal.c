@@ -0,0 +1,676 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2012 The Mesa Authors   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+ * AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * \file marshal.c
+ * The marshalling thread, and the GL functions that can't be marshalled by
+ * generated code because the application's thread has to track what they
+ * do (see the "custom" functions in the API XML).
+ */
+
+
+#include "glheader.h"
+#include "imports.h"
+#include "context.h"
+#include "dispatch.h"
+#include "hash.h"
+#include "marshal.h"
+#include "mtypes.h"
+#include "glapi/glapi.h"
+
+
+#ifdef HAVE_PTHREAD
+
+/**
+ * Execute all the commands in a batch.
+ */
+static void
+execute_batch(struct gl_context *ctx, struct glthread_batch *batch)
+{
+   size_t pos = 0;
+
+   while (pos < batch->used) {
+      const struct marshal_cmd_base *cmd = (const struct marshal_cmd_base *)
+         ((const char *) batch->buffer + pos);
+
+      _mesa_unmarshal_dispatch_cmd(ctx, cmd);
+      pos += cmd->cmd_size;
+   }
+
+   batch->used = 0;
+}
+
+
+static void *
+glthread_worker(void *data)
+{
+   struct gl_context *ctx = (struct gl_context *) data;
+   struct glthread_state *glthread = ctx->GLThread;
+
+   _glapi_set_context(ctx);
+   _glapi_set_dispatch(ctx->CurrentDispatch);
+
+   pthread_mutex_lock(&glthread->mutex);
+   for (;;) {
+      struct glthread_batch *batch;
+
+      while (glthread->executed == glthread->submitted && !glthread->shutdown)
+         pthread_cond_wait(&glthread->new_work, &glthread->mutex);
+
+      if (glthread->executed == glthread->submitted)
+         break; /* shutdown, and nothing left to do */
+
+      batch = &glthread->batches[glthread->executed % MARSHAL_MAX_BATCHES];
+
+      pthread_mutex_unlock(&glthread->mutex);
+      execute_batch(ctx, batch);
+      pthread_mutex_lock(&glthread->mutex);
+
+      glthread->executed++;
+      pthread_cond_broadcast(&glthread->work_done);
+   }
+   pthread_mutex_unlock(&glthread->mutex);
+
+   return NULL;
+}
+
+
+static void
+free_vao_cb(GLuint key, void *data, void *userData)
+{
+   (void) key;
+   (void) userData;
+   free(data);
+}
+
+
+/**
+ * Start running the context's GL calls on a thread of its own.
+ */
+void
+_mesa_glthread_init(struct gl_context *ctx)
+{
+   struct glthread_state *glthread;
+
+   if (ctx->GLThread)
+      return;
+
+   glthread = CALLOC_STRUCT(glthread_state);
+   if (!glthread)
+      return;
+
+   ctx->MarshalExec = _mesa_create_marshal_table(ctx);
+   glthread->VAOs = _mesa_NewHashTable();
+   if (!ctx->MarshalExec || !glthread->VAOs) {
+      free(ctx->MarshalExec);
+      ctx->MarshalExec = NULL;
+      if (glthread->VAOs)
+         _mesa_DeleteHashTable(glthread->VAOs);
+      free(glthread);
+      return;
+   }
+
+   glthread->batch = &glthread->batches[0];
+   glthread->CurrentVAO = &glthread->DefaultVAO;
+
+   pthread_mutex_init(&glthread->mutex, NULL);
+   pthread_cond_init(&glthread->new_work, NULL);
+   pthread_cond_init(&glthread->work_done, NULL);
+
+   ctx->GLThread = glthread;
+
+   if (pthread_create(&glthread->thread, NULL, glthread_worker, ctx) != 0) {
+      ctx->GLThread = NULL;
+      pthread_cond_destroy(&glthread->work_done);
+      pthread_cond_destroy(&glthread->new_work);
+      pthread_mutex_destroy(&glthread->mutex);
+      _mesa_DeleteHashTable(glthread->VAOs);
+      free(ctx->MarshalExec);
+      ctx->MarshalExec = NULL;
+      free(glthread);
+      return;
+   }
+
+   if (_glapi_get_context() == ctx)
+      _glapi_set_dispatch(ctx->MarshalExec);
+}
+
+
+/**
+ * Execute the pending calls and stop the context's thread.
+ */
+void
+_mesa_glthread_destroy(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!glthread)
+      return;
+
+   _mesa_glthread_flush_batch(ctx);
+
+   pthread_mutex_lock(&glthread->mutex);
+   glthread->shutdown = GL_TRUE;
+   pthread_cond_signal(&glthread->new_work);
+   pthread_mutex_unlock(&glthread->mutex);
+
+   pthread_join(glthread->thread, NULL);
+
+   pthread_cond_destroy(&glthread->work_done);
+   pthread_cond_destroy(&glthread->new_work);
+   pthread_mutex_destroy(&glthread->mutex);
+
+   _mesa_HashDeleteAll(glthread->VAOs, free_vao_cb, NULL);
+   _mesa_DeleteHashTable(glthread->VAOs);
+
+   ctx->GLThread = NULL;
+   free(glthread);
+
+   if (_glapi_get_context() == ctx)
+      _glapi_set_dispatch(ctx->CurrentDispatch);
+
+   free(ctx->MarshalExec);
+   ctx->MarshalExec = NULL;
+}
+
+
+/**
+ * Hand the current batch over to the context's thread, and start filling
+ * the next one once the thread is done with it.
+ */
+void
+_mesa_glthread_flush_batch(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!glthread || glthread->batch->used == 0)
+      return;
+
+   pthread_mutex_lock(&glthread->mutex);
+   glthread->submitted++;
+   pthread_cond_signal(&glthread->new_work);
+
+   while (glthread->submitted - glthread->executed == MARSHAL_MAX_BATCHES)
+      pthread_cond_wait(&glthread->work_done, &glthread->mutex);
+   pthread_mutex_unlock(&glthread->mutex);
+
+   glthread->batch =
+      &glthread->batches[glthread->submitted % MARSHAL_MAX_BATCHES];
+}
+
+
+/**
+ * Wait until the context's thread has executed every call made so far.
+ */
+void
+_mesa_glthread_finish(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!glthread)
+      return;
+
+   /* The driver may flush from the context's own thread. */
+   if (pthread_equal(pthread_self(), glthread->thread))
+      return;
+
+   _mesa_glthread_flush_batch(ctx);
+
+   pthread_mutex_lock(&glthread->mutex);
+   while (glthread->executed != glthread->submitted)
+      pthread_cond_wait(&glthread->work_done, &glthread->mutex);
+   pthread_mutex_unlock(&glthread->mutex);
+}
+
+#else /* HAVE_PTHREAD */
+
+void
+_mesa_glthread_init(struct gl_context *ctx)
+{
+   (void) ctx;
+}
+
+void
+_mesa_glthread_destroy(struct gl_context *ctx)
+{
+   (void) ctx;
+}
+
+void
+_mesa_glthread_flush_batch(struct gl_context *ctx)
+{
+   (void) ctx;
+}
+
+void
+_mesa_glthread_finish(struct gl_context *ctx)
+{
+   (void) ctx;
+}
+
+#endif /* HAVE_PTHREAD */
+
+
+/**
+ * Called before a call that has to be executed on the application's
+ * thread.  The call is made through ctx->CurrentDispatch, which is also
+ * what any GL call made by the driver from the same thread will find.
+ */
+void
+_mesa_glthread_begin_sync(struct gl_context *ctx)
+{
+   _mesa_glthread_finish(ctx);
+   _glapi_set_dispatch(ctx->CurrentDispatch);
+}
+
+
+void
+_mesa_glthread_end_sync(struct gl_context *ctx)
+{
+   _glapi_set_dispatch(ctx->MarshalExec);
+}
+
+
+/**
+ * Can a draw call be deferred?  It can't when vertex arrays or, for
+ * \p indexed draws, indices come from client memory, since the application
+ * is free to change that memory once the call returns.
+ */
+GLboolean
+_mesa_glthread_arrays_in_vbos(struct gl_context *ctx, GLboolean indexed)
+{
+   const struct glthread_vao *vao = ctx->GLThread->CurrentVAO;
+
+   return !vao->ClientArrays && (!indexed || vao->ElementBuffer != 0);
+}
+
+
+/**
+ * Called when a vertex array pointer is set.
+ */
+void
+_mesa_glthread_array_pointer(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (glthread->ArrayBuffer == 0)
+      glthread->CurrentVAO->ClientArrays = GL_TRUE;
+}
+
+
+static void
+bind_vao(struct glthread_state *glthread, GLuint name)
+{
+   struct glthread_vao *vao;
+
+   if (name == 0) {
+      vao = &glthread->DefaultVAO;
+   }
+   else {
+      vao = _mesa_HashLookup(glthread->VAOs, name);
+      if (!vao) {
+         vao = CALLOC_STRUCT(glthread_vao);
+         if (!vao) {
+            /* Assume the worst about the arrays of this object */
+            vao = &glthread->DefaultVAO;
+            vao->ClientArrays = GL_TRUE;
+         }
+         else {
+            _mesa_HashInsert(glthread->VAOs, name, vao);
+         }
+      }
+   }
+
+   glthread->CurrentVAOName = name;
+   glthread->CurrentVAO = vao;
+}
+
+
+/* BindBuffer: marshalled asynchronously */
+struct marshal_cmd_BindBuffer
+{
+   struct marshal_cmd_base cmd_base;
+   GLenum target;
+   GLuint buffer;
+};
+
+void
+_mesa_unmarshal_BindBuffer(struct gl_context *ctx,
+                           const struct marshal_cmd_BindBuffer *cmd)
+{
+   CALL_BindBuffer(ctx->CurrentDispatch, (cmd->target, cmd->buffer));
+}
+
+void GLAPIENTRY
+_mesa_marshal_BindBuffer(GLenum target, GLuint buffer)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct glthread_state *glthread = ctx->GLThread;
+   struct marshal_cmd_BindBuffer *cmd;
+
+   switch (target) {
+   case GL_ARRAY_BUFFER:
+      glthread->ArrayBuffer = buffer;
+      break;
+   case GL_ELEMENT_ARRAY_BUFFER:
+      glthread->CurrentVAO->ElementBuffer = buffer;
+      break;
+   case GL_PIXEL_UNPACK_BUFFER:
+      glthread->PixelUnpackBuffer = buffer;
+      break;
+   }
+
+   cmd = _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_BindBuffer,
+                                         sizeof(*cmd));
+   cmd->target = target;
+   cmd->buffer = buffer;
+}
+
+
+/* DeleteBuffers: marshalled asynchronously */
+struct marshal_cmd_DeleteBuffers
+{
+   struct marshal_cmd_base cmd_base;
+   GLsizei n;
+   /* Followed by GLuint buffer[n] */
+};
+
+void
+_mesa_unmarshal_DeleteBuffers(struct gl_context *ctx,
+                              const struct marshal_cmd_DeleteBuffers *cmd)
+{
+   const GLuint *buffer = (const GLuint *) (cmd + 1);
+
+   CALL_DeleteBuffers(ctx->CurrentDispatch, (cmd->n, buffer));
+}
+
+void GLAPIENTRY
+_mesa_marshal_DeleteBuffers(GLsizei n, const GLuint *buffer)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct glthread_state *glthread = ctx->GLThread;
+   int buffer_size = _mesa_glthread_array_size(n, sizeof(GLuint));
+   size_t cmd_size = sizeof(struct marshal_cmd_DeleteBuffers) + buffer_size;
+   struct marshal_cmd_DeleteBuffers *cmd;
+   GLsizei i;
+   GLuint j;
+
+   if (buffer_size < 0 || (buffer_size > 0 && !buffer) ||
+       cmd_size > MARSHAL_MAX_CMD_SIZE) {
+      _mesa_glthread_begin_sync(ctx);
+      CALL_DeleteBuffers(ctx->CurrentDispatch, (n, buffer));
+      _mesa_glthread_end_sync(ctx);
+   }
+   else {
+      cmd = _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_DeleteBuffers,
+                                            cmd_size);
+      cmd->n = n;
+      memcpy(cmd + 1, buffer, buffer_size);
+   }
+
+   if (buffer_size <= 0 || !buffer)
+      return;
+
+   /* Deleting a buffer unbinds it, from the current VAO only. */
+   for (i = 0; i < n; i++) {
+      if (buffer[i] == 0)
+         continue;
+      if (glthread->ArrayBuffer == buffer[i])
+         glthread->ArrayBuffer = 0;
+      if (glthread->CurrentVAO->ElementBuffer == buffer[i])
+         glthread->CurrentVAO->ElementBuffer = 0;
+      if (glthread->PixelUnpackBuffer == buffer[i])
+         glthread->PixelUnpackBuffer = 0;
+      for (j = 0; j < glthread->ClientAttribStackDepth; j++) {
+         if (glthread->ClientAttribStack[j].ArrayBuffer == buffer[i])
+            glthread->ClientAttribStack[j].ArrayBuffer = 0;
+         if (glthread->ClientAttribStack[j].PixelUnpackBuffer == buffer[i])
+            glthread->ClientAttribStack[j].PixelUnpackBuffer = 0;
+      }
+   }
+}
+
+
+/* BindVertexArray: marshalled asynchronously */
+struct marshal_cmd_BindVertexArray
+{
+   struct marshal_cmd_base cmd_base;
+   GLuint array;
+};
+
+void
+_mesa_unmarshal_BindVertexArray(struct gl_context *ctx,
+                                const struct marshal_cmd_BindVertexArray *cmd)
+{
+   CALL_BindVertexArray(ctx->CurrentDispatch, (cmd->array));
+}
+
+void GLAPIENTRY
+_mesa_marshal_BindVertexArray(GLuint array)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct marshal_cmd_BindVertexArray *cmd;
+
+   bind_vao(ctx->GLThread, array);
+
+   cmd = _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_BindVertexArray,
+                                         sizeof(*cmd));
+   cmd->array = array;
+}
+
+
+/* BindVertexArrayAPPLE: marshalled asynchronously */
+struct marshal_cmd_BindVertexArrayAPPLE
+{
+   struct marshal_cmd_base cmd_base;
+   GLuint array;
+};
+
+void
+_mesa_unmarshal_BindVertexArrayAPPLE(struct gl_context *ctx,
+                                     const struct marshal_cmd_BindVertexArrayAPPLE *cmd)
+{
+   CALL_BindVertexArrayAPPLE(ctx->CurrentDispatch, (cmd->array));
+}
+
+void GLAPIENTRY
+_mesa_marshal_BindVertexArrayAPPLE(GLuint array)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct marshal_cmd_BindVertexArrayAPPLE *cmd;
+
+   bind_vao(ctx->GLThread, array);
+
+   cmd = _mesa_glthread_allocate_command(ctx,
+                                         DISPATCH_CMD_BindVertexArrayAPPLE,
+                                         sizeof(*cmd));
+   cmd->array = array;
+}
+
+
+/* DeleteVertexArrays: marshalled asynchronously */
+struct marshal_cmd_DeleteVertexArrays
+{
+   struct marshal_cmd_base cmd_base;
+   GLsizei n;
+   /* Followed by GLuint arrays[n] */
+};
+
+void
+_mesa_unmarshal_DeleteVertexArrays(struct gl_context *ctx,
+                                   const struct marshal_cmd_DeleteVertexArrays *cmd)
+{
+   const GLuint *arrays = (const GLuint *) (cmd + 1);
+
+   CALL_DeleteVertexArrays(ctx->CurrentDispatch, (cmd->n, arrays));
+}
+
+void GLAPIENTRY
+_mesa_marshal_DeleteVertexArrays(GLsizei n, const GLuint *arrays)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct glthread_state *glthread = ctx->GLThread;
+   int arrays_size = _mesa_glthread_array_size(n, sizeof(GLuint));
+   size_t cmd_size = sizeof(struct marshal_cmd_DeleteVertexArrays) + arrays_size;
+   struct marshal_cmd_DeleteVertexArrays *cmd;
+   GLsizei i;
+
+   if (arrays_size < 0 || (arrays_size > 0 && !arrays) ||
+       cmd_size > MARSHAL_MAX_CMD_SIZE) {
+      _mesa_glthread_begin_sync(ctx);
+      CALL_DeleteVertexArrays(ctx->CurrentDispatch, (n, arrays));
+      _mesa_glthread_end_sync(ctx);
+   }
+   else {
+      cmd = _mesa_glthread_allocate_command(ctx,
+                                            DISPATCH_CMD_DeleteVertexArrays,
+                                            cmd_size);
+      cmd->n = n;
+      memcpy(cmd + 1, arrays, arrays_size);
+   }
+
+   if (arrays_size <= 0 || !arrays)
+      return;
+
+   for (i = 0; i < n; i++) {
+      struct glthread_vao *vao;
+
+      if (arrays[i] == 0)
+         continue;
+
+      vao = _mesa_HashLookup(glthread->VAOs, arrays[i]);
+      if (!vao)
+         continue;
+
+      /* Deleting the bound object binds the default one. */
+      if (glthread->CurrentVAO == vao)
+         bind_vao(glthread, 0);
+
+      _mesa_HashRemove(glthread->VAOs, arrays[i]);
+      free(vao);
+   }
+}
+
+
+/* PushClientAttrib: marshalled asynchronously */
+struct marshal_cmd_PushClientAttrib
+{
+   struct marshal_cmd_base cmd_base;
+   GLbitfield mask;
+};
+
+void
+_mesa_unmarshal_PushClientAttrib(struct gl_context *ctx,
+                                 const struct marshal_cmd_PushClientAttrib *cmd)
+{
+   CALL_PushClientAttrib(ctx->CurrentDispatch, (cmd->mask));
+}
+
+void GLAPIENTRY
+_mesa_marshal_PushClientAttrib(GLbitfield mask)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct glthread_state *glthread = ctx->GLThread;
+   struct marshal_cmd_PushClientAttrib *cmd;
+
+   if (glthread->ClientAttribStackDepth < MAX_CLIENT_ATTRIB_STACK_DEPTH) {
+      struct glthread_client_attrib *attr =
+         &glthread->ClientAttribStack[glthread->ClientAttribStackDepth++];
+
+      attr->Mask = mask;
+      attr->VAO = glthread->CurrentVAOName;
+      attr->ArrayBuffer = glthread->ArrayBuffer;
+      attr->PixelUnpackBuffer = glthread->PixelUnpackBuffer;
+      attr->State = *glthread->CurrentVAO;
+   }
+
+   cmd = _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_PushClientAttrib,
+                                         sizeof(*cmd));
+   cmd->mask = mask;
+}
+
+
+/* PopClientAttrib: marshalled asynchronously */
+struct marshal_cmd_PopClientAttrib
+{
+   struct marshal_cmd_base cmd_base;
+};
+
+void
+_mesa_unmarshal_PopClientAttrib(struct gl_context *ctx,
+                                const struct marshal_cmd_PopClientAttrib *cmd)
+{
+   (void) cmd;
+   CALL_PopClientAttrib(ctx->CurrentDispatch, ());
+}
+
+void GLAPIENTRY
+_mesa_marshal_PopClientAttrib(void)
+{
+   GET_CURRENT_CONTEXT(ctx);
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (glthread->ClientAttribStackDepth > 0) {
+      const struct glthread_client_attrib *attr =
+         &glthread->ClientAttribStack[--glthread->ClientAttribStackDepth];
+
+      if (attr->Mask & GL_CLIENT_VERTEX_ARRAY_BIT) {
+         bind_vao(glthread, attr->VAO);
+         glthread->ArrayBuffer = attr->ArrayBuffer;
+         *glthread->CurrentVAO = attr->State;
+      }
+      if (attr->Mask & GL_CLIENT_PIXEL_STORE_BIT)
+         glthread->PixelUnpackBuffer = attr->PixelUnpackBuffer;
+   }
+
+   _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_PopClientAttrib,
+                                   sizeof(struct marshal_cmd_PopClientAttrib));
+}
+
+
+/* Flush: marshalled asynchronously, and submits the batch */
+struct marshal_cmd_Flush
+{
+   struct marshal_cmd_base cmd_base;
+};
+
+void
+_mesa_unmarshal_Flush(struct gl_context *ctx,
+                      const struct marshal_cmd_Flush *cmd)
+{
+   (void) cmd;
+   CALL_Flush(ctx->CurrentDispatch, ());
+}
+
+void GLAPIENTRY
+_mesa_marshal_Flush(void)
+{
+   GET_CURRENT_CONTEXT(ctx);
+
+   _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_Flush,
+                                   sizeof(struct marshal_cmd_Flush));
+
+   /* Don't let the commands wait for the batch to fill up. */
+   _mesa_glthread_flush_batch(ctx);
+}
@@ -0,0 +1,224 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2012 The Mesa Authors   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+ * AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * \file marshal.h
+ * Running a context's GL calls on a separate thread.
+ *
+ * When enabled, the application's thread dispatches through
+ * ctx->MarshalExec.  Its functions (generated by gl_marshal.py) copy their
+ * parameters into commands, which are packed into a ring of batches and
+ * executed in order on the context's own thread, through
+ * ctx->CurrentDispatch as usual.  Calls that return something, or whose
+ * pointer parameters can't be copied, first wait for the thread to become
+ * idle and then run on the application's thread.
+ *
+ * Draw calls can only be deferred when they don't read client memory, so
+ * the application's thread keeps track of the buffer object bindings and
+ * of which vertex array objects have pointed at client memory.  Likewise,
+ * the pixel data of calls like glCompressedTexImage2D is only copied when
+ * no pixel unpack buffer is bound.
+ */
+
+
+#ifndef MARSHAL_H
+#define MARSHAL_H
+
+
+#include <string.h>
+#include "glheader.h"
+#include "mtypes.h"
+#include "main/marshal_generated.h"
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+
+struct _glapi_table;
+struct _mesa_HashTable;
+struct gl_context;
+
+
+/** Size of a batch, and of the largest command */
+#define MARSHAL_MAX_CMD_SIZE (8 * 1024)
+
+/** Number of batches in the ring */
+#define MARSHAL_MAX_BATCHES 8
+
+
+struct marshal_cmd_base
+{
+   /** enum marshal_dispatch_cmd_id */
+   uint16_t cmd_id;
+
+   /** Size of the command in bytes, including this header */
+   uint16_t cmd_size;
+};
+
+
+struct glthread_batch
+{
+   /** Bytes of commands in the buffer */
+   size_t used;
+
+   uint64_t buffer[MARSHAL_MAX_CMD_SIZE / 8];
+};
+
+
+/**
+ * What the application's thread knows about a vertex array object
+ */
+struct glthread_vao
+{
+   GLuint ElementBuffer;
+
+   /** Has a vertex array of this object been set to client memory? */
+   GLboolean ClientArrays;
+};
+
+
+struct glthread_client_attrib
+{
+   GLbitfield Mask;
+   GLuint VAO;
+   GLuint ArrayBuffer;
+   GLuint PixelUnpackBuffer;
+   struct glthread_vao State;
+};
+
+
+struct glthread_state
+{
+#ifdef HAVE_PTHREAD
+   pthread_t thread;
+   pthread_mutex_t mutex;
+
+   /** Signalled when a batch is submitted, or on shutdown */
+   pthread_cond_t new_work;
+
+   /** Signalled when a batch has been executed */
+   pthread_cond_t work_done;
+#endif
+
+   struct glthread_batch batches[MARSHAL_MAX_BATCHES];
+
+   /**
+    * Batches submitted and executed so far.  Batch \c i of the ring is
+    * batches[i % MARSHAL_MAX_BATCHES].
+    */
+   unsigned submitted, executed;
+
+   GLboolean shutdown;
+
+   /** Batch the application's thread is filling */
+   struct glthread_batch *batch;
+
+   /**
+    * \name Binding state, only used on the application's thread
+    */
+   /*@{*/
+   GLuint ArrayBuffer;
+   GLuint PixelUnpackBuffer;
+   GLuint CurrentVAOName;
+   struct glthread_vao *CurrentVAO;
+   struct glthread_vao DefaultVAO;
+   struct _mesa_HashTable *VAOs;
+
+   struct glthread_client_attrib ClientAttribStack[MAX_CLIENT_ATTRIB_STACK_DEPTH];
+   GLuint ClientAttribStackDepth;
+   /*@}*/
+};
+
+
+extern void
+_mesa_glthread_init(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_destroy(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_flush_batch(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_finish(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_begin_sync(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_end_sync(struct gl_context *ctx);
+
+extern GLboolean
+_mesa_glthread_arrays_in_vbos(struct gl_context *ctx, GLboolean indexed);
+
+extern void
+_mesa_glthread_array_pointer(struct gl_context *ctx);
+
+extern struct _glapi_table *
+_mesa_create_marshal_table(const struct gl_context *ctx);
+
+extern void
+_mesa_unmarshal_dispatch_cmd(struct gl_context *ctx, const void *cmd);
+
+
+/**
+ * Reserve room for a command in the current batch.
+ */
+static INLINE void *
+_mesa_glthread_allocate_command(struct gl_context *ctx, uint16_t cmd_id,
+                                size_t size)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct marshal_cmd_base *cmd;
+   const size_t aligned_size = (size + 7) & ~(size_t) 7;
+
+   assert(aligned_size <= MARSHAL_MAX_CMD_SIZE);
+
+   if (glthread->batch->used + aligned_size > MARSHAL_MAX_CMD_SIZE)
+      _mesa_glthread_flush_batch(ctx);
+
+   cmd = (struct marshal_cmd_base *)
+      ((char *) glthread->batch->buffer + glthread->batch->used);
+   glthread->batch->used += aligned_size;
+   cmd->cmd_id = cmd_id;
+   cmd->cmd_size = aligned_size;
+   return cmd;
+}
+
+
+/**
+ * Size in bytes of an array parameter with \p count elements, or -1 if it
+ * is negative or too large to fit in a command.
+ */
+static INLINE int
+_mesa_glthread_array_size(GLint64 count, int element_size)
+{
+   if (count < 0 || count > MARSHAL_MAX_CMD_SIZE)
+      return -1;
+   return (int) count * element_size;
+}
+
+
+#endif /* MARSHAL_H */
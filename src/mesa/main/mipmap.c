@@ -28,6 +28,7 @@
  */
 
 #include "imports.h"
+#include "cpuinfo.h"
 #include "formats.h"
 #include "glformats.h"
 #include "mipmap.h"
@@ -40,6 +41,10 @@
 #include "../../gallium/auxiliary/util/u_format_rgb9e5.h"
 #include "../../gallium/auxiliary/util/u_format_r11g11b10f.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 
 
 static GLint
@@ -137,6 +142,235 @@ bytes_per_pixel(GLenum datatype, GLuint comps)
 /*@}*/
 
 
+static void
+do_row(GLenum datatype, GLuint comps, GLint srcWidth,
+       const GLvoid *srcRowA, const GLvoid *srcRowB,
+       GLint dstWidth, GLvoid *dstRow);
+
+
+#if defined(__SSE2__)
+
+/*
+ * SSE2 versions of the 2:1 cases of do_row(), with the same results as the
+ * scalar code.  Each one returns the number of dest pixels it wrote, and
+ * leaves the rest of the row to the scalar code.
+ */
+
+/**
+ * Add up the horizontally adjacent pixels of two vectors holding 16
+ * consecutive elements of a row, for 1, 2 or 4 component pixels.
+ * The elements are 16 bits wide; the sums are returned as 16-bit elements,
+ * in order.
+ */
+static inline __m128i
+sse2_pair_sums_epi16(__m128i x, __m128i y, GLuint comps)
+{
+   switch (comps) {
+   case 4:
+      return _mm_add_epi16(_mm_unpacklo_epi64(x, y), _mm_unpackhi_epi64(x, y));
+   case 2:
+      {
+         const __m128 fx = _mm_castsi128_ps(x), fy = _mm_castsi128_ps(y);
+         return _mm_add_epi16(
+            _mm_castps_si128(_mm_shuffle_ps(fx, fy, _MM_SHUFFLE(2, 0, 2, 0))),
+            _mm_castps_si128(_mm_shuffle_ps(fx, fy, _MM_SHUFFLE(3, 1, 3, 1))));
+      }
+   default:
+      {
+         const __m128i lo = _mm_set1_epi32(0xffff);
+         const __m128i sx = _mm_add_epi32(_mm_and_si128(x, lo),
+                                          _mm_srli_epi32(x, 16));
+         const __m128i sy = _mm_add_epi32(_mm_and_si128(y, lo),
+                                          _mm_srli_epi32(y, 16));
+         /* the sums are small enough not to saturate */
+         return _mm_packs_epi32(sx, sy);
+      }
+   }
+}
+
+
+/** Like sse2_pair_sums_epi16(), for 8 elements of 32 bits */
+static inline __m128i
+sse2_pair_sums_epi32(__m128i x, __m128i y, GLuint comps)
+{
+   const __m128 fx = _mm_castsi128_ps(x), fy = _mm_castsi128_ps(y);
+
+   switch (comps) {
+   case 4:
+      return _mm_add_epi32(x, y);
+   case 2:
+      return _mm_add_epi32(_mm_unpacklo_epi64(x, y), _mm_unpackhi_epi64(x, y));
+   default:
+      return _mm_add_epi32(
+         _mm_castps_si128(_mm_shuffle_ps(fx, fy, _MM_SHUFFLE(2, 0, 2, 0))),
+         _mm_castps_si128(_mm_shuffle_ps(fx, fy, _MM_SHUFFLE(3, 1, 3, 1))));
+   }
+}
+
+
+static GLint
+sse2_do_row_ubyte(GLuint comps, const GLubyte *rowA, const GLubyte *rowB,
+                  GLint dstWidth, GLubyte *dst)
+{
+   const __m128i zero = _mm_setzero_si128();
+   const GLint n = dstWidth * comps;
+   GLint i;
+
+   for (i = 0; i + 16 <= n; i += 16) {
+      __m128i sums[2];
+      GLuint h;
+
+      for (h = 0; h < 2; h++) {
+         const __m128i a = _mm_loadu_si128((const __m128i *) (rowA + 2 * i) + h);
+         const __m128i b = _mm_loadu_si128((const __m128i *) (rowB + 2 * i) + h);
+         const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                                          _mm_unpacklo_epi8(b, zero));
+         const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                                          _mm_unpackhi_epi8(b, zero));
+         sums[h] = _mm_srli_epi16(sse2_pair_sums_epi16(lo, hi, comps), 2);
+      }
+
+      _mm_storeu_si128((__m128i *) (dst + i),
+                       _mm_packus_epi16(sums[0], sums[1]));
+   }
+
+   return i / comps;
+}
+
+
+static GLint
+sse2_do_row_ushort(GLuint comps, const GLushort *rowA, const GLushort *rowB,
+                   GLint dstWidth, GLushort *dst)
+{
+   const __m128i zero = _mm_setzero_si128();
+   const GLint n = dstWidth * comps;
+   GLint i;
+
+   for (i = 0; i + 8 <= n; i += 8) {
+      __m128i sums[2];
+      GLuint h;
+
+      for (h = 0; h < 2; h++) {
+         const __m128i a = _mm_loadu_si128((const __m128i *) (rowA + 2 * i) + h);
+         const __m128i b = _mm_loadu_si128((const __m128i *) (rowB + 2 * i) + h);
+         const __m128i lo = _mm_add_epi32(_mm_unpacklo_epi16(a, zero),
+                                          _mm_unpacklo_epi16(b, zero));
+         const __m128i hi = _mm_add_epi32(_mm_unpackhi_epi16(a, zero),
+                                          _mm_unpackhi_epi16(b, zero));
+         const __m128i avg = _mm_srli_epi32(sse2_pair_sums_epi32(lo, hi, comps),
+                                            2);
+         /* sign extend, so that packing doesn't saturate */
+         sums[h] = _mm_srai_epi32(_mm_slli_epi32(avg, 16), 16);
+      }
+
+      _mm_storeu_si128((__m128i *) (dst + i),
+                       _mm_packs_epi32(sums[0], sums[1]));
+   }
+
+   return i / comps;
+}
+
+
+/** Split 8 consecutive floats into the left and right pixels of pairs */
+static inline void
+sse2_split_pairs_ps(__m128 x, __m128 y, GLuint comps, __m128 *j, __m128 *k)
+{
+   switch (comps) {
+   case 4:
+      *j = x;
+      *k = y;
+      break;
+   case 2:
+      *j = _mm_movelh_ps(x, y);
+      *k = _mm_movehl_ps(y, x);
+      break;
+   default:
+      *j = _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0));
+      *k = _mm_shuffle_ps(x, y, _MM_SHUFFLE(3, 1, 3, 1));
+      break;
+   }
+}
+
+
+static GLint
+sse2_do_row_float(GLuint comps, const GLfloat *rowA, const GLfloat *rowB,
+                  GLint dstWidth, GLfloat *dst)
+{
+   const __m128 quarter = _mm_set1_ps(0.25F);
+   const GLint n = dstWidth * comps;
+   GLint i;
+
+   for (i = 0; i + 4 <= n; i += 4) {
+      __m128 aj, ak, bj, bk;
+
+      sse2_split_pairs_ps(_mm_loadu_ps(rowA + 2 * i),
+                          _mm_loadu_ps(rowA + 2 * i + 4), comps, &aj, &ak);
+      sse2_split_pairs_ps(_mm_loadu_ps(rowB + 2 * i),
+                          _mm_loadu_ps(rowB + 2 * i + 4), comps, &bj, &bk);
+
+      /* same order of operations as the scalar code */
+      _mm_storeu_ps(dst + i,
+                    _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(aj, ak), bj),
+                                          bk),
+                               quarter));
+   }
+
+   return i / comps;
+}
+
+
+/**
+ * Half floats are converted to floats and back a chunk at a time, and
+ * averaged like floats.  This works for any number of components.
+ */
+static GLint
+sse2_do_row_half(GLuint comps, const GLhalfARB *rowA, const GLhalfARB *rowB,
+                 GLint dstWidth, GLhalfARB *dst)
+{
+#define HALF_CHUNK 64 /* dest pixels */
+   GLfloat a[2 * HALF_CHUNK * 4], b[2 * HALF_CHUNK * 4], d[HALF_CHUNK * 4];
+   GLint i;
+
+   for (i = 0; i < dstWidth; i += HALF_CHUNK) {
+      const GLint w = MIN2(HALF_CHUNK, dstWidth - i);
+
+      _mesa_half_to_float_array(a, rowA + 2 * i * comps, 2 * w * comps);
+      _mesa_half_to_float_array(b, rowB + 2 * i * comps, 2 * w * comps);
+      do_row(GL_FLOAT, comps, 2 * w, a, b, w, d);
+      _mesa_float_to_half_array(dst + i * comps, d, w * comps);
+   }
+#undef HALF_CHUNK
+
+   return dstWidth;
+}
+
+
+static GLint
+sse2_do_row(GLenum datatype, GLuint comps,
+            const GLvoid *srcRowA, const GLvoid *srcRowB,
+            GLint dstWidth, GLvoid *dstRow)
+{
+   if (datatype == GL_HALF_FLOAT_ARB)
+      return sse2_do_row_half(comps, srcRowA, srcRowB, dstWidth, dstRow);
+
+   if (comps == 3)
+      return 0;
+
+   switch (datatype) {
+   case GL_UNSIGNED_BYTE:
+      return sse2_do_row_ubyte(comps, srcRowA, srcRowB, dstWidth, dstRow);
+   case GL_UNSIGNED_SHORT:
+      return sse2_do_row_ushort(comps, srcRowA, srcRowB, dstWidth, dstRow);
+   case GL_FLOAT:
+      return sse2_do_row_float(comps, srcRowA, srcRowB, dstWidth, dstRow);
+   default:
+      return 0;
+   }
+}
+
+#endif /* __SSE2__ */
+
+
 /**
  * Average together two rows of a source image to produce a single new
  * row in the dest image.  It's legal for the two source rows to point
@@ -160,6 +394,34 @@ do_row(GLenum datatype, GLuint comps, GLint srcWidth,
    assert(srcWidth == dstWidth || srcWidth == 2 * dstWidth);
    */
 
+#if defined(__SSE2__) || defined(USE_X86_64_ASM)
+   if (srcWidth != dstWidth) {
+      GLint done = 0;
+
+#if defined(USE_X86_64_ASM)
+      if (cpu_has_avx2)
+         done = _mesa_x86_64_avx2_do_row(datatype, comps, srcRowA, srcRowB,
+                                         dstWidth, dstRow);
+#endif
+#if defined(__SSE2__)
+      if (done == 0)
+         done = sse2_do_row(datatype, comps, srcRowA, srcRowB,
+                            dstWidth, dstRow);
+#endif
+      if (done > 0) {
+         const GLint bpp = bytes_per_pixel(datatype, comps);
+
+         if (done < dstWidth) {
+            do_row(datatype, comps, 2 * (dstWidth - done),
+                   (const GLubyte *) srcRowA + 2 * done * bpp,
+                   (const GLubyte *) srcRowB + 2 * done * bpp,
+                   dstWidth - done, (GLubyte *) dstRow + done * bpp);
+         }
+         return;
+      }
+   }
+#endif
+
    if (datatype == GL_UNSIGNED_BYTE && comps == 4) {
       GLuint i, j, k;
       const GLubyte(*rowA)[4] = (const GLubyte(*)[4]) srcRowA;
@@ -1691,6 +1953,109 @@ make_3d_mipmap(GLenum datatype, GLuint comps, GLint border,
 }
 
 
+/** Fewest dest bytes worth handing to another thread */
+#define MIPMAP_MIN_TASK_BYTES (256 * 1024)
+
+
+/** A mipmap level generated by several threads */
+struct mipmap_job
+{
+   GLenum target;
+   GLenum datatype;
+   GLuint comps;
+   GLint border;
+   GLint srcWidth, srcHeight, srcDepth;
+   const GLubyte **srcData;
+   GLint srcRowStride;
+   GLint dstWidth, dstHeight, dstDepth;
+   GLubyte **dstData;
+   GLint dstRowStride;
+};
+
+
+/**
+ * Generate the dest rows [first, end) of a borderless 2D image.  A stripe
+ * of rows is the mipmap of the source rows it is averaged from.
+ */
+static void
+generate_rows(void *data, GLuint first, GLuint end)
+{
+   const struct mipmap_job *job = (const struct mipmap_job *) data;
+   const GLint srcRowStep =
+      (job->srcHeight > 1 && job->srcHeight > job->dstHeight) ? 2 : 1;
+   const GLint rows = end - first;
+
+   make_2d_mipmap(job->datatype, job->comps, 0,
+                  job->srcWidth, srcRowStep * rows,
+                  job->srcData[0] + (GLintptr) first * srcRowStep *
+                     job->srcRowStride,
+                  job->srcRowStride,
+                  job->dstWidth, rows,
+                  job->dstData[0] + (GLintptr) first * job->dstRowStride,
+                  job->dstRowStride);
+}
+
+
+/**
+ * Generate the dest slices [first, end) of an array texture, or of a
+ * borderless 3D texture.
+ */
+static void
+generate_slices(void *data, GLuint first, GLuint end)
+{
+   const struct mipmap_job *job = (const struct mipmap_job *) data;
+   GLuint i;
+
+   switch (job->target) {
+   case GL_TEXTURE_1D_ARRAY_EXT:
+      for (i = first; i < end; i++) {
+         make_1d_mipmap(job->datatype, job->comps, job->border,
+                        job->srcWidth, job->srcData[i],
+                        job->dstWidth, job->dstData[i]);
+      }
+      break;
+   case GL_TEXTURE_2D_ARRAY_EXT:
+      for (i = first; i < end; i++) {
+         make_2d_mipmap(job->datatype, job->comps, job->border,
+                        job->srcWidth, job->srcHeight, job->srcData[i],
+                        job->srcRowStride,
+                        job->dstWidth, job->dstHeight, job->dstData[i],
+                        job->dstRowStride);
+      }
+      break;
+   case GL_TEXTURE_3D:
+      {
+         /* Dest slice i averages source slices 2i and 2i+1.  Keep the sub
+          * range's depths equal when the level's are, so that
+          * make_3d_mipmap() still reads a single source slice.
+          */
+         const GLint slices = end - first;
+         const GLint srcSlices =
+            (job->srcDepth == job->dstDepth) ? slices : 2 * slices;
+
+         make_3d_mipmap(job->datatype, job->comps, 0,
+                        job->srcWidth, job->srcHeight, srcSlices,
+                        job->srcData + 2 * first, job->srcRowStride,
+                        job->dstWidth, job->dstHeight, slices,
+                        job->dstData + first, job->dstRowStride);
+      }
+      break;
+   default:
+      assert(0);
+   }
+}
+
+
+/**
+ * Number of threads worth generating a mipmap level of \p dstBytes with.
+ */
+static GLuint
+mipmap_tasks(GLuint64 dstBytes)
+{
+   return (GLuint) MIN2(_mesa_num_threads(), dstBytes / MIPMAP_MIN_TASK_BYTES);
+}
+
+
 /**
  * Down-sample a texture image to produce the next lower mipmap level.
  * \param comps  components per texel (1, 2, 3 or 4)
@@ -1710,7 +2075,23 @@ _mesa_generate_mipmap_level(GLenum target,
                             GLubyte **dstData,
                             GLint dstRowStride)
 {
-   int i;
+   const GLuint64 dstBytes = (GLuint64) dstRowStride * dstHeight * dstDepth;
+   struct mipmap_job job;
+
+   job.target = target;
+   job.datatype = datatype;
+   job.comps = comps;
+   job.border = border;
+   job.srcWidth = srcWidth;
+   job.srcHeight = srcHeight;
+   job.srcDepth = srcDepth;
+   job.srcData = srcData;
+   job.srcRowStride = srcRowStride;
+   job.dstWidth = dstWidth;
+   job.dstHeight = dstHeight;
+   job.dstDepth = dstDepth;
+   job.dstData = dstData;
+   job.dstRowStride = dstRowStride;
 
    switch (target) {
    case GL_TEXTURE_1D:
@@ -1725,32 +2106,38 @@ _mesa_generate_mipmap_level(GLenum target,
    case GL_TEXTURE_CUBE_MAP_NEGATIVE_Y_ARB:
    case GL_TEXTURE_CUBE_MAP_POSITIVE_Z_ARB:
    case GL_TEXTURE_CUBE_MAP_NEGATIVE_Z_ARB:
-      make_2d_mipmap(datatype, comps, border,
-                     srcWidth, srcHeight, srcData[0], srcRowStride,
-                     dstWidth, dstHeight, dstData[0], dstRowStride);
+      if (border == 0) {
+         _mesa_parallel_for(dstHeight, mipmap_tasks(dstBytes),
+                            generate_rows, &job);
+      }
+      else {
+         make_2d_mipmap(datatype, comps, border,
+                        srcWidth, srcHeight, srcData[0], srcRowStride,
+                        dstWidth, dstHeight, dstData[0], dstRowStride);
+      }
       break;
    case GL_TEXTURE_3D:
-      make_3d_mipmap(datatype, comps, border,
-                     srcWidth, srcHeight, srcDepth,
-                     srcData, srcRowStride,
-                     dstWidth, dstHeight, dstDepth,
-                     dstData, dstRowStride);
+      if (border == 0) {
+         _mesa_parallel_for(dstDepth, mipmap_tasks(dstBytes),
+                            generate_slices, &job);
+      }
+      else {
+         make_3d_mipmap(datatype, comps, border,
+                        srcWidth, srcHeight, srcDepth,
+                        srcData, srcRowStride,
+                        dstWidth, dstHeight, dstDepth,
+                        dstData, dstRowStride);
+      }
       break;
    case GL_TEXTURE_1D_ARRAY_EXT:
       assert(srcHeight == 1);
       assert(dstHeight == 1);
-      for (i = 0; i < dstDepth; i++) {
-	 make_1d_mipmap(datatype, comps, border,
-			srcWidth, srcData[i],
-			dstWidth, dstData[i]);
-      }
+      _mesa_parallel_for(dstDepth, mipmap_tasks(dstBytes),
+                         generate_slices, &job);
       break;
    case GL_TEXTURE_2D_ARRAY_EXT:
-      for (i = 0; i < dstDepth; i++) {
-	 make_2d_mipmap(datatype, comps, border,
-			srcWidth, srcHeight, srcData[i], srcRowStride,
-			dstWidth, dstHeight, dstData[i], dstRowStride);
-      }
+      _mesa_parallel_for(dstDepth, mipmap_tasks(dstBytes),
+                         generate_slices, &job);
       break;
    case GL_TEXTURE_RECTANGLE_NV:
    case GL_TEXTURE_EXTERNAL_OES:
@@ -2178,6 +2178,7 @@ struct gl_shader
    GLboolean DeletePending;
    GLboolean CompileStatus;
    const GLchar *Source;  /**< Source code string */
+   GLuint SourcePrefixLength;   /**< length of the first of several strings */
    GLuint SourceChecksum;       /**< for debug/logging purposes */
    struct gl_program *Program;  /**< Post-compile assembly code */
    GLchar *InfoLog;
@@ -2407,6 +2408,7 @@ struct gl_shader_program
 #define GLSL_NOP_FRAG 0x40  /**< Force no-op fragment shaders */
 #define GLSL_USE_PROG 0x80  /**< Log glUseProgram calls */
 #define GLSL_REPORT_ERRORS 0x100  /**< Print compilation errors */
+#define GLSL_STATS   0x200  /**< Print compiler statistics */
 
 
 /**
@@ -2435,6 +2437,12 @@ struct gl_shader_state
    struct gl_shader_program *ActiveProgram;
 
    GLbitfield Flags;                    /**< Mask of GLSL_x flags */
+
+   /**
+    * The source prefix most recently preprocessed on its own, and its
+    * macros.  See _mesa_glsl_compile_shader().
+    */
+   void *SourcePrefix;
 };
 
 
@@ -3368,6 +3376,13 @@ struct gl_context
    struct _glapi_table *Save;	/**< Display list save functions */
    struct _glapi_table *Exec;	/**< Execute functions */
    struct _glapi_table *CurrentDispatch;  /**< == Save or Exec !! */
+
+   /**
+    * Dispatch table of the application's thread when the context's GL
+    * calls are run on a separate thread, see marshal.h.
+    */
+   struct _glapi_table *MarshalExec;
+   struct glthread_state *GLThread;
    /*@}*/
 
    struct gl_config Visual;
@@ -85,6 +85,8 @@ get_shader_flags(void)
          flags |= GLSL_USE_PROG;
       if (strstr(env, "errors"))
          flags |= GLSL_REPORT_ERRORS;
+      if (strstr(env, "stats"))
+         flags |= GLSL_STATS;
    }
 
    return flags;
@@ -131,6 +133,8 @@ _mesa_free_shader_state(struct gl_context *ctx)
    _mesa_reference_shader_program(ctx, &ctx->Shader._CurrentFragmentProgram,
 				  NULL);
    _mesa_reference_shader_program(ctx, &ctx->Shader.ActiveProgram, NULL);
+   ralloc_free(ctx->Shader.SourcePrefix);
+   ctx->Shader.SourcePrefix = NULL;
 }
 
 
@@ -686,6 +690,7 @@ shader_source(struct gl_context *ctx, GLuint shader, const GLchar *source)
    /* free old shader source string and install new one */
    free((void *)sh->Source);
    sh->Source = source;
+   sh->SourcePrefixLength = 0;
    sh->CompileStatus = GL_FALSE;
 #ifdef DEBUG
    sh->SourceChecksum = _mesa_str_checksum(sh->Source);
@@ -1293,6 +1298,7 @@ _mesa_ShaderSource(GLhandleARB shaderObj, GLsizei count,
    GLsizei i, totalLength;
    GLcharARB *source;
    GLuint checksum;
+   GLuint prefixLength;
 
    if (!shaderObj || string == NULL) {
       _mesa_error(ctx, GL_INVALID_VALUE, "glShaderSourceARB");
@@ -1345,6 +1351,12 @@ _mesa_ShaderSource(GLhandleARB shaderObj, GLsizei count,
    source[totalLength - 1] = '\0';
    source[totalLength - 2] = '\0';
 
+   /* Applications often pass a header shared by all of their shaders as
+    * the first string.  Remember where it ends, so that the compiler can
+    * preprocess it once for all of them.
+    */
+   prefixLength = count > 1 ? offsets[0] : 0;
+
    if (SHADER_SUBST) {
       /* Compute the shader's source code checksum then try to open a file
        * named newshader_<CHECKSUM>.  If it exists, use it in place of the
@@ -1363,15 +1375,18 @@ _mesa_ShaderSource(GLhandleARB shaderObj, GLsizei count,
                        shaderObj, checksum, filename);
          free(source);
          source = newSource;
+         prefixLength = 0;
       }
    }
 
    shader_source(ctx, shaderObj, source);
 
-   if (SHADER_SUBST) {
+   if (SHADER_SUBST || prefixLength > 0) {
       struct gl_shader *sh = _mesa_lookup_shader(ctx, shaderObj);
-      if (sh)
+      if (sh && SHADER_SUBST)
          sh->SourceChecksum = checksum; /* save original checksum */
+      if (sh)
+         sh->SourcePrefixLength = prefixLength;
    }
 
    free(offsets);
@@ -0,0 +1,173 @@
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name dlist_compile.cpp
+ *
+ * Compile display lists whose state calls repeat earlier ones, which
+ * compile_list() in main/dlist.c drops, and check that executing the list
+ * still leaves the state the calls set.
+ */
+
+extern "C" {
+#include "main/mfeatures.h"
+}
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "GL/gl.h"
+#include "GL/glext.h"
+#include "main/compiler.h"
+#include "main/api_exec.h"
+#include "main/context.h"
+#include "main/mtypes.h"
+#include "glapi/glapi.h"
+#include "drivers/common/driverfuncs.h"
+#include "vbo/vbo.h"
+
+#ifndef GLAPIENTRYP
+#define GLAPIENTRYP GL_APIENTRYP
+#endif
+
+#include "main/dispatch.h"
+}
+
+class DlistCompile_test : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   GLuint begin_list();
+   void end_list_and_call(GLuint list);
+
+   struct gl_config visual;
+   struct dd_function_table driver_functions;
+   struct gl_context ctx;
+};
+
+void
+DlistCompile_test::SetUp()
+{
+   memset(&visual, 0, sizeof(visual));
+   memset(&driver_functions, 0, sizeof(driver_functions));
+   memset(&ctx, 0, sizeof(ctx));
+
+   _mesa_init_driver_functions(&driver_functions);
+
+   ctx.Version = 21;
+   ASSERT_TRUE(_mesa_initialize_context(&ctx, API_OPENGL_COMPAT, &visual,
+                                        NULL, &driver_functions));
+   ASSERT_TRUE(_vbo_CreateContext(&ctx));
+   ASSERT_TRUE(_mesa_make_current(&ctx, NULL, NULL));
+}
+
+void
+DlistCompile_test::TearDown()
+{
+   _vbo_DestroyContext(&ctx);
+   _mesa_free_context_data(&ctx);
+   _mesa_make_current(NULL, NULL, NULL);
+}
+
+GLuint
+DlistCompile_test::begin_list()
+{
+   const GLuint list = CALL_GenLists(GET_DISPATCH(), (1));
+
+   CALL_NewList(GET_DISPATCH(), (list, GL_COMPILE));
+   return list;
+}
+
+/**
+ * End the list, put the state it sets to other values, and execute it.
+ */
+void
+DlistCompile_test::end_list_and_call(GLuint list)
+{
+   CALL_EndList(GET_DISPATCH(), ());
+
+   CALL_PolygonMode(GET_DISPATCH(), (GL_FRONT_AND_BACK, GL_POINT));
+   CALL_Disable(GET_DISPATCH(), (GL_CULL_FACE));
+   CALL_DepthFunc(GET_DISPATCH(), (GL_ALWAYS));
+
+   CALL_CallList(GET_DISPATCH(), (list));
+   EXPECT_EQ((GLenum) GL_NO_ERROR, ctx.ErrorValue);
+}
+
+/**
+ * Repeated state calls give the state of the last one.
+ */
+TEST_F(DlistCompile_test, RepeatedState)
+{
+   const GLuint list = begin_list();
+
+   CALL_DepthFunc(GET_DISPATCH(), (GL_LESS));
+   CALL_Enable(GET_DISPATCH(), (GL_CULL_FACE));
+   CALL_DepthFunc(GET_DISPATCH(), (GL_LESS));
+   CALL_Disable(GET_DISPATCH(), (GL_CULL_FACE));
+   CALL_DepthFunc(GET_DISPATCH(), (GL_GREATER));
+   CALL_Enable(GET_DISPATCH(), (GL_CULL_FACE));
+   CALL_DepthFunc(GET_DISPATCH(), (GL_LESS));
+
+   end_list_and_call(list);
+
+   EXPECT_EQ((GLenum) GL_LESS, ctx.Depth.Func);
+   EXPECT_TRUE(ctx.Polygon.CullFlag);
+}
+
+/**
+ * glPolygonMode(GL_FRONT_AND_BACK) changes the face that an earlier
+ * glPolygonMode(GL_FRONT) set, so setting that face again isn't redundant.
+ */
+TEST_F(DlistCompile_test, PolygonModeFrontAndBack)
+{
+   const GLuint list = begin_list();
+
+   CALL_PolygonMode(GET_DISPATCH(), (GL_FRONT, GL_LINE));
+   CALL_PolygonMode(GET_DISPATCH(), (GL_FRONT_AND_BACK, GL_FILL));
+   CALL_PolygonMode(GET_DISPATCH(), (GL_FRONT, GL_LINE));
+
+   end_list_and_call(list);
+
+   EXPECT_EQ((GLenum) GL_LINE, ctx.Polygon.FrontMode);
+   EXPECT_EQ((GLenum) GL_FILL, ctx.Polygon.BackMode);
+}
+
+/**
+ * The other way around: glPolygonMode(GL_BACK) changes part of what an
+ * earlier glPolygonMode(GL_FRONT_AND_BACK) set.
+ */
+TEST_F(DlistCompile_test, PolygonModeOneFace)
+{
+   const GLuint list = begin_list();
+
+   CALL_PolygonMode(GET_DISPATCH(), (GL_FRONT_AND_BACK, GL_LINE));
+   CALL_PolygonMode(GET_DISPATCH(), (GL_BACK, GL_FILL));
+   CALL_PolygonMode(GET_DISPATCH(), (GL_FRONT_AND_BACK, GL_LINE));
+
+   end_list_and_call(list);
+
+   EXPECT_EQ((GLenum) GL_LINE, ctx.Polygon.FrontMode);
+   EXPECT_EQ((GLenum) GL_LINE, ctx.Polygon.BackMode);
+}
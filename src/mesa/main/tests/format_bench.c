@@ -0,0 +1,215 @@
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * \file format_bench.c
+ * Throughput of the row functions of format_unpack.c and format_pack.c.
+ *
+ * Build with "make format-bench".  For each format and direction, the
+ * number of MB/s of packed pixels converted is printed.  Format names given
+ * on the command line, such as MESA_FORMAT_ARGB8888, limit the run to
+ * those formats.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include "main/macros.h"
+#include "main/formats.h"
+#include "main/format_pack.h"
+#include "main/format_unpack.h"
+
+/** Pixels per row, like a 1080p frame */
+#define WIDTH 1920
+
+/** Time spent on each format and direction, in seconds */
+#define RUN_TIME 0.25
+
+struct bench_format {
+   gl_format format;
+
+   /** Can the format be unpacked to and packed from GLubyte? */
+   GLboolean ubyte;
+
+   /** Is it a depth format? */
+   GLboolean depth;
+};
+
+static const struct bench_format formats[] = {
+   { MESA_FORMAT_RGBA8888,      GL_TRUE,  GL_FALSE },
+   { MESA_FORMAT_RGBA8888_REV,  GL_TRUE,  GL_FALSE },
+   { MESA_FORMAT_ARGB8888,      GL_TRUE,  GL_FALSE },
+   { MESA_FORMAT_ARGB8888_REV,  GL_TRUE,  GL_FALSE },
+   { MESA_FORMAT_RGBX8888,      GL_TRUE,  GL_FALSE },
+   { MESA_FORMAT_RGBX8888_REV,  GL_TRUE,  GL_FALSE },
+   { MESA_FORMAT_XRGB8888,      GL_TRUE,  GL_FALSE },
+   { MESA_FORMAT_XRGB8888_REV,  GL_TRUE,  GL_FALSE },
+   { MESA_FORMAT_RGB888,        GL_TRUE,  GL_FALSE },
+   { MESA_FORMAT_BGR888,        GL_TRUE,  GL_FALSE },
+   { MESA_FORMAT_RGB565,        GL_TRUE,  GL_FALSE },
+   { MESA_FORMAT_RGB565_REV,    GL_TRUE,  GL_FALSE },
+   { MESA_FORMAT_ARGB4444,      GL_TRUE,  GL_FALSE },
+   { MESA_FORMAT_ARGB1555,      GL_TRUE,  GL_FALSE },
+   { MESA_FORMAT_RGBA_FLOAT32,  GL_FALSE, GL_FALSE },
+   { MESA_FORMAT_RGBA_FLOAT16,  GL_FALSE, GL_FALSE },
+   { MESA_FORMAT_Z24_S8,        GL_FALSE, GL_TRUE },
+   { MESA_FORMAT_S8_Z24,        GL_FALSE, GL_TRUE },
+   { MESA_FORMAT_Z16,           GL_FALSE, GL_TRUE },
+   { MESA_FORMAT_Z32_FLOAT,     GL_FALSE, GL_TRUE },
+};
+
+enum direction {
+   UNPACK_FLOAT,
+   UNPACK_UBYTE,
+   PACK_FLOAT,
+   PACK_UBYTE,
+   NUM_DIRECTIONS
+};
+
+static const char *direction_names[NUM_DIRECTIONS] = {
+   "unpack float",
+   "unpack ubyte",
+   "pack float",
+   "pack ubyte"
+};
+
+static GLubyte packed[WIDTH * 16];
+static GLfloat rgba[WIDTH][4];
+static GLubyte rgbaub[WIDTH][4];
+static GLfloat depth[WIDTH];
+
+static double
+now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+convert_row(const struct bench_format *f, enum direction dir)
+{
+   switch (dir) {
+   case UNPACK_FLOAT:
+      if (f->depth)
+         _mesa_unpack_float_z_row(f->format, WIDTH, packed, depth);
+      else
+         _mesa_unpack_rgba_row(f->format, WIDTH, packed, rgba);
+      break;
+   case UNPACK_UBYTE:
+      _mesa_unpack_ubyte_rgba_row(f->format, WIDTH, packed, rgbaub);
+      break;
+   case PACK_FLOAT:
+      if (f->depth)
+         _mesa_pack_float_z_row(f->format, WIDTH, depth, packed);
+      else
+         _mesa_pack_float_rgba_row(f->format, WIDTH,
+                                   (const GLfloat (*)[4]) rgba, packed);
+      break;
+   case PACK_UBYTE:
+      _mesa_pack_ubyte_rgba_row(f->format, WIDTH,
+                                (const GLubyte (*)[4]) rgbaub, packed);
+      break;
+   default:
+      assert(0);
+   }
+}
+
+static void
+run(const struct bench_format *f, enum direction dir)
+{
+   const double start = now();
+   double elapsed;
+   unsigned rows = 0;
+
+   do {
+      unsigned i;
+
+      for (i = 0; i < 64; i++)
+         convert_row(f, dir);
+      rows += 64;
+      elapsed = now() - start;
+   } while (elapsed < RUN_TIME);
+
+   printf("%-32s %-13s %10.1f MB/s\n", _mesa_get_format_name(f->format),
+          direction_names[dir],
+          (double) rows * WIDTH * _mesa_get_format_bytes(f->format) /
+          (elapsed * 1024 * 1024));
+}
+
+static int
+selected(const struct bench_format *f, int argc, char **argv)
+{
+   int i;
+
+   if (argc < 2)
+      return 1;
+
+   for (i = 1; i < argc; i++) {
+      if (strcmp(argv[i], _mesa_get_format_name(f->format)) == 0)
+         return 1;
+   }
+
+   return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned i;
+
+   /* normally done by the first context that is created */
+   for (i = 0; i < 256; i++)
+      _mesa_ubyte_to_float_color_tab[i] = (float) i / 255.0F;
+
+   for (i = 0; i < sizeof(packed); i++)
+      packed[i] = rand();
+   for (i = 0; i < WIDTH; i++) {
+      unsigned c;
+
+      for (c = 0; c < 4; c++) {
+         rgba[i][c] = (float) rand() / RAND_MAX;
+         rgbaub[i][c] = rand();
+      }
+      depth[i] = (float) rand() / RAND_MAX;
+   }
+
+   for (i = 0; i < Elements(formats); i++) {
+      const struct bench_format *f = &formats[i];
+      enum direction dir;
+
+      if (!selected(f, argc, argv))
+         continue;
+
+      for (dir = 0; dir < NUM_DIRECTIONS; dir++) {
+         if ((dir == UNPACK_UBYTE || dir == PACK_UBYTE) && !f->ubyte)
+            continue;
+         run(f, dir);
+      }
+   }
+
+   return 0;
+}
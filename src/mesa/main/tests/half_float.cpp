@@ -0,0 +1,180 @@
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name half_float.cpp
+ *
+ * Check that the vectorized half float conversions, which texture stores
+ * and mipmap generation use, give exactly the same bits as the scalar
+ * _mesa_float_to_half() and _mesa_half_to_float().
+ */
+
+#include <gtest/gtest.h>
+#include <vector>
+
+extern "C" {
+#include "main/compiler.h"
+#include "main/cpuinfo.h"
+#include "main/imports.h"
+#include "main/macros.h"
+}
+
+class HalfFloat_test : public ::testing::Test {
+public:
+   virtual void SetUp();
+
+   void check_float_to_half(const std::vector<GLuint> &bits);
+};
+
+void
+HalfFloat_test::SetUp()
+{
+   _mesa_get_cpu_features();
+}
+
+/**
+ * Convert the floats with the given bit patterns with every code path this
+ * CPU has, at every alignment and with lengths that leave a tail for the
+ * scalar code.
+ */
+void
+HalfFloat_test::check_float_to_half(const std::vector<GLuint> &bits)
+{
+   const GLuint n = bits.size();
+   std::vector<GLfloat> src(n + 1);
+   std::vector<GLhalfARB> expected(n + 1), dst(n + 2);
+
+   for (GLuint i = 0; i < n; i++) {
+      fi_type fi;
+      fi.i = bits[i];
+      src[i + 1] = fi.f;
+   }
+
+   for (GLuint i = 0; i < n; i++)
+      expected[i] = _mesa_float_to_half(src[i + 1]);
+
+#if defined(USE_X86_64_ASM)
+   const int features = _mesa_x86_64_cpu_features;
+   for (int pass = 0; pass < 2; pass++) {
+      /* The second pass is without F16C. */
+      if (pass == 1) {
+         if (!(features & X86_64_FEATURE_F16C))
+            break;
+         _mesa_x86_64_cpu_features &= ~X86_64_FEATURE_F16C;
+      }
+#endif
+
+      for (GLuint offset = 0; offset <= MIN2(n, 1); offset++) {
+         const GLuint count = n - offset;
+
+         dst.assign(n + 2, 0xdead);
+         _mesa_float_to_half_array(&dst[offset], &src[1 + offset], count);
+
+         for (GLuint i = 0; i < count; i++) {
+            ASSERT_EQ(expected[i + offset], dst[i + offset])
+               << "float bits 0x" << std::hex << bits[i + offset];
+         }
+         EXPECT_EQ(0xdead, dst[offset + count]);
+      }
+
+#if defined(USE_X86_64_ASM)
+   }
+   _mesa_x86_64_cpu_features = features;
+#endif
+}
+
+/**
+ * Every exponent and sign, with mantissas around the bits that half floats
+ * truncate, and the specials.
+ */
+TEST_F(HalfFloat_test, FloatToHalf)
+{
+   static const GLuint low[] = {
+      0x0000, 0x0001, 0x0fff, 0x1000, 0x1fff, 0x2000, 0xe000, 0xffff
+   };
+   std::vector<GLuint> bits;
+
+   for (GLuint high = 0; high < 0x10000; high++) {
+      for (GLuint i = 0; i < Elements(low); i++)
+         bits.push_back((high << 16) | low[i]);
+   }
+
+   check_float_to_half(bits);
+}
+
+/**
+ * Short arrays, to check the lengths where only part of a vector is left.
+ */
+TEST_F(HalfFloat_test, FloatToHalfShort)
+{
+   static const GLuint values[] = {
+      0x3f800000, /* 1.0 */
+      0xc7800000, /* -65536.0, too large */
+      0x477fe000, /* 65504.0, the largest half */
+      0x7f800000, /* infinity */
+      0xffc00001, /* NaN */
+      0x33800000, /* 2^-24, the smallest half denormal */
+      0x38800000, /* 2^-14, the smallest half normal */
+      0x80000001, /* float denormal */
+      0x3eaaaaab, /* 1/3 */
+      0x00000000,
+      0x80000000,
+      0x3dcccccd, /* 0.1 */
+      0x477fffff,
+      0x38ffffff,
+      0x42f6e979, /* 123.456 */
+      0xbf7fffff,
+      0x7f7fffff,
+   };
+
+   for (GLuint n = 0; n <= Elements(values); n++)
+      check_float_to_half(std::vector<GLuint>(values, values + n));
+}
+
+/**
+ * All half floats, NaNs included, at every alignment.
+ */
+TEST_F(HalfFloat_test, HalfToFloat)
+{
+   const GLuint n = 0x10000;
+   std::vector<GLhalfARB> src(n + 1);
+   std::vector<GLfloat> dst(n + 1);
+
+   for (GLuint offset = 0; offset <= 1; offset++) {
+      const GLuint count = n - offset;
+
+      for (GLuint i = 0; i < n; i++)
+         src[i + offset] = i;
+
+      _mesa_half_to_float_array(&dst[0], &src[offset], count);
+
+      for (GLuint i = 0; i < count; i++) {
+         fi_type expected, actual;
+
+         expected.f = _mesa_half_to_float(src[i + offset]);
+         actual.f = dst[i];
+         ASSERT_EQ(expected.i, actual.i)
+            << "half 0x" << std::hex << src[i + offset];
+      }
+   }
+}
@@ -0,0 +1,275 @@
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name marshal.cpp
+ *
+ * Run GL calls through the marshalling thread of main/marshal.c, with a
+ * context whose dispatch table records the calls instead of executing them.
+ * Checks that deferred calls run in order on the context's thread, and that
+ * calls returning data or reading client arrays run on the caller's thread
+ * after the deferred ones.
+ */
+
+extern "C" {
+#include "main/mfeatures.h"
+}
+
+#include <gtest/gtest.h>
+#include <pthread.h>
+
+extern "C" {
+#include "GL/gl.h"
+#include "GL/glext.h"
+#include "main/compiler.h"
+#include "main/api_exec.h"
+#include "main/marshal.h"
+#include "main/mtypes.h"
+#include "glapi/glapi.h"
+
+#ifndef GLAPIENTRYP
+#define GLAPIENTRYP GL_APIENTRYP
+#endif
+
+#include "main/dispatch.h"
+}
+
+/** What the recording dispatch table has seen */
+static struct {
+   unsigned clear_color_calls;
+   GLfloat clear_color[4];
+   bool clear_color_in_order;
+
+   pthread_t clear_color_thread;
+   pthread_t get_thread;
+   pthread_t draw_thread;
+   unsigned draw_calls;
+
+   pthread_t compressed_thread;
+   const GLvoid *compressed_data;
+   unsigned compressed_calls;
+} calls;
+
+static void GLAPIENTRY
+record_ClearColor(GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha)
+{
+   if (red != (GLfloat) calls.clear_color_calls)
+      calls.clear_color_in_order = false;
+
+   calls.clear_color_calls++;
+   calls.clear_color[0] = red;
+   calls.clear_color[1] = green;
+   calls.clear_color[2] = blue;
+   calls.clear_color[3] = alpha;
+   calls.clear_color_thread = pthread_self();
+}
+
+static void GLAPIENTRY
+record_GetFloatv(GLenum pname, GLfloat *params)
+{
+   calls.get_thread = pthread_self();
+   if (pname == GL_COLOR_CLEAR_VALUE)
+      memcpy(params, calls.clear_color, sizeof(calls.clear_color));
+}
+
+static void GLAPIENTRY
+record_DrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+   (void) mode;
+   (void) first;
+   (void) count;
+   calls.draw_thread = pthread_self();
+   calls.draw_calls++;
+}
+
+static void GLAPIENTRY
+record_CompressedTexImage2D(GLenum target, GLint level, GLenum internalformat,
+                            GLsizei width, GLsizei height, GLint border,
+                            GLsizei imageSize, const GLvoid *data)
+{
+   (void) target;
+   (void) level;
+   (void) internalformat;
+   (void) width;
+   (void) height;
+   (void) border;
+   (void) imageSize;
+   calls.compressed_thread = pthread_self();
+   calls.compressed_data = data;
+   calls.compressed_calls++;
+}
+
+static void GLAPIENTRY
+record_nop(void)
+{
+}
+
+class Marshal_test : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   struct gl_context ctx;
+};
+
+void
+Marshal_test::SetUp()
+{
+   memset(&calls, 0, sizeof(calls));
+   calls.clear_color_in_order = true;
+
+   memset(&ctx, 0, sizeof(ctx));
+   ctx.CurrentDispatch = _mesa_alloc_dispatch_table(_gloffset_COUNT);
+   ASSERT_TRUE(ctx.CurrentDispatch != NULL);
+
+   SET_ClearColor(ctx.CurrentDispatch, record_ClearColor);
+   SET_GetFloatv(ctx.CurrentDispatch, record_GetFloatv);
+   SET_DrawArrays(ctx.CurrentDispatch, record_DrawArrays);
+   SET_CompressedTexImage2D(ctx.CurrentDispatch, record_CompressedTexImage2D);
+   SET_VertexPointer(ctx.CurrentDispatch,
+                     (void (GLAPIENTRYP)(GLint, GLenum, GLsizei,
+                                         const GLvoid *)) record_nop);
+   SET_BindBuffer(ctx.CurrentDispatch,
+                  (void (GLAPIENTRYP)(GLenum, GLuint)) record_nop);
+   SET_DeleteBuffers(ctx.CurrentDispatch,
+                     (void (GLAPIENTRYP)(GLsizei, const GLuint *)) record_nop);
+   SET_BindVertexArray(ctx.CurrentDispatch,
+                       (void (GLAPIENTRYP)(GLuint)) record_nop);
+
+   _glapi_set_context(&ctx);
+   _glapi_set_dispatch(ctx.CurrentDispatch);
+
+   _mesa_glthread_init(&ctx);
+   ASSERT_TRUE(ctx.GLThread != NULL);
+   ASSERT_EQ(ctx.MarshalExec, GET_DISPATCH());
+}
+
+void
+Marshal_test::TearDown()
+{
+   _mesa_glthread_destroy(&ctx);
+   _glapi_set_dispatch(NULL);
+   _glapi_set_context(NULL);
+   free(ctx.CurrentDispatch);
+}
+
+/**
+ * Enough deferred calls to go around the ring of batches several times must
+ * all be executed, in order, on the context's thread.
+ */
+TEST_F(Marshal_test, DeferredCallsRunInOrder)
+{
+   const unsigned count = 4 * MARSHAL_MAX_BATCHES * MARSHAL_MAX_CMD_SIZE /
+      sizeof(GLfloat[4]);
+
+   for (unsigned i = 0; i < count; i++)
+      CALL_ClearColor(GET_DISPATCH(), ((GLfloat) i, 0.25f, 0.5f, 1.0f));
+
+   _mesa_glthread_finish(&ctx);
+
+   EXPECT_EQ(count, calls.clear_color_calls);
+   EXPECT_TRUE(calls.clear_color_in_order);
+   EXPECT_EQ((GLfloat) (count - 1), calls.clear_color[0]);
+   EXPECT_FALSE(pthread_equal(calls.clear_color_thread, pthread_self()));
+}
+
+/**
+ * A call that returns data runs on the caller's thread, and sees the effect
+ * of the calls made before it.
+ */
+TEST_F(Marshal_test, GetRunsSynchronously)
+{
+   GLfloat color[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+   CALL_ClearColor(GET_DISPATCH(), (0.0f, 0.25f, 0.5f, 0.75f));
+   CALL_GetFloatv(GET_DISPATCH(), (GL_COLOR_CLEAR_VALUE, color));
+
+   EXPECT_EQ(1u, calls.clear_color_calls);
+   EXPECT_EQ(0.25f, color[1]);
+   EXPECT_EQ(0.5f, color[2]);
+   EXPECT_EQ(0.75f, color[3]);
+   EXPECT_TRUE(pthread_equal(calls.get_thread, pthread_self()));
+
+   /* Later calls are deferred again. */
+   EXPECT_EQ(ctx.MarshalExec, GET_DISPATCH());
+}
+
+/**
+ * Draws from client arrays run on the caller's thread, which owns the
+ * memory.  Draws from buffer objects are deferred.
+ */
+TEST_F(Marshal_test, ClientArrayDrawsRunSynchronously)
+{
+   static const GLfloat verts[] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f };
+
+   CALL_VertexPointer(GET_DISPATCH(), (2, GL_FLOAT, 0, verts));
+   CALL_DrawArrays(GET_DISPATCH(), (GL_TRIANGLES, 0, 3));
+
+   EXPECT_EQ(1u, calls.draw_calls);
+   EXPECT_TRUE(pthread_equal(calls.draw_thread, pthread_self()));
+
+   CALL_BindVertexArray(GET_DISPATCH(), (1));
+   CALL_BindBuffer(GET_DISPATCH(), (GL_ARRAY_BUFFER, 1));
+   CALL_VertexPointer(GET_DISPATCH(), (2, GL_FLOAT, 0, NULL));
+   CALL_DrawArrays(GET_DISPATCH(), (GL_TRIANGLES, 0, 3));
+   _mesa_glthread_finish(&ctx);
+
+   EXPECT_EQ(2u, calls.draw_calls);
+   EXPECT_FALSE(pthread_equal(calls.draw_thread, pthread_self()));
+}
+
+
+/**
+ * While a pixel unpack buffer is bound, the data pointer of a compressed
+ * texture upload is an offset into it, which must not be copied: the call
+ * runs on the caller's thread with the offset unchanged.  Without a
+ * buffer, the data is copied and the call is deferred.
+ */
+TEST_F(Marshal_test, PixelUnpackBufferUploadsRunSynchronously)
+{
+   static const GLubyte block[8] = { 0 };
+   static const GLuint buffer = 1;
+   const GLvoid *offset = (const GLvoid *) (uintptr_t) 64;
+
+   CALL_BindBuffer(GET_DISPATCH(), (GL_PIXEL_UNPACK_BUFFER, buffer));
+   CALL_CompressedTexImage2D(GET_DISPATCH(),
+                             (GL_TEXTURE_2D, 0,
+                              GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 4, 4, 0,
+                              sizeof(block), offset));
+
+   EXPECT_EQ(1u, calls.compressed_calls);
+   EXPECT_EQ(offset, calls.compressed_data);
+   EXPECT_TRUE(pthread_equal(calls.compressed_thread, pthread_self()));
+
+   /* Deleting the buffer unbinds it. */
+   CALL_DeleteBuffers(GET_DISPATCH(), (1, &buffer));
+   CALL_CompressedTexImage2D(GET_DISPATCH(),
+                             (GL_TEXTURE_2D, 0,
+                              GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 4, 4, 0,
+                              sizeof(block), block));
+   _mesa_glthread_finish(&ctx);
+
+   EXPECT_EQ(2u, calls.compressed_calls);
+   EXPECT_NE((const GLvoid *) block, calls.compressed_data);
+   EXPECT_FALSE(pthread_equal(calls.compressed_thread, pthread_self()));
+}
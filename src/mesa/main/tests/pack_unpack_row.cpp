@@ -0,0 +1,274 @@
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name pack_unpack_row.cpp
+ *
+ * Check that the row pack and unpack functions give exactly the same bits
+ * for a whole row as they give one pixel at a time.  Rows of several
+ * pixels go through the SIMD kernels of format_pack.c and format_unpack.c
+ * where there are some, and single pixels through the C code only.
+ */
+
+#include <gtest/gtest.h>
+#include <vector>
+
+extern "C" {
+#include "main/compiler.h"
+#include "main/imports.h"
+#include "main/macros.h"
+#include "main/formats.h"
+#include "main/format_pack.h"
+#include "main/format_unpack.h"
+}
+
+/** Color formats with SIMD kernels, and those sharing their row code */
+static const gl_format color_formats[] = {
+   MESA_FORMAT_RGBA8888,
+   MESA_FORMAT_RGBA8888_REV,
+   MESA_FORMAT_ARGB8888,
+   MESA_FORMAT_ARGB8888_REV,
+   MESA_FORMAT_RGBX8888,
+   MESA_FORMAT_RGBX8888_REV,
+   MESA_FORMAT_XRGB8888,
+   MESA_FORMAT_XRGB8888_REV,
+   MESA_FORMAT_RGB565,
+   MESA_FORMAT_RGB565_REV,
+   MESA_FORMAT_RGBA_FLOAT32,
+   MESA_FORMAT_RGBA_FLOAT16,
+};
+
+/** Depth formats with SIMD kernels */
+static const gl_format z_formats[] = {
+   MESA_FORMAT_Z24_S8,
+   MESA_FORMAT_Z24_X8,
+   MESA_FORMAT_S8_Z24,
+   MESA_FORMAT_X8_Z24,
+   MESA_FORMAT_Z16,
+};
+
+/** Row lengths: every remainder after the kernels, and a long row */
+static const GLuint lengths[] = {
+   1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 15, 16, 17, 31, 33, 1027
+};
+
+/** Floats around the edges of the float to ubyte conversion */
+static const GLfloat special_floats[] = {
+   0.0F, -0.0F, 1.0F, -1.0F, 0.5F, 2.0F, 1.0e10F, -1.0e10F,
+   0.996F, 0.99609375F, 0.9960937F, 0.99609381F,
+   1.0F / 255.0F, 0.5F / 255.0F, 1.5F / 255.0F, 254.5F / 255.0F,
+   1.0e-20F, -1.0e-20F,
+};
+
+class PackUnpackRow_test : public ::testing::Test {
+public:
+   virtual void SetUp();
+
+   GLuint random_uint();
+   GLfloat random_float();
+
+   GLuint seed;
+};
+
+void
+PackUnpackRow_test::SetUp()
+{
+   /* The C unpackers use this table, which context creation fills in. */
+   for (GLuint i = 0; i < 256; i++)
+      _mesa_ubyte_to_float_color_tab[i] = (float) i / 255.0F;
+
+   seed = 1;
+}
+
+/** A small LCG, so that the test doesn't depend on the C library's */
+GLuint
+PackUnpackRow_test::random_uint()
+{
+   seed = seed * 1103515245 + 12345;
+   return (seed >> 16) | (seed << 16);
+}
+
+/** Mostly [-0.25, 1.25], with some special values */
+GLfloat
+PackUnpackRow_test::random_float()
+{
+   const GLuint r = random_uint();
+
+   if (r % 8 == 0)
+      return special_floats[(r >> 3) % Elements(special_floats)];
+
+   return (GLfloat) (r >> 8) / (GLfloat) (1 << 24) * 1.5F - 0.25F;
+}
+
+TEST_F(PackUnpackRow_test, UnpackRgbaRow)
+{
+   for (GLuint f = 0; f < Elements(color_formats); f++) {
+      const gl_format format = color_formats[f];
+      const GLuint bpp = _mesa_get_format_bytes(format);
+
+      for (GLuint l = 0; l < Elements(lengths); l++) {
+         const GLuint n = lengths[l];
+         /* one extra byte, to unpack from an odd address */
+         std::vector<GLubyte> src(n * bpp + 1);
+         std::vector<GLfloat> row(4 * n), pixel(4 * n);
+
+         for (GLuint i = 0; i < src.size(); i++)
+            src[i] = random_uint();
+
+         if (format == MESA_FORMAT_RGBA_FLOAT32) {
+            for (GLuint i = 0; i < 4 * n; i++) {
+               const GLfloat v = random_float();
+               memcpy(&src[1 + 4 * i], &v, 4);
+            }
+         }
+
+         _mesa_unpack_rgba_row(format, n, &src[1], (GLfloat (*)[4]) &row[0]);
+         for (GLuint i = 0; i < n; i++) {
+            _mesa_unpack_rgba_row(format, 1, &src[1 + i * bpp],
+                                  (GLfloat (*)[4]) &pixel[4 * i]);
+         }
+
+         ASSERT_EQ(0, memcmp(&row[0], &pixel[0], 4 * n * sizeof(GLfloat)))
+            << _mesa_get_format_name(format) << ", " << n << " pixels";
+      }
+   }
+}
+
+TEST_F(PackUnpackRow_test, UnpackUbyteRgbaRow)
+{
+   for (GLuint f = 0; f < Elements(color_formats); f++) {
+      const gl_format format = color_formats[f];
+      const GLuint bpp = _mesa_get_format_bytes(format);
+
+      if (_mesa_get_format_datatype(format) != GL_UNSIGNED_NORMALIZED)
+         continue;
+
+      for (GLuint l = 0; l < Elements(lengths); l++) {
+         const GLuint n = lengths[l];
+         std::vector<GLubyte> src(n * bpp + 1);
+         std::vector<GLubyte> row(4 * n), pixel(4 * n);
+
+         for (GLuint i = 0; i < src.size(); i++)
+            src[i] = random_uint();
+
+         _mesa_unpack_ubyte_rgba_row(format, n, &src[1],
+                                     (GLubyte (*)[4]) &row[0]);
+         for (GLuint i = 0; i < n; i++) {
+            _mesa_unpack_ubyte_rgba_row(format, 1, &src[1 + i * bpp],
+                                        (GLubyte (*)[4]) &pixel[4 * i]);
+         }
+
+         ASSERT_EQ(0, memcmp(&row[0], &pixel[0], 4 * n))
+            << _mesa_get_format_name(format) << ", " << n << " pixels";
+      }
+   }
+}
+
+TEST_F(PackUnpackRow_test, PackFloatRgbaRow)
+{
+   for (GLuint f = 0; f < Elements(color_formats); f++) {
+      const gl_format format = color_formats[f];
+      const GLuint bpp = _mesa_get_format_bytes(format);
+
+      for (GLuint l = 0; l < Elements(lengths); l++) {
+         const GLuint n = lengths[l];
+         std::vector<GLfloat> src(4 * n + 1);
+         std::vector<GLubyte> row(n * bpp), pixel(n * bpp);
+
+         for (GLuint i = 0; i < src.size(); i++)
+            src[i] = random_float();
+
+         /* src + 1 isn't 16-byte aligned */
+         _mesa_pack_float_rgba_row(format, n,
+                                   (const GLfloat (*)[4]) &src[1], &row[0]);
+         for (GLuint i = 0; i < n; i++) {
+            _mesa_pack_float_rgba_row(format, 1,
+                                      (const GLfloat (*)[4]) &src[1 + 4 * i],
+                                      &pixel[i * bpp]);
+         }
+
+         ASSERT_EQ(0, memcmp(&row[0], &pixel[0], n * bpp))
+            << _mesa_get_format_name(format) << ", " << n << " pixels";
+      }
+   }
+}
+
+TEST_F(PackUnpackRow_test, PackUbyteRgbaRow)
+{
+   for (GLuint f = 0; f < Elements(color_formats); f++) {
+      const gl_format format = color_formats[f];
+      const GLuint bpp = _mesa_get_format_bytes(format);
+
+      if (_mesa_get_format_datatype(format) != GL_UNSIGNED_NORMALIZED)
+         continue;
+
+      for (GLuint l = 0; l < Elements(lengths); l++) {
+         const GLuint n = lengths[l];
+         std::vector<GLubyte> src(4 * n + 1);
+         std::vector<GLubyte> row(n * bpp), pixel(n * bpp);
+
+         for (GLuint i = 0; i < src.size(); i++)
+            src[i] = random_uint();
+
+         _mesa_pack_ubyte_rgba_row(format, n,
+                                   (const GLubyte (*)[4]) &src[1], &row[0]);
+         for (GLuint i = 0; i < n; i++) {
+            _mesa_pack_ubyte_rgba_row(format, 1,
+                                      (const GLubyte (*)[4]) &src[1 + 4 * i],
+                                      &pixel[i * bpp]);
+         }
+
+         ASSERT_EQ(0, memcmp(&row[0], &pixel[0], n * bpp))
+            << _mesa_get_format_name(format) << ", " << n << " pixels";
+      }
+   }
+}
+
+TEST_F(PackUnpackRow_test, UnpackFloatZRow)
+{
+   for (GLuint f = 0; f < Elements(z_formats); f++) {
+      const gl_format format = z_formats[f];
+      const GLuint bpp = _mesa_get_format_bytes(format);
+
+      for (GLuint l = 0; l < Elements(lengths); l++) {
+         const GLuint n = lengths[l];
+         std::vector<GLubyte> src(n * bpp + 1);
+         std::vector<GLfloat> row(n), pixel(n);
+
+         for (GLuint i = 0; i < src.size(); i++)
+            src[i] = random_uint();
+         /* the extremes of the depth range */
+         if (n > 2) {
+            memset(&src[1], 0, bpp);
+            memset(&src[1 + bpp], 0xff, bpp);
+         }
+
+         _mesa_unpack_float_z_row(format, n, &src[1], &row[0]);
+         for (GLuint i = 0; i < n; i++)
+            _mesa_unpack_float_z_row(format, 1, &src[1 + i * bpp], &pixel[i]);
+
+         ASSERT_EQ(0, memcmp(&row[0], &pixel[0], n * sizeof(GLfloat)))
+            << _mesa_get_format_name(format) << ", " << n << " pixels";
+      }
+   }
+}
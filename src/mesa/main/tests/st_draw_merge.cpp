@@ -0,0 +1,112 @@
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name st_draw_merge.cpp
+ *
+ * Check which consecutive draws the state tracker merges into one pipe
+ * draw.  Merged draws must draw the same primitives in the same order.
+ */
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "state_tracker/st_draw.h"
+}
+
+class StDrawMerge_test : public ::testing::Test {
+public:
+   virtual void SetUp();
+
+   struct pipe_draw_info prev, info;
+   struct pipe_index_buffer prev_ib, ib;
+};
+
+/**
+ * Two contiguous, non-indexed triangle list draws of one instance.
+ */
+void
+StDrawMerge_test::SetUp()
+{
+   memset(&prev, 0, sizeof(prev));
+   memset(&prev_ib, 0, sizeof(prev_ib));
+
+   prev.mode = PIPE_PRIM_TRIANGLES;
+   prev.start = 6;
+   prev.count = 12;
+   prev.instance_count = 1;
+   prev.max_index = ~0;
+
+   info = prev;
+   info.start = 18;
+   info.count = 3;
+   ib = prev_ib;
+}
+
+TEST_F(StDrawMerge_test, Contiguous)
+{
+   EXPECT_TRUE(st_draws_mergeable(&prev, &prev_ib, &info, &ib));
+
+   info.start = 21;
+   EXPECT_FALSE(st_draws_mergeable(&prev, &prev_ib, &info, &ib));
+}
+
+TEST_F(StDrawMerge_test, StripsAreNotMerged)
+{
+   prev.mode = info.mode = PIPE_PRIM_TRIANGLE_STRIP;
+   EXPECT_FALSE(st_draws_mergeable(&prev, &prev_ib, &info, &ib));
+}
+
+/**
+ * Drawing two instances of both draws at once would draw instance 1 of the
+ * first draw after instance 0 of the second one.
+ */
+TEST_F(StDrawMerge_test, InstancedDrawsAreNotMerged)
+{
+   prev.instance_count = info.instance_count = 2;
+   EXPECT_FALSE(st_draws_mergeable(&prev, &prev_ib, &info, &ib));
+
+   prev.instance_count = 1;
+   EXPECT_FALSE(st_draws_mergeable(&prev, &prev_ib, &info, &ib));
+
+   prev.instance_count = 2;
+   info.instance_count = 1;
+   EXPECT_FALSE(st_draws_mergeable(&prev, &prev_ib, &info, &ib));
+}
+
+TEST_F(StDrawMerge_test, InstancedIndexedDrawsAreNotMerged)
+{
+   static const unsigned short indices[64] = { 0 };
+
+   prev.indexed = info.indexed = TRUE;
+   prev_ib.index_size = 2;
+   prev_ib.user_buffer = indices;
+   ib = prev_ib;
+   ib.offset = 2 * 6;
+   info.start = 12;
+
+   EXPECT_TRUE(st_draws_mergeable(&prev, &prev_ib, &info, &ib));
+
+   prev.instance_count = info.instance_count = 4;
+   EXPECT_FALSE(st_draws_mergeable(&prev, &prev_ib, &info, &ib));
+}
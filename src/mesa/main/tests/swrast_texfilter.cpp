@@ -0,0 +1,269 @@
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name swrast_texfilter.cpp
+ *
+ * Check that the SSE2 and AVX2 bilinear and trilinear GL_REPEAT filters of
+ * swrast/s_texfilter.c give exactly the same bits as the C filters.  The
+ * SIMD paths are only taken for power of two images, so the C results come
+ * from the same images with _IsPowerOfTwo cleared, which the generic
+ * GL_REPEAT code handles the same way for these texture coordinates.
+ */
+
+#include <gtest/gtest.h>
+#include <vector>
+
+extern "C" {
+#include "main/compiler.h"
+#include "main/cpuinfo.h"
+#include "main/imports.h"
+#include "main/macros.h"
+#include "main/mtypes.h"
+#include "main/formats.h"
+#include "swrast/s_context.h"
+#include "swrast/s_texfetch.h"
+#include "swrast/s_texfilter.h"
+}
+
+/** The formats that the SIMD filters read directly */
+static const gl_format formats[] = {
+   MESA_FORMAT_RGBA8888,
+   MESA_FORMAT_RGBA8888_REV,
+   MESA_FORMAT_ARGB8888,
+   MESA_FORMAT_RGBA_FLOAT32,
+};
+
+/** Base level sizes, with some levels one texel wide */
+static const GLuint sizes[][2] = {
+   { 16, 8 },
+   { 4, 64 },
+};
+
+/** Span lengths: every remainder after the kernels, and a long span */
+static const GLuint lengths[] = {
+   1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 23, 31, 33, 257
+};
+
+class SwrastTexfilter_test : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   GLuint random_uint();
+   GLfloat random_float(GLfloat lo, GLfloat hi);
+
+   void make_texture(gl_format format, GLuint width, GLuint height);
+   void set_power_of_two(GLboolean pot);
+   void check_filter(GLenum minFilter, GLenum magFilter);
+
+   GLuint seed;
+   struct gl_context ctx;
+   struct gl_sampler_object samp;
+   struct gl_texture_object tObj;
+   std::vector<struct swrast_texture_image> images;
+   std::vector<std::vector<GLuint> > maps;
+};
+
+void
+SwrastTexfilter_test::SetUp()
+{
+   /* The C texel fetches use this table, which context creation fills in. */
+   for (GLuint i = 0; i < 256; i++)
+      _mesa_ubyte_to_float_color_tab[i] = (float) i / 255.0F;
+
+   _mesa_get_cpu_features();
+   seed = 1;
+
+   memset(&ctx, 0, sizeof(ctx));
+   memset(&samp, 0, sizeof(samp));
+   samp.WrapS = GL_REPEAT;
+   samp.WrapT = GL_REPEAT;
+   samp.MaxAnisotropy = 1.0F;
+}
+
+void
+SwrastTexfilter_test::TearDown()
+{
+   images.clear();
+   maps.clear();
+}
+
+/** A small LCG, so that the test doesn't depend on the C library's */
+GLuint
+SwrastTexfilter_test::random_uint()
+{
+   seed = seed * 1103515245 + 12345;
+   return (seed >> 16) | (seed << 16);
+}
+
+GLfloat
+SwrastTexfilter_test::random_float(GLfloat lo, GLfloat hi)
+{
+   return lo + (GLfloat) (random_uint() >> 8) / (GLfloat) (1 << 24) * (hi - lo);
+}
+
+/**
+ * A complete mipmapped 2D texture of random texels.
+ */
+void
+SwrastTexfilter_test::make_texture(gl_format format, GLuint width,
+                                   GLuint height)
+{
+   const GLuint levels = 1 + _mesa_logbase2(MAX2(width, height));
+
+   images.clear();
+   images.resize(levels);
+   maps.resize(levels);
+
+   memset(&tObj, 0, sizeof(tObj));
+   tObj.Target = GL_TEXTURE_2D;
+   tObj.BaseLevel = 0;
+   tObj._MaxLevel = levels - 1;
+   tObj._MaxLambda = (GLfloat) (levels - 1);
+   tObj._BaseComplete = GL_TRUE;
+   tObj._MipmapComplete = GL_TRUE;
+
+   for (GLuint l = 0; l < levels; l++) {
+      struct swrast_texture_image *img = &images[l];
+      const GLuint w = MAX2(width >> l, 1), h = MAX2(height >> l, 1);
+
+      memset(img, 0, sizeof(*img));
+      img->Base.TexFormat = format;
+      img->Base._BaseFormat = GL_RGBA;
+      img->Base.Level = l;
+      img->Base.Width = img->Base.Width2 = w;
+      img->Base.Height = img->Base.Height2 = h;
+      img->Base.Depth = img->Base.Depth2 = 1;
+      img->Base.WidthLog2 = _mesa_logbase2(w);
+      img->Base.HeightLog2 = _mesa_logbase2(h);
+      img->RowStride = w;
+      img->FetchTexel = _mesa_get_texel_fetch_func(format, 2);
+
+      maps[l].resize(w * h * _mesa_get_format_bytes(format) / 4);
+      for (GLuint i = 0; i < maps[l].size(); i++) {
+         if (format == MESA_FORMAT_RGBA_FLOAT32) {
+            const GLfloat v = random_float(-0.25F, 1.25F);
+            memcpy(&maps[l][i], &v, 4);
+         }
+         else {
+            maps[l][i] = random_uint();
+         }
+      }
+      img->Map = (GLubyte *) &maps[l][0];
+
+      tObj.Image[0][l] = &img->Base;
+   }
+}
+
+void
+SwrastTexfilter_test::set_power_of_two(GLboolean pot)
+{
+   for (GLuint l = 0; l < images.size(); l++)
+      images[l]._IsPowerOfTwo = pot;
+}
+
+/**
+ * Sample spans of every length with random texture coordinates and
+ * increasing or decreasing lambdas across all the levels, with every code
+ * path this CPU has, and compare with the C filters.
+ */
+void
+SwrastTexfilter_test::check_filter(GLenum minFilter, GLenum magFilter)
+{
+   samp.MinFilter = minFilter;
+   samp.MagFilter = magFilter;
+
+   for (GLuint f = 0; f < Elements(formats); f++) {
+      for (GLuint z = 0; z < Elements(sizes); z++) {
+         make_texture(formats[f], sizes[z][0], sizes[z][1]);
+
+         const texture_sample_func sample =
+            _swrast_choose_texture_sample_func(&ctx, &tObj, &samp);
+
+         for (GLuint l = 0; l < Elements(lengths); l++) {
+            const GLuint n = lengths[l];
+            std::vector<GLfloat> texcoords(4 * n), lambda(n);
+            std::vector<GLfloat> expected(4 * n), rgba(4 * n);
+            const GLfloat start = random_float(-1.0F, tObj._MaxLambda + 1.0F);
+            const GLfloat end = random_float(-1.0F, tObj._MaxLambda + 1.0F);
+
+            for (GLuint i = 0; i < n; i++) {
+               texcoords[4 * i + 0] = random_float(-4.0F, 4.0F);
+               texcoords[4 * i + 1] = random_float(-4.0F, 4.0F);
+               lambda[i] = start + (end - start) * i / n;
+            }
+            /* texel centers and edges */
+            if (n > 2) {
+               texcoords[0] = texcoords[1] = 0.0F;
+               texcoords[4] = 0.5F / sizes[z][0];
+               texcoords[5] = 1.0F;
+            }
+
+            set_power_of_two(GL_FALSE);
+            sample(&ctx, &samp, &tObj, n,
+                   (const GLfloat (*)[4]) &texcoords[0], &lambda[0],
+                   (GLfloat (*)[4]) &expected[0]);
+            set_power_of_two(GL_TRUE);
+
+#if defined(USE_X86_64_ASM)
+            const int features = _mesa_x86_64_cpu_features;
+            for (int pass = 0; pass < 2; pass++) {
+               /* The second pass is without AVX2. */
+               if (pass == 1) {
+                  if (!(features & X86_64_FEATURE_AVX2))
+                     break;
+                  _mesa_x86_64_cpu_features &= ~X86_64_FEATURE_AVX2;
+               }
+#endif
+
+               rgba.assign(4 * n, -1.0F);
+               sample(&ctx, &samp, &tObj, n,
+                      (const GLfloat (*)[4]) &texcoords[0], &lambda[0],
+                      (GLfloat (*)[4]) &rgba[0]);
+
+#if defined(USE_X86_64_ASM)
+               _mesa_x86_64_cpu_features = features;
+#endif
+               ASSERT_EQ(0, memcmp(&expected[0], &rgba[0],
+                                   4 * n * sizeof(GLfloat)))
+                  << _mesa_get_format_name(formats[f]) << ", "
+                  << sizes[z][0] << "x" << sizes[z][1] << ", "
+                  << n << " fragments";
+#if defined(USE_X86_64_ASM)
+            }
+#endif
+         }
+      }
+   }
+}
+
+TEST_F(SwrastTexfilter_test, Linear)
+{
+   check_filter(GL_LINEAR, GL_LINEAR);
+}
+
+TEST_F(SwrastTexfilter_test, LinearMipmapLinear)
+{
+   check_filter(GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+}
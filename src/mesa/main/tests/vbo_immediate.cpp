@@ -0,0 +1,343 @@
+/*
+ * Copyright © 2012 The Mesa Authors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name vbo_immediate.cpp
+ *
+ * Draw in immediate mode and from display lists, and check the primitives
+ * and vertices that the vbo module passes to the driver.  The glVertex3f(v)
+ * functions that vbo_exec_api.c installs for a stable vertex size must
+ * store the same vertices as the generic ones.
+ */
+
+extern "C" {
+#include "main/mfeatures.h"
+}
+
+#include <gtest/gtest.h>
+#include <vector>
+
+extern "C" {
+#include "GL/gl.h"
+#include "GL/glext.h"
+#include "main/compiler.h"
+#include "main/api_exec.h"
+#include "main/bufferobj.h"
+#include "main/context.h"
+#include "main/framebuffer.h"
+#include "main/imports.h"
+#include "main/mtypes.h"
+#include "glapi/glapi.h"
+#include "drivers/common/driverfuncs.h"
+#include "vbo/vbo.h"
+
+#ifndef GLAPIENTRYP
+#define GLAPIENTRYP GL_APIENTRYP
+#endif
+
+#include "main/dispatch.h"
+}
+
+/** Number of glBegin/glEnd pairs drawn, enough to install the fast path */
+#define NUM_TRIANGLES 32
+
+/** What the driver was asked to draw */
+static std::vector<struct _mesa_prim> drawn_prims;
+static std::vector<GLfloat> drawn_vertices;
+
+/**
+ * Append the position and color of the vertices of each primitive.
+ */
+static void
+record_draw(struct gl_context *ctx, const struct _mesa_prim *prims,
+            GLuint nr_prims, const struct _mesa_index_buffer *ib,
+            GLboolean index_bounds_valid, GLuint min_index, GLuint max_index,
+            struct gl_transform_feedback_object *tfb_vertcount)
+{
+   static const GLuint attribs[] = { VERT_ATTRIB_POS, VERT_ATTRIB_COLOR0 };
+
+   (void) ib;
+   (void) index_bounds_valid;
+   (void) min_index;
+   (void) max_index;
+   (void) tfb_vertcount;
+
+   for (GLuint p = 0; p < nr_prims; p++) {
+      drawn_prims.push_back(prims[p]);
+
+      for (GLuint v = prims[p].start; v < prims[p].start + prims[p].count;
+           v++) {
+         for (GLuint a = 0; a < Elements(attribs); a++) {
+            const struct gl_client_array *array =
+               ctx->Array._DrawArrays[attribs[a]];
+            const GLubyte *data = _mesa_is_bufferobj(array->BufferObj) ?
+               ADD_POINTERS(array->BufferObj->Data, array->Ptr) :
+               array->Ptr;
+            const GLfloat *f = (const GLfloat *) (data + v * array->StrideB);
+
+            drawn_vertices.insert(drawn_vertices.end(), f, f + array->Size);
+         }
+      }
+   }
+}
+
+static void
+update_state(struct gl_context *ctx, GLbitfield new_state)
+{
+   (void) ctx;
+   (void) new_state;
+}
+
+class VboImmediate_test : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   static void vertex3f(GLfloat x, GLfloat y, GLfloat z);
+   static void vertex3fv(GLfloat x, GLfloat y, GLfloat z);
+   static void vertex_attrib(GLfloat x, GLfloat y, GLfloat z);
+   void draw_triangles(void (*vertex)(GLfloat, GLfloat, GLfloat));
+   void set_prim_id_program(bool enable);
+
+   struct gl_config visual;
+   struct dd_function_table driver_functions;
+   struct gl_context ctx;
+   struct gl_framebuffer *fb;
+   struct gl_geometry_program prim_id_program;
+};
+
+void
+VboImmediate_test::SetUp()
+{
+   memset(&visual, 0, sizeof(visual));
+   memset(&driver_functions, 0, sizeof(driver_functions));
+   memset(&ctx, 0, sizeof(ctx));
+
+   _mesa_init_driver_functions(&driver_functions);
+   driver_functions.UpdateState = update_state;
+
+   ctx.Version = 21;
+   ASSERT_TRUE(_mesa_initialize_context(&ctx, API_OPENGL_COMPAT, &visual,
+                                        NULL, &driver_functions));
+   ASSERT_TRUE(_vbo_CreateContext(&ctx));
+   vbo_set_draw_func(&ctx, record_draw);
+
+   /* Drawing needs a framebuffer, even one without renderbuffers */
+   fb = _mesa_create_framebuffer(&visual);
+   ASSERT_TRUE(_mesa_make_current(&ctx, fb, fb));
+
+   drawn_prims.clear();
+   drawn_vertices.clear();
+}
+
+void
+VboImmediate_test::TearDown()
+{
+   _vbo_DestroyContext(&ctx);
+   _mesa_free_context_data(&ctx);
+   _mesa_make_current(NULL, NULL, NULL);
+   _mesa_reference_framebuffer(&fb, NULL);
+}
+
+void
+VboImmediate_test::vertex3f(GLfloat x, GLfloat y, GLfloat z)
+{
+   CALL_Vertex3f(GET_DISPATCH(), (x, y, z));
+}
+
+void
+VboImmediate_test::vertex3fv(GLfloat x, GLfloat y, GLfloat z)
+{
+   const GLfloat v[3] = { x, y, z };
+
+   CALL_Vertex3fv(GET_DISPATCH(), (v));
+}
+
+/** Generic attribute 0 is the position, stored by the generic code */
+void
+VboImmediate_test::vertex_attrib(GLfloat x, GLfloat y, GLfloat z)
+{
+   CALL_VertexAttrib3fARB(GET_DISPATCH(), (0, x, y, z));
+}
+
+/**
+ * Draw NUM_TRIANGLES triangles of one glBegin/glEnd pair each, with a
+ * color for every vertex, and flush them.
+ */
+void
+VboImmediate_test::draw_triangles(void (*vertex)(GLfloat, GLfloat, GLfloat))
+{
+   for (GLuint t = 0; t < NUM_TRIANGLES; t++) {
+      CALL_Begin(GET_DISPATCH(), (GL_TRIANGLES));
+      for (GLuint v = 0; v < 3; v++) {
+         const GLfloat f = (GLfloat) (3 * t + v);
+
+         CALL_Color3f(GET_DISPATCH(), (f / 128.0F, 0.5F, 1.0F - f / 128.0F));
+         vertex(f, -f, 0.25F * f);
+      }
+      CALL_End(GET_DISPATCH(), ());
+   }
+
+   CALL_Flush(GET_DISPATCH(), ());
+   EXPECT_EQ((GLenum) GL_NO_ERROR, ctx.ErrorValue);
+}
+
+/**
+ * Make a geometry program that reads gl_PrimitiveIDIn current, or none.
+ * This is done without a state change, which would replace the program.
+ */
+void
+VboImmediate_test::set_prim_id_program(bool enable)
+{
+   if (enable) {
+      memset(&prim_id_program, 0, sizeof(prim_id_program));
+      prim_id_program.Base.Target = MESA_GEOMETRY_PROGRAM;
+      prim_id_program.Base.RefCount = 1;
+      prim_id_program.Base.InputsRead = GEOM_BIT_PRIM_ID;
+      ctx.GeometryProgram._Current = &prim_id_program;
+   }
+   else {
+      ctx.GeometryProgram._Current = NULL;
+   }
+}
+
+/**
+ * The vertices from the glVertex3f(v) functions for the vertex size, once
+ * they are installed, equal those from the generic attribute functions.
+ */
+TEST_F(VboImmediate_test, FastVertexMatchesGeneric)
+{
+   const _glptr_Vertex3f generic_vertex3f = GET_Vertex3f(ctx.Exec);
+   std::vector<GLfloat> generic;
+
+   /* This also installs the functions for the vertex size */
+   draw_triangles(vertex_attrib);
+   generic = drawn_vertices;
+   ASSERT_EQ((size_t) NUM_TRIANGLES * 3 * 6, generic.size());
+
+   for (GLuint i = 0; i < NUM_TRIANGLES * 3; i++) {
+      const GLfloat f = (GLfloat) i;
+
+      EXPECT_EQ(f, generic[6 * i + 0]);
+      EXPECT_EQ(-f, generic[6 * i + 1]);
+      EXPECT_EQ(0.25F * f, generic[6 * i + 2]);
+      EXPECT_EQ(f / 128.0F, generic[6 * i + 3]);
+   }
+
+   EXPECT_NE(generic_vertex3f, GET_Vertex3f(ctx.Exec));
+
+   drawn_vertices.clear();
+   draw_triangles(vertex3f);
+   EXPECT_TRUE(drawn_vertices == generic);
+
+   drawn_vertices.clear();
+   draw_triangles(vertex3fv);
+   EXPECT_TRUE(drawn_vertices == generic);
+}
+
+/**
+ * The installed functions notice a change of the vertex format.
+ */
+TEST_F(VboImmediate_test, FastVertexFormatChange)
+{
+   draw_triangles(vertex3f);
+   draw_triangles(vertex3f);
+
+   drawn_vertices.clear();
+   CALL_Begin(GET_DISPATCH(), (GL_TRIANGLES));
+   CALL_Color3f(GET_DISPATCH(), (0.5F, 0.5F, 0.5F));
+   CALL_Vertex3f(GET_DISPATCH(), (1.0F, 2.0F, 3.0F));
+   CALL_Color4f(GET_DISPATCH(), (0.25F, 0.25F, 0.25F, 0.75F));
+   CALL_Vertex3f(GET_DISPATCH(), (4.0F, 5.0F, 6.0F));
+   CALL_Vertex3f(GET_DISPATCH(), (7.0F, 8.0F, 9.0F));
+   CALL_End(GET_DISPATCH(), ());
+   CALL_Flush(GET_DISPATCH(), ());
+
+   static const GLfloat expected[] = {
+      1.0F, 2.0F, 3.0F, 0.5F, 0.5F, 0.5F, 1.0F,
+      4.0F, 5.0F, 6.0F, 0.25F, 0.25F, 0.25F, 0.75F,
+      7.0F, 8.0F, 9.0F, 0.25F, 0.25F, 0.25F, 0.75F,
+   };
+   ASSERT_EQ(Elements(expected), drawn_vertices.size());
+   EXPECT_EQ(0, memcmp(expected, &drawn_vertices[0], sizeof(expected)));
+}
+
+/**
+ * Consecutive glBegin/glEnd pairs are drawn as one primitive, but not
+ * when a geometry program reads gl_PrimitiveIDIn.
+ */
+TEST_F(VboImmediate_test, MergedPrimitives)
+{
+   draw_triangles(vertex3f);
+   ASSERT_EQ(1u, drawn_prims.size());
+   EXPECT_EQ(0u, drawn_prims[0].start);
+   EXPECT_EQ(3u * NUM_TRIANGLES, drawn_prims[0].count);
+
+   set_prim_id_program(true);
+   drawn_prims.clear();
+   draw_triangles(vertex3f);
+   set_prim_id_program(false);
+
+   ASSERT_EQ((size_t) NUM_TRIANGLES, drawn_prims.size());
+   for (GLuint i = 0; i < NUM_TRIANGLES; i++) {
+      EXPECT_EQ(3 * i, drawn_prims[i].start);
+      EXPECT_EQ(3u, drawn_prims[i].count);
+   }
+}
+
+/**
+ * The same for a display list, where the geometry program is only known
+ * when the list is executed.
+ */
+TEST_F(VboImmediate_test, DisplayListMergedPrimitives)
+{
+   const GLuint list = CALL_GenLists(GET_DISPATCH(), (1));
+   std::vector<GLfloat> immediate;
+
+   draw_triangles(vertex3f);
+   immediate = drawn_vertices;
+
+   CALL_NewList(GET_DISPATCH(), (list, GL_COMPILE));
+   draw_triangles(vertex3f);
+   CALL_EndList(GET_DISPATCH(), ());
+
+   drawn_prims.clear();
+   drawn_vertices.clear();
+   CALL_CallList(GET_DISPATCH(), (list));
+   EXPECT_EQ((GLenum) GL_NO_ERROR, ctx.ErrorValue);
+
+   ASSERT_EQ(1u, drawn_prims.size());
+   EXPECT_EQ(3u * NUM_TRIANGLES, drawn_prims[0].count);
+   EXPECT_TRUE(drawn_vertices == immediate);
+
+   set_prim_id_program(true);
+   drawn_prims.clear();
+   drawn_vertices.clear();
+   CALL_CallList(GET_DISPATCH(), (list));
+   set_prim_id_program(false);
+
+   ASSERT_EQ((size_t) NUM_TRIANGLES, drawn_prims.size());
+   for (GLuint i = 0; i < NUM_TRIANGLES; i++)
+      EXPECT_EQ(3u, drawn_prims[i].count);
+   EXPECT_TRUE(drawn_vertices == immediate);
+}
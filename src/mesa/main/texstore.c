@@ -75,6 +75,10 @@
 #include "../../gallium/auxiliary/util/u_format_rgb9e5.h"
 #include "../../gallium/auxiliary/util/u_format_r11g11b10f.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 
 enum {
    ZERO = 4, 
@@ -663,6 +667,78 @@ _mesa_make_temp_ubyte_image(struct gl_context *ctx, GLuint dims,
 }
 
 
+#if defined(__SSE2__)
+
+/**
+ * SSE2 version of swizzle_copy() for 3 or 4 component sources and 4
+ * component destinations, such as RGBA8 <-> BGRA8 and RGB8 -> RGBX8.
+ * Four pixels are handled at a time by moving each destination byte into
+ * place with shifts and masks.
+ *
+ * \return the number of pixels copied, which may be less than \p count;
+ *         the caller copies the rest.
+ */
+static GLuint
+swizzle_copy_4ubyte_sse2(GLubyte *dst, const GLubyte *src,
+                         GLuint srcComponents, const GLubyte *map,
+                         GLuint count)
+{
+   __m128i select[4], add = _mm_setzero_si128();
+   GLuint j, i = 0;
+
+   for (j = 0; j < 4; j++) {
+      select[j] = _mm_setzero_si128();
+      if (map[j] == ONE)
+         add = _mm_or_si128(add, _mm_set1_epi32(0xff << (8 * j)));
+      else if (map[j] != ZERO)
+         select[j] = _mm_set1_epi32(0xff << (8 * map[j]));
+   }
+
+   /* The 32-bit load of a 3 component pixel reads the first byte of the
+    * next one, so stop early enough not to read past the source.
+    */
+   while (i + 4 + (srcComponents == 3) <= count) {
+      __m128i p, d = add;
+
+      if (srcComponents == 4) {
+         p = _mm_loadu_si128((const __m128i *) src);
+      }
+      else {
+         GLuint w[4];
+         memcpy(&w[0], src + 0, 4);
+         memcpy(&w[1], src + 3, 4);
+         memcpy(&w[2], src + 6, 4);
+         memcpy(&w[3], src + 9, 4);
+         p = _mm_setr_epi32(w[0], w[1], w[2], w[3]);
+      }
+
+      for (j = 0; j < 4; j++) {
+         const int from = 8 * map[j], to = 8 * j;
+         __m128i c;
+
+         if (map[j] >= ZERO)
+            continue;
+
+         c = _mm_and_si128(p, select[j]);
+         if (from > to)
+            c = _mm_srl_epi32(c, _mm_cvtsi32_si128(from - to));
+         else if (from < to)
+            c = _mm_sll_epi32(c, _mm_cvtsi32_si128(to - from));
+         d = _mm_or_si128(d, c);
+      }
+
+      _mm_storeu_si128((__m128i *) dst, d);
+      src += 4 * srcComponents;
+      dst += 16;
+      i += 4;
+   }
+
+   return i;
+}
+
+#endif /* __SSE2__ */
+
+
 /**
  * Copy GLubyte pixels from <src> to <dst> with swizzling.
  * \param dst  destination pixels
@@ -707,6 +783,16 @@ swizzle_copy(GLubyte *dst, GLuint dstComponents, const GLubyte *src,
    ASSERT(srcComponents <= 4);
    ASSERT(dstComponents <= 4);
 
+#if defined(__SSE2__)
+   if (dstComponents == 4 && srcComponents >= 3) {
+      const GLuint done =
+         swizzle_copy_4ubyte_sse2(dst, src, srcComponents, map, count);
+      dst += done * dstComponents;
+      src += done * srcComponents;
+      count -= done;
+   }
+#endif
+
    switch (dstComponents) {
    case 4:
       switch (srcComponents) {
@@ -838,6 +924,105 @@ byteswap_mapping( GLboolean swapBytes,
 
 
 
+/**
+ * Convert one row of \p width texels from \p src to \p dst.
+ */
+typedef void (*convert_row_func)(GLubyte *dst, const GLubyte *src,
+                                 GLuint width, const void *data);
+
+
+/** The rows of an image to be converted by convert_image_rows() */
+struct row_job
+{
+   convert_row_func convert;
+   const void *data;
+   GLuint width;
+   const GLubyte *src;
+   GLint srcRowStride;
+   GLubyte *dst;
+   GLint dstRowStride;
+};
+
+
+/** Fewest destination bytes worth handing to another thread */
+#define TEXSTORE_MIN_STRIPE_BYTES (1 << 20)
+
+
+static void
+convert_rows(void *data, GLuint first, GLuint end)
+{
+   const struct row_job *job = (const struct row_job *) data;
+   const GLubyte *src = job->src + (GLintptr) first * job->srcRowStride;
+   GLubyte *dst = job->dst + (GLintptr) first * job->dstRowStride;
+   GLuint row;
+
+   for (row = first; row < end; row++) {
+      job->convert(dst, src, job->width, job->data);
+      src += job->srcRowStride;
+      dst += job->dstRowStride;
+   }
+}
+
+
+/**
+ * Convert \p height rows of an image.  Large images are split into
+ * stripes of rows that are converted in parallel.
+ *
+ * \param dstRowBytes  bytes written per row, used to decide how many
+ *                     threads are worth starting
+ */
+static void
+convert_image_rows(convert_row_func convert, const void *data,
+                   GLuint width, GLint height,
+                   const GLubyte *src, GLint srcRowStride,
+                   GLubyte *dst, GLint dstRowStride,
+                   GLuint dstRowBytes)
+{
+   const GLuint64 bytes = (GLuint64) dstRowBytes * height;
+   const GLuint stripes = (GLuint) MIN2(_mesa_num_threads(),
+                                        bytes / TEXSTORE_MIN_STRIPE_BYTES);
+   struct row_job job;
+
+   job.convert = convert;
+   job.data = data;
+   job.width = width;
+   job.src = src;
+   job.srcRowStride = srcRowStride;
+   job.dst = dst;
+   job.dstRowStride = dstRowStride;
+
+   _mesa_parallel_for(height, stripes, convert_rows, &job);
+}
+
+
+static void
+memcpy_row(GLubyte *dst, const GLubyte *src, GLuint width, const void *data)
+{
+   (void) data;
+   memcpy(dst, src, width);
+}
+
+
+/** What swizzle_row() needs besides the pixels */
+struct swizzle_row_info
+{
+   GLuint dstComponents;
+   GLuint srcComponents;
+   GLubyte map[4];
+};
+
+
+static void
+swizzle_row(GLubyte *dst, const GLubyte *src, GLuint width, const void *data)
+{
+   const struct swizzle_row_info *info =
+      (const struct swizzle_row_info *) data;
+
+   swizzle_copy(dst, info->dstComponents, src, info->srcComponents,
+                info->map, width);
+}
+
+
 /**
  * Transfer a GLubyte texture image with component swizzling.
  */
@@ -861,8 +1046,9 @@ _mesa_swizzle_ubyte_image(struct gl_context *ctx,
 {
    GLint srcComponents = _mesa_components_in_format(srcFormat);
    const GLubyte *srctype2ubyte, *swap;
-   GLubyte map[4], src2base[6], base2rgba[6];
-   GLint i;
+   GLubyte src2base[6], base2rgba[6];
+   struct swizzle_row_info info;
+   GLint i, img;
    const GLint srcRowStride =
       _mesa_image_row_stride(srcPacking, srcWidth,
                              srcFormat, GL_UNSIGNED_BYTE);
@@ -887,31 +1073,17 @@ _mesa_swizzle_ubyte_image(struct gl_context *ctx,
 
 
    for (i = 0; i < 4; i++)
-      map[i] = srctype2ubyte[swap[src2base[base2rgba[rgba2dst[i]]]]];
-
-/*    printf("map %d %d %d %d\n", map[0], map[1], map[2], map[3]);  */
-
-   if (srcComponents == dstComponents &&
-       srcRowStride == dstRowStride &&
-       srcRowStride == srcWidth * srcComponents &&
-       dimensions < 3) {
-      /* 1 and 2D images only */
-      GLubyte *dstImage = dstSlices[0];
-      swizzle_copy(dstImage, dstComponents, srcImage, srcComponents, map, 
-		   srcWidth * srcHeight);
-   }
-   else {
-      GLint img, row;
-      for (img = 0; img < srcDepth; img++) {
-         const GLubyte *srcRow = srcImage;
-         GLubyte *dstRow = dstSlices[img];
-         for (row = 0; row < srcHeight; row++) {
-	    swizzle_copy(dstRow, dstComponents, srcRow, srcComponents, map, srcWidth);
-            dstRow += dstRowStride;
-            srcRow += srcRowStride;
-         }
-         srcImage += srcImageStride;
-      }
+      info.map[i] = srctype2ubyte[swap[src2base[base2rgba[rgba2dst[i]]]]];
+
+   info.dstComponents = dstComponents;
+   info.srcComponents = srcComponents;
+
+   for (img = 0; img < srcDepth; img++) {
+      convert_image_rows(swizzle_row, &info, srcWidth, srcHeight,
+                         srcImage, srcRowStride,
+                         dstSlices[img], dstRowStride,
+                         srcWidth * dstComponents);
+      srcImage += srcImageStride;
    }
 }
 
@@ -940,30 +1112,23 @@ memcpy_texture(struct gl_context *ctx,
         srcPacking, srcAddr, srcWidth, srcHeight, srcFormat, srcType, 0, 0, 0);
    const GLuint texelBytes = _mesa_get_format_bytes(dstFormat);
    const GLint bytesPerRow = srcWidth * texelBytes;
+   GLint img;
 
-   if (dstRowStride == srcRowStride &&
-       dstRowStride == bytesPerRow) {
-      /* memcpy image by image */
-      GLint img;
-      for (img = 0; img < srcDepth; img++) {
-         GLubyte *dstImage = dstSlices[img];
-         memcpy(dstImage, srcImage, bytesPerRow * srcHeight);
-         srcImage += srcImageStride;
+   for (img = 0; img < srcDepth; img++) {
+      if (dstRowStride == srcRowStride &&
+          dstRowStride == bytesPerRow &&
+          srcHeight * bytesPerRow < TEXSTORE_MIN_STRIPE_BYTES) {
+         /* memcpy the whole image at once */
+         memcpy(dstSlices[img], srcImage, bytesPerRow * srcHeight);
       }
-   }
-   else {
-      /* memcpy row by row */
-      GLint img, row;
-      for (img = 0; img < srcDepth; img++) {
-         const GLubyte *srcRow = srcImage;
-         GLubyte *dstRow = dstSlices[img];
-         for (row = 0; row < srcHeight; row++) {
-            memcpy(dstRow, srcRow, bytesPerRow);
-            dstRow += dstRowStride;
-            srcRow += srcRowStride;
-         }
-         srcImage += srcImageStride;
+      else {
+         /* memcpy row by row */
+         convert_image_rows(memcpy_row, NULL, bytesPerRow, srcHeight,
+                            srcImage, srcRowStride,
+                            dstSlices[img], dstRowStride,
+                            bytesPerRow);
       }
+      srcImage += srcImageStride;
    }
 }
 
@@ -3004,6 +3169,17 @@ _mesa_texstore_s8(TEXSTORE_PARAMS)
 }
 
 
+/** convert_row_func for float -> half float; \p width is in floats */
+static void
+float_to_half_row(GLubyte *dstRow, const GLubyte *srcRow, GLuint width,
+                  const void *data)
+{
+   (void) data;
+   _mesa_float_to_half_array((GLhalfARB *) dstRow, (const GLfloat *) srcRow,
+                             width);
+}
+
+
 /**
  * Store an image in any of the formats:
  *   _mesa_texformat_rgba_float32
@@ -3119,6 +3295,27 @@ _mesa_texstore_rgba_float16(TEXSTORE_PARAMS)
                      srcWidth, srcHeight, srcDepth, srcFormat, srcType,
                      srcAddr, srcPacking);
    }
+   else if (!ctx->_ImageTransferState &&
+            !srcPacking->SwapBytes &&
+            baseInternalFormat == srcFormat &&
+            baseInternalFormat == baseFormat &&
+            srcType == GL_FLOAT) {
+      /* direct float -> half conversion, without a temporary image */
+      const GLint srcRowStride =
+         _mesa_image_row_stride(srcPacking, srcWidth, srcFormat, srcType);
+      GLint img;
+
+      for (img = 0; img < srcDepth; img++) {
+         const GLubyte *srcImage = (const GLubyte *)
+            _mesa_image_address(dims, srcPacking, srcAddr, srcWidth,
+                                srcHeight, srcFormat, srcType, img, 0, 0);
+         convert_image_rows(float_to_half_row, NULL,
+                            srcWidth * components, srcHeight,
+                            srcImage, srcRowStride,
+                            dstSlices[img], dstRowStride,
+                            srcWidth * components * sizeof(GLhalfARB));
+      }
+   }
    else {
       /* general path */
       const GLfloat *tempImage = _mesa_make_temp_float_image(ctx, dims,
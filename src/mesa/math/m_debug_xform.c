@@ -165,8 +165,63 @@ ALIGN16(static GLfloat, s[TEST_COUNT][4]);
 ALIGN16(static GLfloat, d[TEST_COUNT][4]);
 ALIGN16(static GLfloat, r[TEST_COUNT][4]);
 
+
+#ifdef RUN_DEBUG_BENCHMARK
+
+#define BENCH_COUNT		4096	/* vertices per throughput run */
+
+ALIGN16(static GLfloat, bench_s[BENCH_COUNT][4]);
+ALIGN16(static GLfloat, bench_d[BENCH_COUNT][4]);
+
+/* The TEST_COUNT timings above are dominated by call and setup
+ * overhead.  This measures the steady-state cost of the inner loop
+ * instead, over a vector which still fits in the L1/L2 caches.
+ * Returns the best of several runs, in cycles per vertex.
+ */
+static double bench_transform_function( transform_func func, int psize,
+					const GLfloat *m )
+{
+   GLvector4f source[1], dest[1];
+   unsigned long cycles;
+   int cycle_i;
+   int i, j;
+
+   for ( i = 0 ; i < BENCH_COUNT ; i++ ) {
+      ASSIGN_4V( bench_s[i], 0.0, 0.0, 0.0, 1.0 );
+      for ( j = 0 ; j < psize ; j++ )
+         bench_s[i][j] = rnd();
+   }
+
+   source->data = (GLfloat(*)[4])bench_s;
+   source->start = (GLfloat *)bench_s;
+   source->count = BENCH_COUNT;
+   source->stride = sizeof(bench_s[0]);
+   source->size = 4;
+   source->flags = 0;
+
+   dest->data = (GLfloat(*)[4])bench_d;
+   dest->start = (GLfloat *)bench_d;
+   dest->count = BENCH_COUNT;
+   dest->stride = sizeof(bench_d[0]);
+   dest->size = 0;
+   dest->flags = 0;
+
+   /* warm the caches */
+   func( dest, m, source );
+
+   BEGIN_RACE( cycles );
+   func( dest, m, source );
+   END_RACE( cycles );
+
+   return (double) cycles / BENCH_COUNT;
+}
+
+#endif
+
+
 static int test_transform_function( transform_func func, int psize,
-				    int mtype, unsigned long *cycles )
+				    int mtype, unsigned long *cycles,
+				    double *throughput )
 {
    GLvector4f source[1], dest[1], ref[1];
    GLmatrix mat[1];
@@ -177,6 +232,7 @@ static int test_transform_function( transform_func func, int psize,
 #endif
 
    (void) cycles;
+   (void) throughput;
 
    if ( psize > 4 ) {
       _mesa_problem( NULL, "test_transform_function called with psize > 4\n" );
@@ -273,6 +329,11 @@ static int test_transform_function( transform_func func, int psize,
       }
    }
 
+#ifdef RUN_DEBUG_BENCHMARK
+   if ( mesa_profile )
+      *throughput = bench_transform_function( func, psize, mat->m );
+#endif
+
    _mesa_align_free( mat->m );
    return 1;
 }
@@ -281,6 +342,7 @@ void _math_test_all_transform_functions( char *description )
 {
    int psize, mtype;
    unsigned long benchmark_tab[4][7];
+   double throughput_tab[4][7];
    static int first_time = 1;
 
    if ( first_time ) {
@@ -312,8 +374,10 @@ void _math_test_all_transform_functions( char *description )
       for ( psize = 1 ; psize <= 4 ; psize++ ) {
 	 transform_func func = _mesa_transform_tab[psize][mtypes[mtype]];
 	 unsigned long *cycles = &(benchmark_tab[psize-1][mtype]);
+	 double *throughput = &(throughput_tab[psize-1][mtype]);
 
-	 if ( test_transform_function( func, psize, mtype, cycles ) == 0 ) {
+	 if ( test_transform_function( func, psize, mtype,
+				       cycles, throughput ) == 0 ) {
 	    char buf[100];
 	    sprintf(buf, "_mesa_transform_tab[0][%d][%s] failed test (%s)",
 		    psize, mstrings[mtype], description );
@@ -330,8 +394,21 @@ void _math_test_all_transform_functions( char *description )
 #endif
    }
 #ifdef RUN_DEBUG_BENCHMARK
-   if ( mesa_profile )
+   if ( mesa_profile ) {
+      printf( "\nthroughput in cycles/vertex over %d vertices:\n",
+	      BENCH_COUNT );
+      for ( psize = 1 ; psize <= 4 ; psize++ ) {
+	 printf(" p%d\t", psize );
+      }
+      printf("\n--------------------------------------------------------\n" );
+      for ( mtype = 0 ; mtype < 7 ; mtype++ ) {
+	 for ( psize = 1 ; psize <= 4 ; psize++ ) {
+	    printf(" %.2f\t", throughput_tab[psize-1][mtype] );
+	 }
+	 printf(" | [%s]\n", mstrings[mtype] );
+      }
       printf( "\n" );
+   }
 #endif
 }
 
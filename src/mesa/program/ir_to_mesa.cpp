@@ -40,8 +40,10 @@
 #include "glsl_parser_extras.h"
 #include "../glsl/program.h"
 #include "ir_optimization.h"
+#include "ir_stats.h"
 #include "ast.h"
 #include "linker.h"
+#include "shader_cache.h"
 
 #include "main/mtypes.h"
 #include "main/shaderobj.h"
@@ -2975,8 +2977,8 @@ _mesa_ir_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
 
 	 progress = do_lower_jumps(ir, true, true, options->EmitNoMainReturn, options->EmitNoCont, options->EmitNoLoops) || progress;
 
-	 progress = do_common_optimization(ir, true, true,
-					   options->MaxUnrollIterations)
+	 progress = do_common_optimization_loop(ir, true, true,
+						options->MaxUnrollIterations)
 	   || progress;
 
 	 progress = lower_quadop_vector(ir, true) || progress;
@@ -3042,6 +3044,104 @@ _mesa_ir_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
 }
 
 
+/**
+ * A source prefix preprocessed on its own, see preprocess_shader().
+ */
+struct source_prefix {
+   char *text;
+   unsigned length;
+
+   /** \c NULL if the source can't be split after the prefix */
+   struct glcpp_prefix *prefix;
+};
+
+/**
+ * Run the preprocessor on a shader's source.
+ *
+ * Generated shaders often start with a long header of #defines shared by
+ * all of them, passed as the first glShaderSource string.  The context
+ * keeps the last such header preprocessed, so that only the rest has to be
+ * lexed and parsed while the following shaders start with the same text.
+ */
+static int
+preprocess_shader(struct gl_context *ctx, struct gl_shader *shader,
+		  struct _mesa_glsl_parse_state *state, const char **source)
+{
+   const unsigned length = shader->SourcePrefixLength;
+   const char *text = shader->Source;
+
+   /* The prefix has to be made of whole lines. */
+   if (length < 2 || text[length - 1] != '\n' || text[length - 2] == '\\')
+      return glcpp_preprocess(state, source, &state->info_log,
+			      &ctx->Extensions, ctx->API);
+
+   source_prefix *cache = (source_prefix *) ctx->Shader.SourcePrefix;
+   if (cache == NULL || cache->length != length
+       || memcmp(cache->text, text, length) != 0) {
+      ralloc_free(cache);
+      cache = rzalloc(NULL, source_prefix);
+      cache->text = ralloc_strndup(cache, text, length);
+      cache->length = length;
+
+      /* Errors are reported when the whole source is preprocessed. */
+      char *info_log = ralloc_strdup(cache, "");
+      cache->prefix = glcpp_prefix_create(cache, cache->text, &info_log,
+					  &ctx->Extensions, ctx->API);
+      ralloc_free(info_log);
+
+      ctx->Shader.SourcePrefix = cache;
+   }
+
+   if (cache->prefix == NULL)
+      return glcpp_preprocess(state, source, &state->info_log,
+			      &ctx->Extensions, ctx->API);
+
+   *source = text + length;
+   return glcpp_preprocess_with_prefix(state, cache->prefix, source,
+				       &state->info_log);
+}
+
+
+/**
+ * Print the source of a shader for MESA_GLSL=dump
+ */
+static void
+dump_shader_source(struct gl_context *ctx, struct gl_shader *shader,
+		   struct _mesa_glsl_parse_state *state)
+{
+   if (ctx->Shader.Flags & GLSL_DUMP) {
+      printf("GLSL source for %s shader %d:\n",
+	     _mesa_glsl_shader_target_name(state->target), shader->Name);
+      printf("%s\n", shader->Source);
+   }
+}
+
+/**
+ * Handle MESA_GLSL=log and the IR part of MESA_GLSL=dump for a shader that
+ * was compiled or read from the shader cache
+ */
+static void
+dump_compiled_shader(struct gl_context *ctx, struct gl_shader *shader)
+{
+   if (ctx->Shader.Flags & GLSL_LOG) {
+      _mesa_write_shader_to_file(shader);
+   }
+
+   if (ctx->Shader.Flags & GLSL_DUMP) {
+      if (shader->CompileStatus) {
+	 printf("GLSL IR for shader %d:\n", shader->Name);
+	 _mesa_print_ir(shader->ir, NULL);
+	 printf("\n\n");
+      } else {
+	 printf("GLSL shader %d failed to compile.\n", shader->Name);
+      }
+      if (shader->InfoLog && shader->InfoLog[0] != 0) {
+	 printf("GLSL shader %d info log:\n", shader->Name);
+	 printf("%s\n", shader->InfoLog);
+      }
+   }
+}
+
 /**
  * Compile a GLSL shader.  Called via glCompileShader().
  */
@@ -3060,25 +3160,41 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader)
       return;
    }
 
-   state->error = glcpp_preprocess(state, &source, &state->info_log,
-			     &ctx->Extensions, ctx->API);
+   struct glsl_shader_stats stats;
+   glsl_stats_init(&stats);
 
-   if (ctx->Shader.Flags & GLSL_DUMP) {
-      printf("GLSL source for %s shader %d:\n",
-	     _mesa_glsl_shader_target_name(state->target), shader->Name);
-      printf("%s\n", shader->Source);
+   if (glsl_cache_load_shader(shader, state)) {
+      dump_shader_source(ctx, shader, state);
+      dump_compiled_shader(ctx, shader);
+
+      if (ctx->Shader.Flags & GLSL_STATS) {
+	 stats.cached = true;
+	 glsl_stats_print(stdout, "compile", shader->Name, shader, &stats);
+      }
+      ralloc_free(state);
+      return;
    }
 
+   double start = glsl_stats_get_time();
+   state->error = preprocess_shader(ctx, shader, state, &source);
+   stats.seconds[GLSL_PHASE_PREPROCESS] = glsl_stats_get_time() - start;
+
+   dump_shader_source(ctx, shader, state);
+
+   start = glsl_stats_get_time();
    if (!state->error) {
      _mesa_glsl_lexer_ctor(state, source);
      _mesa_glsl_parse(state);
      _mesa_glsl_lexer_dtor(state);
    }
+   stats.seconds[GLSL_PHASE_PARSE] = glsl_stats_get_time() - start;
 
+   start = glsl_stats_get_time();
    ralloc_free(shader->ir);
    shader->ir = new(shader) exec_list;
    if (!state->error && !state->translation_unit.is_empty())
       _mesa_ast_to_hir(shader->ir, state);
+   stats.seconds[GLSL_PHASE_AST_TO_HIR] = glsl_stats_get_time() - start;
 
    if (!state->error && !shader->ir->is_empty()) {
       validate_ir_tree(shader->ir);
@@ -3086,8 +3202,9 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader)
       /* Do some optimization at compile time to reduce shader IR size
        * and reduce later work if the same shader is linked multiple times
        */
-      while (do_common_optimization(shader->ir, false, false, 32))
-	 ;
+      start = glsl_stats_get_time();
+      do_common_optimization_loop(shader->ir, false, false, 32, &stats);
+      stats.seconds[GLSL_PHASE_OPTIMIZE] = glsl_stats_get_time() - start;
 
       validate_ir_tree(shader->ir);
    }
@@ -3101,23 +3218,10 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader)
 	  sizeof(shader->builtins_to_link[0]) * state->num_builtins_to_link);
    shader->num_builtins_to_link = state->num_builtins_to_link;
 
-   if (ctx->Shader.Flags & GLSL_LOG) {
-      _mesa_write_shader_to_file(shader);
-   }
+   dump_compiled_shader(ctx, shader);
 
-   if (ctx->Shader.Flags & GLSL_DUMP) {
-      if (shader->CompileStatus) {
-	 printf("GLSL IR for shader %d:\n", shader->Name);
-	 _mesa_print_ir(shader->ir, NULL);
-	 printf("\n\n");
-      } else {
-	 printf("GLSL shader %d failed to compile.\n", shader->Name);
-      }
-      if (shader->InfoLog && shader->InfoLog[0] != 0) {
-	 printf("GLSL shader %d info log:\n", shader->Name);
-	 printf("%s\n", shader->InfoLog);
-      }
-   }
+   if ((ctx->Shader.Flags & GLSL_STATS) && shader->CompileStatus)
+      glsl_stats_print(stdout, "compile", shader->Name, shader, &stats);
 
    if (shader->UniformBlocks)
       ralloc_free(shader->UniformBlocks);
@@ -3125,6 +3229,9 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader)
    shader->UniformBlocks = state->uniform_blocks;
    ralloc_steal(shader, shader->UniformBlocks);
 
+   if (shader->CompileStatus)
+      glsl_cache_store_shader(shader, state);
+
    /* Retain any live IR, but trash the rest. */
    reparent_ir(shader->ir, shader->ir);
 
@@ -3151,14 +3258,32 @@ _mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
       }
    }
 
+   struct glsl_shader_stats stats[MESA_SHADER_TYPES];
+
    if (prog->LinkStatus) {
-      link_shaders(ctx, prog);
+      link_shaders(ctx, prog, stats);
    }
 
    if (prog->LinkStatus) {
+      const double start = glsl_stats_get_time();
+
       if (!ctx->Driver.LinkShader(ctx, prog)) {
 	 prog->LinkStatus = GL_FALSE;
       }
+
+      /* Report the IR the driver lowered and translated. */
+      if ((ctx->Shader.Flags & GLSL_STATS) && prog->LinkStatus) {
+	 const double seconds = glsl_stats_get_time() - start;
+
+	 for (i = 0; i < MESA_SHADER_TYPES; i++) {
+	    if (prog->_LinkedShaders[i] == NULL)
+	       continue;
+
+	    stats[i].seconds[GLSL_PHASE_DRIVER_LINK] = seconds;
+	    glsl_stats_print(stdout, "link", prog->Name,
+			     prog->_LinkedShaders[i], &stats[i]);
+	 }
+      }
    }
 
    if (ctx->Shader.Flags & GLSL_DUMP) {
@@ -57,6 +57,8 @@ MAIN_FILES = \
 	$(SRCDIR)main/imports.c \
 	$(SRCDIR)main/light.c \
 	$(SRCDIR)main/lines.c \
+	$(SRCDIR)main/marshal.c \
+	$(BUILDDIR)main/marshal_generated.c \
 	$(SRCDIR)main/matrix.c \
 	$(SRCDIR)main/mipmap.c \
 	$(SRCDIR)main/mm.c \
@@ -150,6 +152,7 @@ SWRAST_FILES = \
 	$(SRCDIR)swrast/s_texfilter.c \
 	$(SRCDIR)swrast/s_texrender.c \
 	$(SRCDIR)swrast/s_texture.c \
+	$(SRCDIR)swrast/s_tile.c \
 	$(SRCDIR)swrast/s_triangle.c \
 	$(SRCDIR)swrast/s_zoom.c
 
@@ -276,7 +279,12 @@ ASM_C_FILES =	\
 	$(SRCDIR)x86/sse.c \
 	$(SRCDIR)x86/rtasm/x86sse.c \
 	$(SRCDIR)sparc/sparc.c \
-	$(SRCDIR)x86-64/x86-64.c
+	$(SRCDIR)x86-64/x86-64.c \
+	$(SRCDIR)x86-64/sse41.c \
+	$(SRCDIR)x86-64/avx2.c \
+	$(SRCDIR)x86-64/avx2_mipmap.c \
+	$(SRCDIR)x86-64/avx2_texfilter.c \
+	$(SRCDIR)x86-64/f16c.c
 
 X86_FILES =			\
 	$(SRCDIR)x86/common_x86_asm.S	\
@@ -33,6 +33,7 @@
 #include "st_context.h"
 #include "st_atom.h"
 #include "st_cb_bitmap.h"
+#include "st_draw.h"
 #include "st_program.h"
 #include "st_manager.h"
 
@@ -71,9 +72,34 @@ static const struct st_tracked_state *atoms[] =
 };
 
 
+/**
+ * Build the reverse mapping from state flags to the atoms that depend on
+ * them, so that validation only visits atoms with dirty inputs.
+ */
 void st_init_atoms( struct st_context *st )
 {
-   /* no-op */
+   GLuint i, bit;
+
+   STATIC_ASSERT(Elements(atoms) <= 32);
+
+   memset(st->atoms_for_mesa, 0, sizeof(st->atoms_for_mesa));
+   memset(st->atoms_for_st, 0, sizeof(st->atoms_for_st));
+
+   for (i = 0; i < Elements(atoms); i++) {
+      const struct st_tracked_state *atom = atoms[i];
+
+      if (!(atom->dirty.mesa || atom->dirty.st) || !atom->update) {
+	 printf("malformed atom %s\n", atom->name);
+	 assert(0);
+      }
+
+      for (bit = 0; bit < 32; bit++) {
+	 if (atom->dirty.mesa & (1u << bit))
+	    st->atoms_for_mesa[bit] |= 1u << i;
+	 if (atom->dirty.st & (1u << bit))
+	    st->atoms_for_st[bit] |= 1u << i;
+      }
+   }
 }
 
 
@@ -86,6 +112,7 @@ void st_destroy_atoms( struct st_context *st )
 /***********************************************************************
  */
 
+#ifdef DEBUG
 static GLboolean check_state( const struct st_state_flags *a,
 			      const struct st_state_flags *b )
 {
@@ -99,6 +126,33 @@ static void accumulate_state( struct st_state_flags *a,
    a->mesa |= b->mesa;
    a->st |= b->st;
 }
+#endif
+
+
+/**
+ * Mask of the atoms that depend on any of the given state flags
+ */
+static GLuint atoms_for_state( const struct st_context *st,
+			       const struct st_state_flags *flags )
+{
+   GLuint mesa = flags->mesa;
+   GLuint state = flags->st;
+   GLuint mask = 0;
+
+   while (mesa) {
+      const int bit = ffs(mesa) - 1;
+      mesa &= ~(1u << bit);
+      mask |= st->atoms_for_mesa[bit];
+   }
+
+   while (state) {
+      const int bit = ffs(state) - 1;
+      state &= ~(1u << bit);
+      mask |= st->atoms_for_st[bit];
+   }
+
+   return mask;
+}
 
 
 static void xor_states( struct st_state_flags *result,
@@ -150,7 +204,10 @@ static void check_attrib_edgeflag(struct st_context *st)
 void st_validate_state( struct st_context *st )
 {
    struct st_state_flags *state = &st->dirty;
-   GLuint i;
+   GLuint pending, i;
+
+   /* Draws waiting to be merged were made with the old state. */
+   st_flush_draw_batch(st);
 
    /* Get Mesa driver state. */
    st->dirty.st |= st->ctx->NewDriverState;
@@ -174,53 +231,37 @@ void st_validate_state( struct st_context *st )
 
    /*printf("%s %x/%x\n", __FUNCTION__, state->mesa, state->st);*/
 
-#ifdef DEBUG
-   if (1) {
-#else
-   if (0) {
-#endif
-      /* Debug version which enforces various sanity checks on the
-       * state flags which are generated and checked to help ensure
-       * state atoms are ordered correctly in the list.
-       */
-      struct st_state_flags examined, prev;      
-      memset(&examined, 0, sizeof(examined));
-      prev = *state;
-
-      for (i = 0; i < Elements(atoms); i++) {	 
-	 const struct st_tracked_state *atom = atoms[i];
-	 struct st_state_flags generated;
-	 
-	 /*printf("atom %s %x/%x\n", atom->name, atom->dirty.mesa, atom->dirty.st);*/
+   /* Visit only the atoms whose inputs are dirty, in list order.  An atom
+    * may flag more state as dirty, which can only affect the atoms after it.
+    */
+   pending = atoms_for_state(st, state);
 
-	 if (!(atom->dirty.mesa || atom->dirty.st) ||
-	     !atom->update) {
-	    printf("malformed atom %s\n", atom->name);
-	    assert(0);
-	 }
+   while (pending) {
+      struct st_state_flags prev, generated;
 
-	 if (check_state(state, &atom->dirty)) {
-	    atoms[i]->update( st );
-	    /*printf("after: %x\n", atom->dirty.mesa);*/
-	 }
+      i = ffs(pending) - 1;
+      pending &= ~(1u << i);
 
-	 accumulate_state(&examined, &atom->dirty);
+      prev = *state;
+      atoms[i]->update( st );
 
-	 /* generated = (prev ^ state)
-	  * if (examined & generated)
-	  *     fail;
+      xor_states(&generated, &prev, state);
+      if (generated.mesa || generated.st) {
+#ifdef DEBUG
+	 /* Debug check which helps ensure state atoms are ordered correctly
+	  * in the list: no atom may generate state that an earlier atom
+	  * depends on.
 	  */
-	 xor_states(&generated, &prev, state);
-	 assert(!check_state(&examined, &generated));
-	 prev = *state;
-      }
-      /*printf("\n");*/
+	 struct st_state_flags examined;
+	 GLuint j;
 
-   }
-   else {
-      for (i = 0; i < Elements(atoms); i++) {	 
-	 if (check_state(state, &atoms[i]->dirty))
-	    atoms[i]->update( st );
+	 memset(&examined, 0, sizeof(examined));
+	 for (j = 0; j <= i; j++)
+	    accumulate_state(&examined, &atoms[j]->dirty);
+
+	 assert(!check_state(&examined, &generated));
+#endif
+	 pending |= atoms_for_state(st, &generated) & ~((2u << i) - 1);
       }
    }
 
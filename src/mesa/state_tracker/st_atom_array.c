@@ -535,7 +535,7 @@ static void update_array(struct st_context *st)
    const struct st_vp_variant *vpv;
    struct pipe_vertex_buffer vbuffer[PIPE_MAX_SHADER_INPUTS];
    struct pipe_vertex_element velements[PIPE_MAX_ATTRIBS];
-   unsigned num_vbuffers, num_velements;
+   unsigned num_vbuffers, num_velements, i;
 
    st->vertex_array_out_of_memory = FALSE;
 
@@ -574,6 +574,12 @@ static void update_array(struct st_context *st)
       num_velements = vpv->num_inputs;
    }
 
+   st->user_vertex_buffers = FALSE;
+   for (i = 0; i < num_vbuffers; i++) {
+      if (vbuffer[i].user_buffer)
+         st->user_vertex_buffers = TRUE;
+   }
+
    cso_set_vertex_buffers(st->cso_context, 0, num_vbuffers, vbuffer);
    if (st->last_num_vbuffers > num_vbuffers) {
       /* Unbind remaining buffers, if any. */
@@ -38,6 +38,8 @@
 
 #include "st_context.h"
 #include "st_cb_bufferobjects.h"
+#include "st_cb_readpixels.h"
+#include "st_draw.h"
 
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
@@ -115,6 +117,12 @@ st_bufferobj_subdata(struct gl_context *ctx,
    if (!data)
       return;
 
+   /* Draws waiting to be merged may still read the old contents, and
+    * glReadPixels may not have written theirs yet.
+    */
+   st_flush_draw_batch(st_context(ctx));
+   st_finish_readpixels(st_context(ctx), obj);
+
    if (!st_obj->buffer) {
       /* we probably ran out of memory during buffer allocation */
       return;
@@ -156,6 +164,8 @@ st_bufferobj_get_subdata(struct gl_context *ctx,
       return;
    }
 
+   st_flush_draw_batch(st_context(ctx));
+   st_finish_readpixels(st_context(ctx), obj);
    pipe_buffer_read(st_context(ctx)->pipe, st_obj->buffer,
                     offset, size, data);
 }
@@ -181,6 +191,9 @@ st_bufferobj_data(struct gl_context *ctx,
    struct st_buffer_object *st_obj = st_buffer_object(obj);
    unsigned bind, pipe_usage;
 
+   st_flush_draw_batch(st);
+   st_discard_readpixels(st, obj);
+
    st_obj->Base.Size = size;
    st_obj->Base.Usage = usage;
    
@@ -255,6 +268,13 @@ st_bufferobj_map_range(struct gl_context *ctx,
    struct st_buffer_object *st_obj = st_buffer_object(obj);
    enum pipe_transfer_usage flags = 0x0;
 
+   st_flush_draw_batch(st_context(ctx));
+
+   if (access & GL_MAP_INVALIDATE_BUFFER_BIT)
+      st_discard_readpixels(st_context(ctx), obj);
+   else
+      st_finish_readpixels(st_context(ctx), obj);
+
    if (access & GL_MAP_WRITE_BIT)
       flags |= PIPE_TRANSFER_WRITE;
 
@@ -366,6 +386,10 @@ st_copy_buffer_subdata(struct gl_context *ctx,
    if(!size)
       return;
 
+   st_flush_draw_batch(st_context(ctx));
+   st_finish_readpixels(st_context(ctx), src);
+   st_finish_readpixels(st_context(ctx), dst);
+
    /* buffer should not already be mapped */
    assert(!src->Pointer);
    assert(!dst->Pointer);
@@ -42,6 +42,7 @@
 #include "st_cb_queryobj.h"
 #include "st_cb_condrender.h"
 #include "st_cb_bitmap.h"
+#include "st_draw.h"
 
 
 /**
@@ -58,6 +59,8 @@ st_BeginConditionalRender(struct gl_context *ctx, struct gl_query_object *q,
 
    st_flush_bitmap_cache(st);
 
+   st_flush_draw_batch(st);
+
    switch (mode) {
    case GL_QUERY_WAIT:
       m = PIPE_RENDER_COND_WAIT;
@@ -95,6 +98,8 @@ st_EndConditionalRender(struct gl_context *ctx, struct gl_query_object *q)
 
    st_flush_bitmap_cache(st);
 
+   st_flush_draw_batch(st);
+
    pipe->render_condition(pipe, NULL, 0);
    st->render_condition = NULL;
 }
@@ -36,9 +36,11 @@
 #include "main/context.h"
 #include "st_context.h"
 #include "st_cb_bitmap.h"
+#include "st_draw.h"
 #include "st_cb_flush.h"
 #include "st_cb_clear.h"
 #include "st_cb_fbo.h"
+#include "st_cb_readpixels.h"
 #include "st_manager.h"
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
@@ -83,6 +85,8 @@ void st_flush( struct st_context *st,
 
    st_flush_bitmap_cache(st);
 
+   st_flush_draw_batch(st);
+
    st->pipe->flush( st->pipe, fence );
 }
 
@@ -101,6 +105,9 @@ void st_finish( struct st_context *st )
                                      PIPE_TIMEOUT_INFINITE);
       st->pipe->screen->fence_reference(st->pipe->screen, &fence, NULL);
    }
+
+   /* Buffer objects may be mapped by another context after this. */
+   st_finish_readpixels(st, NULL);
 }
 
 
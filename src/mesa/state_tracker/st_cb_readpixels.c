@@ -26,13 +26,546 @@
  **************************************************************************/
 
 
+/**
+ * glReadPixels.
+ *
+ * A glReadPixels into a buffer object doesn't have to wait for the GPU:
+ * when the pixels can be read without conversion on the CPU, the GPU
+ * copies them into a staging texture, and they are written to the buffer
+ * object when the buffer is used next, by glFinish, or when a sync object
+ * created after the read is found to be signalled.  Until then, each such
+ * read is kept in st_context::readpix_jobs.
+ */
+
+
 #include "main/imports.h"
+#include "main/bufferobj.h"
+#include "main/formats.h"
+#include "main/glformats.h"
+#include "main/image.h"
+#include "main/macros.h"
 #include "main/readpix.h"
 
+#include "os/os_thread.h"
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "util/u_box.h"
+#include "util/u_debug.h"
+#include "util/u_format.h"
+#include "util/u_inlines.h"
+
 #include "st_atom.h"
 #include "st_context.h"
 #include "st_cb_bitmap.h"
+#include "st_cb_bufferobjects.h"
+#include "st_cb_fbo.h"
+#include "st_cb_flush.h"
 #include "st_cb_readpixels.h"
+#include "st_format.h"
+
+
+/** Most reads into buffer objects that may wait for the GPU */
+#define MAX_READPIX_JOBS 4
+
+
+/**
+ * A glReadPixels into a buffer object, waiting for the GPU to copy the
+ * pixels into a staging texture.
+ *
+ * Jobs are referenced by st_context::readpix_jobs until they are written
+ * or discarded, and by the sync objects created after them, which may be
+ * waited for in other contexts.  The first to write a job does so under
+ * its mutex.
+ */
+struct st_readpix_job
+{
+   struct pipe_reference reference;
+   pipe_mutex mutex;
+
+   struct st_readpix_job *next;    /**< in st_context::readpix_jobs */
+
+   struct gl_buffer_object *pbo;   /**< holds a reference */
+   struct pipe_resource *staging;
+   struct pipe_fence_handle *fence;
+
+   GLintptr offset;                /**< of the first row in the buffer */
+   GLint stride;                   /**< between rows in the buffer */
+   GLuint rowBytes, height;
+
+   /** Is the first row at the bottom of the staging texture? */
+   GLboolean invert;
+
+   /** Have the pixels been written, or thrown away? */
+   GLboolean done;
+};
+
+
+DEBUG_GET_ONCE_BOOL_OPTION(mesa_async_readpixels, "MESA_ASYNC_READPIXELS",
+                           TRUE)
+
+
+/**
+ * Drop a reference to a job, and free it with the last one.
+ */
+static void
+release_job(struct st_context *st, struct st_readpix_job *job)
+{
+   struct pipe_screen *screen = st->pipe->screen;
+
+   if (pipe_reference(&job->reference, NULL)) {
+      screen->fence_reference(screen, &job->fence, NULL);
+      pipe_resource_reference(&job->staging, NULL);
+      _mesa_reference_buffer_object(st->ctx, &job->pbo, NULL);
+      pipe_mutex_destroy(job->mutex);
+      free(job);
+   }
+}
+
+
+/**
+ * Write the pixels of a job to its buffer object, unless that is already
+ * done.
+ */
+static void
+complete_job(struct st_context *st, struct st_readpix_job *job)
+{
+   struct pipe_context *pipe = st->pipe;
+   struct pipe_screen *screen = pipe->screen;
+   struct st_buffer_object *stobj = st_buffer_object(job->pbo);
+   const GLintptr length = (job->height - 1) * job->stride + job->rowBytes;
+
+   pipe_mutex_lock(job->mutex);
+
+   if (job->done) {
+      pipe_mutex_unlock(job->mutex);
+      return;
+   }
+
+   if (job->fence) {
+      screen->fence_finish(screen, job->fence, PIPE_TIMEOUT_INFINITE);
+      screen->fence_reference(screen, &job->fence, NULL);
+   }
+
+   if (stobj->buffer && job->offset + length <= job->pbo->Size) {
+      struct pipe_transfer *src_xfer, *dst_xfer;
+      const GLubyte *src;
+      GLubyte *dst;
+
+      src = pipe_transfer_map(pipe, job->staging, 0, 0, PIPE_TRANSFER_READ,
+                              0, 0, job->staging->width0, job->height,
+                              &src_xfer);
+      dst = pipe_buffer_map_range(pipe, stobj->buffer, job->offset, length,
+                                  PIPE_TRANSFER_WRITE |
+                                  (job->stride == job->rowBytes ?
+                                   PIPE_TRANSFER_DISCARD_RANGE : 0),
+                                  &dst_xfer);
+
+      if (src && dst) {
+         GLuint row;
+
+         for (row = 0; row < job->height; row++) {
+            const GLuint srcRow = job->invert ? job->height - 1 - row : row;
+
+            memcpy(dst + row * job->stride,
+                   src + srcRow * src_xfer->stride, job->rowBytes);
+         }
+      }
+
+      if (dst)
+         pipe_buffer_unmap(pipe, dst_xfer);
+      if (src)
+         pipe->transfer_unmap(pipe, src_xfer);
+   }
+
+   pipe_resource_reference(&job->staging, NULL);
+   job->done = GL_TRUE;
+
+   pipe_mutex_unlock(job->mutex);
+}
+
+
+/**
+ * Can a job be written without waiting for the GPU?
+ */
+static GLboolean
+job_ready(struct st_context *st, struct st_readpix_job *job)
+{
+   struct pipe_screen *screen = st->pipe->screen;
+   GLboolean ready;
+
+   pipe_mutex_lock(job->mutex);
+   ready = job->done || !job->fence ||
+           screen->fence_signalled(screen, job->fence);
+   pipe_mutex_unlock(job->mutex);
+
+   return ready;
+}
+
+
+/**
+ * Could the buffer object of a job be read or written by the next draw?
+ *
+ * Rather than looking at every binding point, count the references that
+ * are known not to be draws: the jobs, the hash table of the context and
+ * the pixel and copy bindings.
+ */
+static GLboolean
+buffer_may_be_drawn(struct st_context *st, struct gl_buffer_object *obj)
+{
+   struct gl_context *ctx = st->ctx;
+   const struct st_readpix_job *job;
+   GLint refs = obj->RefCount - (obj->Name != 0);
+
+   for (job = st->readpix_jobs; job; job = job->next) {
+      if (job->pbo == obj)
+         refs--;
+   }
+
+   refs -= (ctx->Pack.BufferObj == obj) +
+           (ctx->Unpack.BufferObj == obj) +
+           (ctx->CopyReadBuffer == obj) +
+           (ctx->CopyWriteBuffer == obj);
+
+   return refs > 0;
+}
+
+
+/**
+ * Complete the pending reads into a buffer object, in the order they were
+ * issued.
+ * \param obj  the buffer object, or NULL for all of them
+ */
+void
+st_finish_readpixels(struct st_context *st, struct gl_buffer_object *obj)
+{
+   struct st_readpix_job **prev = &st->readpix_jobs;
+
+   while (*prev) {
+      struct st_readpix_job *job = *prev;
+
+      if (!obj || job->pbo == obj) {
+         *prev = job->next;
+         complete_job(st, job);
+         release_job(st, job);
+      }
+      else {
+         prev = &job->next;
+      }
+   }
+}
+
+
+/**
+ * Called before drawing.  Complete the reads that the GPU is done with,
+ * and those into buffer objects that the draw may use.
+ */
+void
+st_finish_readpixels_for_draw(struct st_context *st)
+{
+   struct st_readpix_job **prev = &st->readpix_jobs;
+
+   while (*prev) {
+      struct st_readpix_job *job = *prev;
+
+      if (job_ready(st, job) || buffer_may_be_drawn(st, job->pbo)) {
+         *prev = job->next;
+         complete_job(st, job);
+         release_job(st, job);
+      }
+      else {
+         prev = &job->next;
+      }
+   }
+}
+
+
+/**
+ * Drop the pending reads into a buffer object whose contents are being
+ * thrown away.
+ * \param obj  the buffer object, or NULL for all of them
+ */
+void
+st_discard_readpixels(struct st_context *st, struct gl_buffer_object *obj)
+{
+   struct st_readpix_job **prev = &st->readpix_jobs;
+
+   while (*prev) {
+      struct st_readpix_job *job = *prev;
+
+      if (!obj || job->pbo == obj) {
+         *prev = job->next;
+
+         pipe_mutex_lock(job->mutex);
+         job->done = GL_TRUE;
+         pipe_mutex_unlock(job->mutex);
+
+         release_job(st, job);
+      }
+      else {
+         prev = &job->next;
+      }
+   }
+}
+
+
+/**
+ * Reference the pending reads, for a sync object being created.
+ * \return the number of reads, and in \p jobs a new array of them
+ */
+GLuint
+st_reference_readpixels(struct st_context *st, struct st_readpix_job ***jobs)
+{
+   struct st_readpix_job *job;
+   GLuint count = 0;
+
+   *jobs = NULL;
+
+   for (job = st->readpix_jobs; job; job = job->next)
+      count++;
+   if (!count)
+      return 0;
+
+   *jobs = malloc(count * sizeof(**jobs));
+   if (!*jobs) {
+      /* the sync object must still cover them */
+      st_finish_readpixels(st, NULL);
+      return 0;
+   }
+
+   count = 0;
+   for (job = st->readpix_jobs; job; job = job->next) {
+      pipe_reference(NULL, &job->reference);
+      (*jobs)[count++] = job;
+   }
+
+   return count;
+}
+
+
+/**
+ * Complete reads referenced by st_reference_readpixels(), possibly in
+ * another context sharing the buffer objects, and free the array.
+ */
+void
+st_complete_readpixels(struct st_context *st, struct st_readpix_job **jobs,
+                       GLuint count)
+{
+   GLuint i;
+
+   for (i = 0; i < count; i++) {
+      complete_job(st, jobs[i]);
+      release_job(st, jobs[i]);
+   }
+
+   free(jobs);
+}
+
+
+/**
+ * Drop the reads referenced by st_reference_readpixels(), without
+ * completing them, and free the array.
+ */
+void
+st_release_readpixels(struct st_context *st, struct st_readpix_job **jobs,
+                      GLuint count)
+{
+   GLuint i;
+
+   for (i = 0; i < count; i++)
+      release_job(st, jobs[i]);
+
+   free(jobs);
+}
+
+
+/**
+ * Find a format of the staging texture whose texels are laid out like
+ * pixels of the given format and type.
+ *
+ * The renderbuffer's own format lets the GPU just copy.  Otherwise the GPU
+ * converts with a blit, which is only done for the formats whose
+ * conversion in _mesa_readpixels() is the same as a blit's: not luminance
+ * or intensity, which add up or pick channels differently.
+ */
+static gl_format
+find_staging_format(struct pipe_screen *screen, gl_format rbFormat,
+                    GLenum format, GLenum type, GLboolean swapBytes)
+{
+   gl_format f;
+
+   if (_mesa_format_matches_format_and_type(rbFormat, format, type,
+                                            swapBytes))
+      return rbFormat;
+
+   switch (format) {
+   case GL_RED:
+   case GL_RG:
+   case GL_RGB:
+   case GL_BGR:
+   case GL_RGBA:
+   case GL_BGRA:
+   case GL_ALPHA:
+      break;
+   default:
+      return MESA_FORMAT_NONE;
+   }
+
+   for (f = MESA_FORMAT_NONE + 1; f < MESA_FORMAT_COUNT; f++) {
+      enum pipe_format pf;
+
+      if (!_mesa_format_matches_format_and_type(f, format, type, swapBytes))
+         continue;
+
+      pf = st_mesa_format_to_pipe_format(f);
+      if (pf != PIPE_FORMAT_NONE &&
+          screen->is_format_supported(screen, pf, PIPE_TEXTURE_2D, 0,
+                                      PIPE_BIND_RENDER_TARGET))
+         return f;
+   }
+
+   return MESA_FORMAT_NONE;
+}
+
+
+/**
+ * Try to read pixels into a buffer object without waiting for the GPU.
+ * \return GL_FALSE if _mesa_readpixels() has to be used instead
+ */
+static GLboolean
+try_pbo_readpixels(struct st_context *st, GLint x, GLint y,
+                   GLsizei width, GLsizei height,
+                   GLenum format, GLenum type,
+                   const struct gl_pixelstore_attrib *pack,
+                   GLvoid *dest)
+{
+   struct gl_context *ctx = st->ctx;
+   struct pipe_context *pipe = st->pipe;
+   struct pipe_screen *screen = pipe->screen;
+   struct gl_renderbuffer *rb = ctx->ReadBuffer->_ColorReadBuffer;
+   struct gl_pixelstore_attrib clippedPacking = *pack;
+   struct st_renderbuffer *strb;
+   struct pipe_resource templ, *src, *staging;
+   struct st_readpix_job *job, **tail;
+   gl_format stagingFormat;
+   GLboolean clamp;
+   struct pipe_box box;
+   GLuint numJobs = 0;
+
+   if (!debug_get_option_mesa_async_readpixels())
+      return GL_FALSE;
+
+   if (!_mesa_is_bufferobj(pack->BufferObj) || pack->Invert || !rb ||
+       !_mesa_is_color_format(format) || ctx->_ImageTransferState)
+      return GL_FALSE;
+
+   strb = st_renderbuffer(rb);
+   src = strb->texture;
+   if (strb->software || !src)
+      return GL_FALSE;
+
+   stagingFormat = find_staging_format(screen, rb->Format, format, type,
+                                       pack->SwapBytes);
+   if (stagingFormat == MESA_FORMAT_NONE)
+      return GL_FALSE;
+
+   /* Like read_rgba_pixels(): colors are clamped unless they are read as
+    * floats or integers, which only a normalized format gets for free.
+    */
+   clamp = (ctx->Color._ClampReadColor == GL_TRUE || type != GL_FLOAT) &&
+           !_mesa_is_enum_format_integer(format);
+   if (clamp &&
+       _mesa_get_format_datatype(rb->Format) != GL_UNSIGNED_NORMALIZED &&
+       _mesa_get_format_datatype(stagingFormat) != GL_UNSIGNED_NORMALIZED)
+      return GL_FALSE;
+
+   if (stagingFormat != rb->Format &&
+       !screen->is_format_supported(screen, src->format, src->target,
+                                    src->nr_samples,
+                                    PIPE_BIND_SAMPLER_VIEW))
+      return GL_FALSE;
+
+   if (!_mesa_clip_readpixels(ctx, &x, &y, &width, &height, &clippedPacking))
+      return GL_TRUE;
+
+   memset(&templ, 0, sizeof(templ));
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = st_mesa_format_to_pipe_format(stagingFormat);
+   templ.width0 = width;
+   templ.height0 = height;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.usage = PIPE_USAGE_STAGING;
+   templ.bind = PIPE_BIND_TRANSFER_READ;
+   if (stagingFormat != rb->Format || src->nr_samples > 1)
+      templ.bind |= PIPE_BIND_RENDER_TARGET;
+
+   staging = screen->resource_create(screen, &templ);
+   if (!staging)
+      return GL_FALSE;
+
+   job = CALLOC_STRUCT(st_readpix_job);
+   if (!job) {
+      pipe_resource_reference(&staging, NULL);
+      return GL_FALSE;
+   }
+   pipe_reference_init(&job->reference, 1);
+   pipe_mutex_init(job->mutex);
+
+   /* Window system framebuffers are upside down. */
+   job->invert = rb->Name == 0;
+   u_box_2d_zslice(x, job->invert ? rb->Height - y - height : y,
+                   strb->rtt_face + strb->rtt_slice, width, height, &box);
+
+   if (templ.bind & PIPE_BIND_RENDER_TARGET) {
+      struct pipe_blit_info blit;
+
+      memset(&blit, 0, sizeof(blit));
+      blit.src.resource = src;
+      blit.src.level = strb->rtt_level;
+      /* _mesa_readpixels() returns the raw values of sRGB buffers */
+      blit.src.format = util_format_linear(src->format);
+      blit.src.box = box;
+      blit.dst.resource = staging;
+      blit.dst.level = 0;
+      blit.dst.format = staging->format;
+      blit.dst.box.width = width;
+      blit.dst.box.height = height;
+      blit.dst.box.depth = 1;
+      blit.mask = PIPE_MASK_RGBA;
+      blit.filter = PIPE_TEX_FILTER_NEAREST;
+      blit.scissor_enable = FALSE;
+      pipe->blit(pipe, &blit);
+   }
+   else {
+      pipe->resource_copy_region(pipe, staging, 0, 0, 0, 0,
+                                 src, strb->rtt_level, &box);
+   }
+
+   st_flush(st, &job->fence);
+
+   _mesa_reference_buffer_object(ctx, &job->pbo, pack->BufferObj);
+   job->staging = staging;
+   job->offset = (GLintptr)
+      _mesa_image_address2d(&clippedPacking, dest, width, height,
+                            format, type, 0, 0);
+   job->stride = _mesa_image_row_stride(&clippedPacking, width, format, type);
+   job->rowBytes = width * _mesa_get_format_bytes(stagingFormat);
+   job->height = height;
+
+   for (tail = &st->readpix_jobs; *tail; tail = &(*tail)->next)
+      numJobs++;
+   *tail = job;
+
+   if (numJobs >= MAX_READPIX_JOBS) {
+      job = st->readpix_jobs;
+      st->readpix_jobs = job->next;
+      complete_job(st, job);
+      release_job(st, job);
+   }
+
+   return GL_TRUE;
+}
 
 
 /**
@@ -51,6 +584,10 @@ st_readpixels(struct gl_context *ctx, GLint x, GLint y,
 
    st_validate_state(st);
    st_flush_bitmap_cache(st);
+
+   if (try_pbo_readpixels(st, x, y, width, height, format, type, pack, dest))
+      return;
+
    _mesa_readpixels(ctx, x, y, width, height, format, type, pack, dest);
 }
 
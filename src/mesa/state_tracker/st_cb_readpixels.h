@@ -32,9 +32,32 @@
 #include "main/glheader.h"
 
 struct dd_function_table;
+struct gl_buffer_object;
+struct st_context;
+struct st_readpix_job;
 
 extern void
 st_init_readpixels_functions(struct dd_function_table *functions);
 
+extern void
+st_finish_readpixels(struct st_context *st, struct gl_buffer_object *obj);
+
+extern void
+st_finish_readpixels_for_draw(struct st_context *st);
+
+extern void
+st_discard_readpixels(struct st_context *st, struct gl_buffer_object *obj);
+
+extern GLuint
+st_reference_readpixels(struct st_context *st, struct st_readpix_job ***jobs);
+
+extern void
+st_complete_readpixels(struct st_context *st, struct st_readpix_job **jobs,
+                       GLuint count);
+
+extern void
+st_release_readpixels(struct st_context *st, struct st_readpix_job **jobs,
+                      GLuint count);
+
 
 #endif /* ST_CB_READPIXELS_H */
@@ -32,23 +32,39 @@
 
 #include "main/glheader.h"
 #include "main/macros.h"
+#include "os/os_thread.h"
 #include "pipe/p_context.h"
 #include "pipe/p_screen.h"
 #include "st_context.h"
+#include "st_cb_readpixels.h"
 #include "st_cb_syncobj.h"
+#include "st_draw.h"
 
 struct st_sync_object {
    struct gl_sync_object b;
 
    struct pipe_fence_handle *fence;
+
+   /**
+    * The glReadPixels into buffer objects that were pending when the sync
+    * object was created, to be written when it is found to be signalled.
+    */
+   pipe_mutex mutex;
+   struct st_readpix_job **readpix_jobs;
+   GLuint num_readpix_jobs;
 };
 
 
 static struct gl_sync_object * st_new_sync_object(struct gl_context *ctx,
                                                   GLenum type)
 {
-   if (type == GL_SYNC_FENCE)
-      return (struct gl_sync_object*)CALLOC_STRUCT(st_sync_object);
+   if (type == GL_SYNC_FENCE) {
+      struct st_sync_object *so = CALLOC_STRUCT(st_sync_object);
+
+      if (so)
+         pipe_mutex_init(so->mutex);
+      return (struct gl_sync_object*)so;
+   }
    else
       return NULL;
 }
@@ -60,6 +76,9 @@ static void st_delete_sync_object(struct gl_context *ctx,
    struct st_sync_object *so = (struct st_sync_object*)obj;
 
    screen->fence_reference(screen, &so->fence, NULL);
+   st_release_readpixels(st_context(ctx), so->readpix_jobs,
+                         so->num_readpix_jobs);
+   pipe_mutex_destroy(so->mutex);
    free(so);
 }
 
@@ -72,18 +91,48 @@ static void st_fence_sync(struct gl_context *ctx, struct gl_sync_object *obj,
    assert(condition == GL_SYNC_GPU_COMMANDS_COMPLETE && flags == 0);
    assert(so->fence == NULL);
 
+   /* The sync object may be waited for in another context, which can't
+    * see our list of pending reads into buffer objects.
+    */
+   so->num_readpix_jobs = st_reference_readpixels(st_context(ctx),
+                                                  &so->readpix_jobs);
+
+   st_flush_draw_batch(st_context(ctx));
    pipe->flush(pipe, &so->fence);
 }
 
+/**
+ * Write the pixels of the reads that were pending when the sync object
+ * was created, so that the buffer objects hold them once the sync object
+ * is seen as signalled.
+ */
+static void complete_readpixels(struct gl_context *ctx,
+                                struct st_sync_object *so)
+{
+   pipe_mutex_lock(so->mutex);
+   if (so->num_readpix_jobs) {
+      st_complete_readpixels(st_context(ctx), so->readpix_jobs,
+                             so->num_readpix_jobs);
+      so->readpix_jobs = NULL;
+      so->num_readpix_jobs = 0;
+   }
+   pipe_mutex_unlock(so->mutex);
+}
+
 static void st_check_sync(struct gl_context *ctx, struct gl_sync_object *obj)
 {
    struct pipe_screen *screen = st_context(ctx)->pipe->screen;
    struct st_sync_object *so = (struct st_sync_object*)obj;
 
    if (so->fence && screen->fence_signalled(screen, so->fence)) {
+      complete_readpixels(ctx, so);
       screen->fence_reference(screen, &so->fence, NULL);
       so->b.StatusFlag = GL_TRUE;
    }
+   else if (so->b.StatusFlag) {
+      /* another thread may still be writing them */
+      complete_readpixels(ctx, so);
+   }
 }
 
 static void st_client_wait_sync(struct gl_context *ctx,
@@ -98,6 +147,7 @@ static void st_client_wait_sync(struct gl_context *ctx,
 
    if (so->fence &&
        screen->fence_finish(screen, so->fence, timeout)) {
+      complete_readpixels(ctx, so);
       screen->fence_reference(screen, &so->fence, NULL);
       so->b.StatusFlag = GL_TRUE;
    }
@@ -107,8 +157,11 @@ static void st_server_wait_sync(struct gl_context *ctx,
                                 struct gl_sync_object *obj,
                                 GLbitfield flags, GLuint64 timeout)
 {
-   /* NO-OP.
-    * Neither Gallium nor DRM interfaces support blocking on the GPU. */
+   /* Neither Gallium nor DRM interfaces support blocking on the GPU.
+    * The pending reads are written by the CPU though, and the commands
+    * that follow may use them.
+    */
+   complete_readpixels(ctx, (struct st_sync_object*)obj);
 }
 
 void st_init_syncobj_functions(struct dd_function_table *functions)
@@ -48,6 +48,7 @@
 #include "state_tracker/st_cb_fbo.h"
 #include "state_tracker/st_cb_flush.h"
 #include "state_tracker/st_cb_texture.h"
+#include "state_tracker/st_draw.h"
 #include "state_tracker/st_format.h"
 #include "state_tracker/st_texture.h"
 #include "state_tracker/st_gen_mipmap.h"
@@ -200,6 +201,9 @@ st_MapTextureImage(struct gl_context *ctx,
    if (mode & GL_MAP_INVALIDATE_RANGE_BIT)
       pipeMode |= PIPE_TRANSFER_DISCARD_RANGE;
 
+   /* A kept back draw may sample the image or render into it. */
+   st_flush_draw_batch(st);
+
    map = st_texture_image_map(st, stImage, slice, pipeMode, x, y, w, h);
    if (map) {
       *mapOut = map;
@@ -544,6 +548,7 @@ st_TexImage(struct gl_context * ctx, GLuint dims,
             GLenum format, GLenum type, const void *pixels,
             const struct gl_pixelstore_attrib *unpack)
 {
+   st_flush_draw_batch(st_context(ctx));
    prep_teximage(ctx, texImage, format, type);
    _mesa_store_teximage(ctx, dims, texImage, format, type, pixels, unpack);
 }
@@ -554,6 +559,7 @@ st_CompressedTexImage(struct gl_context *ctx, GLuint dims,
                       struct gl_texture_image *texImage,
                       GLsizei imageSize, const GLvoid *data)
 {
+   st_flush_draw_batch(st_context(ctx));
    prep_teximage(ctx, texImage, GL_NONE, GL_NONE);
    _mesa_store_compressed_teximage(ctx, dims, texImage, imageSize, data);
 }
@@ -685,6 +691,8 @@ st_GetTexImage(struct gl_context * ctx,
 {
    struct st_texture_image *stImage = st_texture_image(texImage);
 
+   st_flush_draw_batch(st_context(ctx));
+
    if (stImage->pt && util_format_is_s3tc(stImage->pt->format)) {
       /* Need to decompress the texture.
        * We'll do this by rendering a textured quad (which is hopefully
@@ -934,6 +942,8 @@ st_CopyTexSubImage(struct gl_context *ctx, GLuint dims,
     */
    if (0) st_validate_state(st);
 
+   st_flush_draw_batch(st);
+
    if (!strb || !strb->surface || !stImage->pt) {
       debug_printf("%s: null strb or stImage\n", __FUNCTION__);
       return;
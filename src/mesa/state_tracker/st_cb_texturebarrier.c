@@ -40,6 +40,7 @@
 #include "pipe/p_defines.h"
 #include "st_context.h"
 #include "st_cb_texturebarrier.h"
+#include "st_draw.h"
 
 
 /**
@@ -50,6 +51,7 @@ st_TextureBarrier(struct gl_context *ctx)
 {
    struct pipe_context *pipe = st_context(ctx)->pipe;
 
+   st_flush_draw_batch(st_context(ctx));
    pipe->texture_barrier(pipe);
 }
 
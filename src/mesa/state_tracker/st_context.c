@@ -310,6 +310,8 @@ void st_destroy_context( struct st_context *st )
 
    st_destroy_program_variants(st);
 
+   st_discard_readpixels(st, NULL);
+
    _mesa_free_context_data(ctx);
 
    /* This will free the st_context too, so 'st' must not be accessed
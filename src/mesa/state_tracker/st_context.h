@@ -41,6 +41,7 @@ struct draw_stage;
 struct gen_mipmap_state;
 struct st_context;
 struct st_fragment_program;
+struct st_readpix_job;
 struct u_upload_mgr;
 
 
@@ -91,6 +92,9 @@ struct st_context
 
    boolean vertex_array_out_of_memory;
 
+   /** Are any of the bound vertex buffers in user memory? */
+   boolean user_vertex_buffers;
+
    /* Some state is contained in constant objects.
     * Other state is just parameter values.
     */
@@ -122,6 +126,31 @@ struct st_context
 
    struct st_state_flags dirty;
 
+   /**
+    * For each bit of st_state_flags::mesa and st_state_flags::st, the
+    * atoms that depend on it, as a mask of indices into the atom list.
+    * Set up by st_init_atoms().
+    */
+   GLuint atoms_for_mesa[32];
+   GLuint atoms_for_st[32];
+
+   /**
+    * Draw waiting to be merged with the next ones, see st_draw.c
+    */
+   struct {
+      GLboolean enabled;               /**< MESA_DRAW_BATCH option */
+      GLboolean pending;
+      struct pipe_draw_info info;
+      struct pipe_index_buffer ibuffer; /**< holds a buffer reference */
+      void (*vbo_flush_vertices)(struct gl_context *ctx, GLuint flags);
+   } draw_batch;
+
+   /**
+    * Reads into buffer objects waiting for the GPU, oldest first, see
+    * st_cb_readpixels.c
+    */
+   struct st_readpix_job *readpix_jobs;
+
    GLboolean missing_textures;
    GLboolean vertdata_edgeflags;
 
@@ -47,6 +47,7 @@
 #include "st_context.h"
 #include "st_atom.h"
 #include "st_cb_bufferobjects.h"
+#include "st_cb_readpixels.h"
 #include "st_cb_xformfb.h"
 #include "st_draw.h"
 #include "st_program.h"
@@ -58,12 +59,16 @@
 #include "util/u_prim.h"
 #include "util/u_draw_quad.h"
 #include "util/u_upload_mgr.h"
+#include "util/u_debug.h"
 #include "draw/draw_context.h"
 #include "cso_cache/cso_context.h"
 
 #include "../glsl/ir_uniform.h"
 
 
+DEBUG_GET_ONCE_BOOL_OPTION(mesa_draw_batch, "MESA_DRAW_BATCH", FALSE)
+
+
 /**
  * This is very similar to vbo_all_varyings_in_vbos() but we are
  * only interested in per-vertex data.  See bug 38626.
@@ -107,8 +112,6 @@ setup_index_buffer(struct st_context *st,
       /* indices are in user space memory */
       ibuffer->user_buffer = ib->ptr;
    }
-
-   cso_set_index_buffer(st->cso_context, ibuffer);
 }
 
 
@@ -171,6 +174,130 @@ translate_prim(const struct gl_context *ctx, unsigned prim)
 }
 
 
+/**
+ * Draw merging
+ *
+ * Consecutive draws of the same list primitive whose vertices or indices
+ * follow each other are merged into one pipe draw, see st_draws_mergeable().
+ * This is always done for the primitives of one call to st_draw_vbo().
+ *
+ * With MESA_DRAW_BATCH=true, the last draw is also kept back after
+ * st_draw_vbo() returns, so that it can be merged with the draws of the next
+ * calls.  Any GL state change goes through FLUSH_VERTICES, which ends up in
+ * st_flush_vertices() and sends the draw.  So do state validation and the
+ * driver functions that change or read buffers without flushing vertices.
+ * Draws are only kept back when every vertex buffer and the index buffer
+ * are buffer objects, whose contents can't change behind our back.
+ *
+ * Merging renumbers the primitives of the later draws, so nothing is merged
+ * while the bound geometry program reads the primitive ID.  Geometry
+ * programs are the only ones that can read it.
+ */
+/**
+ * Can the draw be appended to the pending one?
+ */
+static boolean
+can_merge_draw(const struct st_context *st,
+               const struct pipe_draw_info *info,
+               const struct pipe_index_buffer *ibuffer)
+{
+   if (st->gp && (st->gp->Base.Base.InputsRead & GEOM_BIT_PRIM_ID))
+      return FALSE;
+
+   return st_draws_mergeable(&st->draw_batch.info, &st->draw_batch.ibuffer,
+                             info, ibuffer);
+}
+
+
+/**
+ * Send the pending draw, if any, to the driver.
+ */
+void
+st_flush_draw_batch(struct st_context *st)
+{
+   if (!st->draw_batch.pending)
+      return;
+
+   st->draw_batch.pending = GL_FALSE;
+
+   if (st->draw_batch.info.indexed)
+      cso_set_index_buffer(st->cso_context, &st->draw_batch.ibuffer);
+
+   cso_draw_vbo(st->cso_context, &st->draw_batch.info);
+
+   pipe_resource_reference(&st->draw_batch.ibuffer.buffer, NULL);
+}
+
+
+/**
+ * Merge a draw with the pending one, or make it the pending one.
+ */
+static void
+queue_draw(struct st_context *st,
+           const struct pipe_draw_info *info,
+           const struct pipe_index_buffer *ibuffer)
+{
+   if (st->draw_batch.pending) {
+      if (can_merge_draw(st, info, ibuffer)) {
+         struct pipe_draw_info *prev = &st->draw_batch.info;
+
+         prev->count += info->count;
+         prev->min_index = MIN2(prev->min_index, info->min_index);
+         prev->max_index = MAX2(prev->max_index, info->max_index);
+         return;
+      }
+
+      st_flush_draw_batch(st);
+   }
+
+   st->draw_batch.info = *info;
+   if (info->indexed) {
+      pipe_resource_reference(&st->draw_batch.ibuffer.buffer,
+                              ibuffer->buffer);
+      st->draw_batch.ibuffer.user_buffer = ibuffer->user_buffer;
+      st->draw_batch.ibuffer.offset = ibuffer->offset;
+      st->draw_batch.ibuffer.index_size = ibuffer->index_size;
+   }
+   else {
+      st->draw_batch.ibuffer.user_buffer = NULL;
+   }
+   st->draw_batch.pending = GL_TRUE;
+}
+
+
+/**
+ * May the pending draw wait for the next call to st_draw_vbo()?
+ */
+static boolean
+can_keep_draw(const struct st_context *st)
+{
+   const struct gl_context *ctx = st->ctx;
+
+   return st->draw_batch.enabled &&
+          !st->user_vertex_buffers &&
+          !st->draw_batch.ibuffer.user_buffer &&
+          !st->draw_batch.info.count_from_stream_output &&
+          !ctx->TransformFeedback.CurrentObject->Active &&
+          !ctx->Query.CondRenderQuery;
+}
+
+
+/**
+ * Called via ctx->Driver.FlushVertices() when draws are kept back.
+ */
+static void
+st_flush_vertices(struct gl_context *ctx, GLuint flags)
+{
+   struct st_context *st = st_context(ctx);
+
+   /* The vbo module's own vertices may be drawn now, through st_draw_vbo()
+    * and merged with the pending draw, so send the pending draw after.
+    */
+   st->draw_batch.vbo_flush_vertices(ctx, flags);
+   st_flush_draw_batch(st);
+}
+
+
 /**
  * This function gets plugged into the VBO module and is called when
  * we have something to render.
@@ -211,6 +338,9 @@ st_draw_vbo(struct gl_context *ctx,
 #endif
    }
 
+   if (st->readpix_jobs)
+      st_finish_readpixels_for_draw(st);
+
    util_draw_init_info(&info);
    if (ib) {
       /* Get index bounds for user buffers. */
@@ -255,14 +385,21 @@ st_draw_vbo(struct gl_context *ctx,
       }
 
       if (info.count_from_stream_output) {
-         cso_draw_vbo(st->cso_context, &info);
+         queue_draw(st, &info, &ibuffer);
       }
       else if (info.primitive_restart) {
          /* don't trim, restarts might be inside index list */
-         cso_draw_vbo(st->cso_context, &info);
+         queue_draw(st, &info, &ibuffer);
       }
       else if (u_trim_pipe_prim(info.mode, &info.count))
-         cso_draw_vbo(st->cso_context, &info);
+         queue_draw(st, &info, &ibuffer);
+   }
+
+   if (st->draw_batch.pending) {
+      if (can_keep_draw(st))
+         ctx->Driver.NeedFlush |= FLUSH_STORED_VERTICES;
+      else
+         st_flush_draw_batch(st);
    }
 
    if (ib && st->indexbuf_uploader && !_mesa_is_bufferobj(ib->obj)) {
@@ -278,6 +415,12 @@ st_init_draw(struct st_context *st)
 
    vbo_set_draw_func(ctx, st_draw_vbo);
 
+   st->draw_batch.enabled = debug_get_option_mesa_draw_batch();
+   if (st->draw_batch.enabled) {
+      st->draw_batch.vbo_flush_vertices = ctx->Driver.FlushVertices;
+      ctx->Driver.FlushVertices = st_flush_vertices;
+   }
+
    st->draw = draw_create(st->pipe); /* for selection/feedback */
 
    /* Disable draw options that might convert points/lines to tris, etc.
@@ -293,5 +436,7 @@ st_init_draw(struct st_context *st)
 void
 st_destroy_draw(struct st_context *st)
 {
+   st->draw_batch.pending = GL_FALSE;
+   pipe_resource_reference(&st->draw_batch.ibuffer.buffer, NULL);
    draw_destroy(st->draw);
 }
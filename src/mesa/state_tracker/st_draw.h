@@ -36,6 +36,7 @@
 
 #include "main/compiler.h"
 #include "main/glheader.h"
+#include "pipe/p_state.h"
 
 struct _mesa_index_buffer;
 struct _mesa_prim;
@@ -47,6 +48,8 @@ void st_init_draw( struct st_context *st );
 
 void st_destroy_draw( struct st_context *st );
 
+void st_flush_draw_batch( struct st_context *st );
+
 extern void
 st_draw_vbo(struct gl_context *ctx,
             const struct _mesa_prim *prims,
@@ -81,4 +84,57 @@ pointer_to_offset(const void *ptr)
 }
 
 
+/**
+ * Can a draw be appended to a previous one, as one pipe draw with the
+ * same result?
+ *
+ * The draws must use the same list primitive, with the vertices or indices
+ * of the second following those of the first.  Instanced draws are never
+ * merged: instance 0 of both draws would be drawn before instance 1 of the
+ * first one, which changes the order of the primitives.
+ */
+static INLINE boolean
+st_draws_mergeable(const struct pipe_draw_info *prev,
+                   const struct pipe_index_buffer *prev_ib,
+                   const struct pipe_draw_info *info,
+                   const struct pipe_index_buffer *ibuffer)
+{
+   unsigned start = info->start;
+
+   switch (info->mode) {
+   case PIPE_PRIM_POINTS:
+   case PIPE_PRIM_LINES:
+   case PIPE_PRIM_TRIANGLES:
+   case PIPE_PRIM_LINES_ADJACENCY:
+   case PIPE_PRIM_TRIANGLES_ADJACENCY:
+      break;
+   default:
+      return FALSE;
+   }
+
+   if (info->mode != prev->mode ||
+       info->indexed != prev->indexed ||
+       info->index_bias != prev->index_bias ||
+       info->instance_count != 1 || prev->instance_count != 1 ||
+       info->start_instance != prev->start_instance ||
+       info->primitive_restart || prev->primitive_restart ||
+       info->count_from_stream_output || prev->count_from_stream_output)
+      return FALSE;
+
+   if (info->indexed) {
+      if (ibuffer->index_size != prev_ib->index_size ||
+          ibuffer->buffer != prev_ib->buffer ||
+          ibuffer->user_buffer != prev_ib->user_buffer ||
+          ibuffer->offset < prev_ib->offset ||
+          (ibuffer->offset - prev_ib->offset) % ibuffer->index_size)
+         return FALSE;
+
+      /* Express the start relative to the previous draw's offset. */
+      start += (ibuffer->offset - prev_ib->offset) / ibuffer->index_size;
+   }
+
+   return start == prev->start + prev->count;
+}
+
+
 #endif
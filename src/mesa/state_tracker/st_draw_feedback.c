@@ -35,6 +35,7 @@
 #include "st_context.h"
 #include "st_atom.h"
 #include "st_cb_bufferobjects.h"
+#include "st_cb_readpixels.h"
 #include "st_draw.h"
 #include "st_program.h"
 
@@ -116,6 +117,9 @@ st_feedback_draw_vbo(struct gl_context *ctx,
 
    st_validate_state(st);
 
+   if (st->readpix_jobs)
+      st_finish_readpixels_for_draw(st);
+
    if (!index_bounds_valid)
       vbo_get_minmax_indices(ctx, prims, ib, &min_index, &max_index, nr_prims);
 
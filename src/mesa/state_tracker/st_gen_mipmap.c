@@ -40,6 +40,7 @@
 #include "st_context.h"
 #include "st_texture.h"
 #include "st_gen_mipmap.h"
+#include "st_draw.h"
 #include "st_cb_texture.h"
 
 
@@ -151,6 +152,11 @@ st_generate_mipmap(struct gl_context *ctx, GLenum target,
    if (!pt)
       return;
 
+   /* The texture may have been rendered to by draws that are waiting to be
+    * merged.
+    */
+   st_flush_draw_batch(st);
+
    /* not sure if this ultimately actually should work,
       but we're not supporting multisampled textures yet. */
    assert(pt->nr_samples < 2);
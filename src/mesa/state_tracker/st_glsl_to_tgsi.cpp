@@ -5062,8 +5062,8 @@ st_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
 
          progress = do_lower_jumps(ir, true, true, options->EmitNoMainReturn, options->EmitNoCont, options->EmitNoLoops) || progress;
 
-         progress = do_common_optimization(ir, true, true,
-					   options->MaxUnrollIterations)
+         progress = do_common_optimization_loop(ir, true, true,
+						options->MaxUnrollIterations)
 	   || progress;
 
          progress = lower_quadop_vector(ir, false) || progress;
@@ -34,6 +34,7 @@
 #include "main/texstate.h"
 #include "main/framebuffer.h"
 #include "main/fbobject.h"
+#include "main/marshal.h"
 #include "main/renderbuffer.h"
 #include "main/version.h"
 #include "st_texture.h"
@@ -52,8 +53,12 @@
 #include "util/u_pointer.h"
 #include "util/u_inlines.h"
 #include "util/u_atomic.h"
+#include "util/u_debug.h"
 #include "util/u_surface.h"
 
+
+DEBUG_GET_ONCE_BOOL_OPTION(mesa_glthread, "MESA_GLTHREAD", FALSE)
+
 /**
  * Cast wrapper to convert a struct gl_framebuffer to an st_framebuffer.
  * Return NULL if the struct gl_framebuffer is a user-created framebuffer.
@@ -461,6 +466,7 @@ st_context_flush(struct st_context_iface *stctxi, unsigned flags,
                  struct pipe_fence_handle **fence)
 {
    struct st_context *st = (struct st_context *) stctxi;
+   _mesa_glthread_finish(st->ctx);
    st_flush(st, fence);
    if (flags & ST_FLUSH_FRONT)
       st_manager_flush_frontbuffer(st);
@@ -483,6 +489,8 @@ st_context_teximage(struct st_context_iface *stctxi,
    GLuint width, height, depth;
    GLenum target;
 
+   _mesa_glthread_finish(ctx);
+
    switch (tex_type) {
    case ST_TEXTURE_1D:
       target = GL_TEXTURE_1D;
@@ -578,6 +586,8 @@ st_context_copy(struct st_context_iface *stctxi,
    struct st_context *st = (struct st_context *) stctxi;
    struct st_context *src = (struct st_context *) stsrci;
 
+   _mesa_glthread_finish(src->ctx);
+   _mesa_glthread_finish(st->ctx);
    _mesa_copy_context(src->ctx, st->ctx, mask);
 }
 
@@ -595,6 +605,7 @@ static void
 st_context_destroy(struct st_context_iface *stctxi)
 {
    struct st_context *st = (struct st_context *) stctxi;
+   _mesa_glthread_destroy(st->ctx);
    st_destroy_context(st);
 }
 
@@ -676,6 +687,9 @@ st_api_create_context(struct st_api *stapi, struct st_manager *smapi,
    st->iface.cso_context = st->cso_context;
    st->iface.pipe = st->pipe;
 
+   if (debug_get_option_mesa_glthread())
+      _mesa_glthread_init(st->ctx);
+
    *error = ST_CONTEXT_SUCCESS;
    return &st->iface;
 }
@@ -717,10 +731,19 @@ st_api_make_current(struct st_api *stapi, struct st_context_iface *stctxi,
    struct st_context *st = (struct st_context *) stctxi;
    struct st_framebuffer *stdraw, *stread;
    boolean ret;
+   GET_CURRENT_CONTEXT(curCtx);
 
    _glapi_check_multithread();
 
+   /* The framebuffers are validated from this thread below, so the
+    * marshalling threads must not be using them.
+    */
+   if (curCtx)
+      _mesa_glthread_finish(curCtx);
+
    if (st) {
+      _mesa_glthread_finish(st->ctx);
+
       /* reuse or create the draw fb */
       stdraw = st_framebuffer_reuse_or_create(st->ctx->WinSysDrawBuffer,
                                               stdrawi);
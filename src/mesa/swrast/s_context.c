@@ -41,6 +41,7 @@
 #include "s_points.h"
 #include "s_span.h"
 #include "s_texfetch.h"
+#include "s_tile.h"
 #include "s_triangle.h"
 #include "s_texfilter.h"
 
@@ -85,6 +86,13 @@ _swrast_update_rasterflags( struct gl_context *ctx )
    if (ctx->Query.CurrentOcclusionObject)
       rasterMask |= OCCLUSION_BIT;
 
+   /* With tiled rendering every span is clipped to its tile, so the
+    * triangle functions which write directly to the renderbuffer can't
+    * be used.
+    */
+   if (swrast->Tiles)
+      rasterMask |= CLIP_BIT;
+
 
    /* If we're not drawing to exactly one color buffer set the
     * MULTI_DRAW_BIT flag.  Also set it if we're drawing to no
@@ -363,6 +371,29 @@ _swrast_validate_triangle( struct gl_context *ctx,
    swrast->Triangle( ctx, v0, v1, v2 );
 }
 
+/**
+ * Replace the _swrast_validate_triangle stub by the real triangle
+ * function without drawing anything.  Needed before swrast->Triangle
+ * may be called from several threads at once.
+ */
+void
+_swrast_validate_triangle_func( struct gl_context *ctx )
+{
+   SWcontext *swrast = SWRAST_CONTEXT(ctx);
+
+   if (swrast->Triangle != _swrast_validate_triangle)
+      return;
+
+   _swrast_validate_derived( ctx );
+   swrast->choose_triangle( ctx );
+   ASSERT(swrast->Triangle);
+
+   if (swrast->SpecularVertexAdd) {
+      swrast->SpecTriangle = swrast->Triangle;
+      swrast->Triangle = _swrast_add_spec_terms_triangle;
+   }
+}
+
 /**
  * Called via swrast->Line.  Examine current GL state and choose a software
  * line routine.  Then call it.
@@ -591,6 +622,9 @@ _swrast_validate_derived( struct gl_context *ctx )
                               _NEW_TEXTURE))
          _swrast_update_specular_vertex_add(ctx);
 
+      if (swrast->Tiles)
+         _swrast_update_tile_state(ctx);
+
       swrast->NewState = 0;
       swrast->StateChanges = 0;
       swrast->InvalidateState = _swrast_invalidate_state;
@@ -613,8 +647,8 @@ _swrast_Quad( struct gl_context *ctx,
       _swrast_print_vertex( ctx, v2 );
       _swrast_print_vertex( ctx, v3 );
    }
-   SWRAST_CONTEXT(ctx)->Triangle( ctx, v0, v1, v3 );
-   SWRAST_CONTEXT(ctx)->Triangle( ctx, v1, v2, v3 );
+   _swrast_Triangle( ctx, v0, v1, v3 );
+   _swrast_Triangle( ctx, v1, v2, v3 );
 }
 
 void
@@ -627,6 +661,9 @@ _swrast_Triangle( struct gl_context *ctx, const SWvertex *v0,
       _swrast_print_vertex( ctx, v1 );
       _swrast_print_vertex( ctx, v2 );
    }
+   if (SWRAST_CONTEXT(ctx)->Tiles &&
+       _swrast_tile_triangle( ctx, v0, v1, v2 ))
+      return;
    SWRAST_CONTEXT(ctx)->Triangle( ctx, v0, v1, v2 );
 }
 
@@ -638,6 +675,8 @@ _swrast_Line( struct gl_context *ctx, const SWvertex *v0, const SWvertex *v1 )
       _swrast_print_vertex( ctx, v0 );
       _swrast_print_vertex( ctx, v1 );
    }
+   /* lines aren't binned; draw any pending triangles first */
+   _swrast_tile_flush( ctx );
    SWRAST_CONTEXT(ctx)->Line( ctx, v0, v1 );
 }
 
@@ -648,6 +687,8 @@ _swrast_Point( struct gl_context *ctx, const SWvertex *v0 )
       _mesa_debug(ctx, "_swrast_Point\n");
       _swrast_print_vertex( ctx, v0 );
    }
+   /* points aren't binned; draw any pending triangles first */
+   _swrast_tile_flush( ctx );
    SWRAST_CONTEXT(ctx)->Point( ctx, v0 );
 }
 
@@ -695,6 +736,44 @@ _swrast_allow_pixel_fog( struct gl_context *ctx, GLboolean value )
    SWRAST_CONTEXT(ctx)->AllowPixelFog = value;
 }
 
+/**
+ * Enable or disable tiled triangle rasterization.  When enabled,
+ * triangles are binned into screen tiles and rasterized when the
+ * primitive ends (at _swrast_render_finish() or _swrast_flush()), on
+ * up to _mesa_num_threads() threads.
+ *
+ * Triangles must be drawn between _swrast_render_start() and
+ * _swrast_render_finish(), as swrast_setup does.
+ *
+ * \return GL_FALSE if enabling failed for lack of memory.
+ */
+GLboolean
+_swrast_allow_tiled_rendering( struct gl_context *ctx, GLboolean value )
+{
+   SWcontext *swrast = SWRAST_CONTEXT(ctx);
+
+   if (SWRAST_DEBUG) {
+      _mesa_debug(ctx, "_swrast_allow_tiled_rendering %d\n", value);
+   }
+
+   if (!value == !swrast->Tiles)
+      return GL_TRUE;
+
+   if (value) {
+      if (!_swrast_tile_create(ctx))
+         return GL_FALSE;
+   }
+   else {
+      _swrast_tile_flush(ctx);
+      _swrast_tile_destroy(ctx);
+      swrast->_TileTriangles = GL_FALSE;
+   }
+
+   /* CLIP_BIT in _RasterMask and the triangle function depend on this */
+   swrast->InvalidateState( ctx, _SWRAST_NEW_RASTERMASK );
+   return GL_TRUE;
+}
+
 
 /**
  * Initialize native program limits by copying the logical limits.
@@ -714,6 +793,72 @@ init_program_native_limits(struct gl_program_constants *prog)
 }
 
 
+/**
+ * Make room for the per-thread state of \p numThreads threads: span
+ * arrays, fragment program machines and texel buffers.  There's never
+ * less room than before.
+ * \return GL_FALSE if out of memory.
+ */
+static GLboolean
+alloc_threads(SWcontext *swrast, GLuint numThreads)
+{
+   SWspanarrays *arrays;
+   struct gl_program_machine *machines;
+   GLuint i;
+
+   if (numThreads <= swrast->MaxThreads)
+      return GL_TRUE;
+
+   /* SpanArrays is global and shared by all SWspan instances. However, when
+    * using multiple threads, it is necessary to have one SpanArrays instance
+    * per thread.
+    */
+   arrays = realloc(swrast->SpanArrays, numThreads * sizeof(SWspanarrays));
+   if (!arrays)
+      return GL_FALSE;
+   swrast->SpanArrays = arrays;
+   swrast->PointSpan.array = arrays;
+
+   /* Likewise for the fragment program interpreter state. */
+   machines = realloc(swrast->FragProgMachine,
+                      numThreads * sizeof(struct gl_program_machine));
+   if (!machines)
+      return GL_FALSE;
+   memset(machines + swrast->MaxThreads, 0,
+          (numThreads - swrast->MaxThreads) * sizeof(struct gl_program_machine));
+   swrast->FragProgMachine = machines;
+
+   for (i = swrast->MaxThreads; i < numThreads; i++) {
+      arrays[i].ChanType = CHAN_TYPE;
+#if CHAN_TYPE == GL_UNSIGNED_BYTE
+      arrays[i].rgba = arrays[i].rgba8;
+#elif CHAN_TYPE == GL_UNSIGNED_SHORT
+      arrays[i].rgba = arrays[i].rgba16;
+#else
+      arrays[i].rgba = arrays[i].attribs[FRAG_ATTRIB_COL0];
+#endif
+   }
+
+   /* _swrast_alloc_texel_buffer() makes a bigger one when next needed */
+   free(swrast->TexelBuffer);
+   swrast->TexelBuffer = NULL;
+
+   swrast->MaxThreads = numThreads;
+   return GL_TRUE;
+}
+
+
+/**
+ * Make room for \p numThreads threads to run the span code at once.
+ * \return GL_FALSE if out of memory.
+ */
+GLboolean
+_swrast_alloc_threads(struct gl_context *ctx, GLuint numThreads)
+{
+   return alloc_threads(SWRAST_CONTEXT(ctx), numThreads);
+}
+
+
 GLboolean
 _swrast_CreateContext( struct gl_context *ctx )
 {
@@ -769,25 +914,14 @@ _swrast_CreateContext( struct gl_context *ctx )
    for (i = 0; i < MAX_TEXTURE_IMAGE_UNITS; i++)
       swrast->TextureSample[i] = NULL;
 
-   /* SpanArrays is global and shared by all SWspan instances. However, when
-    * using multiple threads, it is necessary to have one SpanArrays instance
-    * per thread.
-    */
-   swrast->SpanArrays = malloc(maxThreads * sizeof(SWspanarrays));
-   if (!swrast->SpanArrays) {
+   _swrast_init_thread_num();
+
+   if (!alloc_threads(swrast, maxThreads)) {
+      free(swrast->SpanArrays);
+      free(swrast->FragProgMachine);
       free(swrast);
       return GL_FALSE;
    }
-   for(i = 0; i < maxThreads; i++) {
-      swrast->SpanArrays[i].ChanType = CHAN_TYPE;
-#if CHAN_TYPE == GL_UNSIGNED_BYTE
-      swrast->SpanArrays[i].rgba = swrast->SpanArrays[i].rgba8;
-#elif CHAN_TYPE == GL_UNSIGNED_SHORT
-      swrast->SpanArrays[i].rgba = swrast->SpanArrays[i].rgba16;
-#else
-      swrast->SpanArrays[i].rgba = swrast->SpanArrays[i].attribs[FRAG_ATTRIB_COL0];
-#endif
-   }
 
    /* init point span buffer */
    swrast->PointSpan.primitive = GL_POINT;
@@ -826,9 +960,12 @@ _swrast_DestroyContext( struct gl_context *ctx )
       _mesa_debug(ctx, "_swrast_DestroyContext\n");
    }
 
+   _swrast_tile_destroy( ctx );
+
    free( swrast->SpanArrays );
    free( swrast->ZoomedArrays );
    free( swrast->TexelBuffer );
+   free( swrast->FragProgMachine );
 
    free(swrast->stencil_temp.buf1);
    free(swrast->stencil_temp.buf2);
@@ -852,6 +989,8 @@ void
 _swrast_flush( struct gl_context *ctx )
 {
    SWcontext *swrast = SWRAST_CONTEXT(ctx);
+   /* flush any binned triangles */
+   _swrast_tile_flush(ctx);
    /* flush any pending fragments from rendering points */
    if (swrast->PointSpan.end > 0) {
       _swrast_write_rgba_span(ctx, &(swrast->PointSpan));
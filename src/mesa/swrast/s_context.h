@@ -112,6 +112,7 @@ typedef void (*validate_texture_image_func)(struct gl_context *ctx,
 
 
 struct swrast_texture_image;
+struct swrast_tile_state;
 
 
 /**
@@ -218,6 +219,7 @@ typedef struct
    GLboolean _TextureCombinePrimary;
    GLboolean _FogEnabled;
    GLboolean _DeferredTexture;
+   GLboolean _TileTriangles;     /**< Bin triangles into tiles? */
 
    /** List/array of the fragment attributes to interpolate */
    GLuint _ActiveAttribs[FRAG_ATTRIB_MAX];
@@ -287,6 +289,19 @@ typedef struct
    SWspanarrays *SpanArrays;
    SWspanarrays *ZoomedArrays;  /**< For pixel zooming */
 
+   /**
+    * Number of threads that may run the span code at once, and so of
+    * SpanArrays, FragProgMachines and per-thread texel buffers.
+    * See _swrast_thread_num().
+    */
+   GLuint MaxThreads;
+
+   /**
+    * Screen-space triangle bins for tiled rendering, or NULL if tiled
+    * rendering is off.  See s_tile.c.
+    */
+   struct swrast_tile_state *Tiles;
+
    /**
     * Used to buffer N GL_POINTS, instead of rendering one by one.
     */
@@ -304,8 +319,8 @@ typedef struct
 
    validate_texture_image_func ValidateTextureImage;
 
-   /** State used during execution of fragment programs */
-   struct gl_program_machine FragProgMachine;
+   /** State used during execution of fragment programs, one per thread */
+   struct gl_program_machine *FragProgMachine;
 
    /** Temporary arrays for stencil operations.  To avoid large stack
     * allocations.
@@ -323,6 +338,12 @@ _swrast_validate_derived( struct gl_context *ctx );
 extern void
 _swrast_update_texture_samplers(struct gl_context *ctx);
 
+extern void
+_swrast_validate_triangle_func(struct gl_context *ctx);
+
+extern GLboolean
+_swrast_alloc_threads(struct gl_context *ctx, GLuint numThreads);
+
 
 /** Return SWcontext for the given struct gl_context */
 static inline SWcontext *
@@ -52,6 +52,7 @@
 #include "s_span.h"
 #include "s_stencil.h"
 #include "s_texcombine.h"
+#include "s_tile.h"
 
 #include <stdbool.h>
 
@@ -693,17 +694,30 @@ stipple_polygon_span(struct gl_context *ctx, SWspan *span)
 /**
  * Clip a pixel span to the current buffer/window boundaries:
  * DrawBuffer->_Xmin, _Xmax, _Ymin, _Ymax.  This will accomplish
- * window clipping and scissoring.
+ * window clipping and scissoring.  While binned triangles are being
+ * rasterized, the bounds are those of the current thread's tile.
  * Return:   GL_TRUE   some pixels still visible
  *           GL_FALSE  nothing visible
  */
 static inline GLuint
 clip_span( struct gl_context *ctx, SWspan *span )
 {
-   const GLint xmin = ctx->DrawBuffer->_Xmin;
-   const GLint xmax = ctx->DrawBuffer->_Xmax;
-   const GLint ymin = ctx->DrawBuffer->_Ymin;
-   const GLint ymax = ctx->DrawBuffer->_Ymax;
+   const struct swrast_tile_state *tiles = SWRAST_CONTEXT(ctx)->Tiles;
+   GLint xmin, xmax, ymin, ymax;
+
+   if (tiles && tiles->Flushing) {
+      const struct swrast_tile_rect *clip = tiles->Clip + _swrast_thread_num();
+      xmin = clip->xmin;
+      xmax = clip->xmax;
+      ymin = clip->ymin;
+      ymax = clip->ymax;
+   }
+   else {
+      xmin = ctx->DrawBuffer->_Xmin;
+      xmax = ctx->DrawBuffer->_Xmax;
+      ymin = ctx->DrawBuffer->_Ymin;
+      ymax = ctx->DrawBuffer->_Ymax;
+   }
 
    span->leftClip = 0;
 
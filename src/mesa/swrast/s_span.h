@@ -34,6 +34,10 @@
 #include "swrast/s_chan.h"
 #include "swrast/swrast.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 
 struct gl_context;
 struct gl_renderbuffer;
@@ -170,6 +174,20 @@ typedef struct sw_span
 
 
 
+extern void
+_swrast_init_thread_num(void);
+
+extern GLuint
+_swrast_thread_num(void);
+
+/**
+ * Each thread needs to use a different (global) SpanArrays variable.
+ * Outside of parallel regions this is always the first one.
+ */
+#define SWRAST_SPAN_ARRAYS(ctx) \
+   (SWRAST_CONTEXT(ctx)->SpanArrays + _swrast_thread_num())
+
+
 #define INIT_SPAN(S, PRIMITIVE)			\
 do {						\
    (S).primitive = (PRIMITIVE);			\
@@ -179,7 +197,7 @@ do {						\
    (S).end = 0;					\
    (S).leftClip = 0;				\
    (S).facing = 0;				\
-   (S).array = SWRAST_CONTEXT(ctx)->SpanArrays;	\
+   (S).array = SWRAST_SPAN_ARRAYS(ctx);		\
 } while (0)
 
 
@@ -49,11 +49,9 @@ typedef float (*float4_array)[4];
 static inline float4_array
 get_texel_array(SWcontext *swrast, GLuint unit)
 {
-#ifdef _OPENMP
-   return (float4_array) (swrast->TexelBuffer + unit * SWRAST_MAX_WIDTH * 4 * omp_get_num_threads() + (SWRAST_MAX_WIDTH * 4 * omp_get_thread_num()));
-#else
-   return (float4_array) (swrast->TexelBuffer + unit * SWRAST_MAX_WIDTH * 4);
-#endif
+   return (float4_array) (swrast->TexelBuffer +
+                          SWRAST_MAX_WIDTH * 4 *
+                          (unit * swrast->MaxThreads + _swrast_thread_num()));
 }
 
 
@@ -590,21 +588,16 @@ swizzle_texels(GLuint swizzle, GLuint count, float4_array texels)
 
 
 /**
- * Apply texture mapping to a span of fragments.
+ * Allocate swrast->TexelBuffer if that hasn't been done yet.
+ * \return GL_FALSE if out of memory.
  */
-void
-_swrast_texture_span( struct gl_context *ctx, SWspan *span )
+GLboolean
+_swrast_alloc_texel_buffer( struct gl_context *ctx )
 {
    SWcontext *swrast = SWRAST_CONTEXT(ctx);
-   float4_array primary_rgba;
-   GLuint unit;
 
    if (!swrast->TexelBuffer) {
-#ifdef _OPENMP
-      const GLint maxThreads = omp_get_max_threads();
-#else
-      const GLint maxThreads = 1;
-#endif
+      const GLint maxThreads = swrast->MaxThreads;
 
       /* TexelBuffer is also global and normally shared by all SWspan
        * instances; when running with multiple threads, create one per
@@ -615,10 +608,27 @@ _swrast_texture_span( struct gl_context *ctx, SWspan *span )
 			    SWRAST_MAX_WIDTH * 4 * sizeof(GLfloat));
       if (!swrast->TexelBuffer) {
 	 _mesa_error(ctx, GL_OUT_OF_MEMORY, "texture_combine");
-	 return;
+	 return GL_FALSE;
       }
    }
 
+   return GL_TRUE;
+}
+
+
+/**
+ * Apply texture mapping to a span of fragments.
+ */
+void
+_swrast_texture_span( struct gl_context *ctx, SWspan *span )
+{
+   SWcontext *swrast = SWRAST_CONTEXT(ctx);
+   float4_array primary_rgba;
+   GLuint unit;
+
+   if (!_swrast_alloc_texel_buffer(ctx))
+      return;
+
    primary_rgba = malloc(span->end * 4 * sizeof(GLfloat));
 
    if (!primary_rgba) {
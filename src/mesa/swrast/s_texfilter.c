@@ -29,6 +29,11 @@
 #include "main/imports.h"
 #include "main/texobj.h"
 #include "main/samplerobj.h"
+#include "main/cpuinfo.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "s_context.h"
 #include "s_texfilter.h"
@@ -1354,6 +1359,205 @@ sample_2d_linear_mipmap_linear_repeat(struct gl_context *ctx,
 }
 
 
+#if defined(__SSE2__)
+
+/*
+ * SSE2 versions of the GL_REPEAT, power of two, bilinear/trilinear paths
+ * for the most common 8-bit RGBA and float RGBA formats.  Texels are read
+ * straight out of the mapped image instead of through FetchTexel and the
+ * four color channels are filtered in parallel.
+ */
+
+/** Can the format be filtered with the SSE2 paths below? */
+static inline GLboolean
+sse2_linear_format(gl_format format)
+{
+   switch (format) {
+   case MESA_FORMAT_RGBA8888:
+   case MESA_FORMAT_RGBA8888_REV:
+   case MESA_FORMAT_ARGB8888:
+   case MESA_FORMAT_RGBA_FLOAT32:
+      return GL_TRUE;
+   default:
+      return GL_FALSE;
+   }
+}
+
+
+/**
+ * Convert a 32-bit texel to four floats in [0,1], in memory order.
+ * Dividing gives exactly UBYTE_TO_FLOAT(), so that the filtered result
+ * is the same as the C code's.
+ */
+static inline __m128
+sse2_unpack_ubyte4(GLuint texel)
+{
+   const __m128i zero = _mm_setzero_si128();
+   __m128i v = _mm_cvtsi32_si128((int) texel);
+   v = _mm_unpacklo_epi8(v, zero);
+   v = _mm_unpacklo_epi16(v, zero);
+   return _mm_div_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(255.0F));
+}
+
+
+/** a + t * (b - a), per channel */
+static inline __m128
+sse2_lerp(__m128 t, __m128 a, __m128 b)
+{
+   return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+}
+
+
+/**
+ * SSE2 version of sample_2d_linear_repeat().  The result is left in the
+ * image's memory channel order; see sse2_store_rgba().
+ */
+static inline __m128
+sse2_sample_2d_linear_repeat(const struct gl_texture_image *img,
+                             const GLfloat texcoord[4])
+{
+   const struct swrast_texture_image *swImg = swrast_texture_image_const(img);
+   GLint i0, j0, i1, j1;
+   GLfloat wi, wj;
+   __m128 t00, t10, t01, t11, si;
+
+   linear_repeat_texel_location(img->Width2,  texcoord[0], &i0, &i1, &wi);
+   linear_repeat_texel_location(img->Height2, texcoord[1], &j0, &j1, &wj);
+
+   if (img->TexFormat == MESA_FORMAT_RGBA_FLOAT32) {
+      const GLfloat *row0 = (const GLfloat *) swImg->Map
+         + 4 * swImg->RowStride * j0;
+      const GLfloat *row1 = (const GLfloat *) swImg->Map
+         + 4 * swImg->RowStride * j1;
+      t00 = _mm_loadu_ps(row0 + 4 * i0);
+      t10 = _mm_loadu_ps(row0 + 4 * i1);
+      t01 = _mm_loadu_ps(row1 + 4 * i0);
+      t11 = _mm_loadu_ps(row1 + 4 * i1);
+   }
+   else {
+      const GLuint *row0 = (const GLuint *) swImg->Map + swImg->RowStride * j0;
+      const GLuint *row1 = (const GLuint *) swImg->Map + swImg->RowStride * j1;
+      t00 = sse2_unpack_ubyte4(row0[i0]);
+      t10 = sse2_unpack_ubyte4(row0[i1]);
+      t01 = sse2_unpack_ubyte4(row1[i0]);
+      t11 = sse2_unpack_ubyte4(row1[i1]);
+   }
+
+   si = _mm_set1_ps(wi);
+   return sse2_lerp(_mm_set1_ps(wj),
+                    sse2_lerp(si, t00, t10),
+                    sse2_lerp(si, t01, t11));
+}
+
+
+/**
+ * Reorder a filtered texel from memory order into RGBA order and store it.
+ * Filtering works on each channel alone, so this only needs doing once
+ * per fragment.
+ */
+static inline void
+sse2_store_rgba(gl_format format, __m128 texel, GLfloat rgba[4])
+{
+   switch (format) {
+   case MESA_FORMAT_RGBA8888:
+      /* bytes in memory are A, B, G, R */
+      texel = _mm_shuffle_ps(texel, texel, _MM_SHUFFLE(0, 1, 2, 3));
+      break;
+   case MESA_FORMAT_ARGB8888:
+      /* bytes in memory are B, G, R, A */
+      texel = _mm_shuffle_ps(texel, texel, _MM_SHUFFLE(3, 0, 1, 2));
+      break;
+   default:
+      ;
+   }
+
+   _mm_storeu_ps(rgba, texel);
+}
+
+
+static void
+sse2_sample_linear_2d_repeat(const struct gl_texture_object *tObj,
+                             GLuint n, const GLfloat texcoords[][4],
+                             GLfloat rgba[][4])
+{
+   const struct gl_texture_image *img = tObj->Image[0][tObj->BaseLevel];
+   const gl_format format = img->TexFormat;
+   GLuint i = 0;
+
+#if defined(USE_X86_64_ASM)
+   if (cpu_has_avx2) {
+      i = _mesa_x86_64_avx2_sample_2d_linear_repeat(img, NULL, n, texcoords,
+                                                    NULL, rgba);
+   }
+#endif
+
+   for (; i < n; i++) {
+      sse2_store_rgba(format, sse2_sample_2d_linear_repeat(img, texcoords[i]),
+                      rgba[i]);
+   }
+}
+
+
+/** The level that linear_mipmap_level() gives, or _MaxLevel if past it */
+static inline GLint
+sse2_linear_mipmap_level(const struct gl_texture_object *tObj, GLfloat lambda)
+{
+   return MIN2(linear_mipmap_level(tObj, lambda), tObj->_MaxLevel);
+}
+
+
+/**
+ * SSE2 version of sample_2d_linear_mipmap_linear_repeat().
+ * All mipmap levels of a complete texture share the base level's format,
+ * and levels of a power of two image are powers of two, so checking the
+ * base level is enough.
+ *
+ * Neighbouring fragments mostly sample the same levels, so the span is
+ * cut into runs of fragments with the same level, and with AVX2 most of
+ * each run is filtered eight fragments at a time.
+ */
+static void
+sse2_sample_2d_linear_mipmap_linear_repeat(const struct gl_texture_object *tObj,
+                                           GLuint n,
+                                           const GLfloat texcoord[][4],
+                                           const GLfloat lambda[],
+                                           GLfloat rgba[][4])
+{
+   const gl_format format = tObj->Image[0][tObj->BaseLevel]->TexFormat;
+   GLuint i = 0;
+
+   while (i < n) {
+      const GLint level = sse2_linear_mipmap_level(tObj, lambda[i]);
+      const struct gl_texture_image *img0 = tObj->Image[0][level];
+      const struct gl_texture_image *img1 =
+         level < tObj->_MaxLevel ? tObj->Image[0][level + 1] : NULL;
+      GLuint end = i + 1;
+
+      while (end < n && sse2_linear_mipmap_level(tObj, lambda[end]) == level)
+         end++;
+
+#if defined(USE_X86_64_ASM)
+      if (cpu_has_avx2) {
+         i += _mesa_x86_64_avx2_sample_2d_linear_repeat(img0, img1, end - i,
+                                                        texcoord + i,
+                                                        lambda + i, rgba + i);
+      }
+#endif
+
+      for (; i < end; i++) {
+         __m128 texel = sse2_sample_2d_linear_repeat(img0, texcoord[i]);
+         if (img1) {
+            const __m128 t1 = sse2_sample_2d_linear_repeat(img1, texcoord[i]);
+            texel = sse2_lerp(_mm_set1_ps(FRAC(lambda[i])), texel, t1);
+         }
+         sse2_store_rgba(format, texel, rgba[i]);
+      }
+   }
+}
+
+#endif /* __SSE2__ */
+
+
 /** Sample 2D texture, nearest filtering for both min/magnification */
 static void
 sample_nearest_2d(struct gl_context *ctx,
@@ -1387,6 +1591,12 @@ sample_linear_2d(struct gl_context *ctx,
        samp->WrapT == GL_REPEAT &&
        swImg->_IsPowerOfTwo &&
        image->Border == 0) {
+#if defined(__SSE2__)
+      if (sse2_linear_format(image->TexFormat)) {
+         sse2_sample_linear_2d_repeat(tObj, n, texcoords, rgba);
+         return;
+      }
+#endif
       for (i = 0; i < n; i++) {
          sample_2d_linear_repeat(ctx, samp, image, texcoords[i], rgba[i]);
       }
@@ -1554,6 +1764,12 @@ sample_lambda_2d(struct gl_context *ctx,
                                          lambda + minStart, rgba + minStart);
          break;
       case GL_LINEAR_MIPMAP_LINEAR:
+#if defined(__SSE2__)
+         if (repeatNoBorderPOT && sse2_linear_format(tImg->TexFormat))
+            sse2_sample_2d_linear_mipmap_linear_repeat(tObj, m,
+                  texcoords + minStart, lambda + minStart, rgba + minStart);
+         else
+#endif
          if (repeatNoBorderPOT)
             sample_2d_linear_mipmap_linear_repeat(ctx, samp, tObj, m,
                   texcoords + minStart, lambda + minStart, rgba + minStart);
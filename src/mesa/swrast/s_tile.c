@@ -0,0 +1,464 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2012  The Mesa Authors   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+ * AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * \file swrast/s_tile.c
+ * \brief Deferred, tile-parallel triangle rasterization.
+ *
+ * Triangles handed to _swrast_Triangle() are copied into a batch and
+ * binned into SWRAST_TILE_SIZE x SWRAST_TILE_SIZE screen tiles by their
+ * bounding box.  _swrast_tile_flush() then runs the regular triangle
+ * function once per (tile, triangle) pair with clip_span() limited to
+ * the tile, so each tile sees its primitives in submission order and no
+ * pixel is touched by two threads.
+ *
+ * Only state for which the span pipeline is safe to run concurrently is
+ * binned; see _swrast_update_tile_state().  Everything else falls back
+ * to immediate rasterization after flushing the pending bins.
+ */
+
+
+#include "main/glheader.h"
+#include "main/imports.h"
+#include "main/macros.h"
+#include "main/mtypes.h"
+#include "glapi/glthread.h"
+
+#include "s_blend.h"
+#include "s_context.h"
+#include "s_texcombine.h"
+#include "s_tile.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+/**
+ * Number of the tile thread running on this thread, stored as a pointer.
+ * It's only set while _swrast_tile_flush() runs, and reads as 0 (NULL)
+ * everywhere else.
+ */
+static _glthread_TSD tile_thread_tsd;
+_glthread_DECLARE_STATIC_MUTEX(tile_thread_mutex);
+
+
+/**
+ * Create the thread-specific data key behind _swrast_thread_num().
+ * Called when a context is created, before any thread can ask.
+ */
+void
+_swrast_init_thread_num(void)
+{
+   _glthread_LOCK_MUTEX(tile_thread_mutex);
+   (void) _glthread_GetTSD(&tile_thread_tsd);
+   _glthread_UNLOCK_MUTEX(tile_thread_mutex);
+}
+
+
+/**
+ * Index of the calling thread's SpanArrays, FragProgMachine, texel
+ * buffer and tile clip rectangle, less than SWcontext::MaxThreads.
+ * This is the tile thread number while binned triangles are rasterized,
+ * and the OpenMP thread number inside the OpenMP loops of the span code.
+ */
+GLuint
+_swrast_thread_num(void)
+{
+   GLuint num = (GLuint) (uintptr_t) _glthread_GetTSD(&tile_thread_tsd);
+#ifdef _OPENMP
+   num += omp_get_thread_num();
+#endif
+   return num;
+}
+
+
+GLboolean
+_swrast_tile_create(struct gl_context *ctx)
+{
+   SWcontext *swrast = SWRAST_CONTEXT(ctx);
+   struct swrast_tile_state *tiles;
+
+   if (swrast->Tiles)
+      return GL_TRUE;
+
+   /* one set of span arrays and such for each tile thread */
+   if (!_swrast_alloc_threads(ctx, _mesa_num_threads()))
+      return GL_FALSE;
+
+   tiles = CALLOC_STRUCT(swrast_tile_state);
+   if (!tiles)
+      return GL_FALSE;
+
+   tiles->Triangles = malloc(SWRAST_TILE_MAX_TRIANGLES *
+                             sizeof(struct swrast_tile_triangle));
+   tiles->Clip = calloc(swrast->MaxThreads, sizeof(struct swrast_tile_rect));
+   if (!tiles->Triangles || !tiles->Clip) {
+      free(tiles->Triangles);
+      free(tiles->Clip);
+      free(tiles);
+      return GL_FALSE;
+   }
+
+   swrast->Tiles = tiles;
+   return GL_TRUE;
+}
+
+
+void
+_swrast_tile_destroy(struct gl_context *ctx)
+{
+   SWcontext *swrast = SWRAST_CONTEXT(ctx);
+   struct swrast_tile_state *tiles = swrast->Tiles;
+   GLuint i;
+
+   if (!tiles)
+      return;
+
+   for (i = 0; i < tiles->NumBins; i++)
+      free(tiles->Bins[i].Triangles);
+   free(tiles->Bins);
+   free(tiles->Triangles);
+   free(tiles->Clip);
+   free(tiles);
+
+   swrast->Tiles = NULL;
+}
+
+
+/**
+ * Determine whether triangles may be binned with the current state.
+ * Called from _swrast_validate_derived() after _RasterMask is updated.
+ *
+ * The per-span code must not write any context-global scratch state:
+ * stencil testing uses swrast->stencil_temp, occlusion queries sum into
+ * the query object and ATI fragment shaders keep their machine in the
+ * context.  Antialiased triangles already parallelize over scanlines,
+ * feedback/select must see triangles in order and the separate
+ * specular path temporarily modifies the (shared) vertices.
+ */
+void
+_swrast_update_tile_state(struct gl_context *ctx)
+{
+   SWcontext *swrast = SWRAST_CONTEXT(ctx);
+   const GLbitfield unsafeMask = (STENCIL_BIT |
+                                  OCCLUSION_BIT |
+                                  ATIFRAGSHADER_BIT);
+
+   swrast->_TileTriangles = (swrast->Tiles &&
+                             ctx->RenderMode == GL_RENDER &&
+                             !ctx->Polygon.SmoothFlag &&
+                             !swrast->SpecularVertexAdd &&
+                             (swrast->_RasterMask & unsafeMask) == 0);
+}
+
+
+/**
+ * Lay out the tile grid for a framebuffer of the given size.
+ * The bins must be empty.
+ */
+static GLboolean
+setup_tile_grid(struct swrast_tile_state *tiles, GLuint width, GLuint height)
+{
+   const GLuint tilesX = (width + SWRAST_TILE_SIZE - 1) >> SWRAST_TILE_SIZE_LOG2;
+   const GLuint tilesY = (height + SWRAST_TILE_SIZE - 1) >> SWRAST_TILE_SIZE_LOG2;
+   const GLuint numBins = tilesX * tilesY;
+
+   ASSERT(tiles->NumTriangles == 0);
+
+   if (numBins > tiles->NumBins) {
+      struct swrast_tile_bin *bins =
+         realloc(tiles->Bins, numBins * sizeof(struct swrast_tile_bin));
+      if (!bins)
+         return GL_FALSE;
+      memset(bins + tiles->NumBins, 0,
+             (numBins - tiles->NumBins) * sizeof(struct swrast_tile_bin));
+      tiles->Bins = bins;
+      tiles->NumBins = numBins;
+   }
+
+   tiles->Width = width;
+   tiles->Height = height;
+   tiles->TilesX = tilesX;
+   tiles->TilesY = tilesY;
+   return GL_TRUE;
+}
+
+
+/**
+ * Append triangle 'index' to a bin.
+ */
+static inline GLboolean
+bin_triangle(struct swrast_tile_bin *bin, GLuint index)
+{
+   if (bin->Count == bin->Size) {
+      const GLuint size = bin->Size ? bin->Size * 2 : 64;
+      GLuint *tris = realloc(bin->Triangles, size * sizeof(GLuint));
+      if (!tris)
+         return GL_FALSE;
+      bin->Triangles = tris;
+      bin->Size = size;
+   }
+   bin->Triangles[bin->Count++] = index;
+   return GL_TRUE;
+}
+
+
+/**
+ * Remove triangle 'index' from the bins in the given tile range.  It's
+ * always the most recently added entry of any bin it was added to.
+ */
+static void
+unbin_triangle(struct swrast_tile_state *tiles, GLuint index,
+               GLint tx0, GLint tx1, GLint ty0, GLint ty1)
+{
+   GLint tx, ty;
+
+   for (ty = ty0; ty <= ty1; ty++) {
+      struct swrast_tile_bin *row = tiles->Bins + ty * tiles->TilesX;
+      for (tx = tx0; tx <= tx1; tx++) {
+         struct swrast_tile_bin *bin = &row[tx];
+         if (bin->Count > 0 && bin->Triangles[bin->Count - 1] == index)
+            bin->Count--;
+      }
+   }
+}
+
+
+/**
+ * Defer a triangle into the tile bins.
+ * \return GL_FALSE if the caller must rasterize the triangle itself.
+ */
+GLboolean
+_swrast_tile_triangle(struct gl_context *ctx, const SWvertex *v0,
+                      const SWvertex *v1, const SWvertex *v2)
+{
+   SWcontext *swrast = SWRAST_CONTEXT(ctx);
+   struct swrast_tile_state *tiles = swrast->Tiles;
+   const struct gl_framebuffer *fb = ctx->DrawBuffer;
+   struct swrast_tile_triangle *tri;
+   GLfloat xmin, xmax, ymin, ymax;
+   GLint tx0, tx1, ty0, ty1, tx, ty;
+   GLuint index;
+
+   _swrast_validate_derived(ctx);
+
+   if (!swrast->_TileTriangles) {
+      /* draw immediately, but only after everything queued before it */
+      _swrast_tile_flush(ctx);
+      return GL_FALSE;
+   }
+
+   if (tiles->Width != fb->Width || tiles->Height != fb->Height) {
+      _swrast_tile_flush(ctx);
+      if (!setup_tile_grid(tiles, fb->Width, fb->Height)) {
+         tiles->Width = tiles->Height = 0;
+         return GL_FALSE;
+      }
+   }
+
+   /* Bounding box, with a pixel of slop for sub-pixel snapping in
+    * s_tritemp.h.  The comparisons are written so that NaN coordinates
+    * end up rejected.
+    */
+   xmin = MIN3(v0->attrib[FRAG_ATTRIB_WPOS][0],
+               v1->attrib[FRAG_ATTRIB_WPOS][0],
+               v2->attrib[FRAG_ATTRIB_WPOS][0]) - 1.0F;
+   xmax = MAX3(v0->attrib[FRAG_ATTRIB_WPOS][0],
+               v1->attrib[FRAG_ATTRIB_WPOS][0],
+               v2->attrib[FRAG_ATTRIB_WPOS][0]) + 1.0F;
+   ymin = MIN3(v0->attrib[FRAG_ATTRIB_WPOS][1],
+               v1->attrib[FRAG_ATTRIB_WPOS][1],
+               v2->attrib[FRAG_ATTRIB_WPOS][1]) - 1.0F;
+   ymax = MAX3(v0->attrib[FRAG_ATTRIB_WPOS][1],
+               v1->attrib[FRAG_ATTRIB_WPOS][1],
+               v2->attrib[FRAG_ATTRIB_WPOS][1]) + 1.0F;
+
+   if (!(xmax >= (GLfloat) fb->_Xmin && xmin < (GLfloat) fb->_Xmax &&
+         ymax >= (GLfloat) fb->_Ymin && ymin < (GLfloat) fb->_Ymax)) {
+      /* completely clipped, nothing to draw */
+      return GL_TRUE;
+   }
+
+   tx0 = MAX2(IFLOOR(xmin), fb->_Xmin) >> SWRAST_TILE_SIZE_LOG2;
+   tx1 = MIN2(IFLOOR(xmax), fb->_Xmax - 1) >> SWRAST_TILE_SIZE_LOG2;
+   ty0 = MAX2(IFLOOR(ymin), fb->_Ymin) >> SWRAST_TILE_SIZE_LOG2;
+   ty1 = MIN2(IFLOOR(ymax), fb->_Ymax - 1) >> SWRAST_TILE_SIZE_LOG2;
+
+   index = tiles->NumTriangles;
+   tri = &tiles->Triangles[index];
+   memcpy(&tri->v[0], v0, sizeof(SWvertex));
+   memcpy(&tri->v[1], v1, sizeof(SWvertex));
+   memcpy(&tri->v[2], v2, sizeof(SWvertex));
+
+   for (ty = ty0; ty <= ty1; ty++) {
+      struct swrast_tile_bin *row = tiles->Bins + ty * tiles->TilesX;
+      for (tx = tx0; tx <= tx1; tx++) {
+         if (!bin_triangle(&row[tx], index)) {
+            /* Out of memory.  Take back this triangle's partial binning,
+             * flush what we have and let the caller draw this one.
+             */
+            unbin_triangle(tiles, index, tx0, tx1, ty0, ty1);
+            _swrast_tile_flush(ctx);
+            return GL_FALSE;
+         }
+      }
+   }
+
+   if (++tiles->NumTriangles == SWRAST_TILE_MAX_TRIANGLES)
+      _swrast_tile_flush(ctx);
+
+   return GL_TRUE;
+}
+
+
+/**
+ * Make lazily-validated state usable from several threads.  The span
+ * code normally picks the blend function and allocates the texel
+ * buffer on first use; do that here, before going parallel.
+ */
+static void
+prepare_tile_flush(struct gl_context *ctx)
+{
+   SWcontext *swrast = SWRAST_CONTEXT(ctx);
+   struct gl_renderbuffer *rb = ctx->DrawBuffer->_ColorDrawBuffers[0];
+
+   _swrast_validate_triangle_func(ctx);
+
+   if ((swrast->_RasterMask & BLEND_BIT) && rb)
+      _swrast_choose_blend_func(ctx, swrast_renderbuffer(rb)->ColorType);
+
+   if (swrast->_RasterMask & TEXTURE_BIT)
+      _swrast_alloc_texel_buffer(ctx);
+}
+
+
+/** Work shared by the threads of a _swrast_tile_flush() */
+struct tile_flush_job
+{
+   struct gl_context *ctx;
+   GLuint NumTiles;
+   GLuint NextTile;             /**< next tile to hand out, under Mutex */
+   _glthread_Mutex Mutex;
+};
+
+
+/**
+ * Replay the triangles of tile 't', clipped to the tile.
+ */
+static void
+rasterize_tile(struct gl_context *ctx, GLuint t, struct swrast_tile_rect *clip)
+{
+   SWcontext *swrast = SWRAST_CONTEXT(ctx);
+   struct swrast_tile_state *tiles = swrast->Tiles;
+   const struct gl_framebuffer *fb = ctx->DrawBuffer;
+   struct swrast_tile_bin *bin = &tiles->Bins[t];
+   const GLint x = (t % tiles->TilesX) << SWRAST_TILE_SIZE_LOG2;
+   const GLint y = (t / tiles->TilesX) << SWRAST_TILE_SIZE_LOG2;
+   GLuint i;
+
+   if (bin->Count == 0)
+      return;
+
+   clip->xmin = MAX2(x, fb->_Xmin);
+   clip->xmax = MIN2(x + SWRAST_TILE_SIZE, fb->_Xmax);
+   clip->ymin = MAX2(y, fb->_Ymin);
+   clip->ymax = MIN2(y + SWRAST_TILE_SIZE, fb->_Ymax);
+
+   for (i = 0; i < bin->Count; i++) {
+      const struct swrast_tile_triangle *tri =
+         &tiles->Triangles[bin->Triangles[i]];
+      swrast->Triangle(ctx, &tri->v[0], &tri->v[1], &tri->v[2]);
+   }
+
+   bin->Count = 0;
+}
+
+
+/**
+ * Body of a tile thread.  Each range of the _mesa_parallel_for() is one
+ * thread, numbered by 'thread'.  The threads take the next tile until
+ * there are none left, so that a few busy tiles don't hold up the rest.
+ */
+static void
+rasterize_tiles(void *data, GLuint thread, GLuint end)
+{
+   struct tile_flush_job *job = (struct tile_flush_job *) data;
+   struct swrast_tile_rect *clip =
+      SWRAST_CONTEXT(job->ctx)->Tiles->Clip + thread;
+   (void) end;
+
+   _glthread_SetTSD(&tile_thread_tsd, (void *) (uintptr_t) thread);
+
+   for (;;) {
+      GLuint t;
+
+      _glthread_LOCK_MUTEX(job->Mutex);
+      t = job->NextTile++;
+      _glthread_UNLOCK_MUTEX(job->Mutex);
+
+      if (t >= job->NumTiles)
+         break;
+
+      rasterize_tile(job->ctx, t, clip);
+   }
+
+   _glthread_SetTSD(&tile_thread_tsd, NULL);
+}
+
+
+/**
+ * Rasterize all binned triangles, on up to _mesa_num_threads() threads.
+ */
+void
+_swrast_tile_flush(struct gl_context *ctx)
+{
+   SWcontext *swrast = SWRAST_CONTEXT(ctx);
+   struct swrast_tile_state *tiles = swrast->Tiles;
+   struct tile_flush_job job;
+   GLuint t, busyTiles = 0, numThreads;
+
+   if (!tiles || tiles->NumTriangles == 0)
+      return;
+
+   prepare_tile_flush(ctx);
+
+   job.ctx = ctx;
+   job.NumTiles = tiles->TilesX * tiles->TilesY;
+   job.NextTile = 0;
+   _glthread_INIT_MUTEX(job.Mutex);
+
+   for (t = 0; t < job.NumTiles; t++) {
+      if (tiles->Bins[t].Count > 0)
+         busyTiles++;
+   }
+   numThreads = MIN3(_mesa_num_threads(), swrast->MaxThreads, busyTiles);
+
+   tiles->Flushing = GL_TRUE;
+   _mesa_parallel_for(numThreads, numThreads, rasterize_tiles, &job);
+   tiles->Flushing = GL_FALSE;
+   tiles->NumTriangles = 0;
+
+   _glthread_DESTROY_MUTEX(job.Mutex);
+}
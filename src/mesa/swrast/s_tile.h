@@ -0,0 +1,112 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2012  The Mesa Authors   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+ * AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * \file swrast/s_tile.h
+ * \brief Screen-space tile binning for triangles.
+ *
+ * When tiled rendering is enabled, triangles are not rasterized as they
+ * arrive.  Instead they're copied and sorted into screen-space tiles.
+ * At flush time each tile replays its triangles, in submission order,
+ * with span clipping restricted to the tile's rectangle.  Since no two
+ * tiles touch the same pixels, tiles may be rasterized concurrently
+ * (on the threads of _mesa_parallel_for()) without changing the
+ * rendered image.
+ */
+
+
+#ifndef S_TILE_H
+#define S_TILE_H
+
+
+#include "main/mtypes.h"
+#include "swrast.h"
+
+
+/** Size of a tile, in pixels, in each dimension */
+#define SWRAST_TILE_SIZE_LOG2  6
+#define SWRAST_TILE_SIZE       (1 << SWRAST_TILE_SIZE_LOG2)
+
+/** Max number of binned triangles before we force a flush */
+#define SWRAST_TILE_MAX_TRIANGLES 4096
+
+
+/** A deferred triangle */
+struct swrast_tile_triangle
+{
+   SWvertex v[3];
+};
+
+
+/** The list of triangles which touch one tile */
+struct swrast_tile_bin
+{
+   GLuint *Triangles;   /**< indexes into swrast_tile_state::Triangles */
+   GLuint Count, Size;
+};
+
+
+/** Clip rectangle of the tile a thread is currently rasterizing */
+struct swrast_tile_rect
+{
+   GLint xmin, xmax, ymin, ymax;
+};
+
+
+struct swrast_tile_state
+{
+   /** The framebuffer size the bins were laid out for */
+   GLuint Width, Height;
+   GLuint TilesX, TilesY;
+
+   struct swrast_tile_bin *Bins;
+   GLuint NumBins;             /**< allocated bins (>= TilesX * TilesY) */
+
+   struct swrast_tile_triangle *Triangles;
+   GLuint NumTriangles;
+
+   /** One clip rect per thread, only valid while Flushing is set */
+   struct swrast_tile_rect *Clip;
+   GLboolean Flushing;
+};
+
+
+extern GLboolean
+_swrast_tile_create(struct gl_context *ctx);
+
+extern void
+_swrast_tile_destroy(struct gl_context *ctx);
+
+extern void
+_swrast_update_tile_state(struct gl_context *ctx);
+
+extern GLboolean
+_swrast_tile_triangle(struct gl_context *ctx, const SWvertex *v0,
+                      const SWvertex *v1, const SWvertex *v2);
+
+extern void
+_swrast_tile_flush(struct gl_context *ctx);
+
+
+#endif
@@ -251,6 +251,9 @@ _swrast_allow_vertex_fog( struct gl_context *ctx, GLboolean value );
 extern void
 _swrast_allow_pixel_fog( struct gl_context *ctx, GLboolean value );
 
+extern GLboolean
+_swrast_allow_tiled_rendering( struct gl_context *ctx, GLboolean value );
+
 /* Debug:
  */
 extern void
@@ -72,6 +72,7 @@ _tnl_CreateContext( struct gl_context *ctx )
    tnl->NeedNdcCoords = GL_TRUE;
    tnl->AllowVertexFog = GL_TRUE;
    tnl->AllowPixelFog = GL_TRUE;
+   tnl->BatchSize = TNL_MAX_BATCH_SIZE;
 
    /* Set a few default values in the driver struct.
     */
@@ -234,3 +235,15 @@ _tnl_allow_pixel_fog( struct gl_context *ctx, GLboolean value )
       || !tnl->AllowPixelFog) && !ctx->FragmentProgram._Current;
 }
 
+
+/**
+ * Set the number of vertices the vectorized lighting and texgen paths
+ * process per batch.  Zero disables those paths.
+ */
+void
+_tnl_set_batch_size( struct gl_context *ctx, GLuint size )
+{
+   TNLcontext *tnl = TNL_CONTEXT(ctx);
+   tnl->BatchSize = MIN2(size, TNL_MAX_BATCH_SIZE);
+   tnl->pipeline.new_state |= _NEW_LIGHT | _NEW_TEXTURE;
+}
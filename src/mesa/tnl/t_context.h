@@ -59,6 +59,9 @@
 
 #define MAX_PIPELINE_STAGES     30
 
+/** Max number of vertices processed per SoA batch, see TNLcontext::BatchSize */
+#define TNL_MAX_BATCH_SIZE      64
+
 /*
  * Note: The first attributes match the VERT_ATTRIB_* definitions
  * in mtypes.h.  However, the tnl module has additional attributes
@@ -384,6 +387,37 @@ struct tnl_clipspace
 };
 
 
+/**
+ * A batch of 3-component vectors in structure-of-arrays form.  The
+ * vectorized lighting and texgen paths transpose their inputs into these
+ * so that the inner loops run across vertices.
+ */
+struct tnl_soa3
+{
+   GLfloat x[TNL_MAX_BATCH_SIZE];
+   GLfloat y[TNL_MAX_BATCH_SIZE];
+   GLfloat z[TNL_MAX_BATCH_SIZE];
+};
+
+
+/**
+ * Load n (<= TNL_MAX_BATCH_SIZE) 3-vectors, stride bytes apart, into SoA
+ * form.
+ */
+static inline void
+_tnl_soa3_load(struct tnl_soa3 *dst, const GLfloat *src, GLuint stride,
+               GLuint n)
+{
+   GLuint i;
+   for (i = 0; i < n; i++) {
+      dst->x[i] = src[0];
+      dst->y[i] = src[1];
+      dst->z[i] = src[2];
+      src = (const GLfloat *) ((const GLubyte *) src + stride);
+   }
+}
+
+
 #define SHINE_TABLE_SIZE 256	/**< Material shininess lookup table sizes */
 
 /**
@@ -522,6 +556,11 @@ typedef struct
    GLboolean AllowPixelFog;
    GLboolean _DoVertexFog;  /* eval fog function at each vertex? */
 
+   /** Vertices per batch in the vectorized (SoA) lighting and texgen paths,
+    * at most TNL_MAX_BATCH_SIZE.  Zero selects the per-vertex paths.
+    */
+   GLuint BatchSize;
+
    GLbitfield64 render_inputs_bitset;
 
    GLvector4f tmp_inputs[VERT_ATTRIB_MAX];
@@ -66,6 +66,7 @@ struct light_stage_data {
    GLvector4f LitColor[2];
    GLvector4f LitSecondary[2];
    light_func *light_func_tab;
+   light_func *light_soa_tab;    /**< vectorized paths, or NULL */
 
    struct material_cursor mat[MAT_ATTRIB_MAX];
    GLuint mat_count;
@@ -290,6 +291,7 @@ static light_func _tnl_light_tab[MAX_LIGHT_FUNC];
 static light_func _tnl_light_fast_tab[MAX_LIGHT_FUNC];
 static light_func _tnl_light_fast_single_tab[MAX_LIGHT_FUNC];
 static light_func _tnl_light_spec_tab[MAX_LIGHT_FUNC];
+static light_func _tnl_light_fast_soa_tab[MAX_LIGHT_FUNC];
 
 #define TAG(x)           x
 #define IDX              (0)
@@ -372,7 +374,10 @@ static GLboolean run_lighting( struct gl_context *ctx,
    /* The individual functions know about replaying side-effects
     * vs. full re-execution. 
     */
-   store->light_func_tab[idx]( ctx, VB, stage, input );
+   if (store->light_soa_tab && store->light_soa_tab[idx])
+      store->light_soa_tab[idx]( ctx, VB, stage, input );
+   else
+      store->light_func_tab[idx]( ctx, VB, stage, input );
 
    return GL_TRUE;
 }
@@ -404,6 +409,13 @@ static void validate_lighting( struct gl_context *ctx,
 
    LIGHT_STAGE_DATA(stage)->light_func_tab = tab;
 
+   /* Infinite lights without GL_COLOR_MATERIAL can be done in batches.
+    */
+   if (!ctx->Light._NeedVertices && TNL_CONTEXT(ctx)->BatchSize)
+      LIGHT_STAGE_DATA(stage)->light_soa_tab = _tnl_light_fast_soa_tab;
+   else
+      LIGHT_STAGE_DATA(stage)->light_soa_tab = NULL;
+
    /* This and the above should only be done on _NEW_LIGHT:
     */
    TNL_CONTEXT(ctx)->Driver.NotifyMaterialChange( ctx );
@@ -429,6 +441,7 @@ static GLboolean init_lighting( struct gl_context *ctx,
    /* Do onetime init.
     */
    init_lighting_tables();
+   store->light_soa_tab = NULL;
 
    _mesa_vector4f_alloc( &store->Input, 0, size, 32 );
    _mesa_vector4f_alloc( &store->LitColor[0], 0, size, 32 );
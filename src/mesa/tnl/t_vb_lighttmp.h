@@ -618,12 +618,156 @@ static void TAG(light_fast_rgba)( struct gl_context *ctx,
 
 
 
+#if !(IDX & LIGHT_MATERIAL)
+
+/* As light_fast_rgba(), but the normals and accumulated colors are kept
+ * in SoA form, tnl->BatchSize vertices at a time, so that the loops over
+ * vertices can be vectorized.  Only the specular table lookups remain
+ * per-vertex.  Not used with GL_COLOR_MATERIAL, which updates the
+ * material between vertices.
+ */
+static void TAG(light_fast_rgba_soa)( struct gl_context *ctx,
+				      struct vertex_buffer *VB,
+				      struct tnl_pipeline_stage *stage,
+				      GLvector4f *input )
+{
+   struct light_stage_data *store = LIGHT_STAGE_DATA(stage);
+   const GLuint batch = TNL_CONTEXT(ctx)->BatchSize;
+   const GLuint nstride = VB->AttribPtr[_TNL_ATTRIB_NORMAL]->stride;
+   const GLfloat *normal = (GLfloat *)VB->AttribPtr[_TNL_ATTRIB_NORMAL]->data;
+   GLfloat (*Fcolor)[4] = (GLfloat (*)[4]) store->LitColor[0].data;
+#if IDX & LIGHT_TWOSIDE
+   GLfloat (*Bcolor)[4] = (GLfloat (*)[4]) store->LitColor[1].data;
+#endif
+   const GLuint nr = VB->AttribPtr[_TNL_ATTRIB_NORMAL]->count;
+   GLfloat sumA[2];
+   GLfloat n_dot_VP[TNL_MAX_BATCH_SIZE], n_dot_h[TNL_MAX_BATCH_SIZE];
+   struct tnl_soa3 n, sum[NR_SIDES];
+   GLuint start;
+
+#ifdef TRACE
+   fprintf(stderr, "%s %d\n", __FUNCTION__, nr );
+#endif
+
+   (void) input;
+
+   ASSERT(batch > 0 && batch <= TNL_MAX_BATCH_SIZE);
+
+   sumA[0] = ctx->Light.Material.Attrib[MAT_ATTRIB_FRONT_DIFFUSE][3];
+   sumA[1] = ctx->Light.Material.Attrib[MAT_ATTRIB_BACK_DIFFUSE][3];
+
+   VB->AttribPtr[_TNL_ATTRIB_COLOR0] = &store->LitColor[0];
+#if IDX & LIGHT_TWOSIDE
+   VB->BackfaceColorPtr = &store->LitColor[1];
+#endif
+
+   if (nr > 1) {
+      store->LitColor[0].stride = 16;
+      store->LitColor[1].stride = 16;
+   }
+   else {
+      store->LitColor[0].stride = 0;
+      store->LitColor[1].stride = 0;
+   }
+
+   for (start = 0; start < nr; start += batch) {
+      const GLuint count = MIN2(batch, nr - start);
+      const struct gl_light *light;
+      GLuint side, j;
+
+      _tnl_soa3_load(&n, normal, nstride, count);
+      STRIDE_F(normal, nstride * count);
+
+      for (side = 0; side < NR_SIDES; side++) {
+	 const GLfloat *base = ctx->Light._BaseColor[side];
+	 for (j = 0; j < count; j++) {
+	    sum[side].x[j] = base[0];
+	    sum[side].y[j] = base[1];
+	    sum[side].z[j] = base[2];
+	 }
+      }
+
+      foreach (light, &ctx->Light.EnabledList) {
+	 const GLfloat *VP = light->_VP_inf_norm;
+	 const GLfloat *h = light->_h_inf_norm;
+
+	 for (j = 0; j < count; j++) {
+	    n_dot_VP[j] = n.x[j] * VP[0] + n.y[j] * VP[1] + n.z[j] * VP[2];
+	    n_dot_h[j] = n.x[j] * h[0] + n.y[j] * h[1] + n.z[j] * h[2];
+	 }
+
+	 for (side = 0; side < NR_SIDES; side++) {
+	    const GLfloat *ambient = light->_MatAmbient[side];
+	    const GLfloat *diffuse = light->_MatDiffuse[side];
+	    const GLfloat *specular = light->_MatSpecular[side];
+	    const GLfloat sign = side ? -1.0F : 1.0F;
+	    GLboolean need_spec = GL_FALSE;
+
+	    /* Ambient and diffuse terms; the facing test is a select.
+	     * A vertex with n_dot_VP == 0 is lit on the back side only, as
+	     * in light_fast_rgba().
+	     */
+	    for (j = 0; j < count; j++) {
+	       const GLfloat d = sign * n_dot_VP[j];
+	       const GLboolean facing = side ? d >= 0.0F : d > 0.0F;
+	       const GLfloat lit = facing ? d : 0.0F;
+	       sum[side].x[j] += ambient[0];
+	       sum[side].y[j] += ambient[1];
+	       sum[side].z[j] += ambient[2];
+	       sum[side].x[j] += lit * diffuse[0];
+	       sum[side].y[j] += lit * diffuse[1];
+	       sum[side].z[j] += lit * diffuse[2];
+	       need_spec |= facing && sign * n_dot_h[j] > 0.0F;
+	    }
+
+	    if (!need_spec)
+	       continue;
+
+	    for (j = 0; j < count; j++) {
+	       const GLfloat d = sign * n_dot_VP[j];
+	       const GLfloat nh = sign * n_dot_h[j];
+	       const GLboolean facing = side ? d >= 0.0F : d > 0.0F;
+	       if (facing && nh > 0.0F) {
+		  const GLfloat spec = lookup_shininess(ctx, side, nh);
+		  sum[side].x[j] += spec * specular[0];
+		  sum[side].y[j] += spec * specular[1];
+		  sum[side].z[j] += spec * specular[2];
+	       }
+	    }
+	 }
+      }
+
+      for (j = 0; j < count; j++) {
+	 Fcolor[start + j][0] = sum[0].x[j];
+	 Fcolor[start + j][1] = sum[0].y[j];
+	 Fcolor[start + j][2] = sum[0].z[j];
+	 Fcolor[start + j][3] = sumA[0];
+#if IDX & LIGHT_TWOSIDE
+	 Bcolor[start + j][0] = sum[1].x[j];
+	 Bcolor[start + j][1] = sum[1].y[j];
+	 Bcolor[start + j][2] = sum[1].z[j];
+	 Bcolor[start + j][3] = sumA[1];
+#endif
+      }
+   }
+}
+
+#endif
+
+
+
+
 static void TAG(init_light_tab)( void )
 {
    _tnl_light_tab[IDX] = TAG(light_rgba);
    _tnl_light_fast_tab[IDX] = TAG(light_fast_rgba);
    _tnl_light_fast_single_tab[IDX] = TAG(light_fast_rgba_single);
    _tnl_light_spec_tab[IDX] = TAG(light_rgba_spec);
+#if IDX & LIGHT_MATERIAL
+   _tnl_light_fast_soa_tab[IDX] = NULL;
+#else
+   _tnl_light_fast_soa_tab[IDX] = TAG(light_fast_rgba_soa);
+#endif
 }
 
 
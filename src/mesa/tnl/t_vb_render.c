@@ -259,6 +259,41 @@ void _tnl_RenderClippedLine( struct gl_context *ctx, GLuint ii, GLuint jj )
 /**********************************************************************/
 
 
+/**
+ * Compute the bitwise OR and AND of the clip masks of one primitive's
+ * vertices.  This lets run_render() draw primitives which lie wholly
+ * inside the frustum without any per-triangle clip tests, and drop those
+ * lying wholly outside one frustum plane, even when other primitives in
+ * the vertex buffer need clipping.
+ */
+static void prim_clip_masks( const struct vertex_buffer *VB,
+			     GLuint start, GLuint count,
+			     GLubyte *ormask, GLubyte *andmask )
+{
+   const GLubyte *clipmask = VB->ClipMask;
+   GLubyte o = 0, a = ~0;
+   GLuint i;
+
+   if (VB->Elts) {
+      const GLuint *elts = VB->Elts + start;
+      for (i = 0; i < count; i++) {
+	 o |= clipmask[elts[i]];
+	 a &= clipmask[elts[i]];
+      }
+   }
+   else {
+      clipmask += start;
+      for (i = 0; i < count; i++) {
+	 o |= clipmask[i];
+	 a &= clipmask[i];
+      }
+   }
+
+   *ormask = o;
+   *andmask = a;
+}
+
+
 static GLboolean run_render( struct gl_context *ctx,
 			     struct tnl_pipeline_stage *stage )
 {
@@ -317,8 +352,38 @@ static GLboolean run_render( struct gl_context *ctx,
 			_mesa_lookup_enum_by_nr(prim & PRIM_MODE_MASK), 
 			start, start+length);
 
-	 if (length)
-	    tab[prim & PRIM_MODE_MASK]( ctx, start, start + length, prim );
+	 if (!length)
+	    continue;
+
+	 if (VB->ClipOrMask) {
+	    GLubyte ormask, andmask;
+
+	    prim_clip_masks( VB, start, length, &ormask, &andmask );
+
+	    /* CLIP_USER_BIT doesn't say which plane a vertex is outside
+	     * of, so only the frustum bits allow trivial rejection.
+	     */
+	    if (andmask & CLIP_FRUSTUM_BITS) {
+	       /* The render functions reset the stipple counter at the
+		* start of a primitive, so do that for a skipped one too,
+		* or the next line would continue the previous pattern.
+		*/
+	       if ((prim & PRIM_BEGIN) && ctx->Line.StippleFlag)
+		  tnl->Driver.Render.ResetLineStipple( ctx );
+	       continue;
+	    }
+
+	    if (!ormask) {
+	       tnl_render_func *noclip_tab = (VB->Elts ?
+					      tnl->Driver.Render.PrimTabElts :
+					      tnl->Driver.Render.PrimTabVerts);
+	       noclip_tab[prim & PRIM_MODE_MASK]( ctx, start, start + length,
+						  prim );
+	       continue;
+	    }
+	 }
+
+	 tab[prim & PRIM_MODE_MASK]( ctx, start, start + length, prim );
       }
    } while (tnl->Driver.Render.Multipass &&
 	    tnl->Driver.Render.Multipass( ctx, ++pass ));
@@ -245,6 +245,132 @@ static build_f_func build_f_tab[5] = {
 };
 
 
+/* Vectorized versions of build_m3() and build_f3(), which transpose
+ * tnl->BatchSize eye coordinates and normals at a time into SoA form.
+ */
+
+/* Replace each u with its reflection about n: f = u' - 2 (n.u') n, where
+ * u' is u normalized.
+ */
+static inline void reflect_soa( struct tnl_soa3 *u,
+				const struct tnl_soa3 *n,
+				GLuint count )
+{
+   GLuint i;
+
+   for (i = 0; i < count; i++) {
+      const GLfloat len = u->x[i] * u->x[i] + u->y[i] * u->y[i]
+	 + u->z[i] * u->z[i];
+      const GLfloat inv = len != 0.0F ? INV_SQRTF(len) : 1.0F;
+      const GLfloat ux = u->x[i] * inv;
+      const GLfloat uy = u->y[i] * inv;
+      const GLfloat uz = u->z[i] * inv;
+      const GLfloat two_nu = 2.0F * (n->x[i] * ux + n->y[i] * uy
+				     + n->z[i] * uz);
+      u->x[i] = ux - n->x[i] * two_nu;
+      u->y[i] = uy - n->y[i] * two_nu;
+      u->z[i] = uz - n->z[i] * two_nu;
+   }
+}
+
+
+static void build_m3_soa( GLuint batch,
+			  GLfloat f[][3], GLfloat m[],
+			  const GLvector4f *normal,
+			  const GLvector4f *eye )
+{
+   const GLfloat *coord = eye->start;
+   const GLfloat *norm = normal->start;
+   const GLuint count = eye->count;
+   struct tnl_soa3 u, n;
+   GLuint start, i;
+
+   for (start = 0; start < count; start += batch) {
+      const GLuint nr = MIN2(batch, count - start);
+
+      _tnl_soa3_load( &u, coord, eye->stride, nr );
+      _tnl_soa3_load( &n, norm, normal->stride, nr );
+      STRIDE_F(coord, eye->stride * nr);
+      STRIDE_F(norm, normal->stride * nr);
+
+      reflect_soa( &u, &n, nr );
+
+      for (i = 0; i < nr; i++) {
+	 const GLfloat fz1 = u.z[i] + 1.0F;
+	 const GLfloat mm = u.x[i] * u.x[i] + u.y[i] * u.y[i] + fz1 * fz1;
+	 m[start + i] = mm != 0.0F ? 0.5F * INV_SQRTF(mm) : 0.0F;
+      }
+
+      for (i = 0; i < nr; i++) {
+	 f[start + i][0] = u.x[i];
+	 f[start + i][1] = u.y[i];
+	 f[start + i][2] = u.z[i];
+      }
+   }
+}
+
+
+static void build_f3_soa( GLuint batch,
+			  GLfloat *f, GLuint fstride,
+			  const GLvector4f *normal,
+			  const GLvector4f *eye )
+{
+   const GLfloat *coord = eye->start;
+   const GLfloat *norm = normal->start;
+   const GLuint count = eye->count;
+   struct tnl_soa3 u, n;
+   GLuint start, i;
+
+   for (start = 0; start < count; start += batch) {
+      const GLuint nr = MIN2(batch, count - start);
+
+      _tnl_soa3_load( &u, coord, eye->stride, nr );
+      _tnl_soa3_load( &n, norm, normal->stride, nr );
+      STRIDE_F(coord, eye->stride * nr);
+      STRIDE_F(norm, normal->stride * nr);
+
+      reflect_soa( &u, &n, nr );
+
+      for (i = 0; i < nr; i++) {
+	 f[0] = u.x[i];
+	 f[1] = u.y[i];
+	 f[2] = u.z[i];
+	 STRIDE_F(f, fstride);
+      }
+   }
+}
+
+
+/* Choose between the per-vertex and batched versions.
+ */
+static void build_m( struct gl_context *ctx,
+		     GLfloat f[][3], GLfloat m[],
+		     const GLvector4f *normal,
+		     const GLvector4f *eye )
+{
+   const GLuint batch = TNL_CONTEXT(ctx)->BatchSize;
+
+   if (batch && eye->size >= 3)
+      build_m3_soa( batch, f, m, normal, eye );
+   else
+      build_m_tab[eye->size]( f, m, normal, eye );
+}
+
+
+static void build_f( struct gl_context *ctx,
+		     GLfloat *f, GLuint fstride,
+		     const GLvector4f *normal,
+		     const GLvector4f *eye )
+{
+   const GLuint batch = TNL_CONTEXT(ctx)->BatchSize;
+
+   if (batch && eye->size >= 3)
+      build_f3_soa( batch, f, fstride, normal, eye );
+   else
+      build_f_tab[eye->size]( f, fstride, normal, eye );
+}
+
+
 
 /* Special case texgen functions.
  */
@@ -256,10 +382,8 @@ static void texgen_reflection_map_nv( struct gl_context *ctx,
    GLvector4f *in = VB->AttribPtr[VERT_ATTRIB_TEX0 + unit];
    GLvector4f *out = &store->texcoord[unit];
 
-   build_f_tab[VB->EyePtr->size]( out->start,
-				  out->stride,
-				  VB->AttribPtr[_TNL_ATTRIB_NORMAL],
-				  VB->EyePtr );
+   build_f( ctx, out->start, out->stride,
+	    VB->AttribPtr[_TNL_ATTRIB_NORMAL], VB->EyePtr );
 
    out->flags |= (in->flags & VEC_SIZE_FLAGS) | VEC_SIZE_3;
    out->count = VB->Count;
@@ -311,10 +435,8 @@ static void texgen_sphere_map( struct gl_context *ctx,
    GLfloat (*f)[3] = store->tmp_f;
    GLfloat *m = store->tmp_m;
 
-   (build_m_tab[VB->EyePtr->size])( store->tmp_f,
-				    store->tmp_m,
-				    VB->AttribPtr[_TNL_ATTRIB_NORMAL],
-				    VB->EyePtr );
+   build_m( ctx, store->tmp_f, store->tmp_m,
+	    VB->AttribPtr[_TNL_ATTRIB_NORMAL], VB->EyePtr );
 
    out->size = MAX2(in->size,2);
 
@@ -350,9 +472,9 @@ static void texgen( struct gl_context *ctx,
    GLuint copy;
 
    if (texUnit->_GenFlags & TEXGEN_NEED_M) {
-      build_m_tab[eye->size]( store->tmp_f, store->tmp_m, normal, eye );
+      build_m( ctx, store->tmp_f, store->tmp_m, normal, eye );
    } else if (texUnit->_GenFlags & TEXGEN_NEED_F) {
-      build_f_tab[eye->size]( (GLfloat *)store->tmp_f, 3, normal, eye );
+      build_f( ctx, (GLfloat *)store->tmp_f, 3, normal, eye );
    }
 
 
@@ -69,6 +69,11 @@ _tnl_allow_vertex_fog( struct gl_context *ctx, GLboolean value );
 extern void
 _tnl_allow_pixel_fog( struct gl_context *ctx, GLboolean value );
 
+/* Vertices per batch in the vectorized T&L paths, 0 to disable them
+ */
+extern void
+_tnl_set_batch_size( struct gl_context *ctx, GLuint size );
+
 extern GLboolean
 _tnl_program_string(struct gl_context *ctx, GLenum target, struct gl_program *program);
 
@@ -190,4 +190,52 @@ vbo_get_default_vals_as_float(GLenum format)
    }
 }
 
+
+/**
+ * Does the current geometry program read gl_PrimitiveIDIn?  The primitive
+ * ID counts from the start of each primitive drawn, so primitives can't be
+ * merged then.
+ */
+static inline GLboolean
+vbo_reads_primitive_id(const struct gl_context *ctx)
+{
+   const struct gl_geometry_program *gp = ctx->GeometryProgram._Current;
+
+   return gp && (gp->Base.InputsRead & GEOM_BIT_PRIM_ID) != 0;
+}
+
+
+/**
+ * Can primitive \p p1, which follows \p p0 in the vertex data, be drawn
+ * as part of it?  Only whole begin/end pairs of independent points, lines,
+ * triangles or quads are joined.
+ */
+static inline GLboolean
+vbo_can_merge_prims(const struct _mesa_prim *p0, const struct _mesa_prim *p1)
+{
+   if (!p0->begin || !p0->end || !p1->begin || !p1->end ||
+       p0->mode != p1->mode ||
+       p0->weak != p1->weak ||
+       p0->no_current_update != p1->no_current_update ||
+       p0->indexed || p1->indexed ||
+       p0->basevertex != p1->basevertex ||
+       p0->num_instances != p1->num_instances ||
+       p0->base_instance != p1->base_instance ||
+       p0->start + p0->count != p1->start)
+      return GL_FALSE;
+
+   switch (p0->mode) {
+   case GL_POINTS:
+      return GL_TRUE;
+   case GL_LINES:
+      return p0->count % 2 == 0;
+   case GL_TRIANGLES:
+      return p0->count % 3 == 0;
+   case GL_QUADS:
+      return p0->count % 4 == 0;
+   default:
+      return GL_FALSE;
+   }
+}
+
 #endif
@@ -49,7 +49,14 @@ USE OR OTHER DEALINGS IN THE SOFTWARE.
 /**
  * Size of the VBO to use for glBegin/glVertex/glEnd-style rendering.
  */
-#define VBO_VERT_BUFFER_SIZE (1024*64)	/* bytes */
+#define VBO_VERT_BUFFER_SIZE (1024*256)	/* bytes */
+
+
+/**
+ * Number of glBegin/End pairs in a row with the same vertex size after
+ * which glVertex3f(v) functions specialized for that size are installed.
+ */
+#define VBO_STABLE_PRIMS 4
 
 
 /** Current vertex program mode */
@@ -100,6 +107,10 @@ struct vbo_exec_context
       GLuint max_vert;
       struct vbo_exec_copied_vtx copied;
 
+      /** Vertex size at the last glEnd, and how many times in a row */
+      GLuint end_vertex_size;
+      GLuint stable_prims;
+
       GLubyte attrsz[VBO_ATTRIB_MAX];
       GLenum attrtype[VBO_ATTRIB_MAX];
       GLubyte active_sz[VBO_ATTRIB_MAX];
@@ -441,6 +441,151 @@ do {									\
 #include "vbo_attrib_tmp.h"
 
 
+/**
+ * \name glVertex3f(v) for a fixed vertex size
+ *
+ * Once the vertex format has stayed the same for VBO_STABLE_PRIMS
+ * primitives, these replace the generic glVertex3f(v), so that the copy of
+ * the vertex into the buffer has a size known at compile time.  They fall
+ * back to the generic functions whenever the format changes under them.
+ */
+/*@{*/
+
+/** Smallest and largest vertex sizes with specialized functions */
+#define FAST_VERTEX_MIN_SIZE 3
+#define FAST_VERTEX_MAX_SIZE 12
+
+static inline void
+vbo_exec_fast_vertex(struct gl_context *ctx, struct vbo_exec_context *exec,
+                     GLfloat x, GLfloat y, GLfloat z, const GLuint size)
+{
+   GLfloat *pos = exec->vtx.attrptr[VBO_ATTRIB_POS];
+
+   pos[0] = x;
+   pos[1] = y;
+   pos[2] = z;
+   exec->vtx.attrtype[VBO_ATTRIB_POS] = GL_FLOAT;
+
+   memcpy(exec->vtx.buffer_ptr, exec->vtx.vertex, size * sizeof(GLfloat));
+   exec->vtx.buffer_ptr += size;
+
+   ctx->Driver.NeedFlush |= FLUSH_STORED_VERTICES;
+
+   if (++exec->vtx.vert_count >= exec->vtx.max_vert)
+      vbo_exec_vtx_wrap(exec);
+}
+
+/* Same tests as the ATTR macro, plus the vertex size */
+#define FAST_VERTEX_OK(N)						\
+   (exec->vtx.vertex_size == (N) &&					\
+    exec->vtx.active_sz[VBO_ATTRIB_POS] == 3 &&				\
+    (ctx->Driver.NeedFlush & FLUSH_UPDATE_CURRENT))
+
+#define FAST_VERTEX(N)							\
+static void GLAPIENTRY							\
+vbo_exec_Vertex3f_##N(GLfloat x, GLfloat y, GLfloat z)			\
+{									\
+   GET_CURRENT_CONTEXT(ctx);						\
+   struct vbo_exec_context *exec = &vbo_context(ctx)->exec;		\
+									\
+   if (likely(FAST_VERTEX_OK(N)))					\
+      vbo_exec_fast_vertex(ctx, exec, x, y, z, N);			\
+   else									\
+      vbo_Vertex3f(x, y, z);						\
+}									\
+									\
+static void GLAPIENTRY							\
+vbo_exec_Vertex3fv_##N(const GLfloat *v)				\
+{									\
+   GET_CURRENT_CONTEXT(ctx);						\
+   struct vbo_exec_context *exec = &vbo_context(ctx)->exec;		\
+									\
+   if (likely(FAST_VERTEX_OK(N)))					\
+      vbo_exec_fast_vertex(ctx, exec, v[0], v[1], v[2], N);		\
+   else									\
+      vbo_Vertex3fv(v);							\
+}
+
+FAST_VERTEX(3)
+FAST_VERTEX(4)
+FAST_VERTEX(5)
+FAST_VERTEX(6)
+FAST_VERTEX(7)
+FAST_VERTEX(8)
+FAST_VERTEX(9)
+FAST_VERTEX(10)
+FAST_VERTEX(11)
+FAST_VERTEX(12)
+
+static void (GLAPIENTRYP fast_vertex3f[])(GLfloat, GLfloat, GLfloat) = {
+   vbo_exec_Vertex3f_3,
+   vbo_exec_Vertex3f_4,
+   vbo_exec_Vertex3f_5,
+   vbo_exec_Vertex3f_6,
+   vbo_exec_Vertex3f_7,
+   vbo_exec_Vertex3f_8,
+   vbo_exec_Vertex3f_9,
+   vbo_exec_Vertex3f_10,
+   vbo_exec_Vertex3f_11,
+   vbo_exec_Vertex3f_12
+};
+
+static void (GLAPIENTRYP fast_vertex3fv[])(const GLfloat *) = {
+   vbo_exec_Vertex3fv_3,
+   vbo_exec_Vertex3fv_4,
+   vbo_exec_Vertex3fv_5,
+   vbo_exec_Vertex3fv_6,
+   vbo_exec_Vertex3fv_7,
+   vbo_exec_Vertex3fv_8,
+   vbo_exec_Vertex3fv_9,
+   vbo_exec_Vertex3fv_10,
+   vbo_exec_Vertex3fv_11,
+   vbo_exec_Vertex3fv_12
+};
+
+
+/**
+ * Called by glEnd.  Once the vertex size has been the same for
+ * VBO_STABLE_PRIMS primitives, install the glVertex3f(v) functions for it.
+ */
+static void
+vbo_exec_update_fast_vertex(struct gl_context *ctx,
+                            struct vbo_exec_context *exec)
+{
+   const GLuint size = exec->vtx.active_sz[VBO_ATTRIB_POS] == 3 ?
+      exec->vtx.vertex_size : 0;
+
+   if (size != exec->vtx.end_vertex_size) {
+      exec->vtx.end_vertex_size = size;
+      exec->vtx.stable_prims = 0;
+      return;
+   }
+
+   if (exec->vtx.stable_prims < VBO_STABLE_PRIMS) {
+      exec->vtx.stable_prims++;
+      return;
+   }
+
+   /* The functions may also have been reset by installing a vtxfmt */
+   if (size >= FAST_VERTEX_MIN_SIZE && size <= FAST_VERTEX_MAX_SIZE) {
+      const GLuint i = size - FAST_VERTEX_MIN_SIZE;
+
+      if (GET_Vertex3f(ctx->Exec) != fast_vertex3f[i] &&
+          !_mesa_using_noop_vtxfmt(ctx->Exec)) {
+         SET_Vertex3f(ctx->Exec, fast_vertex3f[i]);
+         SET_Vertex3fv(ctx->Exec, fast_vertex3fv[i]);
+      }
+   }
+   else if (GET_Vertex3f(ctx->Exec) != vbo_Vertex3f &&
+            !_mesa_using_noop_vtxfmt(ctx->Exec)) {
+      SET_Vertex3f(ctx->Exec, vbo_Vertex3f);
+      SET_Vertex3fv(ctx->Exec, vbo_Vertex3fv);
+   }
+}
+
+/*@}*/
+
+
 
 /**
  * Execute a glMaterial call.  Note that if GL_COLOR_MATERIAL is enabled,
@@ -857,10 +1002,21 @@ static void GLAPIENTRY vbo_exec_End( void )
 
          exec->vtx.prim[i].end = 1; 
          exec->vtx.prim[i].count = idx - exec->vtx.prim[i].start;
+
+         /* Draw it along with the previous one if possible */
+         if (i > 0 &&
+             !vbo_reads_primitive_id(ctx) &&
+             vbo_can_merge_prims(&exec->vtx.prim[i - 1],
+                                 &exec->vtx.prim[i])) {
+            exec->vtx.prim[i - 1].count += exec->vtx.prim[i].count;
+            exec->vtx.prim_count--;
+         }
       }
 
       ctx->Driver.CurrentExecPrimitive = PRIM_OUTSIDE_BEGIN_END;
 
+      vbo_exec_update_fast_vertex(ctx, exec);
+
       if (exec->vtx.prim_count == VBO_MAX_PRIM)
 	 vbo_exec_vtx_flush( exec, GL_FALSE );
    }
@@ -82,6 +82,13 @@ struct vbo_save_vertex_list {
    struct _mesa_prim *prim;
    GLuint prim_count;
 
+   /* The primitives with whole begin/end pairs that follow each other
+    * joined, or NULL if there are none to join.  They are drawn instead
+    * of prim[] unless the geometry program reads the primitive ID.
+    */
+   struct _mesa_prim *merged_prim;
+   GLuint merged_prim_count;
+
    struct vbo_save_vertex_store *vertex_store;
    struct vbo_save_primitive_store *prim_store;
 };
@@ -302,6 +302,47 @@ _save_reset_counters(struct gl_context *ctx)
 }
 
 
+/**
+ * Join the primitives of a vertex list that can be drawn as one, into
+ * node->merged_prim.  The primitives as compiled are kept as well: which
+ * ones to draw depends on the geometry program when the list is executed.
+ */
+static void
+_save_merge_prims(struct vbo_save_vertex_list *node)
+{
+   struct _mesa_prim *merged;
+   GLuint i, j;
+
+   free(node->merged_prim);
+   node->merged_prim = NULL;
+   node->merged_prim_count = 0;
+
+   for (i = 1; i < node->prim_count; i++) {
+      if (vbo_can_merge_prims(&node->prim[i - 1], &node->prim[i]))
+         break;
+   }
+
+   if (i >= node->prim_count)
+      return;
+
+   /* If this fails, we just draw the primitives as compiled */
+   merged = malloc(node->prim_count * sizeof(*merged));
+   if (!merged)
+      return;
+
+   merged[0] = node->prim[0];
+   for (i = 1, j = 0; i < node->prim_count; i++) {
+      if (vbo_can_merge_prims(&merged[j], &node->prim[i]))
+         merged[j].count += node->prim[i].count;
+      else
+         merged[++j] = node->prim[i];
+   }
+
+   node->merged_prim = merged;
+   node->merged_prim_count = j + 1;
+}
+
+
 /**
  * Insert the active immediate struct onto the display list currently
  * being built.
@@ -333,9 +374,12 @@ _save_compile_vertex_list(struct gl_context *ctx)
    node->dangling_attr_ref = save->dangling_attr_ref;
    node->prim = save->prim;
    node->prim_count = save->prim_count;
+   node->merged_prim = NULL;
    node->vertex_store = save->vertex_store;
    node->prim_store = save->prim_store;
 
+   _save_merge_prims(node);
+
    node->vertex_store->refcount++;
    node->prim_store->refcount++;
 
@@ -1580,6 +1624,70 @@ vbo_destroy_vertex_list(struct gl_context *ctx, void *data)
 
    free(node->current_data);
    node->current_data = NULL;
+
+   free(node->merged_prim);
+   node->merged_prim = NULL;
+}
+
+
+/**
+ * Append the vertex list \p next_data to \p data when the two follow each
+ * other in a display list.  This works when the vertices and primitives of
+ * the second one come right after those of the first one in the same
+ * stores, which is the case unless the stores filled up in between.
+ */
+static GLboolean
+vbo_merge_vertex_lists(struct gl_context *ctx, void *data, void *next_data)
+{
+   struct vbo_save_vertex_list *node = (struct vbo_save_vertex_list *) data;
+   struct vbo_save_vertex_list *next =
+      (struct vbo_save_vertex_list *) next_data;
+   GLuint i;
+
+   if (next->vertex_store != node->vertex_store ||
+       next->prim_store != node->prim_store ||
+       next->vertex_size != node->vertex_size ||
+       memcmp(next->attrsz, node->attrsz, sizeof(node->attrsz)) != 0 ||
+       memcmp(next->attrtype, node->attrtype, sizeof(node->attrtype)) != 0)
+      return GL_FALSE;
+
+   if (next->buffer_offset != node->buffer_offset +
+       node->count * node->vertex_size * sizeof(GLfloat) ||
+       next->prim != node->prim + node->prim_count)
+      return GL_FALSE;
+
+   /* Both must hold whole begin/end pairs, and update the current
+    * attributes the same way.
+    */
+   if (node->prim_count == 0 || next->prim_count == 0 ||
+       !node->prim[node->prim_count - 1].end || !next->prim[0].begin ||
+       next->wrap_count != 0 ||
+       node->prim[0].no_current_update != next->prim[0].no_current_update)
+      return GL_FALSE;
+
+   for (i = 0; i < next->prim_count; i++)
+      next->prim[i].start += node->count;
+
+   node->count += next->count;
+   node->prim_count += next->prim_count;
+   node->dangling_attr_ref |= next->dangling_attr_ref;
+
+   /* Join the primitives across the two lists too */
+   free(next->merged_prim);
+   _save_merge_prims(node);
+
+   /* The last vertex of the second list becomes the current one */
+   free(node->current_data);
+   node->current_data = next->current_data;
+   node->current_size = next->current_size;
+
+   node->vertex_store->refcount--;
+   node->prim_store->refcount--;
+   assert(node->vertex_store->refcount != 0);
+   assert(node->prim_store->refcount != 0);
+
+   (void) ctx;
+   return GL_TRUE;
 }
 
 
@@ -1646,7 +1754,8 @@ vbo_save_api_init(struct vbo_save_context *save)
                                sizeof(struct vbo_save_vertex_list),
                                vbo_save_playback_vertex_list,
                                vbo_destroy_vertex_list,
-                               vbo_print_vertex_list);
+                               vbo_print_vertex_list,
+                               vbo_merge_vertex_lists);
 
    ctx->Driver.NotifySaveBegin = vbo_save_NotifyBegin;
 
@@ -312,9 +312,17 @@ vbo_save_playback_vertex_list(struct gl_context *ctx, void *data)
 	 _mesa_update_state( ctx );
 
       if (node->count > 0) {
+         const struct _mesa_prim *prim = node->prim;
+         GLuint prim_count = node->prim_count;
+
+         if (node->merged_prim && !vbo_reads_primitive_id(ctx)) {
+            prim = node->merged_prim;
+            prim_count = node->merged_prim_count;
+         }
+
          vbo_context(ctx)->draw_prims(ctx, 
-                                      node->prim,
-                                      node->prim_count,
+                                      prim,
+                                      prim_count,
                                       NULL,
                                       GL_TRUE,
                                       0,    /* Node is a VBO, so this is ok */
@@ -0,0 +1,250 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2012  The Mesa Authors   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+ * AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * AVX2/FMA transform functions for x86-64.
+ *
+ * Like sse41.c these use intrinsics with the "target" function attribute.
+ * Two vertices are processed per 256-bit register.  They're only
+ * installed when CPUID reports AVX2 and FMA and the OS saves the YMM
+ * registers, see _mesa_get_x86_64_features().
+ */
+
+#include "main/glheader.h"
+#include "main/macros.h"
+#include "math/m_xform.h"
+#include "x86-64.h"
+
+#ifdef DEBUG_MATH
+#include "math/m_debug.h"
+#endif
+
+#if defined(USE_X86_64_ASM) && \
+    (defined(__clang__) || \
+     (defined(__GNUC__) && \
+      (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define USE_AVX2_XFORM
+#endif
+
+
+#ifdef USE_AVX2_XFORM
+
+#include <immintrin.h>
+
+#define AVX2_FUNC __attribute__((target("avx2,fma")))
+
+
+/** Broadcast a to the low four lanes and b to the high four lanes */
+static inline AVX2_FUNC __m256
+broadcast2( GLfloat a, GLfloat b )
+{
+   return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(a)),
+			       _mm_set1_ps(b), 1);
+}
+
+
+/** Load a 4x4 matrix column into both halves of a register */
+static inline AVX2_FUNC __m256
+load_column2( const GLfloat *col )
+{
+   return _mm256_broadcast_ps((const __m128 *) col);
+}
+
+
+/**
+ * Transform count points of the given size (2, 3 or 4) by a general 4x4
+ * matrix, two points per iteration.  The destination is always a packed
+ * GLfloat[4] array so the pair is written with one 256-bit store.
+ */
+static inline AVX2_FUNC void
+transform_points_general( GLvector4f *to_vec,
+			  const GLfloat m[16],
+			  const GLvector4f *from_vec,
+			  const GLuint size )
+{
+   const GLuint stride = from_vec->stride;
+   GLfloat *from = from_vec->start;
+   GLfloat (*to)[4] = (GLfloat (*)[4])to_vec->start;
+   const GLuint count = from_vec->count;
+   const __m256 c0 = load_column2(m);
+   const __m256 c1 = load_column2(m + 4);
+   const __m256 c2 = load_column2(m + 8);
+   const __m256 c3 = load_column2(m + 12);
+   GLuint i;
+
+   for (i = 0; i + 1 < count; i += 2) {
+      const GLfloat *f0 = from;
+      const GLfloat *f1 = (const GLfloat *) ((const GLubyte *) from + stride);
+      __m256 r;
+
+      if (size == 4)
+	 r = _mm256_mul_ps(c3, broadcast2(f0[3], f1[3]));
+      else
+	 r = c3;
+      r = _mm256_fmadd_ps(c0, broadcast2(f0[0], f1[0]), r);
+      r = _mm256_fmadd_ps(c1, broadcast2(f0[1], f1[1]), r);
+      if (size >= 3)
+	 r = _mm256_fmadd_ps(c2, broadcast2(f0[2], f1[2]), r);
+      _mm256_storeu_ps(to[i], r);
+
+      STRIDE_F(from, 2 * stride);
+   }
+
+   if (i < count) {
+      __m128 r;
+      if (size == 4)
+	 r = _mm_mul_ps(_mm256_castps256_ps128(c3), _mm_set1_ps(from[3]));
+      else
+	 r = _mm256_castps256_ps128(c3);
+      r = _mm_fmadd_ps(_mm256_castps256_ps128(c0), _mm_set1_ps(from[0]), r);
+      r = _mm_fmadd_ps(_mm256_castps256_ps128(c1), _mm_set1_ps(from[1]), r);
+      if (size >= 3)
+	 r = _mm_fmadd_ps(_mm256_castps256_ps128(c2), _mm_set1_ps(from[2]), r);
+      _mm_storeu_ps(to[i], r);
+   }
+
+   _mm256_zeroupper();
+
+   to_vec->size = 4;
+   to_vec->flags |= VEC_SIZE_4;
+   to_vec->count = from_vec->count;
+}
+
+
+static AVX2_FUNC void
+avx2_transform_points2_general( GLvector4f *to_vec,
+				const GLfloat m[16],
+				const GLvector4f *from_vec )
+{
+   transform_points_general(to_vec, m, from_vec, 2);
+}
+
+static AVX2_FUNC void
+avx2_transform_points3_general( GLvector4f *to_vec,
+				const GLfloat m[16],
+				const GLvector4f *from_vec )
+{
+   transform_points_general(to_vec, m, from_vec, 3);
+}
+
+static AVX2_FUNC void
+avx2_transform_points4_general( GLvector4f *to_vec,
+				const GLfloat m[16],
+				const GLvector4f *from_vec )
+{
+   transform_points_general(to_vec, m, from_vec, 4);
+}
+
+
+/**
+ * AVX2 version of transform_normalize_normals() in m_norm_tmp.h, two
+ * normals per iteration.
+ */
+static AVX2_FUNC void
+avx2_transform_normalize_normals( const GLmatrix *mat,
+				  GLfloat scale,
+				  const GLvector4f *in,
+				  const GLfloat *lengths,
+				  GLvector4f *dest )
+{
+   GLfloat (*out)[4] = (GLfloat (*)[4])dest->start;
+   GLfloat *from = in->start;
+   const GLuint stride = in->stride;
+   const GLuint count = in->count;
+   const GLfloat *m = mat->inv;
+   __m256 c0 = _mm256_setr_ps(m[0], m[4], m[8], 0.0F,
+			      m[0], m[4], m[8], 0.0F);
+   __m256 c1 = _mm256_setr_ps(m[1], m[5], m[9], 0.0F,
+			      m[1], m[5], m[9], 0.0F);
+   __m256 c2 = _mm256_setr_ps(m[2], m[6], m[10], 0.0F,
+			      m[2], m[6], m[10], 0.0F);
+   const __m256 one = _mm256_set1_ps(1.0F);
+   const __m256 tiny = _mm256_set1_ps(1e-20F);
+   GLuint i;
+
+   if (lengths && scale != 1.0F) {
+      const __m256 s = _mm256_set1_ps(scale);
+      c0 = _mm256_mul_ps(c0, s);
+      c1 = _mm256_mul_ps(c1, s);
+      c2 = _mm256_mul_ps(c2, s);
+   }
+
+   for (i = 0; i < count; i += 2) {
+      /* With an odd count the last pair repeats the last normal, and
+       * only the low half is stored.
+       */
+      const GLfloat *f0 = from;
+      const GLfloat *f1 = i + 1 < count ?
+	 (const GLfloat *) ((const GLubyte *) from + stride) : from;
+      __m256 t;
+
+      t = _mm256_mul_ps(c0, broadcast2(f0[0], f1[0]));
+      t = _mm256_fmadd_ps(c1, broadcast2(f0[1], f1[1]), t);
+      t = _mm256_fmadd_ps(c2, broadcast2(f0[2], f1[2]), t);
+
+      if (!lengths) {
+	 const __m256 len = _mm256_dp_ps(t, t, 0x77);
+	 t = _mm256_mul_ps(t, _mm256_div_ps(one, _mm256_sqrt_ps(len)));
+	 /* zero vectors which are too short to normalize */
+	 t = _mm256_and_ps(t, _mm256_cmp_ps(len, tiny, _CMP_GT_OQ));
+      }
+      else {
+	 t = _mm256_mul_ps(t, broadcast2(lengths[i],
+					 lengths[i + 1 < count ? i + 1 : i]));
+      }
+
+      if (i + 1 < count)
+	 _mm256_storeu_ps(out[i], t);
+      else
+	 _mm_storeu_ps(out[i], _mm256_castps256_ps128(t));
+
+      STRIDE_F(from, 2 * stride);
+   }
+
+   _mm256_zeroupper();
+
+   dest->count = in->count;
+}
+
+#endif /* USE_AVX2_XFORM */
+
+
+void _mesa_init_avx2_transform_asm( void )
+{
+#ifdef USE_AVX2_XFORM
+   _mesa_transform_tab[2][MATRIX_GENERAL] = avx2_transform_points2_general;
+   _mesa_transform_tab[3][MATRIX_GENERAL] = avx2_transform_points3_general;
+   _mesa_transform_tab[4][MATRIX_GENERAL] = avx2_transform_points4_general;
+   _mesa_transform_tab[4][MATRIX_3D] = avx2_transform_points4_general;
+   _mesa_transform_tab[4][MATRIX_PERSPECTIVE] =
+      avx2_transform_points4_general;
+
+   _mesa_normal_tab[NORM_TRANSFORM | NORM_NORMALIZE] =
+      avx2_transform_normalize_normals;
+
+#ifdef DEBUG_MATH
+   _math_test_all_transform_functions( "AVX2" );
+   _math_test_all_normal_transform_functions( "AVX2" );
+#endif
+#endif
+}
@@ -0,0 +1,282 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2012  The Mesa Authors   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+ * AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * AVX2 2x2 box filters for mipmap generation on x86-64.
+ *
+ * These are the 256-bit versions of the SSE2 kernels in main/mipmap.c,
+ * with the same results as the scalar code.  Each 128-bit lane does what
+ * an SSE2 kernel does for a contiguous part of the row, and the lanes are
+ * put back in order when the results are packed.  They're only called
+ * when CPUID reports AVX2 and the OS saves the YMM registers, see
+ * _mesa_get_x86_64_features().
+ */
+
+#include "main/glheader.h"
+#include "x86-64.h"
+
+#if defined(USE_X86_64_ASM) && \
+    (defined(__clang__) || \
+     (defined(__GNUC__) && \
+      (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define USE_AVX2_MIPMAP
+#endif
+
+
+#ifdef USE_AVX2_MIPMAP
+
+#include <immintrin.h>
+
+/* No FMA: the float filter must round like the scalar code. */
+#define AVX2_FUNC __attribute__((target("avx2")))
+
+
+/**
+ * Add up the horizontally adjacent pixels of 1, 2 or 4 components in each
+ * lane, where x and y hold the first and second halves of 16 consecutive
+ * 16-bit elements.  Each lane gets its sums in order.
+ */
+static inline AVX2_FUNC __m256i
+pair_sums_epi16( __m256i x, __m256i y, GLuint comps )
+{
+   switch (comps) {
+   case 4:
+      return _mm256_add_epi16(_mm256_unpacklo_epi64(x, y),
+			      _mm256_unpackhi_epi64(x, y));
+   case 2:
+      {
+	 const __m256 fx = _mm256_castsi256_ps(x), fy = _mm256_castsi256_ps(y);
+	 return _mm256_add_epi16(
+	    _mm256_castps_si256(
+	       _mm256_shuffle_ps(fx, fy, _MM_SHUFFLE(2, 0, 2, 0))),
+	    _mm256_castps_si256(
+	       _mm256_shuffle_ps(fx, fy, _MM_SHUFFLE(3, 1, 3, 1))));
+      }
+   default:
+      {
+	 const __m256i lo = _mm256_set1_epi32(0xffff);
+	 const __m256i sx = _mm256_add_epi32(_mm256_and_si256(x, lo),
+					     _mm256_srli_epi32(x, 16));
+	 const __m256i sy = _mm256_add_epi32(_mm256_and_si256(y, lo),
+					     _mm256_srli_epi32(y, 16));
+	 return _mm256_packus_epi32(sx, sy);
+      }
+   }
+}
+
+
+/** Like pair_sums_epi16(), for 8 elements of 32 bits per lane */
+static inline AVX2_FUNC __m256i
+pair_sums_epi32( __m256i x, __m256i y, GLuint comps )
+{
+   const __m256 fx = _mm256_castsi256_ps(x), fy = _mm256_castsi256_ps(y);
+
+   switch (comps) {
+   case 4:
+      return _mm256_add_epi32(x, y);
+   case 2:
+      return _mm256_add_epi32(_mm256_unpacklo_epi64(x, y),
+			      _mm256_unpackhi_epi64(x, y));
+   default:
+      return _mm256_add_epi32(
+	 _mm256_castps_si256(_mm256_shuffle_ps(fx, fy, _MM_SHUFFLE(2, 0, 2, 0))),
+	 _mm256_castps_si256(_mm256_shuffle_ps(fx, fy, _MM_SHUFFLE(3, 1, 3, 1))));
+   }
+}
+
+
+static AVX2_FUNC GLint
+avx2_do_row_ubyte( GLuint comps, const GLubyte *rowA, const GLubyte *rowB,
+		   GLint dstWidth, GLubyte *dst )
+{
+   const __m256i zero = _mm256_setzero_si256();
+   const GLint n = dstWidth * comps;
+   GLint i;
+
+   for (i = 0; i + 32 <= n; i += 32) {
+      __m256i sums[2];
+      GLuint h;
+
+      for (h = 0; h < 2; h++) {
+	 const __m256i a =
+	    _mm256_loadu_si256((const __m256i *) (rowA + 2 * i) + h);
+	 const __m256i b =
+	    _mm256_loadu_si256((const __m256i *) (rowB + 2 * i) + h);
+	 const __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(a, zero),
+					     _mm256_unpacklo_epi8(b, zero));
+	 const __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(a, zero),
+					     _mm256_unpackhi_epi8(b, zero));
+	 sums[h] = _mm256_srli_epi16(pair_sums_epi16(lo, hi, comps), 2);
+      }
+
+      _mm256_storeu_si256((__m256i *) (dst + i),
+			  _mm256_permute4x64_epi64(
+			     _mm256_packus_epi16(sums[0], sums[1]),
+			     _MM_SHUFFLE(3, 1, 2, 0)));
+   }
+
+   _mm256_zeroupper();
+
+   return i / comps;
+}
+
+
+static AVX2_FUNC GLint
+avx2_do_row_ushort( GLuint comps, const GLushort *rowA, const GLushort *rowB,
+		    GLint dstWidth, GLushort *dst )
+{
+   const __m256i zero = _mm256_setzero_si256();
+   const GLint n = dstWidth * comps;
+   GLint i;
+
+   for (i = 0; i + 16 <= n; i += 16) {
+      __m256i sums[2];
+      GLuint h;
+
+      for (h = 0; h < 2; h++) {
+	 const __m256i a =
+	    _mm256_loadu_si256((const __m256i *) (rowA + 2 * i) + h);
+	 const __m256i b =
+	    _mm256_loadu_si256((const __m256i *) (rowB + 2 * i) + h);
+	 const __m256i lo = _mm256_add_epi32(_mm256_unpacklo_epi16(a, zero),
+					     _mm256_unpacklo_epi16(b, zero));
+	 const __m256i hi = _mm256_add_epi32(_mm256_unpackhi_epi16(a, zero),
+					     _mm256_unpackhi_epi16(b, zero));
+	 sums[h] = _mm256_srli_epi32(pair_sums_epi32(lo, hi, comps), 2);
+      }
+
+      _mm256_storeu_si256((__m256i *) (dst + i),
+			  _mm256_permute4x64_epi64(
+			     _mm256_packus_epi32(sums[0], sums[1]),
+			     _MM_SHUFFLE(3, 1, 2, 0)));
+   }
+
+   _mm256_zeroupper();
+
+   return i / comps;
+}
+
+
+/**
+ * Split 16 consecutive floats into the left and right pixels of pairs.
+ * Lane 0 gets the pairs of the first 8 floats, lane 1 those of the rest.
+ */
+static inline AVX2_FUNC void
+split_pairs_ps( const GLfloat *src, GLuint comps, __m256 *j, __m256 *k )
+{
+   const __m256 a = _mm256_loadu_ps(src);
+   const __m256 b = _mm256_loadu_ps(src + 8);
+   const __m256 x = _mm256_permute2f128_ps(a, b, 0x20);
+   const __m256 y = _mm256_permute2f128_ps(a, b, 0x31);
+
+   switch (comps) {
+   case 4:
+      *j = x;
+      *k = y;
+      break;
+   case 2:
+      *j = _mm256_castpd_ps(_mm256_unpacklo_pd(_mm256_castps_pd(x),
+					       _mm256_castps_pd(y)));
+      *k = _mm256_castpd_ps(_mm256_unpackhi_pd(_mm256_castps_pd(x),
+					       _mm256_castps_pd(y)));
+      break;
+   default:
+      *j = _mm256_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0));
+      *k = _mm256_shuffle_ps(x, y, _MM_SHUFFLE(3, 1, 3, 1));
+      break;
+   }
+}
+
+
+static AVX2_FUNC GLint
+avx2_do_row_float( GLuint comps, const GLfloat *rowA, const GLfloat *rowB,
+		   GLint dstWidth, GLfloat *dst )
+{
+   const __m256 quarter = _mm256_set1_ps(0.25F);
+   const GLint n = dstWidth * comps;
+   GLint i;
+
+   for (i = 0; i + 8 <= n; i += 8) {
+      __m256 aj, ak, bj, bk;
+
+      split_pairs_ps(rowA + 2 * i, comps, &aj, &ak);
+      split_pairs_ps(rowB + 2 * i, comps, &bj, &bk);
+
+      /* same order of operations as the scalar code */
+      _mm256_storeu_ps(dst + i,
+		       _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(
+						      _mm256_add_ps(aj, ak),
+						      bj), bk),
+				     quarter));
+   }
+
+   _mm256_zeroupper();
+
+   return i / comps;
+}
+
+
+/**
+ * 2:1 box filter of a row of 1, 2 or 4 component GLubyte, GLushort or
+ * GLfloat pixels, like do_row() in main/mipmap.c.
+ *
+ * \return the number of dest pixels written, which may be less than
+ *         \p dstWidth; the caller does the rest.
+ */
+GLint
+_mesa_x86_64_avx2_do_row( GLenum datatype, GLuint comps,
+			  const GLvoid *srcRowA, const GLvoid *srcRowB,
+			  GLint dstWidth, GLvoid *dstRow )
+{
+   if (comps == 3)
+      return 0;
+
+   switch (datatype) {
+   case GL_UNSIGNED_BYTE:
+      return avx2_do_row_ubyte(comps, srcRowA, srcRowB, dstWidth, dstRow);
+   case GL_UNSIGNED_SHORT:
+      return avx2_do_row_ushort(comps, srcRowA, srcRowB, dstWidth, dstRow);
+   case GL_FLOAT:
+      return avx2_do_row_float(comps, srcRowA, srcRowB, dstWidth, dstRow);
+   default:
+      return 0;
+   }
+}
+
+#else
+
+GLint
+_mesa_x86_64_avx2_do_row( GLenum datatype, GLuint comps,
+			  const GLvoid *srcRowA, const GLvoid *srcRowB,
+			  GLint dstWidth, GLvoid *dstRow )
+{
+   (void) datatype;
+   (void) comps;
+   (void) srcRowA;
+   (void) srcRowB;
+   (void) dstWidth;
+   (void) dstRow;
+   return 0;
+}
+
+#endif /* USE_AVX2_MIPMAP */
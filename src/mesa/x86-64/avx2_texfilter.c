@@ -0,0 +1,321 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2012  The Mesa Authors   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+ * AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * AVX2 bilinear/trilinear texture filters for swrast on x86-64.
+ *
+ * These do the GL_REPEAT, power of two, borderless paths of
+ * swrast/s_texfilter.c for eight fragments of a span at a time.  Unlike
+ * the SSE2 code there, which filters the four channels of one fragment
+ * together, each register holds one channel of eight fragments, and the
+ * texels are gathered straight out of the mapped image.  The texel
+ * locations, the conversion to float and the lerps are done in the same
+ * order as the C code, so the results are the same.  They're only called
+ * when CPUID reports AVX2 and the OS saves the YMM registers, see
+ * _mesa_get_x86_64_features().
+ */
+
+#include "main/glheader.h"
+#include "swrast/s_context.h"
+#include "x86-64.h"
+
+#if defined(USE_X86_64_ASM) && \
+    (defined(__clang__) || \
+     (defined(__GNUC__) && \
+      (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define USE_AVX2_TEXFILTER
+#endif
+
+
+#ifdef USE_AVX2_TEXFILTER
+
+#include <immintrin.h>
+
+/* No FMA: the lerps must round like the scalar code. */
+#define AVX2_FUNC __attribute__((target("avx2")))
+
+
+/**
+ * IFLOOR() of main/imports.h for eight floats, with the same IEEE
+ * rounding trick, so that the results agree for any input.
+ */
+static inline AVX2_FUNC __m256i
+ifloor_epi32( __m256 f )
+{
+   const __m256d bias = _mm256_set1_pd((3 << 22) + 0.5);
+   const __m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(f));
+   const __m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(f, 1));
+   const __m256 a = _mm256_insertf128_ps(
+      _mm256_castps128_ps256(_mm256_cvtpd_ps(_mm256_add_pd(bias, lo))),
+      _mm256_cvtpd_ps(_mm256_add_pd(bias, hi)), 1);
+   const __m256 b = _mm256_insertf128_ps(
+      _mm256_castps128_ps256(_mm256_cvtpd_ps(_mm256_sub_pd(bias, lo))),
+      _mm256_cvtpd_ps(_mm256_sub_pd(bias, hi)), 1);
+
+   return _mm256_srai_epi32(_mm256_sub_epi32(_mm256_castps_si256(a),
+					     _mm256_castps_si256(b)), 1);
+}
+
+
+/** FRAC() of main/macros.h */
+static inline AVX2_FUNC __m256
+frac_ps( __m256 f )
+{
+   return _mm256_sub_ps(f, _mm256_cvtepi32_ps(ifloor_epi32(f)));
+}
+
+
+/** a + t * (b - a) */
+static inline AVX2_FUNC __m256
+lerp_ps( __m256 t, __m256 a, __m256 b )
+{
+   return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+}
+
+
+/** linear_repeat_texel_location() of swrast/s_texfilter.c */
+static inline AVX2_FUNC void
+repeat_texel_location( GLuint size, __m256 s,
+		       __m256i *i0, __m256i *i1, __m256 *weight )
+{
+   const __m256 u = _mm256_sub_ps(_mm256_mul_ps(s, _mm256_set1_ps(size)),
+				  _mm256_set1_ps(0.5F));
+   const __m256i fl = ifloor_epi32(u);
+   const __m256i mask = _mm256_set1_epi32(size - 1);
+
+   *i0 = _mm256_and_si256(fl, mask);
+   *i1 = _mm256_and_si256(_mm256_add_epi32(*i0, _mm256_set1_epi32(1)), mask);
+   *weight = _mm256_sub_ps(u, _mm256_cvtepi32_ps(fl));
+}
+
+
+/**
+ * One 8-bit channel of eight texels, as UBYTE_TO_FLOAT() gives it.
+ * \param shift  where the channel is in the 32-bit texel
+ */
+static inline AVX2_FUNC __m256
+unpack_channel( __m256i texels, GLuint shift )
+{
+   const __m256i c = _mm256_and_si256(
+      _mm256_srl_epi32(texels, _mm_cvtsi32_si128(shift)),
+      _mm256_set1_epi32(0xff));
+
+   return _mm256_div_ps(_mm256_cvtepi32_ps(c), _mm256_set1_ps(255.0F));
+}
+
+
+/**
+ * sample_2d_linear_repeat() for eight fragments.
+ * \param shifts  where R, G, B and A are in a texel of an 8-bit format
+ */
+static inline AVX2_FUNC void
+sample_2d_linear_repeat( const struct gl_texture_image *img,
+			 const GLuint shifts[4], __m256 s, __m256 t,
+			 __m256 rgba[4] )
+{
+   const struct swrast_texture_image *swImg =
+      (const struct swrast_texture_image *) img;
+   const __m256i stride = _mm256_set1_epi32(swImg->RowStride);
+   __m256i i0, i1, j0, j1, row0, row1, k00, k10, k01, k11;
+   __m256 wi, wj;
+   GLuint c;
+
+   repeat_texel_location(img->Width2, s, &i0, &i1, &wi);
+   repeat_texel_location(img->Height2, t, &j0, &j1, &wj);
+
+   row0 = _mm256_mullo_epi32(j0, stride);
+   row1 = _mm256_mullo_epi32(j1, stride);
+   k00 = _mm256_add_epi32(row0, i0);
+   k10 = _mm256_add_epi32(row0, i1);
+   k01 = _mm256_add_epi32(row1, i0);
+   k11 = _mm256_add_epi32(row1, i1);
+
+   if (img->TexFormat == MESA_FORMAT_RGBA_FLOAT32) {
+      const GLfloat *map = (const GLfloat *) swImg->Map;
+
+      k00 = _mm256_slli_epi32(k00, 2);
+      k10 = _mm256_slli_epi32(k10, 2);
+      k01 = _mm256_slli_epi32(k01, 2);
+      k11 = _mm256_slli_epi32(k11, 2);
+
+      for (c = 0; c < 4; c++) {
+	 const __m256 t00 = _mm256_i32gather_ps(map + c, k00, 4);
+	 const __m256 t10 = _mm256_i32gather_ps(map + c, k10, 4);
+	 const __m256 t01 = _mm256_i32gather_ps(map + c, k01, 4);
+	 const __m256 t11 = _mm256_i32gather_ps(map + c, k11, 4);
+
+	 rgba[c] = lerp_ps(wj, lerp_ps(wi, t00, t10), lerp_ps(wi, t01, t11));
+      }
+   }
+   else {
+      const int *map = (const int *) swImg->Map;
+      const __m256i t00 = _mm256_i32gather_epi32(map, k00, 4);
+      const __m256i t10 = _mm256_i32gather_epi32(map, k10, 4);
+      const __m256i t01 = _mm256_i32gather_epi32(map, k01, 4);
+      const __m256i t11 = _mm256_i32gather_epi32(map, k11, 4);
+
+      for (c = 0; c < 4; c++) {
+	 rgba[c] = lerp_ps(wj,
+			   lerp_ps(wi, unpack_channel(t00, shifts[c]),
+				   unpack_channel(t10, shifts[c])),
+			   lerp_ps(wi, unpack_channel(t01, shifts[c]),
+				   unpack_channel(t11, shifts[c])));
+      }
+   }
+}
+
+
+/** Store one channel per register as RGBA for eight fragments */
+static inline AVX2_FUNC void
+store_rgba( const __m256 c[4], GLfloat rgba[][4] )
+{
+   const __m256 rg0 = _mm256_unpacklo_ps(c[0], c[1]);
+   const __m256 rg1 = _mm256_unpackhi_ps(c[0], c[1]);
+   const __m256 ba0 = _mm256_unpacklo_ps(c[2], c[3]);
+   const __m256 ba1 = _mm256_unpackhi_ps(c[2], c[3]);
+   /* fragments 0 and 4, 1 and 5, 2 and 6, 3 and 7 */
+   const __m256 p0 = _mm256_shuffle_ps(rg0, ba0, _MM_SHUFFLE(1, 0, 1, 0));
+   const __m256 p1 = _mm256_shuffle_ps(rg0, ba0, _MM_SHUFFLE(3, 2, 3, 2));
+   const __m256 p2 = _mm256_shuffle_ps(rg1, ba1, _MM_SHUFFLE(1, 0, 1, 0));
+   const __m256 p3 = _mm256_shuffle_ps(rg1, ba1, _MM_SHUFFLE(3, 2, 3, 2));
+
+   _mm256_storeu_ps(rgba[0], _mm256_permute2f128_ps(p0, p1, 0x20));
+   _mm256_storeu_ps(rgba[2], _mm256_permute2f128_ps(p2, p3, 0x20));
+   _mm256_storeu_ps(rgba[4], _mm256_permute2f128_ps(p0, p1, 0x31));
+   _mm256_storeu_ps(rgba[6], _mm256_permute2f128_ps(p2, p3, 0x31));
+}
+
+
+static AVX2_FUNC GLuint
+avx2_sample_2d_linear_repeat( const struct gl_texture_image *img0,
+			      const struct gl_texture_image *img1,
+			      const GLuint shifts[4], GLuint n,
+			      const GLfloat texcoords[][4],
+			      const GLfloat lambda[], GLfloat rgba[][4] )
+{
+   const __m256i coord = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+   GLuint i, c;
+
+   for (i = 0; i + 8 <= n; i += 8) {
+      const __m256 s = _mm256_i32gather_ps(&texcoords[i][0], coord, 4);
+      const __m256 t = _mm256_i32gather_ps(&texcoords[i][1], coord, 4);
+      __m256 t0[4];
+
+      sample_2d_linear_repeat(img0, shifts, s, t, t0);
+
+      if (img1) {
+	 const __m256 f = frac_ps(_mm256_loadu_ps(lambda + i));
+	 __m256 t1[4];
+
+	 sample_2d_linear_repeat(img1, shifts, s, t, t1);
+	 for (c = 0; c < 4; c++)
+	    t0[c] = lerp_ps(f, t0[c], t1[c]);
+      }
+
+      store_rgba(t0, rgba + i);
+   }
+
+   _mm256_zeroupper();
+
+   return i;
+}
+
+
+/** Does every texel index of the image fit the gathers' 32-bit offsets? */
+static GLboolean
+gather_addressable( const struct gl_texture_image *img )
+{
+   const struct swrast_texture_image *swImg =
+      (const struct swrast_texture_image *) img;
+
+   return (uint64_t) swImg->RowStride * img->Height2 * 4 <= 0x7fffffff;
+}
+
+
+/**
+ * Bilinear GL_REPEAT filter of power of two, borderless 2D images, like
+ * sample_2d_linear_repeat() in swrast/s_texfilter.c.  With \p img1, the
+ * texels of \p img0 and \p img1 are blended by the fractions of
+ * \p lambda, as sample_2d_linear_mipmap_linear_repeat() does for two
+ * adjacent levels.  Both images must have the same format, one of
+ * MESA_FORMAT_RGBA8888, MESA_FORMAT_RGBA8888_REV, MESA_FORMAT_ARGB8888 or
+ * MESA_FORMAT_RGBA_FLOAT32.
+ *
+ * \return the number of fragments filtered, a multiple of 8 which may be
+ *         less than \p n; the caller does the rest.
+ */
+GLuint
+_mesa_x86_64_avx2_sample_2d_linear_repeat( const struct gl_texture_image *img0,
+					   const struct gl_texture_image *img1,
+					   GLuint n, const GLfloat texcoords[][4],
+					   const GLfloat lambda[],
+					   GLfloat rgba[][4] )
+{
+   static const GLuint rgba8888[4] = { 24, 16, 8, 0 };
+   static const GLuint rgba8888_rev[4] = { 0, 8, 16, 24 };
+   static const GLuint argb8888[4] = { 16, 8, 0, 24 };
+   const GLuint *shifts;
+
+   if (!gather_addressable(img0) || (img1 && !gather_addressable(img1)))
+      return 0;
+
+   switch (img0->TexFormat) {
+   case MESA_FORMAT_RGBA8888:
+      shifts = rgba8888;
+      break;
+   case MESA_FORMAT_RGBA8888_REV:
+      shifts = rgba8888_rev;
+      break;
+   case MESA_FORMAT_ARGB8888:
+      shifts = argb8888;
+      break;
+   case MESA_FORMAT_RGBA_FLOAT32:
+      shifts = NULL;
+      break;
+   default:
+      return 0;
+   }
+
+   return avx2_sample_2d_linear_repeat(img0, img1, shifts, n, texcoords,
+				       lambda, rgba);
+}
+
+#else
+
+GLuint
+_mesa_x86_64_avx2_sample_2d_linear_repeat( const struct gl_texture_image *img0,
+					   const struct gl_texture_image *img1,
+					   GLuint n, const GLfloat texcoords[][4],
+					   const GLfloat lambda[],
+					   GLfloat rgba[][4] )
+{
+   (void) img0;
+   (void) img1;
+   (void) n;
+   (void) texcoords;
+   (void) lambda;
+   (void) rgba;
+   return 0;
+}
+
+#endif /* USE_AVX2_TEXFILTER */
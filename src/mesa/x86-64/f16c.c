@@ -0,0 +1,113 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2012  The Mesa Authors   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+ * AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * F16C float to half float conversion for x86-64.
+ *
+ * Like sse41.c this uses intrinsics with the "target" function attribute.
+ * It's only called when CPUID reports F16C and the OS saves the YMM
+ * registers, see _mesa_get_x86_64_features().
+ */
+
+#include "main/glheader.h"
+#include "x86-64.h"
+
+#if defined(USE_X86_64_ASM) && \
+    (defined(__clang__) || \
+     (defined(__GNUC__) && \
+      (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define USE_F16C_HALF
+#endif
+
+
+#ifdef USE_F16C_HALF
+
+#include <immintrin.h>
+
+#define F16C_FUNC __attribute__((target("f16c")))
+
+
+/**
+ * Convert \p n floats to half floats with the same results as
+ * _mesa_float_to_half(): the mantissa is truncated, too large values
+ * become infinity rather than the largest half, and NaNs become 0x7c01
+ * with the sign kept.
+ *
+ * \return the number of floats converted, which may be less than \p n;
+ *         the caller converts the rest.
+ */
+F16C_FUNC GLuint
+_mesa_x86_64_f16c_float_to_half( GLhalfARB *dst, const GLfloat *src,
+				 GLuint n )
+{
+   const __m128i absMask = _mm_set1_epi32(0x7fffffff);
+   const __m128i maxFinite = _mm_set1_epi32(0x477fffff);
+   const __m128i infinity = _mm_set1_epi32(0x7f800000);
+   const __m128i halfInf = _mm_set1_epi32(0x7c00);
+   const __m128i one = _mm_set1_epi32(1);
+   GLuint i;
+
+   for (i = 0; i + 8 <= n; i += 8) {
+      __m128i h[2];
+      GLuint k;
+
+      for (k = 0; k < 2; k++) {
+	 const __m128 f = _mm_loadu_ps(src + i + 4 * k);
+	 const __m128i bits = _mm_castps_si128(f);
+	 const __m128i a = _mm_and_si128(bits, absMask);
+	 const __m128i sign =
+	    _mm_srli_epi32(_mm_andnot_si128(absMask, bits), 16);
+	 const __m128i isInf = _mm_cmpgt_epi32(a, maxFinite);
+	 const __m128i isNaN = _mm_cmpgt_epi32(a, infinity);
+	 const __m128i special =
+	    _mm_or_si128(_mm_or_si128(halfInf, sign),
+			 _mm_and_si128(isNaN, one));
+	 const __m128i r = _mm_unpacklo_epi16(
+	    _mm_cvtps_ph(f, _MM_FROUND_TO_ZERO), _mm_setzero_si128());
+
+	 h[k] = _mm_or_si128(_mm_andnot_si128(isInf, r),
+			     _mm_and_si128(isInf, special));
+
+	 /* sign extend, so that packing doesn't saturate */
+	 h[k] = _mm_srai_epi32(_mm_slli_epi32(h[k], 16), 16);
+      }
+
+      _mm_storeu_si128((__m128i *) (dst + i), _mm_packs_epi32(h[0], h[1]));
+   }
+
+   return i;
+}
+
+#else
+
+GLuint
+_mesa_x86_64_f16c_float_to_half( GLhalfARB *dst, const GLfloat *src,
+				 GLuint n )
+{
+   (void) dst;
+   (void) src;
+   (void) n;
+   return 0;
+}
+
+#endif /* USE_F16C_HALF */
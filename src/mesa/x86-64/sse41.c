@@ -0,0 +1,310 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright (C) 2012  The Mesa Authors   All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+ * AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * SSE4.1 transform, normal and cliptest functions for x86-64.
+ *
+ * These are written with compiler intrinsics and the "target" function
+ * attribute, so the rest of Mesa doesn't have to be built with -msse4.1.
+ * They're only installed when CPUID reports SSE4.1, see
+ * _mesa_init_all_x86_64_transform_asm().
+ */
+
+#include "main/glheader.h"
+#include "main/macros.h"
+#include "math/m_xform.h"
+#include "x86-64.h"
+
+#ifdef DEBUG_MATH
+#include "math/m_debug.h"
+#endif
+
+#if defined(USE_X86_64_ASM) && \
+    (defined(__clang__) || \
+     (defined(__GNUC__) && \
+      (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define USE_SSE41_XFORM
+#endif
+
+
+#ifdef USE_SSE41_XFORM
+
+#include <smmintrin.h>
+
+#define SSE41_FUNC __attribute__((target("sse4.1")))
+
+
+/**
+ * Transform count points of the given size (2, 3 or 4) by a general 4x4
+ * matrix.  Each component of the point is broadcast and multiplied by
+ * the corresponding matrix column, so only the size components of the
+ * source are read.
+ */
+static inline SSE41_FUNC void
+transform_points_general( GLvector4f *to_vec,
+			  const GLfloat m[16],
+			  const GLvector4f *from_vec,
+			  const GLuint size )
+{
+   const GLuint stride = from_vec->stride;
+   GLfloat *from = from_vec->start;
+   GLfloat (*to)[4] = (GLfloat (*)[4])to_vec->start;
+   const GLuint count = from_vec->count;
+   const __m128 c0 = _mm_loadu_ps(m);
+   const __m128 c1 = _mm_loadu_ps(m + 4);
+   const __m128 c2 = _mm_loadu_ps(m + 8);
+   const __m128 c3 = _mm_loadu_ps(m + 12);
+   GLuint i;
+
+   for (i = 0; i < count; i++, STRIDE_F(from, stride)) {
+      __m128 r = _mm_mul_ps(c0, _mm_set1_ps(from[0]));
+      r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(from[1])));
+      if (size >= 3)
+	 r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(from[2])));
+      if (size == 4)
+	 r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_set1_ps(from[3])));
+      else
+	 r = _mm_add_ps(r, c3);
+      _mm_storeu_ps(to[i], r);
+   }
+
+   to_vec->size = 4;
+   to_vec->flags |= VEC_SIZE_4;
+   to_vec->count = from_vec->count;
+}
+
+
+static SSE41_FUNC void
+sse41_transform_points2_general( GLvector4f *to_vec,
+				 const GLfloat m[16],
+				 const GLvector4f *from_vec )
+{
+   transform_points_general(to_vec, m, from_vec, 2);
+}
+
+static SSE41_FUNC void
+sse41_transform_points3_general( GLvector4f *to_vec,
+				 const GLfloat m[16],
+				 const GLvector4f *from_vec )
+{
+   transform_points_general(to_vec, m, from_vec, 3);
+}
+
+
+/**
+ * SSE4.1 version of transform_normalize_normals() in m_norm_tmp.h.
+ * The normals are transformed by the upper 3x3 of the inverse matrix,
+ * transposed, and normalized with a single dpps.
+ */
+static SSE41_FUNC void
+sse41_transform_normalize_normals( const GLmatrix *mat,
+				   GLfloat scale,
+				   const GLvector4f *in,
+				   const GLfloat *lengths,
+				   GLvector4f *dest )
+{
+   GLfloat (*out)[4] = (GLfloat (*)[4])dest->start;
+   GLfloat *from = in->start;
+   const GLuint stride = in->stride;
+   const GLuint count = in->count;
+   const GLfloat *m = mat->inv;
+   __m128 c0 = _mm_setr_ps(m[0], m[4], m[8], 0.0F);
+   __m128 c1 = _mm_setr_ps(m[1], m[5], m[9], 0.0F);
+   __m128 c2 = _mm_setr_ps(m[2], m[6], m[10], 0.0F);
+   GLuint i;
+
+   if (!lengths) {
+      const __m128 one = _mm_set1_ps(1.0F);
+      const __m128 tiny = _mm_set1_ps(1e-20F);
+
+      for (i = 0; i < count; i++, STRIDE_F(from, stride)) {
+	 __m128 t, len;
+	 t = _mm_mul_ps(c0, _mm_set1_ps(from[0]));
+	 t = _mm_add_ps(t, _mm_mul_ps(c1, _mm_set1_ps(from[1])));
+	 t = _mm_add_ps(t, _mm_mul_ps(c2, _mm_set1_ps(from[2])));
+	 len = _mm_dp_ps(t, t, 0x77);
+	 t = _mm_mul_ps(t, _mm_div_ps(one, _mm_sqrt_ps(len)));
+	 /* zero vectors which are too short to normalize */
+	 t = _mm_and_ps(t, _mm_cmpgt_ps(len, tiny));
+	 _mm_storeu_ps(out[i], t);
+      }
+   }
+   else {
+      if (scale != 1.0F) {
+	 const __m128 s = _mm_set1_ps(scale);
+	 c0 = _mm_mul_ps(c0, s);
+	 c1 = _mm_mul_ps(c1, s);
+	 c2 = _mm_mul_ps(c2, s);
+      }
+
+      for (i = 0; i < count; i++, STRIDE_F(from, stride)) {
+	 __m128 t;
+	 t = _mm_mul_ps(c0, _mm_set1_ps(from[0]));
+	 t = _mm_add_ps(t, _mm_mul_ps(c1, _mm_set1_ps(from[1])));
+	 t = _mm_add_ps(t, _mm_mul_ps(c2, _mm_set1_ps(from[2])));
+	 _mm_storeu_ps(out[i], _mm_mul_ps(t, _mm_set1_ps(lengths[i])));
+      }
+   }
+
+   dest->count = in->count;
+}
+
+
+/**
+ * Compute the frustum clip mask of one clip-space vertex.
+ * Lane n of (w,w,w,w) + (-x,x,-y,y) is negative exactly when the C
+ * version sets clip bit n, so movmskps gives the x/y bits directly.
+ */
+static inline SSE41_FUNC GLubyte
+cliptest_vertex( __m128 v, GLboolean viewport_z_clip )
+{
+   const __m128 zero = _mm_setzero_ps();
+   const __m128 neg02 = _mm_setr_ps(-0.0F, 0.0F, -0.0F, 0.0F);
+   const __m128 w = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+   const __m128 xy = _mm_xor_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 0, 0)),
+				neg02);
+   GLuint mask = _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(xy, w), zero));
+
+   if (viewport_z_clip) {
+      const __m128 z = _mm_xor_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)),
+				  neg02);
+      const GLuint zmask =
+	 _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(z, w), zero));
+      if (zmask & 1)
+	 mask |= CLIP_FAR_BIT;
+      if (zmask & 2)
+	 mask |= CLIP_NEAR_BIT;
+   }
+
+   return (GLubyte) mask;
+}
+
+
+/**
+ * SSE4.1 version of cliptest_points4() in m_clip_tmp.h.
+ */
+static SSE41_FUNC GLvector4f *
+sse41_cliptest_points4( GLvector4f *clip_vec,
+			GLvector4f *proj_vec,
+			GLubyte clipMask[],
+			GLubyte *orMask,
+			GLubyte *andMask,
+			GLboolean viewport_z_clip )
+{
+   const GLuint stride = clip_vec->stride;
+   GLfloat *from = clip_vec->start;
+   const GLuint count = clip_vec->count;
+   GLfloat (*vProj)[4] = (GLfloat (*)[4])proj_vec->start;
+   const __m128 one = _mm_set1_ps(1.0F);
+   const __m128 culled = _mm_setr_ps(0.0F, 0.0F, 0.0F, 1.0F);
+   GLubyte tmpAndMask = *andMask;
+   GLubyte tmpOrMask = *orMask;
+   GLuint c = 0;
+   GLuint i;
+
+   for (i = 0; i < count; i++, STRIDE_F(from, stride)) {
+      const __m128 v = _mm_loadu_ps(from);
+      const GLubyte mask = cliptest_vertex(v, viewport_z_clip);
+
+      clipMask[i] = mask;
+      if (mask) {
+	 c++;
+	 tmpAndMask &= mask;
+	 tmpOrMask |= mask;
+	 _mm_storeu_ps(vProj[i], culled);
+      }
+      else {
+	 const __m128 oow = _mm_div_ps(one, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)));
+	 /* (x/w, y/w, z/w, 1/w) */
+	 _mm_storeu_ps(vProj[i], _mm_blend_ps(_mm_mul_ps(v, oow), oow, 0x8));
+      }
+   }
+
+   *orMask = tmpOrMask;
+   *andMask = (GLubyte) (c < count ? 0 : tmpAndMask);
+
+   proj_vec->flags |= VEC_SIZE_4;
+   proj_vec->size = 4;
+   proj_vec->count = clip_vec->count;
+   return proj_vec;
+}
+
+
+/**
+ * SSE4.1 version of cliptest_np_points4() in m_clip_tmp.h.
+ */
+static SSE41_FUNC GLvector4f *
+sse41_cliptest_np_points4( GLvector4f *clip_vec,
+			   GLvector4f *proj_vec,
+			   GLubyte clipMask[],
+			   GLubyte *orMask,
+			   GLubyte *andMask,
+			   GLboolean viewport_z_clip )
+{
+   const GLuint stride = clip_vec->stride;
+   GLfloat *from = clip_vec->start;
+   const GLuint count = clip_vec->count;
+   GLubyte tmpAndMask = *andMask;
+   GLubyte tmpOrMask = *orMask;
+   GLuint c = 0;
+   GLuint i;
+   (void) proj_vec;
+
+   for (i = 0; i < count; i++, STRIDE_F(from, stride)) {
+      const GLubyte mask = cliptest_vertex(_mm_loadu_ps(from), viewport_z_clip);
+
+      clipMask[i] = mask;
+      if (mask) {
+	 c++;
+	 tmpAndMask &= mask;
+	 tmpOrMask |= mask;
+      }
+   }
+
+   *orMask = tmpOrMask;
+   *andMask = (GLubyte) (c < count ? 0 : tmpAndMask);
+   return clip_vec;
+}
+
+#endif /* USE_SSE41_XFORM */
+
+
+void _mesa_init_sse41_transform_asm( void )
+{
+#ifdef USE_SSE41_XFORM
+   _mesa_transform_tab[2][MATRIX_GENERAL] = sse41_transform_points2_general;
+   _mesa_transform_tab[3][MATRIX_GENERAL] = sse41_transform_points3_general;
+
+   _mesa_normal_tab[NORM_TRANSFORM | NORM_NORMALIZE] =
+      sse41_transform_normalize_normals;
+
+   _mesa_clip_tab[4] = sse41_cliptest_points4;
+   _mesa_clip_np_tab[4] = sse41_cliptest_np_points4;
+
+#ifdef DEBUG_MATH
+   _math_test_all_transform_functions( "SSE4.1" );
+   _math_test_all_normal_transform_functions( "SSE4.1" );
+   _math_test_all_cliptest_functions( "SSE4.1" );
+#endif
+#endif
+}
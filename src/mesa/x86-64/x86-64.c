@@ -71,6 +71,80 @@ static void message( const char *msg )
 #endif
 
 
+/** Bitmask of X86_64_FEATURE_x bits */
+int _mesa_x86_64_cpu_features = 0x0;
+
+
+#ifdef USE_X86_64_ASM
+/* Read XCR0, to check that the OS saves the YMM registers. */
+static unsigned int xgetbv0( void )
+{
+   unsigned int eax, edx;
+   __asm__ __volatile__ (".byte 0x0f, 0x01, 0xd0"	/* xgetbv */
+			 : "=a" (eax), "=d" (edx) : "c" (0));
+   return eax;
+}
+#endif
+
+
+/**
+ * Initialize the _mesa_x86_64_cpu_features bitfield.
+ * This is a no-op if called more than once.
+ */
+void _mesa_get_x86_64_features( void )
+{
+#ifdef USE_X86_64_ASM
+   static int called = 0;
+   unsigned int regs[4], max_leaf;
+
+   if (called)
+      return;
+
+   called = 1;
+
+   if ( _mesa_getenv( "MESA_NO_ASM" ) ) {
+      return;
+   }
+
+   regs[0] = 0x00000000;
+   regs[1] = regs[2] = regs[3] = 0x00000000;
+   _mesa_x86_64_cpuid(regs);
+   max_leaf = regs[0];
+
+   regs[0] = 0x00000001;
+   regs[1] = regs[2] = regs[3] = 0x00000000;
+   _mesa_x86_64_cpuid(regs);
+
+   if (regs[2] & (1U << 19))
+      _mesa_x86_64_cpu_features |= X86_64_FEATURE_SSE4_1;
+
+   /* F16C is VEX encoded, so it also needs the AVX and OSXSAVE bits and
+    * the OS to have enabled the XMM and YMM state.
+    */
+   if ((regs[2] & (1U << 27)) &&
+       (regs[2] & (1U << 28)) &&
+       (regs[2] & (1U << 29)) &&
+       (xgetbv0() & 0x6) == 0x6)
+      _mesa_x86_64_cpu_features |= X86_64_FEATURE_F16C;
+
+   /* AVX2 needs the FMA, AVX and OSXSAVE bits here, leaf 7 to say the
+    * CPU has AVX2, and the OS to have enabled the XMM and YMM state.
+    */
+   if ((regs[2] & (1U << 12)) &&
+       (regs[2] & (1U << 27)) &&
+       (regs[2] & (1U << 28)) &&
+       max_leaf >= 7 &&
+       (xgetbv0() & 0x6) == 0x6) {
+      regs[0] = 0x00000007;
+      regs[1] = regs[2] = regs[3] = 0x00000000;
+      _mesa_x86_64_cpuid(regs);
+      if (regs[1] & (1U << 5))
+	 _mesa_x86_64_cpu_features |= X86_64_FEATURE_AVX2;
+   }
+#endif
+}
+
+
 void _mesa_init_all_x86_64_transform_asm(void)
 {
 #ifdef USE_X86_64_ASM
@@ -82,6 +156,8 @@ void _mesa_init_all_x86_64_transform_asm(void)
 
    message("Initializing x86-64 optimizations\n");
 
+   _mesa_get_x86_64_features();
+
 
    _mesa_transform_tab[4][MATRIX_GENERAL] =
       _mesa_x86_64_transform_points4_general;
@@ -108,6 +184,15 @@ void _mesa_init_all_x86_64_transform_asm(void)
 
    }
 
+   if (cpu_has_sse4_1) {
+      message("SSE4.1 detected\n");
+      _mesa_init_sse41_transform_asm();
+   }
+
+   if (cpu_has_avx2) {
+      message("AVX2 detected\n");
+      _mesa_init_avx2_transform_asm();
+   }
    
 #ifdef DEBUG_MATH
    _math_test_all_transform_functions("x86_64");
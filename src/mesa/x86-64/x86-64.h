@@ -26,6 +26,39 @@
 #ifndef __X86_64_ASM_H__
 #define __X86_64_ASM_H__
 
+#include "main/glheader.h"
+
+/** Bits in _mesa_x86_64_cpu_features */
+#define X86_64_FEATURE_SSE4_1	(1<<0)
+#define X86_64_FEATURE_AVX2	(1<<1)	/* AVX2 and FMA, with OS YMM support */
+#define X86_64_FEATURE_F16C	(1<<2)	/* F16C, with OS YMM support */
+
+#define cpu_has_sse4_1		(_mesa_x86_64_cpu_features & X86_64_FEATURE_SSE4_1)
+#define cpu_has_avx2		(_mesa_x86_64_cpu_features & X86_64_FEATURE_AVX2)
+#define cpu_has_f16c		(_mesa_x86_64_cpu_features & X86_64_FEATURE_F16C)
+
+extern int _mesa_x86_64_cpu_features;
+
+extern void _mesa_get_x86_64_features( void );
+
 extern void _mesa_init_all_x86_64_transform_asm( void );
 
+extern void _mesa_init_sse41_transform_asm( void );
+extern void _mesa_init_avx2_transform_asm( void );
+
+extern GLuint _mesa_x86_64_f16c_float_to_half( GLhalfARB *dst,
+					       const GLfloat *src, GLuint n );
+
+extern GLint _mesa_x86_64_avx2_do_row( GLenum datatype, GLuint comps,
+				       const GLvoid *srcRowA,
+				       const GLvoid *srcRowB,
+				       GLint dstWidth, GLvoid *dstRow );
+
+struct gl_texture_image;
+
+extern GLuint _mesa_x86_64_avx2_sample_2d_linear_repeat(
+   const struct gl_texture_image *img0, const struct gl_texture_image *img1,
+   GLuint n, const GLfloat texcoords[][4], const GLfloat lambda[],
+   GLfloat rgba[][4] );
+
 #endif